@@ -13,6 +13,7 @@
         'axe_http/axe_http.gyp:*',
         'axe_loader/axe_loader.gyp:*',
         'axys/axys.gyp:*',
+        'bench/bench.gyp:*',
         'main/afx2lg.gyp:*',
         'test/test.gyp:*',
       ],
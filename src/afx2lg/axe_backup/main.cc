@@ -3,25 +3,49 @@
 
 #include "common/common_types.h"
 
+#include "axefx/bank_dump_tracker.h"
 #include "axefx/preset.h"
 #include "axefx/sysex_types.h"
+#include "common/bounded_queue.h"
 #include "common/file_utils.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "json/writer.h"
 #include "midi/midi_in.h"
 #include "midi/midi_out.h"
 
+#include <condition_variable>
 #include <ctime>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
+#include <thread>
 
 using axefx::BankDumpRequest;
+using axefx::BankDumpTracker;
 using base::FileExists;
 using base::SharedThreadLoop;
 using std::placeholders::_1;
 using std::placeholders::_2;
 
+// The end of a dump is detected from the message sequence itself, so this
+// only kicks in if the AxeFx stops sending data half way through.
+const std::chrono::milliseconds kInactivityTimeout(10 * 1000);
+// Timeout for a single preset when re-requesting damaged presets.
+const std::chrono::milliseconds kRetryTimeout(2 * 1000);
+// How many times each damaged preset is requested before giving up.
+const int kMaxRetries = 3;
+// Room for all the messages of a bank.  MIDI input never waits for the
+// verify stage, so if it falls further behind than this, messages are
+// dropped and the presets they belong to are requested again.
+const size_t kVerifyQueueSize =
+    axefx::kPresetsPerBank * (axefx::kParameterBlocksPerPreset + 2);
+// Verified presets are written to disk in chunks of at least this size.
+const size_t kWriteChunkSize = 256 * 1024;
+
+static base::Counter g_dropped_messages("backup.dropped_messages");
+
 void PrintUsage() {
   std::cerr <<
       "Usage:\n\n"
@@ -38,7 +62,13 @@ void PrintUsage() {
       "    -j     Writes out a JSON file for each bank.\n"
       "\n"
       "If no arguments are given, a backup will be created for all banks and\n"
-      "system data.\n\n";
+      "system data.\n"
+      "\n"
+      "Set the AFX2LG_METRICS environment variable to print transfer\n"
+      "statistics when done.\n"
+      "\n"
+      "Add --trace=<file> or set the AFX2LG_TRACE environment variable to\n"
+      "write a trace that can be loaded in chrome://tracing.\n\n";
 }
 
 struct Options {
@@ -128,30 +158,182 @@ bool CreateOutputFile(std::string* name, std::ofstream* file) {
   return file->good();
 }
 
+// Receives a bank dump and writes it to disk.  The work is split into three
+// stages, connected by bounded queues, so that neither verification nor a
+// slow disk or terminal holds up reading from the MIDI device:
+//
+//  * OnSysEx() runs on the loop that drains MIDI input and only hands each
+//    message to the verify queue, without ever blocking.
+//  * The verify thread checks the messages, drives the BankDumpTracker and
+//    prints progress.  Verified presets are passed on to the write queue.
+//  * The write thread appends presets to the file in order, in large chunks,
+//    and converts them to JSON while the transfer is still going on.
+//
+// Presets that get damaged or lost on the way are requested again
+// individually (see RequestFailedPresets) and slotted in where they belong.
 class BackupWriter {
  public:
-  BackupWriter(std::ofstream* file, const SharedThreadLoop& loop)
-      : file_(file), loop_(loop), bytes_written_(0u), failed_(false) {
+  BackupWriter(const std::string& file_name, std::ofstream* file,
+               std::ofstream* json, const SharedThreadLoop& loop,
+               BankDumpRequest::BankId bank)
+      : file_name_(file_name), file_(file), json_(json), loop_(loop),
+        verify_queue_(kVerifyQueueSize),
+        write_queue_(axefx::kPresetsPerBank),
+        in_flight_(0),
+        dropped_(0),
+        tracker_(bank),
+        current_index_(-1),
+        current_corrupt_(false),
+        started_(false),
+        ready_(axefx::kPresetsPerBank),
+        next_write_(0),
+        json_presets_(axefx::kPresetsPerBank) {
+    write_buffer_.reserve(kWriteChunkSize);
+    verify_thread_ = std::thread(&BackupWriter::VerifyThread, this);
+    write_thread_ = std::thread(&BackupWriter::WriteThread, this);
   }
 
   ~BackupWriter() {
+    Stop();
+  }
+
+  bool failed() {
+    WaitForIdle();
+    return !tracker_.all_received();
+  }
+
+  size_t preset_count() {
+    WaitForIdle();
+    return tracker_.presets_received();
+  }
+
+  std::vector<int> failed_presets() {
+    WaitForIdle();
+    return tracker_.failed_presets();
   }
 
-  bool failed() const { return !bytes_written_ || failed_; }
-  size_t preset_count() const { return presets_.size(); }
+  // Must be called before re-requesting a preset that has failed.
+  void Retry(int preset_id) {
+    WaitForIdle();
+    tracker_.Retry(preset_id);
+  }
+
+  // Number of messages that were dropped because the verify queue was full.
+  int dropped_messages() {
+    std::lock_guard<std::mutex> lock(lock_);
+    return dropped_;
+  }
 
+  // Receive stage.  Called on the MIDI worker loop.
   void OnSysEx(midi::Message* msg) {
-    if (failed_)
+    // Take over the buffer instead of copying it.
+    unique_ptr<midi::Message> queued(new midi::Message());
+    queued->swap(*msg);
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      ++in_flight_;
+    }
+    if (verify_queue_.TryPush(&queued))
       return;
 
+    // Don't hold up MIDI input.  The tracker sees the gap and the preset is
+    // requested again after the dump.
+    g_dropped_messages.Add();
+    std::lock_guard<std::mutex> lock(lock_);
+    ++dropped_;
+    if (--in_flight_ == 0)
+      idle_.notify_all();
+  }
+
+  void OnTimeout() {
+    WaitForIdle();
+    std::cerr << "Timed out waiting for data.  Received "
+              << tracker_.presets_received() << " of "
+              << axefx::kPresetsPerBank << " presets.\n";
+    tracker_.OnTimeout();
+    current_preset_.reset();
+  }
+
+  // Waits for the remaining presets to be written, then flushes the file to
+  // disk along with the JSON file if there is one.
+  bool Finish() {
+    bool ok = !failed();
+    Stop();
+
+    if (ok && next_write_ == axefx::kPresetsPerBank) {
+      FlushWriteBuffer();
+      file_->close();
+      ok = !file_->fail() && base::SyncFile(file_name_);
+    } else {
+      file_->close();
+      ok = false;
+    }
+
+    if (ok && json_) {
+      Json::Value presets(Json::arrayValue);
+      for (auto& p : json_presets_)
+        presets.append(p);
+      Json::Value root;
+      root["bank"] = presets;
+      TRACE_EVENT0("io", "BackupWriter::WriteJson");
+      Json::StyledWriter writer;
+      *json_ << writer.write(root);
+      json_->flush();
+    }
+
+    return ok;
+  }
+
+ private:
+  // Holds on to a preset between the verify and write stages.
+  struct VerifiedPreset {
+    int index;
+    std::vector<uint8_t> data;
+    unique_ptr<axefx::Preset> preset;
+  };
+
+  void Stop() {
+    verify_queue_.Close();
+    if (verify_thread_.joinable())
+      verify_thread_.join();
+    write_queue_.Close();
+    if (write_thread_.joinable())
+      write_thread_.join();
+  }
+
+  // Waits until everything handed to the verify stage has been processed.
+  // The loop is not running when this is called, so no new messages arrive.
+  void WaitForIdle() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (in_flight_)
+      idle_.wait(lock);
+  }
+
+  void VerifyThread() {
+    base::SetTraceThreadName("verify");
+    unique_ptr<midi::Message> msg;
+    while (verify_queue_.Pop(&msg)) {
+      bool was_complete = tracker_.complete();
+      Verify(msg.get());
+      if (!was_complete && tracker_.complete())
+        loop_->Quit();
+
+      std::lock_guard<std::mutex> lock(lock_);
+      if (--in_flight_ == 0)
+        idle_.notify_all();
+    }
+  }
+
+  // Verify stage.
+  void Verify(midi::Message* msg) {
     // Check if the message is recognized as a Fractal message.
     // We'll start by ignoring the message checksum.
     if (!msg->IsFractalMessageNoChecksum()) {
-      if (bytes_written_) {
+      if (started_) {
         std::ostringstream stream;
         stream << "Received an unrecognized message (size=" << msg->size() <<
             ").\nAre there any other MIDI devices connected to the AxeFx?";
-        OnError(stream.str());
+        OnWarning(stream.str());
       } else {
 #ifndef NDEBUG
         std::cout << "Ignoring unrecognized/partial message.\n";
@@ -162,119 +344,185 @@ class BackupWriter {
 
     auto header =
         reinterpret_cast<const axefx::FractalSysExHeader*>(&msg->at(0));
-    if (header->function() == axefx::TEMPO_HEARTBEAT) {
-      if (bytes_written_) {
-        file_->close();
-        loop_->Quit();
-      } else {
-#ifndef NDEBUG
-        std::cerr
-            << "Received tempo message before starting to receive dump.\n";
-#endif
-      }
+    if (header->function() == axefx::TEMPO_HEARTBEAT ||
+        header->function() == axefx::TUNER_DATA) {
+      // These can be interleaved with the dump and are not part of it.
       return;
     }
 
     // From this point on all messages that we expect, should have a
-    // valid checksum.
+    // valid checksum.  Damaged messages are dropped, which makes the tracker
+    // mark the preset they belong to as failed.
     if (!msg->IsFractalMessageWithChecksum()) {
       std::ostringstream stream;
       stream << "Checksum error on message with function="
              << header->function();
-      OnError(stream.str());
+      OnWarning(stream.str());
       return;
     }
 
     switch (header->function()) {
       case axefx::PRESET_ID: {
         auto preset_hdr = static_cast<const axefx::PresetIdHeader*>(header);
+        if (!tracker_.OnPresetId(preset_hdr->id.As16bit()))
+          return;
+        started_ = true;
         std::cout << preset_hdr->id.As16bit() << ": ";
 
+        current_index_ = preset_hdr->id.As16bit() - tracker_.first_preset_id();
+        current_data_.clear();
         current_preset_.reset(new axefx::Preset());
-        if (!current_preset_->SetPresetId(*preset_hdr, msg->size())) {
-          OnError("Failed to parse preset ID header");
-          return;
-        }
+        current_corrupt_ =
+            !current_preset_->SetPresetId(*preset_hdr, msg->size());
         break;
       }
 
       case axefx::PRESET_PARAMETERS: {
-        if (!current_preset_.get()) {
-          OnError("Received out of band preset parameters.");
+        if (!tracker_.OnParameterBlock())
           return;
-        }
         auto param_header =
             static_cast<const axefx::ParameterBlockHeader*>(header);
-        if (!current_preset_->AddParameterData(*param_header, msg->size())) {
-          OnError("Failed to parse preset parameters");
-          return;
-        }
+        if (!current_preset_->AddParameterData(*param_header, msg->size()))
+          current_corrupt_ = true;
         break;
       }
 
       case axefx::PRESET_CHECKSUM: {
-        if (!current_preset_.get()) {
-          OnError("Received out of band preset checksum.");
-          return;
-        }
-
         auto checksum = static_cast<const axefx::PresetChecksumHeader*>(header);
-        if (!current_preset_->Finalize(checksum, msg->size(), true)) {
-          ASSERT(current_preset_->valid());
-          OnError("Preset checksum verification failed.\n");
+        bool verified = current_preset_.get() && !current_corrupt_ &&
+            current_preset_->Finalize(checksum, msg->size(), true);
+        if (!tracker_.OnChecksum(verified)) {
+          if (current_preset_.get())
+            std::cout << "<failed>\n";
+          current_preset_.reset();
           return;
         }
         std::cout << current_preset_->name() << " <verified>\n";
-        presets_.push_back(std::move(current_preset_));
-        break;
+        unique_ptr<VerifiedPreset> verified_preset(new VerifiedPreset());
+        verified_preset->index = current_index_;
+        verified_preset->data.swap(current_data_);
+        verified_preset->data.insert(verified_preset->data.end(),
+                                     msg->begin(), msg->end());
+        verified_preset->preset = std::move(current_preset_);
+        write_queue_.Push(std::move(verified_preset));
+        return;
       }
 
       default:
-        OnError("Unrecognized function: " + std::to_string(header->function()));
+        OnWarning("Unrecognized function: " +
+                  std::to_string(header->function()));
         return;
     }
 
-    file_->write(reinterpret_cast<const char*>(&msg->at(0)), msg->size());
-    bytes_written_ += msg->size();
+    if (current_preset_.get())
+      current_data_.insert(current_data_.end(), msg->begin(), msg->end());
   }
 
-  std::string ToJson() {
-    Json::Value presets;
-    for (auto& p : presets_) {
-      Json::Value preset;
-      p->ToJson(&preset);
-      presets.append(preset);
+  // Write stage.
+  void WriteThread() {
+    base::SetTraceThreadName("write");
+    unique_ptr<VerifiedPreset> p;
+    while (write_queue_.Pop(&p)) {
+      if (json_)
+        p->preset->ToJson(&json_presets_[p->index]);
+
+      // Presets that have been requested again arrive out of order, so hold
+      // on to anything that comes after a gap until the gap has been filled.
+      ready_[p->index].swap(p->data);
+      while (next_write_ < axefx::kPresetsPerBank &&
+             !ready_[next_write_].empty()) {
+        std::vector<uint8_t>& data = ready_[next_write_];
+        write_buffer_.insert(write_buffer_.end(), data.begin(), data.end());
+        std::vector<uint8_t>().swap(data);
+        ++next_write_;
+      }
+
+      if (write_buffer_.size() >= kWriteChunkSize)
+        FlushWriteBuffer();
     }
-    Json::Value root;
-    root["bank"] = presets;
-    Json::StyledWriter writer;
-    return writer.write(root);
   }
 
- private:
-  void OnError(const std::string& err) {
-    if (bytes_written_ == 0u) {
-      // Treat errors as just warnings before we actually start to
-      // receive data that we expect.  On Mac there can be 'leftovers' in
-      // the midi driver that it will give us when we connect.
-      std::cerr << "Warning: " << err << std::endl;
+  void FlushWriteBuffer() {
+    if (write_buffer_.empty())
       return;
-    }
-    failed_ = true;
-    std::cerr << "Error: " << err << std::endl;
-    file_->close();
-    loop_->Quit();
+    TRACE_EVENT1("io", "BackupWriter::FlushWriteBuffer", "bytes",
+                 write_buffer_.size());
+    file_->write(reinterpret_cast<const char*>(&write_buffer_[0]),
+                 write_buffer_.size());
+    write_buffer_.clear();
+  }
+
+  void OnWarning(const std::string& err) {
+    std::cerr << "Warning: " << err << std::endl;
   }
 
+  const std::string file_name_;
   std::ofstream* file_;
+  std::ofstream* json_;
   SharedThreadLoop loop_;
-  size_t bytes_written_;
-  bool failed_;
+
+  base::BoundedQueue<unique_ptr<midi::Message> > verify_queue_;
+  base::BoundedQueue<unique_ptr<VerifiedPreset> > write_queue_;
+  std::mutex lock_;
+  std::condition_variable idle_;
+  int in_flight_;  // Messages queued or being verified.  Guarded by |lock_|.
+  int dropped_;  // Guarded by |lock_|.
+
+  // Used by the verify stage.
+  BankDumpTracker tracker_;
+  int current_index_;
+  bool current_corrupt_;
+  bool started_;
+  std::vector<uint8_t> current_data_;
   unique_ptr<axefx::Preset> current_preset_;
-  std::vector<unique_ptr<axefx::Preset> > presets_;
+
+  // Used by the write stage.
+  std::vector<std::vector<uint8_t> > ready_;
+  int next_write_;
+  std::vector<uint8_t> write_buffer_;
+  std::vector<Json::Value> json_presets_;
+
+  std::thread verify_thread_;
+  std::thread write_thread_;
 };
 
+// Requests the presets that failed during the bank dump, one at a time,
+// until all of them have been received or we've run out of attempts.
+bool RequestFailedPresets(BackupWriter* writer, midi::MidiOut* midi_out,
+                          const SharedThreadLoop& loop) {
+  for (int attempt = 0; attempt < kMaxRetries; ++attempt) {
+    std::vector<int> failed(writer->failed_presets());
+    if (failed.empty())
+      return true;
+
+    // If nothing at all came through, the AxeFx isn't responding and asking
+    // for each preset in turn would just take a long time to fail.
+    if (writer->preset_count() == 0)
+      return false;
+
+    std::cout << "\nRequesting " << failed.size()
+              << " damaged preset(s) again...\n";
+    for (int id : failed) {
+      writer->Retry(id);
+      axefx::PresetDumpRequest request(static_cast<uint16_t>(id));
+      unique_ptr<midi::Message> message(
+          new midi::Message(&request, sizeof(request)));
+      if (!midi_out->Send(std::move(message), nullptr)) {
+        std::cerr << "Failed to send preset request.\n";
+        return false;
+      }
+      loop->set_timeout(kRetryTimeout);
+      if (!loop->Run())
+        writer->OnTimeout();
+    }
+  }
+
+  return writer->failed_presets().empty();
+}
+
 int main(int argc, char* argv[]) {
+  base::ScopedMetricsSummary metrics_summary;
+  base::ScopedTracing tracing(base::TakeTraceArgument(&argc, argv));
   Options options;
   if (!ParseArgs(argc, argv, &options)) {
     PrintUsage();
@@ -328,7 +576,8 @@ int main(int argc, char* argv[]) {
         (!options.json || CreateOutputFile(&files[i].json_name, &j))) {
       std::cout << "\nWriting " << files[i].description << " to "
                 << files[i].name << ".\n";
-      BackupWriter writer(&f, loop);
+      BackupWriter writer(files[i].name, &f, options.json ? &j : NULL, loop,
+                          files[i].bank_id);
       midi::SysExDataBuffer sysex_buffer(
           std::bind(&BackupWriter::OnSysEx, &writer, _1));
       sysex_buffer.Attach(midi_in);
@@ -336,12 +585,20 @@ int main(int argc, char* argv[]) {
       unique_ptr<midi::Message> message(
           new midi::Message(&request, sizeof(request)));
       if (midi_out->Send(std::move(message), nullptr)) {
-        // Run until we get a timeout.  When we time out, we assume that the
-        // transmission is done.
-        loop->set_timeout(std::chrono::milliseconds(3 * 1000));
-        loop->Run();
+        // The writer quits the loop as soon as the last preset has been
+        // verified (or on error).  The timeout only fires if the device
+        // goes quiet before that.
+        loop->set_timeout(kInactivityTimeout);
+        if (!loop->Run())
+          writer.OnTimeout();
+        if (writer.dropped_messages()) {
+          std::cerr << "Warning: Verification fell behind and "
+                    << writer.dropped_messages() << " messages were"
+                    " dropped.\n";
+        }
 
-        if (writer.failed()) {
+        if (!RequestFailedPresets(&writer, midi_out.get(), loop) ||
+            !writer.Finish()) {
           std::cerr <<
             "\nErrors were detected in the backup data.\n\n"
             "It is possible that using other apps, typing or using"
@@ -356,10 +613,6 @@ int main(int argc, char* argv[]) {
           return -1;
         }
 
-        if (options.json) {
-          j << writer.ToJson();
-          j.flush();
-        }
         std::cout << "\n" << "Backup " << files[i].name << " ready.\n";
       } else {
         std::cerr << "Failed to send bank request.\n";
@@ -3,10 +3,13 @@
 
 #include "axe_http/server.h"
 
+#include "common/metrics.h"
+
 #include <algorithm>
 #include <climits>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 using std::placeholders::_1;
 
@@ -104,6 +107,9 @@ bool Server::Initialize(uint16_t port) {
       std::make_pair(
           "/", std::bind(&Server::OnServeFile, this, "edit.html", _1)));
 
+  request_map_.insert(
+      std::make_pair("/metrics", std::bind(&Server::OnMetrics, this, _1)));
+
   // Should we bind to only the local IP (127.0.0.1) to avoid connections
   // from other machines?
   if (!listener_.Create() || !listener_.Listen(port))
@@ -200,6 +206,12 @@ void Server::OnQuit(const unique_ptr<DataSocket>& s) {
   quit_ = true;
 }
 
+void Server::OnMetrics(const unique_ptr<DataSocket>& s) {
+  std::ostringstream summary;
+  base::WriteMetricsSummary(&summary);
+  s->Send("200 OK", true, "text/plain", "", summary.str());
+}
+
 void Server::GarbageCollect() {
   for (auto it = sockets_.begin(); it != sockets_.end(); ++it) {
     if (!(*it)->valid()) {
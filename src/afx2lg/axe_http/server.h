@@ -33,6 +33,9 @@ class Server {
 
   void OnQuit(const unique_ptr<DataSocket>& s);
 
+  // Serves the metrics summary as plain text.
+  void OnMetrics(const unique_ptr<DataSocket>& s);
+
   void OnServeFile(const std::string& path, const unique_ptr<DataSocket>& s);
 
   // Goes through all sockets and deletes the closed ones.
@@ -7,6 +7,9 @@
 #include "axefx/preset.h"
 #include "axefx/sysex_types.h"
 #include "common/file_utils.h"
+#include "common/metrics.h"
+#include "common/trace.h"
+#include "midi/device_session.h"
 #include "midi/midi_in.h"
 #include "midi/midi_out.h"
 
@@ -25,6 +28,9 @@ using std::placeholders::_2;
 
 typedef std::queue<unique_ptr<midi::Message> > MessageQueue;
 
+// How long to wait for the AxeFx to acknowledge a request.
+const std::chrono::milliseconds kReplyTimeout(10 * 1000);
+
 void PrintUsage() {
   std::cerr <<
       "Usage:\n\n"
@@ -45,6 +51,12 @@ void PrintUsage() {
       "\n"
       "Firmware files can be sent to the AxeFx but you'll be prompted before\n"
       "the data is sent\n"
+      "\n"
+      "Set the AFX2LG_METRICS environment variable to print transfer\n"
+      "statistics when done.\n"
+      "\n"
+      "Add --trace=<file> or set the AFX2LG_TRACE environment variable to\n"
+      "write a trace that can be loaded in chrome://tracing.\n"
       "\n";
 }
 
@@ -71,28 +83,55 @@ unique_ptr<midi::Message> PopMessage(MessageQueue* q) {
   return m;
 }
 
-void SendMessage(const SharedThreadLoop& loop,
-                 midi::MidiOut* midi_out,
-                 MessageQueue* q,
-                 std::function<void()>& on_complete) {
-  if (q->empty()) {
-    loop->Quit();
-  } else {
-    midi_out->Send(PopMessage(q), on_complete);
+// Sends the messages in a queue one at a time.  Each message is sent from
+// the loop and the next one is queued when the previous one has been written.
+// The task and the completion callback only hold a pointer to the sender, so
+// they fit in the inline storage of ThreadLoop::Task and std::function and
+// nothing is allocated per message.
+class MessageSender {
+ public:
+  MessageSender(const SharedThreadLoop& loop,
+                midi::MidiOut* midi_out,
+                MessageQueue* queue)
+      : loop_(loop), midi_out_(midi_out), queue_(queue) {
+    OnSent callback = { this };
+    on_complete_ = callback;
   }
-}
 
-void QueueNext(const SharedThreadLoop& loop,
-               midi::MidiOut* midi_out,
-               MessageQueue* q) {
-  if (q->empty()) {
-    loop->Quit();
-  } else {
-    std::function<void()> on_complete(std::bind(&QueueNext, loop, midi_out, q));
-    loop->QueueTask(std::bind(&SendMessage, loop, midi_out, q, on_complete));
-    std::cout << "#";
+  void Start() { QueueNext(); }
+
+ private:
+  // std::bind with a member function is too big to be stored inline by
+  // std::function, which copies |on_complete_| for each message.
+  struct OnSent {
+    MessageSender* sender;
+    void operator()() const { sender->QueueNext(); }
+  };
+
+  void QueueNext() {
+    if (queue_->empty()) {
+      loop_->Quit();
+    } else {
+      loop_->QueueTask(std::bind(&MessageSender::SendNext, this));
+      std::cout << "#";
+    }
   }
-}
+
+  void SendNext() {
+    if (queue_->empty()) {
+      loop_->Quit();
+    } else {
+      midi_out_->Send(PopMessage(queue_), on_complete_);
+    }
+  }
+
+  SharedThreadLoop loop_;
+  midi::MidiOut* midi_out_;
+  MessageQueue* queue_;
+  std::function<void()> on_complete_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageSender);
+};
 
 void Wait() {
   std::cin.sync();
@@ -100,24 +139,9 @@ void Wait() {
   std::cin.get();
 }
 
-// TODO: Move this function to a common utility file.
-bool IsTempoOrTuner(midi::Message* msg) {
-  return msg->IsFractalMessageType(axefx::TEMPO_HEARTBEAT) ||
-         msg->IsFractalMessageType(axefx::TUNER_DATA);
-}
-
-// TODO: Move this function to a common utility file.
-void AssignToBufferAndQuit(midi::Message* new_message,
-                           const shared_ptr<base::ThreadLoop>& loop,
-                           midi::Message* message) {
-  if (!new_message->IsSysEx()) {
-    std::cerr << "Ignoring non-sysex (partial?) message\n";
-    return;
-  }
-
-  new_message->swap(*message);
-  ASSERT(!message->empty());
-  loop->Quit();
+void AssignStatus(midi::DeviceSession::Status* status,
+                  midi::DeviceSession::Status response_status) {
+  *status = response_status;
 }
 
 bool SwitchToFwUpdatePage(const shared_ptr<midi::MidiIn>& midi_in,
@@ -126,47 +150,34 @@ bool SwitchToFwUpdatePage(const shared_ptr<midi::MidiIn>& midi_in,
   // Switch to the FW update screen.
   std::cout << "Switching unit to firmware update mode.\n";
 
-  axefx::GenericNoDataMessage request(axefx::FIRMWARE_UPDATE);
-  unique_ptr<midi::Message> message(
-      new midi::Message(&request, sizeof(request)));
-
-  midi::Message data;
-  midi::SysExDataBuffer buffer(
-      std::bind(&AssignToBufferAndQuit, _1, loop, &data));
-  midi::ScopedBufferAttach scoped_attach(midi_in, &buffer);
-  if (!midi_out->Send(std::move(message), nullptr)) {
-    std::cerr << "Failed to send a midi message.\n";
-    return false;
-  }
-
-  // Wait until we get a confirmation.
-  while (loop->Run()) {
-    if (!IsTempoOrTuner(&data)) {
-      if (axefx::IsFractalSysEx(&data[0], data.size()))
-        break;
-    }
-    data.clear();
-  }
-
-  if (!axefx::IsFractalSysEx(&data[0], data.size())) {
-    std::cerr << "Didn't receive a valid confirmation message\n";
-    return false;
+  midi::DeviceSession session(midi_in, midi_out.get(), loop);
+  midi::DeviceSession::Status status = midi::DeviceSession::CANCELLED;
+  session.SwitchToFirmwareUpdate(kReplyTimeout,
+                                 std::bind(&AssignStatus, &status, _1));
+  session.Run();
+
+  switch (status) {
+    case midi::DeviceSession::OK:
+      return true;
+    case midi::DeviceSession::SEND_FAILED:
+      std::cerr << "Failed to send a midi message.\n";
+      return false;
+    case midi::DeviceSession::TIMED_OUT:
+      std::cerr << "Didn't receive a valid confirmation message\n";
+      return false;
+    case midi::DeviceSession::DISCONNECTED:
+      std::cerr << "Lost the connection to the AxeFx\n";
+      return false;
+    default:
+      std::cerr << "Failed to switch to fw update mode. "
+                   "You may need to reboot the AxeFx\n";
+      return false;
   }
-
-  auto p = reinterpret_cast<const axefx::FractalSysExHeader*>(&data[0]);
-  auto r = static_cast<const axefx::ReplyMessage*>(p);
-  if (p->function() != axefx::REPLY ||
-      r->reply_to() != axefx::FIRMWARE_UPDATE ||
-      r->error_id != 0) {
-    std::cerr << "Failed to switch to fw update mode. "
-                 "You may need to reboot the AxeFx\n";
-    return false;
-  }
-
-  return true;
 }
 
 int main(int argc, char* argv[]) {
+  base::ScopedMetricsSummary metrics_summary;
+  base::ScopedTracing tracing(base::TakeTraceArgument(&argc, argv));
   std::string path;
   if (!ParseArgs(argc, argv, &path)) {
     PrintUsage();
@@ -228,7 +239,8 @@ int main(int argc, char* argv[]) {
     return -1;
   }
 
-  QueueNext(loop, midi_out.get(), &messages);
+  MessageSender sender(loop, midi_out.get(), &messages);
+  sender.Start();
   loop->Run();
 
   std::cout << "\n\nAll done\n";
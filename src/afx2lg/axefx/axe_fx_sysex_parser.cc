@@ -6,11 +6,20 @@
 #include "axefx/blocks.h"
 #include "axefx/ir_data.h"
 #include "axefx/preset.h"
+#include "common/metrics.h"
+#include "common/thread_pool.h"
+#include "common/trace.h"
 
 #include <iostream>
 
 namespace axefx {
 
+static base::Counter g_bytes_parsed("axefx.parser.bytes");
+static base::Counter g_frames_parsed("axefx.parser.frames");
+static base::Counter g_bad_frames("axefx.parser.checksum_failures");
+static base::Counter g_bad_irs("axefx.parser.ir_checksum_failures");
+static base::Histogram g_parse_time("axefx.parser.parse_us");
+
 FirmwareData::FirmwareData(const FirmwareBeginHeader& header)
     : expected_total_words_(header.count.Decode()) {
   data_.reserve(expected_total_words_);
@@ -59,6 +68,16 @@ bool FirmwareData::Verify(const FirmwareChecksumHeader& header) {
   return true;
 }
 
+base::MemoryUsage FirmwareData::MemoryUsage() const {
+  base::MemoryUsage usage(sizeof(*this), 1);
+  usage += base::HeapUsage(data_);
+  return usage;
+}
+
+void FirmwareData::Compact() {
+  data_.shrink_to_fit();
+}
+
 bool FirmwareData::Serialize(const SysExCallback& callback) const {
   ASSERT(expected_total_words_ == data_.size());
 
@@ -110,17 +129,67 @@ bool FirmwareData::Serialize(const SysExCallback& callback) const {
   return true;
 }
 
-SysExParser::SysExParser() : type_(UNKNOWN) {
+namespace {
+// A preset whose checksum message has been seen, waiting to be finalized.
+struct PendingPreset {
+  shared_ptr<Preset> preset;
+  const PresetChecksumHeader* checksum;
+  size_t size;
+  bool ok;
+};
+
+void FinalizePending(std::vector<PendingPreset>* pending,
+                     bool verify_only, size_t index) {
+  PendingPreset& p = (*pending)[index];
+  p.ok = p.preset->Finalize(p.checksum, p.size, verify_only);
+}
+}  // namespace
+
+SysExParser::SysExParser() : type_(UNKNOWN), pool_(NULL) {
 }
 
 SysExParser::~SysExParser() {
 }
 
+base::MemoryUsage SysExParser::MemoryUsage() const {
+  base::MemoryUsage usage(sizeof(*this), 1);
+  for (const auto& entry: presets_) {
+    usage += base::MemoryUsage(
+        base::kTreeNodeOverhead + sizeof(entry) +
+        base::kSharedPtrControlBlock, 2);
+    usage += entry.second->MemoryUsage();
+  }
+
+  usage += base::HeapUsage(ir_array_);
+  for (const auto& entry: ir_array_)
+    usage += entry->MemoryUsage();
+
+  if (firmware_)
+    usage += firmware_->MemoryUsage();
+
+  return usage;
+}
+
+void SysExParser::Compact() {
+  for (auto& entry: presets_)
+    entry.second->Compact();
+
+  ir_array_.shrink_to_fit();
+  for (auto& entry: ir_array_)
+    entry->Compact();
+
+  if (firmware_)
+    firmware_->Compact();
+}
+
 bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
                                    bool parse_parameter_data) {
   ASSERT(!firmware_);
   ASSERT(ir_array_.empty());
   ASSERT(presets_.empty() || (type_ == PRESET || type_ == PRESET_ARCHIVE));
+  TRACE_EVENT1("axefx", "SysExParser::ParseSysExBuffer", "bytes", end - begin);
+  base::ScopedHistogramTimer timer(&g_parse_time);
+  g_bytes_parsed.Add(end - begin);
 
   const uint8_t* sys_ex_begins = NULL;
   const uint8_t* pos = begin;
@@ -128,6 +197,7 @@ bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
   shared_ptr<Preset> preset;
   unique_ptr<IRData> ir_data;
   unique_ptr<FirmwareData> firmware;
+  std::vector<PendingPreset> pending;
 
   while (pos < end) {
     if (pos[0] == kSysExStart) {
@@ -136,7 +206,9 @@ bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
     } else if (pos[0] == kSysExEnd) {
       ASSERT(sys_ex_begins);
       size_t size = (pos - sys_ex_begins) + 1;
+      g_frames_parsed.Add();
       if (!IsFractalSysEx(sys_ex_begins, size)) {
+        g_bad_frames.Add();
 #ifndef NDEBUG
         std::cerr << "This doesn't look like an AxeFx preset file\n";
 #endif
@@ -173,8 +245,11 @@ bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
         case PRESET_CHECKSUM: {
           ASSERT(preset);
           auto checksum = static_cast<const PresetChecksumHeader*>(&header);
-          if (preset &&
-              preset->Finalize(checksum, size, !parse_parameter_data)) {
+          if (preset && pool_) {
+            PendingPreset p = { preset, checksum, size, false };
+            pending.push_back(p);
+          } else if (preset &&
+                     preset->Finalize(checksum, size, !parse_parameter_data)) {
             ASSERT(preset->valid());
             presets_.insert(std::make_pair(preset->id(), preset));
           } else {
@@ -206,6 +281,7 @@ bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
           ASSERT(ir_data);
           auto checksum = static_cast<const IRChecksumHeader*>(&header);
           if (!ir_data || checksum->checksum.Decode() != ir_data->Checksum()) {
+            g_bad_irs.Add();
             std::cerr
                 << "Invalid/corrupt IR data or not meant for the AxeFx II\n";
             return false;
@@ -256,6 +332,20 @@ bool SysExParser::ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
     ++pos;
   }
 
+  if (!pending.empty()) {
+    pool_->ParallelFor(0, pending.size(),
+        std::bind(&FinalizePending, &pending, !parse_parameter_data,
+                  std::placeholders::_1));
+    for (auto& p : pending) {
+      if (!p.ok) {
+        std::cerr << "Failed to parse preset data." << std::endl;
+        return false;
+      }
+      ASSERT(p.preset->valid());
+      presets_.insert(std::make_pair(p.preset->id(), p.preset));
+    }
+  }
+
   if (preset.get() && presets_.empty()) {
     // This is a possible bug in the AxeFx (experienced with 9.02) where
     // a parameter checksum won't be included with a preset dump.
@@ -10,9 +10,14 @@
 #include "axefx/preset_parameters.h"
 #include "axefx/sysex_callback.h"
 #include "axefx/sysex_types.h"
+#include "common/memory_usage.h"
 
 #include <map>
 
+namespace base {
+class ThreadPool;
+}
+
 namespace axefx {
 
 class IRData;
@@ -31,6 +36,11 @@ class FirmwareData {
 
   bool Serialize(const SysExCallback& callback) const;
 
+  // Memory held by the firmware, including the object itself.
+  base::MemoryUsage MemoryUsage() const;
+  // Releases unused container capacity.
+  void Compact();
+
  private:
   uint32_t expected_total_words_;
   std::vector<uint32_t> data_;
@@ -49,6 +59,10 @@ class SysExParser {
     FIRMWARE,
   };
 
+  // When set, the presets of a bank are finalized (verified, decompressed
+  // and parsed) in parallel on |pool|.
+  void set_thread_pool(base::ThreadPool* pool) { pool_ = pool; }
+
   bool ParseSysExBuffer(const uint8_t* begin, const uint8_t* end,
                         bool parse_parameter_data);
 
@@ -59,11 +73,19 @@ class SysExParser {
 
   bool Serialize(const SysExCallback& callback) const;
 
+  // Memory held by the parser and everything it has parsed, including the
+  // parser object itself.  Presets that are shared with other owners are
+  // counted in full.
+  base::MemoryUsage MemoryUsage() const;
+  // Compacts all presets, IRs and firmware data.
+  void Compact();
+
  private:
   PresetMap presets_;
   IRDataArray ir_array_;
   unique_ptr<FirmwareData> firmware_;
   DataType type_;
+  base::ThreadPool* pool_;
 
   DISALLOW_COPY_AND_ASSIGN(SysExParser);
 };
@@ -12,6 +12,8 @@
       'target_name': 'axefx_types',
       'type': 'none',
       'sources': [
+        'AxeFxII_7.axeml',
+        'AxeFxII_7_3.profile',
         'AxeFxII_9_2.axeml',
         'type_gen.py',
       ],
@@ -20,14 +22,19 @@
           'action_name': 'generate_types',
           'msvs_cygwin_shell': 0,
           'inputs': [
+            'AxeFxII_7.axeml',
+            'AxeFxII_7_3.profile',
             'AxeFxII_9_2.axeml',
+            'type_gen.py',
           ],
           'outputs': [
             'axefx_ii_ids.cc',
             'axefx_ii_ids.h',
+            'axefx_ii_schemas.cc',
           ],
           'action': [
-            'python', 'type_gen.py', 'AxeFxII_9_2.axeml', './'
+            'python', 'type_gen.py', 'AxeFxII_7.axeml', 'AxeFxII_7_3.profile',
+            'AxeFxII_9_2.axeml', './'
           ],
         },
       ],
@@ -42,6 +49,7 @@
       ],
       'dependencies': [
         '../../bcl/bcl.gyp:bcl',
+        '../common/base.gyp:base',
         '../jsoncpp/jsoncpp.gyp:*',
         'axefx_types',
       ],
@@ -50,14 +58,22 @@
         'axe_fx_sysex_parser.h',
         'axefx_ii_ids.cc',
         'axefx_ii_ids.h',
+        'axefx_ii_schemas.cc',
+        'bank_dump_tracker.cc',
+        'bank_dump_tracker.h',
         'blocks.cc',
         'blocks.h',
         'ir_data.cc',
         'ir_data.h',
+        'param_converter.cc',
+        'param_converter.h',
+        'perfect_hash.h',
         'preset.cc',
         'preset.h',
         'preset_parameters.cc',
         'preset_parameters.h',
+        'schema.cc',
+        'schema.h',
         'sysex_callback.h',
         'sysex_types.cc',
         'sysex_types.h',
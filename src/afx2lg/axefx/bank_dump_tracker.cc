@@ -0,0 +1,103 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "axefx/bank_dump_tracker.h"
+
+#include <algorithm>
+
+namespace axefx {
+
+BankDumpTracker::BankDumpTracker(BankDumpRequest::BankId bank)
+    : first_preset_id_(static_cast<int>(bank) * kPresetsPerBank),
+      status_(kPresetsPerBank, PENDING),
+      current_(-1),
+      parameter_blocks_(0),
+      received_(0) {
+}
+
+BankDumpTracker::~BankDumpTracker() {}
+
+bool BankDumpTracker::complete() const {
+  return !is_receiving() &&
+         std::find(status_.begin(), status_.end(), PENDING) == status_.end();
+}
+
+std::vector<int> BankDumpTracker::failed_presets() const {
+  std::vector<int> ret;
+  for (size_t i = 0; i < status_.size(); ++i) {
+    if (status_[i] == FAILED)
+      ret.push_back(first_preset_id_ + static_cast<int>(i));
+  }
+  return ret;
+}
+
+bool BankDumpTracker::OnPresetId(int preset_id) {
+  // A new preset before the checksum of the current one means that we've
+  // lost the rest of the current preset.
+  if (is_receiving())
+    FailCurrent();
+
+  int index = preset_id - first_preset_id_;
+  if (index < 0 || index >= kPresetsPerBank || status_[index] != PENDING)
+    return false;
+
+  // Presets are sent in ascending order, so anything before this one that
+  // we're still waiting for, got lost on the way.
+  for (int i = 0; i < index; ++i) {
+    if (status_[i] == PENDING)
+      status_[i] = FAILED;
+  }
+
+  current_ = index;
+  parameter_blocks_ = 0;
+  return true;
+}
+
+bool BankDumpTracker::OnParameterBlock() {
+  if (!is_receiving())
+    return false;
+
+  if (++parameter_blocks_ > kParameterBlocksPerPreset) {
+    FailCurrent();
+    return false;
+  }
+
+  return true;
+}
+
+bool BankDumpTracker::OnChecksum(bool verified) {
+  if (!is_receiving())
+    return false;
+
+  if (!verified || parameter_blocks_ != kParameterBlocksPerPreset) {
+    FailCurrent();
+    return false;
+  }
+
+  status_[current_] = RECEIVED;
+  ++received_;
+  current_ = -1;
+  return true;
+}
+
+void BankDumpTracker::OnTimeout() {
+  if (is_receiving())
+    FailCurrent();
+  std::replace(status_.begin(), status_.end(), PENDING, FAILED);
+}
+
+void BankDumpTracker::Retry(int preset_id) {
+  int index = preset_id - first_preset_id_;
+  ASSERT(index >= 0 && index < kPresetsPerBank);
+  ASSERT(status_[index] == FAILED);
+  if (index >= 0 && index < kPresetsPerBank && status_[index] == FAILED)
+    status_[index] = PENDING;
+}
+
+void BankDumpTracker::FailCurrent() {
+  ASSERT(is_receiving());
+  status_[current_] = FAILED;
+  current_ = -1;
+}
+
+}  // namespace axefx
@@ -0,0 +1,84 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef AXEFX_BANK_DUMP_TRACKER_H_
+#define AXEFX_BANK_DUMP_TRACKER_H_
+
+#include "common/common_types.h"
+
+#include "axefx/sysex_types.h"
+
+#include <vector>
+
+namespace axefx {
+
+const int kPresetsPerBank = 128;
+const int kParameterBlocksPerPreset = 32;
+
+// Keeps track of where we are in the message sequence of a bank dump so that
+// we know exactly when the dump is complete instead of waiting for the device
+// to go quiet.  A bank dump (including the system bank) consists of 128
+// presets, each sent as a PRESET_ID message, followed by 32 PRESET_PARAMETERS
+// messages and finally a PRESET_CHECKSUM message.  The preset IDs are sent in
+// ascending order starting at bank_id * 128.
+//
+// Presets that fail checksum verification or are partially or entirely
+// missing from the stream are recorded as failed rather than failing the
+// whole dump.  They can then be requested individually and fed through the
+// same tracker after calling Retry().
+class BankDumpTracker {
+ public:
+  explicit BankDumpTracker(BankDumpRequest::BankId bank);
+  ~BankDumpTracker();
+
+  // True when every preset in the bank has either been received or has
+  // failed, i.e. there's nothing more to wait for.
+  bool complete() const;
+  // True when every preset in the bank has been received and verified.
+  bool all_received() const { return received_ == kPresetsPerBank; }
+
+  int first_preset_id() const { return first_preset_id_; }
+  int presets_received() const { return received_; }
+  // The IDs of presets that need to be requested again, in ascending order.
+  std::vector<int> failed_presets() const;
+
+  // Each of these methods advances the state machine.  They return true if
+  // the message belongs to a preset that is still valid and false if the
+  // message should be dropped (along with any data received so far for the
+  // current preset).
+  bool OnPresetId(int preset_id);
+  bool OnParameterBlock();
+  // |verified| is the result of verifying the preset checksum.
+  // Returns true if the preset has been received successfully.
+  bool OnChecksum(bool verified);
+
+  // Call when the device has stopped sending data.  Marks the preset being
+  // received as well as all presets that haven't arrived yet, as failed.
+  void OnTimeout();
+
+  // Marks a failed preset as pending again, before re-requesting it.
+  void Retry(int preset_id);
+
+ private:
+  enum Status {
+    PENDING,
+    RECEIVED,
+    FAILED,
+  };
+
+  bool is_receiving() const { return current_ != -1; }
+  void FailCurrent();
+
+  const int first_preset_id_;
+  std::vector<Status> status_;
+  int current_;  // Index into |status_| of the preset being received or -1.
+  int parameter_blocks_;
+  int received_;
+
+  DISALLOW_COPY_AND_ASSIGN(BankDumpTracker);
+};
+
+}  // namespace axefx
+
+#endif  // AXEFX_BANK_DUMP_TRACKER_H_
@@ -122,11 +122,20 @@ void BlockInMatrix::ToJson(Json::Value* out) const {
 }
 
 BlockParameters::BlockParameters()
-    : block_(BLOCK_INVALID),
+    : schema_(&GetLatestSchema()),
+      block_(BLOCK_INVALID),
       config_(CONFIG_X),
       global_block_index_(0u) {
 }
 
+BlockParameters::BlockParameters(const FirmwareSchema* schema)
+    : schema_(schema),
+      block_(BLOCK_INVALID),
+      config_(CONFIG_X),
+      global_block_index_(0u) {
+  ASSERT(schema);
+}
+
 BlockParameters::~BlockParameters() {}
 
 // Populates the block parameters from a 16bit value array.
@@ -213,19 +222,29 @@ void BlockParameters::SetParamValue(int index,
 }
 
 BlockSceneState BlockParameters::GetBypassState() const {
-  int bypass_id = GetBlockBypassParamID(type());
+  int bypass_id = schema_->GetBypassParamID(type());
   return bypass_id == -1 ? BlockSceneState(0) :
                            BlockSceneState(GetParamValue(bypass_id, true));
 }
 
 bool BlockParameters::SetBypassState(const BlockSceneState& state) {
-  int bypass_id = GetBlockBypassParamID(type());
+  int bypass_id = schema_->GetBypassParamID(type());
   if (bypass_id == -1)
     return false;
   SetParamValue(bypass_id, state.As16bit(), true);
   return true;
 }
 
+base::MemoryUsage BlockParameters::MemoryUsage() const {
+  base::MemoryUsage usage(sizeof(*this), 1);
+  usage += base::HeapUsage(params_);
+  return usage;
+}
+
+void BlockParameters::Compact() {
+  params_.shrink_to_fit();
+}
+
 void BlockParameters::ToJson(Json::Value* out) const {
   Json::Value& j = *out;
   AxeFxBlockType block_type = GetBlockType(block_);
@@ -241,13 +260,13 @@ void BlockParameters::ToJson(Json::Value* out) const {
   size_t y_offset = params_.size() / 2u;
 
   if (block_type == BLOCK_TYPE_AMP && !params_.empty()) {
-    j["amp_x"] = GetAmpName(params_[DISTORT_TYPE]);
-    j["amp_y"] = GetAmpName(params_[y_offset + DISTORT_TYPE]);
+    j["amp_x"] = schema_->GetAmpName(params_[DISTORT_TYPE]);
+    j["amp_y"] = schema_->GetAmpName(params_[y_offset + DISTORT_TYPE]);
   } else if (block_type == BLOCK_TYPE_CAB) {
-    j["cab_x_left"] = GetCabName(params_[CABINET_TYPEL]);
-    j["cab_x_right"] = GetCabName(params_[CABINET_TYPER]);
-    j["cab_y_left"] = GetCabName(params_[y_offset + CABINET_TYPEL]);
-    j["cab_y_right"] = GetCabName(params_[y_offset + CABINET_TYPER]);
+    j["cab_x_left"] = schema_->GetCabName(params_[CABINET_TYPEL]);
+    j["cab_x_right"] = schema_->GetCabName(params_[CABINET_TYPER]);
+    j["cab_y_left"] = schema_->GetCabName(params_[y_offset + CABINET_TYPEL]);
+    j["cab_y_right"] = schema_->GetCabName(params_[y_offset + CABINET_TYPER]);
   }
 
   std::string default_param_prefix(type_name);
@@ -266,7 +285,7 @@ void BlockParameters::ToJson(Json::Value* out) const {
     int v = 0;
     for (size_t i = 0; i < params_.size(); ++i) {
       const char* param_name =
-          GetParamName(block_type, static_cast<int>(i % y_offset));
+          schema_->GetParamName(block_type, static_cast<int>(i % y_offset));
       if (i == y_offset)
         ++v;
 
@@ -281,7 +300,8 @@ void BlockParameters::ToJson(Json::Value* out) const {
     values["y"] = values_y;
   } else {
     for (size_t i = 0; i < params_.size(); ++i) {
-      const char* param_name = GetParamName(block_type, static_cast<int>(i));
+      const char* param_name =
+          schema_->GetParamName(block_type, static_cast<int>(i));
       if (!param_name[0]) {
         values[default_param_prefix + std::to_string(i)] = params_[i];
       } else {
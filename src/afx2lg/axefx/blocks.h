@@ -7,6 +7,8 @@
 
 #include "common/common_types.h"
 #include "axefx/axefx_ii_ids.h"
+#include "axefx/schema.h"
+#include "common/memory_usage.h"
 
 #include <vector>
 
@@ -80,7 +82,11 @@ enum BlockConfig {
 
 class BlockParameters {
  public:
+  // Blocks of presets from the newest firmware.
   BlockParameters();
+  // |schema| describes the firmware of the preset and has to outlive the
+  // block.
+  explicit BlockParameters(const FirmwareSchema* schema);
   ~BlockParameters();
 
   // Populates the block parameters from a 16bit value array.
@@ -92,6 +98,7 @@ class BlockParameters {
 
   AxeFxBlockType type() const;
   AxeFxIIBlockID block() const;
+  const FirmwareSchema& schema() const { return *schema_; }
 
   bool supports_xy() const;
   size_t param_count() const;
@@ -107,7 +114,13 @@ class BlockParameters {
 
   void ToJson(Json::Value* out) const;
 
+  // Memory held by the block, including the object itself.
+  base::MemoryUsage MemoryUsage() const;
+  // Releases unused container capacity.
+  void Compact();
+
  private:
+  const FirmwareSchema* schema_;
   AxeFxIIBlockID block_;
   BlockConfig config_;
   uint8_t global_block_index_;
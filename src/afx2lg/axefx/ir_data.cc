@@ -35,6 +35,16 @@ std::string IRData::name() const {
   return ret;
 }
 
+base::MemoryUsage IRData::MemoryUsage() const {
+  base::MemoryUsage usage(sizeof(*this), 1);
+  usage += base::HeapUsage(data_);
+  return usage;
+}
+
+void IRData::Compact() {
+  data_.shrink_to_fit();
+}
+
 uint32_t IRData::Checksum() const {
   return CalculateChecksum(data_);
 }
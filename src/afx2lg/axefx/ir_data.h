@@ -8,6 +8,7 @@
 #include "common/common_types.h"
 #include "axefx/sysex_callback.h"
 #include "axefx/sysex_types.h"
+#include "common/memory_usage.h"
 
 #include <vector>
 
@@ -24,8 +25,11 @@ class IRData {
   uint16_t id() const { return id_; }
   void set_id(uint16_t id) { id_ = id; }
 
-  // TODO: Support a way to set the name.
+  // The name is stored in the first words of |data|, four characters per
+  // word, and terminated by a zero word.
   std::string name() const;
+  const std::vector<uint32_t>& data() const { return data_; }
+  void set_data(const std::vector<uint32_t>& data) { data_ = data; }
   uint32_t Checksum() const;
 
   bool AppendFromSysEx(const IRBlockHeader& header, size_t header_size);
@@ -34,6 +38,11 @@ class IRData {
 
   bool Serialize(const SysExCallback& callback) const;
 
+  // Memory held by the IR, including the object itself.
+  base::MemoryUsage MemoryUsage() const;
+  // Releases unused container capacity.
+  void Compact();
+
  private:
   uint16_t id_;
   std::vector<uint32_t> data_;
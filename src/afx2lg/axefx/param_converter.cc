@@ -0,0 +1,312 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "axefx/param_converter.h"
+
+#include "axefx/blocks.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AXEFX_USE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace axefx {
+
+namespace {
+
+// An unknown parameter covers all the raw values.
+const double kMaxRawValue = 65535.0;
+
+bool OverrideLess(uint16_t variant, uint16_t param_id,
+                  uint16_t key_variant, uint16_t key_param_id) {
+  return variant < key_variant ||
+         (variant == key_variant && param_id < key_param_id);
+}
+
+// values[i] = offsets[i] + scales[i] * raw[i]
+void AffineToValues(const double* offsets, const double* scales,
+                    const uint16_t* raw, size_t count, double* values) {
+  size_t i = 0;
+#if defined(AXEFX_USE_SSE2)
+  // Eight raw values are widened to 32 bits, four at a time, and then
+  // converted two at a time.
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 8 <= count; i += 8) {
+    __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + i));
+    __m128i halves[2] = {
+      _mm_unpacklo_epi16(r, zero), _mm_unpackhi_epi16(r, zero)
+    };
+    for (size_t h = 0; h < 2; ++h) {
+      for (size_t j = 0; j < 4; j += 2) {
+        size_t k = i + h * 4 + j;
+        __m128d pair = _mm_cvtepi32_pd(
+            j ? _mm_srli_si128(halves[h], 8) : halves[h]);
+        _mm_storeu_pd(values + k,
+                      _mm_add_pd(_mm_loadu_pd(offsets + k),
+                                 _mm_mul_pd(_mm_loadu_pd(scales + k), pair)));
+      }
+    }
+  }
+#endif
+  for (; i < count; ++i)
+    values[i] = offsets[i] + scales[i] * raw[i];
+}
+
+// raw[i] = clamp((values[i] - offsets[i]) * inverse_scales[i]) rounded.
+// NaN becomes 0.
+void AffineToRaw(const double* offsets, const double* inverse_scales,
+                 const double* max_raw, const double* values, size_t count,
+                 uint16_t* raw) {
+  size_t i = 0;
+#if defined(AXEFX_USE_SSE2)
+  const __m128d zero = _mm_setzero_pd();
+  const __m128d half = _mm_set1_pd(0.5);
+  const __m128i bias32 = _mm_set1_epi32(0x8000);
+  const __m128i bias16 = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  for (; i + 8 <= count; i += 8) {
+    __m128i pairs[4];
+    for (size_t j = 0; j < 4; ++j) {
+      size_t k = i + j * 2;
+      __m128d x = _mm_mul_pd(
+          _mm_sub_pd(_mm_loadu_pd(values + k), _mm_loadu_pd(offsets + k)),
+          _mm_loadu_pd(inverse_scales + k));
+      // maxpd returns the second operand if the first one is NaN.
+      x = _mm_min_pd(_mm_max_pd(x, zero), _mm_loadu_pd(max_raw + k));
+      // Values are positive, so truncating after adding 0.5 rounds them.
+      pairs[j] = _mm_cvttpd_epi32(_mm_add_pd(x, half));
+    }
+    __m128i lo = _mm_unpacklo_epi64(pairs[0], pairs[1]);
+    __m128i hi = _mm_unpacklo_epi64(pairs[2], pairs[3]);
+    // SSE2 can only pack with signed saturation, so move the values into the
+    // int16_t range and flip the sign bit back afterwards.
+    __m128i packed = _mm_packs_epi32(_mm_sub_epi32(lo, bias32),
+                                     _mm_sub_epi32(hi, bias32));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(raw + i),
+                     _mm_xor_si128(packed, bias16));
+  }
+#endif
+  for (; i < count; ++i) {
+    double x = (values[i] - offsets[i]) * inverse_scales[i];
+    x = x > 0.0 ? x : 0.0;
+    x = x < max_raw[i] ? x : max_raw[i];
+    raw[i] = static_cast<uint16_t>(x + 0.5);
+  }
+}
+
+}  // namespace
+
+ParamConverter::ParamConverter(const FirmwareSchema* schema)
+    : schema_(schema), block_types_(schema->block_type_count) {
+  for (int type = 0; type < schema->block_type_count; ++type) {
+    const BlockTypeSchema& source = schema->block_types[type];
+    BlockCoefficients& block = block_types_[type];
+    block.offsets.resize(source.param_count);
+    block.scales.resize(source.param_count);
+    block.inverse_scales.resize(source.param_count);
+    block.max_raw.resize(source.param_count);
+    for (int id = 0; id < source.param_count; ++id) {
+      const ParamRange* range = source.ranges ? &source.ranges[id] : NULL;
+      Coefficients c = FromRange(range);
+      block.offsets[id] = c.offset;
+      block.scales[id] = c.scale;
+      block.inverse_scales[id] = c.inverse_scale;
+      block.max_raw[id] = c.max_raw;
+      if (c.log)
+        block.log_params.push_back(id);
+    }
+
+    block.overrides.resize(source.override_count);
+    for (int i = 0; i < source.override_count; ++i) {
+      const ParamRangeOverride& o = source.overrides[i];
+      block.overrides[i].variant = o.variant;
+      block.overrides[i].param_id = o.param_id;
+      block.overrides[i].coefficients = FromRange(&o.range);
+    }
+  }
+}
+
+ParamConverter::~ParamConverter() {}
+
+double ParamConverter::ToValue(AxeFxBlockType type, int param_id, int variant,
+                               uint16_t raw) const {
+  return ToValue(GetCoefficients(type, param_id, variant), raw);
+}
+
+uint16_t ParamConverter::ToRaw(AxeFxBlockType type, int param_id, int variant,
+                               double value) const {
+  return ToRaw(GetCoefficients(type, param_id, variant), value);
+}
+
+void ParamConverter::ToValues(AxeFxBlockType type, int variant,
+                              const uint16_t* raw, size_t count,
+                              double* values) const {
+  const BlockCoefficients* block = GetBlock(type);
+  size_t known = block ? std::min(count, block->offsets.size()) : 0;
+  if (known) {
+    AffineToValues(&block->offsets[0], &block->scales[0], raw, known,
+                   values);
+  }
+  for (size_t i = known; i < count; ++i)
+    values[i] = raw[i];
+  if (!block)
+    return;
+
+  for (size_t i = 0; i < block->log_params.size(); ++i) {
+    size_t id = block->log_params[i];
+    if (id < count)
+      values[id] = std::exp(values[id]);
+  }
+
+  if (variant < 0)
+    return;
+  const Override* o = FindOverride(*block, 0, variant);
+  const Override* end = o ? &block->overrides.back() + 1 : NULL;
+  for (; o != end && o->variant == variant; ++o) {
+    if (o->param_id < count)
+      values[o->param_id] = ToValue(o->coefficients, raw[o->param_id]);
+  }
+}
+
+void ParamConverter::ToRawValues(AxeFxBlockType type, int variant,
+                                 const double* values, size_t count,
+                                 uint16_t* raw) const {
+  const BlockCoefficients* block = GetBlock(type);
+  size_t known = block ? std::min(count, block->offsets.size()) : 0;
+  if (known) {
+    AffineToRaw(&block->offsets[0], &block->inverse_scales[0],
+                &block->max_raw[0], values, known, raw);
+  }
+  for (size_t i = known; i < count; ++i)
+    raw[i] = ToRaw(FromRange(NULL), values[i]);
+  if (!block)
+    return;
+
+  // The affine pass treated logarithmic values as if they were linear.
+  for (size_t i = 0; i < block->log_params.size(); ++i) {
+    int id = block->log_params[i];
+    if (static_cast<size_t>(id) < count)
+      raw[id] = ToRaw(GetCoefficients(type, id, -1), values[id]);
+  }
+
+  if (variant < 0)
+    return;
+  const Override* o = FindOverride(*block, 0, variant);
+  const Override* end = o ? &block->overrides.back() + 1 : NULL;
+  for (; o != end && o->variant == variant; ++o) {
+    if (o->param_id < count)
+      raw[o->param_id] = ToRaw(o->coefficients, values[o->param_id]);
+  }
+}
+
+void ParamConverter::BlockToValues(const BlockParameters& block,
+                                   bool x_values,
+                                   std::vector<double>* values) const {
+  ASSERT(&block.schema() == schema_);
+  size_t count = block.supports_xy() ? block.param_count() / 2 :
+                                       block.param_count();
+  std::vector<uint16_t> raw(count);
+  for (size_t i = 0; i < count; ++i)
+    raw[i] = block.GetParamValue(static_cast<int>(i), x_values);
+
+  int variant_id = schema_->GetVariantParamID(block.type());
+  int variant = variant_id >= 0 && static_cast<size_t>(variant_id) < count ?
+      raw[variant_id] : -1;
+  values->resize(count);
+  if (count)
+    ToValues(block.type(), variant, &raw[0], count, &(*values)[0]);
+}
+
+// static
+ParamConverter::Coefficients ParamConverter::FromRange(
+    const ParamRange* range) {
+  Coefficients c = { 0.0, 1.0, 1.0, kMaxRawValue, false };
+  if (!range || range->scale == SCALE_UNKNOWN)
+    return c;
+
+  c.max_raw = range->max_raw_value;
+  if (range->scale == SCALE_INT) {
+    // Raw values are indices.
+    c.offset = range->minimum;
+    return c;
+  }
+
+  // Logarithmic ranges that start at 0 (knobs with a log taper) can't be
+  // interpolated geometrically, so those are treated as linear.
+  c.log = range->scale == SCALE_LOG && range->minimum > 0.0 &&
+          range->maximum > 0.0;
+  double minimum = c.log ? std::log(range->minimum) : range->minimum;
+  double maximum = c.log ? std::log(range->maximum) : range->maximum;
+  c.offset = minimum;
+  c.scale = c.max_raw > 0.0 ? (maximum - minimum) / c.max_raw : 0.0;
+  c.inverse_scale = c.scale != 0.0 ? 1.0 / c.scale : 0.0;
+  return c;
+}
+
+// static
+double ParamConverter::ToValue(const Coefficients& c, uint16_t raw) {
+  double value = c.offset + c.scale * raw;
+  return c.log ? std::exp(value) : value;
+}
+
+// static
+uint16_t ParamConverter::ToRaw(const Coefficients& c, double value) {
+  double x = ((c.log ? std::log(value) : value) - c.offset) * c.inverse_scale;
+  // Written so that NaN becomes 0, like in AffineToRaw().
+  x = x > 0.0 ? x : 0.0;
+  x = x < c.max_raw ? x : c.max_raw;
+  return static_cast<uint16_t>(x + 0.5);
+}
+
+const ParamConverter::BlockCoefficients* ParamConverter::GetBlock(
+    AxeFxBlockType type) const {
+  return type >= 0 && static_cast<size_t>(type) < block_types_.size() ?
+      &block_types_[type] : NULL;
+}
+
+const ParamConverter::Override* ParamConverter::FindOverride(
+    const BlockCoefficients& block, int param_id, int variant) const {
+  if (block.overrides.empty() || variant < 0 || param_id < 0)
+    return NULL;
+  uint16_t key_variant = static_cast<uint16_t>(variant);
+  uint16_t key_param_id = static_cast<uint16_t>(param_id);
+  size_t begin = 0, end = block.overrides.size();
+  while (begin < end) {
+    size_t mid = (begin + end) / 2;
+    const Override& o = block.overrides[mid];
+    if (OverrideLess(o.variant, o.param_id, key_variant, key_param_id)) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin < block.overrides.size() ? &block.overrides[begin] : NULL;
+}
+
+ParamConverter::Coefficients ParamConverter::GetCoefficients(
+    AxeFxBlockType type, int param_id, int variant) const {
+  const BlockCoefficients* block = GetBlock(type);
+  if (!block || param_id < 0 ||
+      static_cast<size_t>(param_id) >= block->offsets.size()) {
+    return FromRange(NULL);
+  }
+
+  const Override* o = FindOverride(*block, param_id, variant);
+  if (o && o->variant == variant && o->param_id == param_id)
+    return o->coefficients;
+
+  Coefficients c = {
+    block->offsets[param_id],
+    block->scales[param_id],
+    block->inverse_scales[param_id],
+    block->max_raw[param_id],
+    std::binary_search(block->log_params.begin(), block->log_params.end(),
+                       param_id)
+  };
+  return c;
+}
+
+}  // namespace axefx
@@ -0,0 +1,109 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef AXEFX_PARAM_CONVERTER_H_
+#define AXEFX_PARAM_CONVERTER_H_
+
+#include "common/common_types.h"
+#include "axefx/axefx_ii_ids.h"
+#include "axefx/schema.h"
+
+#include <vector>
+
+namespace axefx {
+
+class BlockParameters;
+
+// Converts raw 16 bit parameter values to the values that the Axe-Fx shows
+// (dB, ms, Hz, ...) and back, using the parameter ranges of a firmware
+// schema.  The ranges are turned into a pair of coefficients per parameter
+// up front so that a conversion is a multiply and an add (plus an exp() or
+// log() for logarithmic parameters).  The batch methods convert all the
+// parameters of a block at a time, two values per instruction where SSE2 is
+// available.
+//
+// Parameters that the schema has no range for, which includes all of them
+// in schemas built without a .profile, convert to their raw value.
+class ParamConverter {
+ public:
+  // |schema| has to outlive the converter.
+  explicit ParamConverter(const FirmwareSchema* schema);
+  ~ParamConverter();
+
+  const FirmwareSchema& schema() const { return *schema_; }
+
+  // |variant| is the value of the block's variant parameter (see
+  // FirmwareSchema::GetVariantParamID()), or -1.
+  double ToValue(AxeFxBlockType type, int param_id, int variant,
+                 uint16_t raw) const;
+  // Rounds to the closest raw value.  Values outside of the range of the
+  // parameter are clamped.
+  uint16_t ToRaw(AxeFxBlockType type, int param_id, int variant,
+                 double value) const;
+
+  // Convert the values of parameters 0 to |count| - 1 of a block of |type|.
+  // Gives the same results as calling ToValue()/ToRaw() for each parameter.
+  void ToValues(AxeFxBlockType type, int variant, const uint16_t* raw,
+                size_t count, double* values) const;
+  void ToRawValues(AxeFxBlockType type, int variant, const double* values,
+                   size_t count, uint16_t* raw) const;
+
+  // Converts the x or y values of |block|, which must be from a preset of
+  // the converter's firmware.  The variant is read from the block.
+  void BlockToValues(const BlockParameters& block, bool x_values,
+                     std::vector<double>* values) const;
+
+ private:
+  // value = offset + scale * raw, or exp() of that for logarithmic
+  // parameters.
+  struct Coefficients {
+    double offset;
+    double scale;
+    double inverse_scale;
+    double max_raw;
+    bool log;
+  };
+
+  struct Override {
+    uint16_t variant;
+    uint16_t param_id;
+    Coefficients coefficients;
+  };
+
+  // The coefficients of a block type, one array per field so that the batch
+  // conversions can load several parameters at a time.
+  struct BlockCoefficients {
+    std::vector<double> offsets;
+    std::vector<double> scales;
+    std::vector<double> inverse_scales;
+    std::vector<double> max_raw;
+    // Ids of the parameters that are logarithmic.
+    std::vector<int> log_params;
+    // Sorted by variant and param id, like in the schema.
+    std::vector<Override> overrides;
+  };
+
+  static Coefficients FromRange(const ParamRange* range);
+  static double ToValue(const Coefficients& c, uint16_t raw);
+  static uint16_t ToRaw(const Coefficients& c, double value);
+
+  const BlockCoefficients* GetBlock(AxeFxBlockType type) const;
+  // Returns the first override of |variant| whose param id is |param_id| or
+  // larger, or NULL.
+  const Override* FindOverride(const BlockCoefficients& block, int param_id,
+                               int variant) const;
+  Coefficients GetCoefficients(AxeFxBlockType type, int param_id,
+                               int variant) const;
+
+  const FirmwareSchema* schema_;
+  // Indexed by AxeFxBlockType.
+  std::vector<BlockCoefficients> block_types_;
+
+  DISALLOW_COPY_AND_ASSIGN(ParamConverter);
+};
+
+}  // namespace axefx
+
+#endif  // AXEFX_PARAM_CONVERTER_H_
@@ -0,0 +1,76 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef AXEFX_PERFECT_HASH_H_
+#define AXEFX_PERFECT_HASH_H_
+
+#include <stdint.h>
+
+// Lookups in the perfect hash tables that type_gen.py generates for finding
+// ids by name.  A table has a seed per bucket and one slot per entry (plus
+// some empty ones).  A key is hashed once to find its bucket, and hashed again
+// with the seed of the bucket to find the only slot it can be in, so a lookup
+// is two hashes and one string comparison.
+// HashKey() must match Hash() in type_gen.py.
+namespace axefx {
+namespace perfect_hash {
+
+const uint32_t kFnvOffsetBasis = 2166136261u;
+const uint32_t kFnvPrime = 16777619u;
+
+struct Slot {
+  // NULL for empty slots.
+  const char* name;
+  // Tables that are only keyed by name use 0.
+  int type;
+  int id;
+};
+
+struct Table {
+  const uint32_t* seeds;
+  uint32_t seed_count;
+  const Slot* slots;
+  uint32_t slot_count;
+};
+
+// 32 bit FNV-1a.
+constexpr uint32_t HashByte(uint32_t hash, uint32_t byte) {
+  return (hash ^ (byte & 0xff)) * kFnvPrime;
+}
+
+constexpr uint32_t HashString(uint32_t hash, const char* str) {
+  return *str ? HashString(HashByte(hash, static_cast<uint8_t>(*str)), str + 1)
+              : hash;
+}
+
+constexpr uint32_t HashKey(uint32_t seed, int type, const char* name) {
+  return HashString(HashByte(kFnvOffsetBasis ^ seed,
+                             static_cast<uint32_t>(type)),
+                    name);
+}
+
+constexpr bool Equals(const char* a, const char* b) {
+  return *a == *b && (!*a || Equals(a + 1, b + 1));
+}
+
+constexpr int Match(const Slot& slot, int type, const char* name,
+                    int not_found) {
+  return slot.name && slot.type == type && Equals(slot.name, name) ?
+      slot.id : not_found;
+}
+
+// Returns the id of |name| (of |type|) or |not_found|.
+constexpr int Find(const Table& table, int type, const char* name,
+                   int not_found) {
+  return Match(table.slots[HashKey(table.seeds[HashKey(0, type, name) %
+                                               table.seed_count],
+                                   type, name) % table.slot_count],
+               type, name, not_found);
+}
+
+}  // namespace perfect_hash
+}  // namespace axefx
+
+#endif  // AXEFX_PERFECT_HASH_H_
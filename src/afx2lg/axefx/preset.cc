@@ -5,6 +5,8 @@
 
 #include "axefx/sysex_types.h"
 #include "bcl/overrides/src/huffman.h"
+#include "common/metrics.h"
+#include "common/trace.h"
 #include "json/value.h"
 
 #include <algorithm>
@@ -15,13 +17,19 @@ namespace axefx {
 const int kInvalidPresetId = -1;
 const uint16_t kCurrentParameterVersion = 0x0206;
 
+static base::Counter g_presets_finalized("axefx.preset.finalized");
+static base::Counter g_checksum_failures("axefx.preset.checksum_failures");
+static base::Histogram g_finalize_time("axefx.preset.finalize_us");
+static base::Histogram g_decompress_time("axefx.preset.decompress_us");
+static base::Histogram g_compress_time("axefx.preset.compress_us");
+
 namespace {
 
 bool IsVersionSupported(uint16_t version) {
-  // Versions 0x01nn seem to be using the same format, so we optimistically
-  // allow them to pass.  We also assume that all version with major version
-  // 0x02 will have the same format.
-  return version >= 0x0100 && version < 0x0300;
+  // Versions 0x01nn seem to be using the same format, so the schema registry
+  // optimistically accepts them.  We also assume that all versions with
+  // major version 0x02 will have the same format.
+  return FindSchema(version) != NULL;
 }
 
 }  // namespace
@@ -29,6 +37,11 @@ bool IsVersionSupported(uint16_t version) {
 Preset::Preset() : version_(kCurrentParameterVersion), id_(kInvalidPresetId) {}
 Preset::~Preset() {}
 
+const FirmwareSchema& Preset::schema() const {
+  const FirmwareSchema* schema = FindSchema(version_);
+  return schema ? *schema : GetLatestSchema();
+}
+
 void Preset::set_id(int id) {
   ASSERT(id >= 0 && id < 512);
   id_ = id;
@@ -39,6 +52,12 @@ void Preset::set_name(const std::string& name) {
   name.length() >= 31 ? name_ = name.substr(0, 30) : name_ = name;
 }
 
+void Preset::set_ir_data(const std::vector<uint16_t>& ir_data) {
+  ASSERT(params_.empty());
+  ASSERT(ir_data.empty() || ir_data.size() == 1024);
+  ir_data_ = ir_data;
+}
+
 bool Preset::valid() const {
   return id_ != kInvalidPresetId;
 }
@@ -97,12 +116,16 @@ bool Preset::AddParameterData(const ParameterBlockHeader& header, size_t size) {
 bool Preset::Finalize(const PresetChecksumHeader* header, size_t size,
                       bool verify_only) {
   ASSERT(valid());
+  TRACE_EVENT0("axefx", "Preset::Finalize");
+  base::ScopedHistogramTimer timer(&g_finalize_time);
+  g_presets_finalized.Add();
   // Support for skipping checksum checks is here because a preset dump
   // might not have a parameter checksum for some reason.  Possibly this
   // is simply a bug in the AxeFx when realtime sysex sending is set to "All".
   if (header) {
     if (size != sizeof(PresetChecksumHeader) ||
         header->checksum.Decode() != params_.Checksum()) {
+      g_checksum_failures.Add();
       return false;
     }
   }
@@ -145,6 +168,9 @@ bool Preset::Finalize(const PresetChecksumHeader* header, size_t size,
     ASSERT(ir_data_.size() == 1024);
     params_.erase(params_.end() - 1024, params_.end());
 
+    TRACE_EVENT0("axefx", "Preset::Decompress");
+    base::ScopedHistogramTimer decompress_timer(&g_decompress_time);
+
     // The compression seems to assume that the bytes are ordered in a little
     // endian 16 bit fashion - which is what we already have - so no conversion
     // to network byte order (big endian) is necessary.
@@ -175,7 +201,8 @@ bool Preset::Finalize(const PresetChecksumHeader* header, size_t size,
 
   // Parse per block parameters (including modifiers).
   while (p < params_.end() && *p) {
-    unique_ptr<BlockParameters> block_params(new BlockParameters());
+    unique_ptr<BlockParameters> block_params(
+        new BlockParameters(&schema()));
     size_t values_eaten = block_params->Initialize(&(*p), params_.end() - p);
     if (!values_eaten)
       return false;
@@ -183,12 +210,33 @@ bool Preset::Finalize(const PresetChecksumHeader* header, size_t size,
     p += values_eaten;
   }
 
-  // Free some memory since we don't need it anymore.
-  params_.clear();
+  // Free some memory since we don't need it anymore.  clear() would keep
+  // the capacity of the 2048 values around.
+  PresetParameters().swap(params_);
 
   return true;
 }
 
+base::MemoryUsage Preset::MemoryUsage() const {
+  base::MemoryUsage usage(sizeof(*this), 1);
+  usage += base::HeapUsage(params_);
+  usage += base::HeapUsage(ir_data_);
+  usage += base::HeapUsage(name_);
+  usage += base::HeapUsage(block_parameters_);
+  for (const auto& block: block_parameters_)
+    usage += block->MemoryUsage();
+  return usage;
+}
+
+void Preset::Compact() {
+  params_.shrink_to_fit();
+  ir_data_.shrink_to_fit();
+  name_.shrink_to_fit();
+  block_parameters_.shrink_to_fit();
+  for (const auto& block: block_parameters_)
+    block->Compact();
+}
+
 void Preset::ToJson(Json::Value* out) const {
   Json::Value& j = *out;
   if (from_edit_buffer()) {
@@ -229,6 +277,7 @@ void Preset::ToJson(Json::Value* out) const {
 
 bool Preset::Serialize(const SysExCallback& callback) const {
   ASSERT(valid());
+  TRACE_EVENT0("axefx", "Preset::Serialize");
 
   WriteHeader(callback);
 
@@ -283,6 +332,8 @@ void Preset::FillParameters(PresetParameters* params) const {
 
   if (!ir_data_.empty()) {
     // Compress the parameters.
+    TRACE_EVENT0("axefx", "Preset::Compress");
+    base::ScopedHistogramTimer compress_timer(&g_compress_time);
     std::vector<uint16_t> compressed;
     // Assume the compressed size will be smaller or equal to the data being
     // compressed.
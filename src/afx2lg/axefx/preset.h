@@ -9,7 +9,9 @@
 
 #include "axefx/blocks.h"
 #include "axefx/preset_parameters.h"
+#include "axefx/schema.h"
 #include "axefx/sysex_types.h"
+#include "common/memory_usage.h"
 
 #include <map>
 #include <string>
@@ -32,10 +34,16 @@ class Preset {
   void set_name(const std::string& name);
   const Matrix& matrix() const { return matrix_; }
   const PresetParameters& params() const { return params_; }
+  // The names and ranges of the parameters of the firmware that the preset
+  // is from.
+  const FirmwareSchema& schema() const;
 
   // Returns the embedded IR data if any.  Used in presets that use the tone
   // match block.
   const std::vector<uint16_t>& ir_data() const { return ir_data_; }
+  // |ir_data| must be empty or hold 1024 values.  Only presets that already
+  // use the tone match block should be given IR data.
+  void set_ir_data(const std::vector<uint16_t>& ir_data);
 
   bool valid() const;
 
@@ -63,6 +71,12 @@ class Preset {
 
   bool Serialize(const SysExCallback& callback) const;
 
+  // Memory held by the preset and its blocks, including the object itself.
+  base::MemoryUsage MemoryUsage() const;
+  // Releases unused container capacity.  Presets that are kept around for
+  // a long time, such as in a library, should be compacted once parsed.
+  void Compact();
+
  private:
   void WriteHeader(const SysExCallback& callback) const;
   void FillParameters(PresetParameters* params) const;
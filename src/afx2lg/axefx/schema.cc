@@ -0,0 +1,86 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "axefx/schema.h"
+
+#include <algorithm>
+
+namespace axefx {
+
+namespace {
+
+bool OverrideLess(const ParamRangeOverride& o, const ParamRangeOverride& key) {
+  return o.variant < key.variant ||
+         (o.variant == key.variant && o.param_id < key.param_id);
+}
+
+}  // namespace
+
+const char* FirmwareSchema::GetParamName(AxeFxBlockType type,
+                                         int param_id) const {
+  if (type < 0 || type >= block_type_count)
+    return "";
+  const BlockTypeSchema& block_type = block_types[type];
+  return param_id >= 0 && param_id < block_type.param_count ?
+      block_type.param_names[param_id] : "";
+}
+
+int FirmwareSchema::GetParamIdByName(AxeFxBlockType type,
+                                     const char* name) const {
+  return perfect_hash::Find(*param_ids_by_name, type, name, -1);
+}
+
+int FirmwareSchema::GetBypassParamID(AxeFxBlockType type) const {
+  return type >= 0 && type < block_type_count ?
+      block_types[type].bypass_param_id : -1;
+}
+
+int FirmwareSchema::GetVariantParamID(AxeFxBlockType type) const {
+  return type >= 0 && type < block_type_count ?
+      block_types[type].variant_param_id : -1;
+}
+
+const char* FirmwareSchema::GetAmpName(int index) const {
+  return index >= 0 && index < amp_count ? amp_names[index] : "";
+}
+
+const char* FirmwareSchema::GetCabName(int index) const {
+  return index >= 0 && index < cab_count ? cab_names[index] : "";
+}
+
+const ParamRange* FirmwareSchema::GetParamRange(AxeFxBlockType type,
+                                                int param_id,
+                                                int variant) const {
+  if (type < 0 || type >= block_type_count)
+    return NULL;
+  const BlockTypeSchema& block_type = block_types[type];
+  if (!block_type.ranges || param_id < 0 ||
+      param_id >= block_type.param_count) {
+    return NULL;
+  }
+
+  if (block_type.override_count && variant >= 0) {
+    ParamRangeOverride key = {};
+    key.variant = static_cast<uint16_t>(variant);
+    key.param_id = static_cast<uint16_t>(param_id);
+    const ParamRangeOverride* end =
+        block_type.overrides + block_type.override_count;
+    const ParamRangeOverride* found =
+        std::lower_bound(block_type.overrides, end, key, &OverrideLess);
+    if (found != end && found->variant == key.variant &&
+        found->param_id == key.param_id) {
+      return &found->range;
+    }
+  }
+
+  const ParamRange* range = &block_type.ranges[param_id];
+  return range->scale == SCALE_UNKNOWN ? NULL : range;
+}
+
+bool FirmwareSchema::IsValidValue(AxeFxBlockType type, int param_id,
+                                  int variant, uint16_t value) const {
+  const ParamRange* range = GetParamRange(type, param_id, variant);
+  return !range || value <= range->max_raw_value;
+}
+
+}  // namespace axefx
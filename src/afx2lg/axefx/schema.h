@@ -0,0 +1,105 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef AXEFX_SCHEMA_H_
+#define AXEFX_SCHEMA_H_
+
+#include "common/common_types.h"
+#include "axefx/axefx_ii_ids.h"
+#include "axefx/perfect_hash.h"
+
+namespace axefx {
+
+// How the raw values of a parameter map to the values that the Axe-Fx shows.
+enum ParamScale {
+  // The firmware profile doesn't describe the parameter.
+  SCALE_UNKNOWN,
+  SCALE_LINEAR,
+  SCALE_LOG,
+  // Raw values are indices into a list of choices.
+  SCALE_INT,
+};
+
+struct ParamRange {
+  ParamScale scale;
+  double minimum;
+  double maximum;
+  // Number of decimals that the value is shown with.
+  int precision;
+  const char* unit;
+  uint16_t max_raw_value;
+};
+
+// A range that only applies while the variant parameter of the block (e.g.
+// the amp type) is set to |variant|.
+struct ParamRangeOverride {
+  uint16_t variant;
+  uint16_t param_id;
+  ParamRange range;
+};
+
+struct BlockTypeSchema {
+  // |param_count| names, indexed by param id.
+  const char* const* param_names;
+  int param_count;
+  int bypass_param_id;
+  // NULL, or |param_count| ranges indexed by param id.
+  const ParamRange* ranges;
+  // -1 if the ranges are the same for all variants of the block.
+  int variant_param_id;
+  // Sorted by variant and param id.
+  const ParamRangeOverride* overrides;
+  int override_count;
+};
+
+// The block parameters of one firmware version, generated by type_gen.py
+// from the .axeml and .profile files.  Names and bypass parameters are
+// looked up the same way as with the functions in axefx_ii_ids.h, which
+// describe the newest firmware.
+struct FirmwareSchema {
+  const char* name;
+  // The first preset parameter version that the schema describes.
+  uint16_t first_version;
+  // Indexed by AxeFxBlockType.
+  const BlockTypeSchema* block_types;
+  int block_type_count;
+  const perfect_hash::Table* param_ids_by_name;
+  const char* const* amp_names;
+  int amp_count;
+  const char* const* cab_names;
+  int cab_count;
+
+  const char* GetParamName(AxeFxBlockType type, int param_id) const;
+  // Returns -1 if |type| has no parameter called |name|.
+  int GetParamIdByName(AxeFxBlockType type, const char* name) const;
+  int GetBypassParamID(AxeFxBlockType type) const;
+  // Returns -1 if the ranges of |type| don't depend on a variant.
+  int GetVariantParamID(AxeFxBlockType type) const;
+  const char* GetAmpName(int index) const;
+  const char* GetCabName(int index) const;
+
+  // Returns NULL if the schema has no range for the parameter.  |variant| is
+  // the value of the block's variant parameter and ignored for blocks that
+  // don't have one.
+  const ParamRange* GetParamRange(AxeFxBlockType type, int param_id,
+                                  int variant) const;
+
+  // Returns false for values that are out of range.  Parameters that the
+  // schema has no range for accept any value.
+  bool IsValidValue(AxeFxBlockType type, int param_id, int variant,
+                    uint16_t value) const;
+};
+
+// Returns the schema for presets with the parameter |version| or NULL if the
+// version isn't supported.  Versions between the ones that there are schemas
+// for get the schema of the closest older firmware.
+const FirmwareSchema* FindSchema(uint16_t version);
+
+// The schema of the newest firmware.
+const FirmwareSchema& GetLatestSchema();
+
+}  // namespace axefx
+
+#endif  // AXEFX_SCHEMA_H_
@@ -3,11 +3,25 @@
  # Use of this source code is governed by a BSD-style license that can be
  # found in the LICENSE file.
 
-import os, sys
+import os, re, sys
 import xml.parsers.expat
 
 OUTPUT_H = "axefx_ii_ids.h"
 OUTPUT_CC = "axefx_ii_ids.cc"
+OUTPUT_SCHEMAS_CC = "axefx_ii_schemas.cc"
+
+# The preset parameter version (the first value of the parameter data of a
+# preset) that each major firmware version starts out with.  The schema
+# files don't say, so a firmware has to be added here along with its schema.
+FIRST_PARAMETER_VERSIONS = {
+  7: 0x0202,
+  9: 0x0204,
+}
+
+# Presets with parameter versions in this range are supported.  Versions
+# older than the oldest schema get the oldest one.
+FIRST_SUPPORTED_VERSION = 0x0100
+LAST_SUPPORTED_VERSION = 0x02ff
 
 HEADER_FILE_TEMPLATE = """// Copyright (c) 2012, Tomas Gunnarsson
 // All rights reserved.
@@ -17,19 +31,90 @@ HEADER_FILE_TEMPLATE = """// Copyright (c) 2012, Tomas Gunnarsson
 #ifndef __AXEFX_II_GENERATED_TYPE_IDS__
 #define __AXEFX_II_GENERATED_TYPE_IDS__
 
+#include "axefx/perfect_hash.h"
+
 namespace axefx {
 
 %s
 
-AxeFxBlockType GetBlockType(AxeFxIIBlockID id);
-const char* GetBlockTypeName(AxeFxBlockType type);
-const char* GetBlockName(AxeFxIIBlockID id);
-int GetBlockBypassParamID(AxeFxBlockType type);
-const char* GetParamName(AxeFxBlockType type, int param_id);
-const char* GetAmpName(int index);
-const char* GetCabName(int index);
+// The tables behind the lookup functions below.  Names are indexed by id,
+// with "" for ids that aren't used, and ids are found by name with the
+// perfect hash tables.
+struct AxeFxIITables {
+  struct ParamNames {
+    const char* const* names;
+    int count;
+  };
 
-// Forward declarations for block parameter lookups.
+%s
+};
+
+constexpr AxeFxBlockType GetBlockType(AxeFxIIBlockID id) {
+  return id >= AxeFxIITables::kFirstBlockId &&
+         id < AxeFxIITables::kFirstBlockId + AxeFxIITables::kBlockIdCount ?
+      AxeFxIITables::kBlockTypes[id - AxeFxIITables::kFirstBlockId] :
+      BLOCK_TYPE_INVALID;
+}
+
+constexpr const char* GetBlockTypeName(AxeFxBlockType type) {
+  return type >= 0 && type < AxeFxIITables::kBlockTypeCount ?
+      AxeFxIITables::kBlockTypeNames[type] : "";
+}
+
+constexpr const char* GetBlockName(AxeFxIIBlockID id) {
+  return id >= AxeFxIITables::kFirstBlockId &&
+         id < AxeFxIITables::kFirstBlockId + AxeFxIITables::kBlockIdCount ?
+      AxeFxIITables::kBlockNames[id - AxeFxIITables::kFirstBlockId] : "";
+}
+
+constexpr int GetBlockBypassParamID(AxeFxBlockType type) {
+  return type >= 0 && type < AxeFxIITables::kBlockTypeCount ?
+      AxeFxIITables::kBypassParamIds[type] : -1;
+}
+
+constexpr const char* GetParamName(AxeFxBlockType type, int param_id) {
+  return type >= 0 && type < AxeFxIITables::kBlockTypeCount &&
+         param_id >= 0 && param_id < AxeFxIITables::kParamNames[type].count ?
+      AxeFxIITables::kParamNames[type].names[param_id] : "";
+}
+
+constexpr const char* GetAmpName(int index) {
+  return index >= 0 && index < AxeFxIITables::kAmpCount ?
+      AxeFxIITables::kAmpNames[index] : "";
+}
+
+constexpr const char* GetCabName(int index) {
+  return index >= 0 && index < AxeFxIITables::kCabCount ?
+      AxeFxIITables::kCabNames[index] : "";
+}
+
+// The reverse lookups take the names that the functions above return.
+constexpr AxeFxIIBlockID GetBlockIdByName(const char* name) {
+  return static_cast<AxeFxIIBlockID>(perfect_hash::Find(
+      AxeFxIITables::kBlockIdsByName, 0, name, BLOCK_INVALID));
+}
+
+constexpr AxeFxBlockType GetBlockTypeByName(const char* name) {
+  return static_cast<AxeFxBlockType>(perfect_hash::Find(
+      AxeFxIITables::kBlockTypesByName, 0, name, BLOCK_TYPE_INVALID));
+}
+
+// Returns -1 if |type| has no parameter called |name|.
+constexpr int GetParamIdByName(AxeFxBlockType type, const char* name) {
+  return perfect_hash::Find(AxeFxIITables::kParamIdsByName, type, name, -1);
+}
+
+// Returns -1 if there's no such amp.
+constexpr int GetAmpIdByName(const char* name) {
+  return perfect_hash::Find(AxeFxIITables::kAmpIdsByName, 0, name, -1);
+}
+
+// Returns -1 if there's no such cab.
+constexpr int GetCabIdByName(const char* name) {
+  return perfect_hash::Find(AxeFxIITables::kCabIdsByName, 0, name, -1);
+}
+
+// Block parameter lookups.
 %s
 
 }  // namespace axefx
@@ -46,65 +131,45 @@ SOURCE_FILE_TEMPLATE = """// Copyright (c) 2012, Tomas Gunnarsson
 
 namespace axefx {
 
-AxeFxBlockType GetBlockType(AxeFxIIBlockID id) {
-  switch (id) {
-    default:
-      break;
-%s  }
-  return BLOCK_TYPE_INVALID;
-}
+// Definitions of the tables, which are initialized in the header.
+%s
 
-const char* GetBlockTypeName(AxeFxBlockType type) {
-  switch (type) {
-    default:
-      break;
-%s  }
-  return "";
-}
+}  // namespace axefx
+"""
 
-const char* GetBlockName(AxeFxIIBlockID id) {
-  switch (id) {
-    default:
-      break;
-%s  }
-  return "";
-}
+SCHEMAS_FILE_TEMPLATE = """// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
 
-int GetBlockBypassParamID(AxeFxBlockType type) {
-  switch (type) {
-    default:
-      break;
-%s  }
-  return -1;
-}
+#include "axefx/schema.h"
 
-const char* GetParamName(AxeFxBlockType type, int param_id) {
-  switch (type) {
-    default:
-      break;
-%s  }
-  return "";
-}
+// WARNING: Do not edit, this file is generated!
 
-const char* GetAmpName(int index) {
-  switch (index) {
-    default:
-      break;
-%s  }
-  return "";
-}
+namespace axefx {
 
-const char* GetCabName(int index) {
-  switch (index) {
-    default:
-      break;
-%s  }
-  return "";
-}
+namespace {
 
-// Implementations of block parameter lookup functions.
+%s
+
+const FirmwareSchema kFirmwareSchemas[] = {
+%s
+};
 
+// Indexes into kFirmwareSchemas by parameter version, starting with
+// version 0x%04x.
+const uint8_t kSchemaIndexByVersion[%d] = {
 %s
+};
+
+}  // namespace
+
+const FirmwareSchema* FindSchema(uint16_t version) {
+  return version >= 0x%04x && version <= 0x%04x ?
+      &kFirmwareSchemas[kSchemaIndexByVersion[version - 0x%04x]] : NULL;
+}
+
+const FirmwareSchema& GetLatestSchema() {
+  return kFirmwareSchemas[%d];
+}
 
 }  // namespace axefx
 """
@@ -124,39 +189,124 @@ PARAM_ID_TEMPLATE = """enum %sParamID {
   %s
 };"""
 
-PARAM_ID_LOOKUP_FUNCTION_FWD_TEMPLATE = \
-  "const char* Get%sParamName(%sParamID id);"
-
 PARAM_ID_LOOKUP_FUNCTION_TEMPLATE = \
 """
-const char* Get%sParamName(%sParamID id) {
-  switch (id) {
-    default:
-      break;
-%s  }
-  return "";
+constexpr const char* Get%sParamName(%sParamID id) {
+  return id >= 0 && id < %d ?
+      AxeFxIITables::k%sParamNames[id] : "";
 }"""
 
-class AxeMlParser:
-  amp_names = {}
-  block_ids = []
-  block_to_type_id = {}
-  block_type_bypass_ids = {}
-  block_types = []
-  cab_names = {}
-  current_block = None
-  current_bypass_id = None
-  current_type_name = None
-  effect_parameter_names = []
-  effect_parameters = []
-  param_ids = []
-  param_lookup_fn_fwd = []
-  param_lookup_fn_impl = []
-  parser = None
-  type_id_name = {}
-  type_id_to_name = {}
+# Must match perfect_hash::HashKey() in perfect_hash.h.
+FNV_OFFSET_BASIS = 2166136261
+FNV_PRIME = 16777619
+
+def HashByte(h, byte):
+  return ((h ^ (byte & 0xff)) * FNV_PRIME) & 0xffffffff
+
+def Hash(seed, type_id, name):
+  h = HashByte(FNV_OFFSET_BASIS ^ seed, type_id)
+  for c in name.encode("utf-8"):
+    h = HashByte(h, ord(c))
+  return h
+
+def BuildPerfectHash(entries):
+  """Builds a perfect hash table for a list of (type, name, id) entries.
+
+  The entries are spread over buckets by their hash with seed 0, and then,
+  starting with the largest bucket, a seed is found for each bucket that
+  puts all of its entries in slots that are still empty.  Returns the seeds
+  and the slots, with None for empty slots."""
+  bucket_count = max(1, len(entries) / 2)
+  slot_count = len(entries) + len(entries) / 4 + 1
+  buckets = [[] for i in range(bucket_count)]
+  for e in entries:
+    buckets[Hash(0, e[0], e[1]) % bucket_count].append(e)
+
+  seeds = [0] * bucket_count
+  slots = [None] * slot_count
+  order = sorted(range(bucket_count), key=lambda b: (-len(buckets[b]), b))
+  for b in order:
+    if not buckets[b]:
+      continue
+    seed = 1
+    while True:
+      positions = [Hash(seed, e[0], e[1]) % slot_count for e in buckets[b]]
+      if len(set(positions)) == len(positions) and \
+         all(slots[p] is None for p in positions):
+        break
+      seed += 1
+    seeds[b] = seed
+    for p, e in zip(positions, buckets[b]):
+      slots[p] = e
+  return seeds, slots
+
+def DenseTable(items, count, empty):
+  """Returns a list of |count| values where items[i] is at index i."""
+  table = [empty] * count
+  for i, v in items:
+    table[i] = v
+  return table
+
+def FormatArray(decl, values, first_index=None, member=True):
+  """Formats a table as a member of AxeFxIITables or, if |member| is False,
+  as a constant at namespace scope.  Tables that are indexed by id get the
+  id of each value as a comment when |first_index| is given."""
+  prefix, indent = ("  static constexpr ", "  ") if member else ("const ", "")
+  if first_index is None:
+    lines = ["%s  %s," % (indent, v) for v in values]
+  else:
+    lines = ["%s  %s,  // %d" % (indent, v, first_index + i)
+             for i, v in enumerate(values)]
+  return "%s%s = {\n%s\n%s};" % (prefix, decl, "\n".join(lines), indent)
+
+def FormatHashTable(name, entries, member=True):
+  seeds, slots = BuildPerfectHash(entries)
+  slot_values = []
+  for s in slots:
+    if s is None:
+      slot_values += ["{ nullptr, 0, 0 }"]
+    else:
+      slot_values += ['{ "%s", %s, %s }' % (s[1], s[2], s[3])]
+  return "\n".join([
+      FormatArray("uint32_t k%sSeeds[%d]" % (name, len(seeds)), seeds,
+                  member=member),
+      FormatArray("perfect_hash::Slot k%sSlots[%d]" % (name, len(slots)),
+                  slot_values, member=member),
+      FormatArray("perfect_hash::Table k%sByName" % name,
+                  ["k%sSeeds, %d, k%sSlots, %d" %
+                   (name, len(seeds), name, len(slots))], member=member)])
+
+def Quote(s):
+  return '"%s"' % s
+
+def FirmwareVersion(path):
+  """Returns the firmware version that a schema file is for, as a
+  (major, minor) tuple, e.g. (9, 2) for AxeFxII_9_2.axeml.  The version
+  attributes in the files themselves aren't reliable."""
+  match = re.match(r"AxeFxII_(\d+)(?:_(\d+))?\.", os.path.basename(path))
+  if not match:
+    print >> sys.stderr, "Can't tell the firmware version of %s" % path
+    sys.exit(-1)
+  return (int(match.group(1)), int(match.group(2) or 0))
 
+class AxeMlParser:
   def __init__(self):
+    self.amp_names = {}
+    self.block_ids = []
+    self.block_id_values = {}
+    self.block_to_type_id = {}
+    self.block_type_bypass_ids = {}
+    self.block_type_params = {}
+    self.block_types = []
+    self.cab_names = {}
+    self.current_block = None
+    self.current_bypass_id = None
+    self.current_type_name = None
+    self.effect_parameters = []
+    self.effect_parameter_ids = []
+    self.param_ids = []
+    self.type_id_name = {}
+    self.type_id_to_name = {}
     self.parser = xml.parsers.expat.ParserCreate()
     self.parser.CharacterDataHandler = self.onCharData
     self.parser.StartElementHandler = self.onStartElement
@@ -174,6 +324,7 @@ class AxeMlParser:
         block_name = "BLOCK_%s" % (attrs["name"].replace(' ', '_')\
             .replace('/','_').upper())
         self.block_ids += ["%s = %s" % (block_name, attrs["id"])]
+        self.block_id_values[block_name] = int(attrs["id"])
         self.block_to_type_id[block_name] = [attrs["typeID"], attrs["name"]]
     elif name == "EffectParameters":
       if "typeID" in attrs:
@@ -187,7 +338,7 @@ class AxeMlParser:
           self.current_bypass_id = attrs["bypassParam"]
     elif name == "EffectParameter":
       self.effect_parameters += ["%s = %s" % (attrs["name"], attrs["id"])]
-      self.effect_parameter_names += [attrs["name"]]
+      self.effect_parameter_ids += [(int(attrs["id"]), attrs["name"])]
       if attrs["id"] == self.current_bypass_id:
         self.block_type_bypass_ids[self.current_type_name] = attrs["name"]
     elif name == "Amp":
@@ -201,70 +352,327 @@ class AxeMlParser:
         self.param_ids += \
           [PARAM_ID_TEMPLATE % (self.current_block,
                                 ",\n  ".join(self.effect_parameters))]
-        self.param_lookup_fn_fwd += \
-          [PARAM_ID_LOOKUP_FUNCTION_FWD_TEMPLATE %
-           (self.current_block, self.current_block)]
-        self.param_lookup_fn_impl += \
-          [PARAM_ID_LOOKUP_FUNCTION_TEMPLATE %
-           (self.current_block, self.current_block,
-            self.GenerateCaseLabelsWithReturn(self.effect_parameter_names))]
+        self.block_type_params[self.current_type_name] = \
+          (self.current_block, sorted(self.effect_parameter_ids))
       self.current_block = None
       self.current_type_name = None
       self.effect_parameters = []
-      self.effect_parameter_names = []
+      self.effect_parameter_ids = []
       self.current_bypass_id = None
 
-  def GenerateCaseLabelsWithReturn(self, entries):
-    ret = ""
-    for e in entries:
-      ret += '    case %s:\n      return "%s";\n' % (e, e.lower())
-    return ret
-
-  def GenerateBlockTypeFromID(self):
-    ret = ""
-    for b, t in self.block_to_type_id.items():
-      ret += "    case %s:\n      return %s;\n" % (b, self.type_id_to_name[t[0]])
-    return ret
-
-  def GenerateBlockTypeName(self):
-    ret = ""
-    for t in self.type_id_name.items():
-      ret += "    case %s:\n      return \"%s\";\n" % (t[0], t[1])
-    return ret
-
-  def GenerateBlockNameFromID(self):
-    ret = ""
-    for b, t in self.block_to_type_id.items():
-      ret += '    case %s:\n      return "%s";\n' % (b, t[1])
-    return ret
-
-  def GenerateBlockBypassParamID(self):
-    ret = ""
-    for n in self.type_id_to_name.values():
-      if n in self.block_type_bypass_ids:
-        ret += "    case %s:\n      return %s;\n" % \
-               (n, self.block_type_bypass_ids[n])
-    return ret
-
-  def GenerateParamNamesForBlocks(self):
-    ret = ""
-    for t in self.type_id_to_name.values():
-      block_name = self.type_id_name[t]
-      ret += "    case %s:\n      return Get%sParamName(static_cast<%sParamID>(param_id));\n" % \
-        (t, block_name, block_name)
-    return ret
-
-  def GenerateAmpNames(self):
-    ret = ""
-    for i, n in sorted(self.amp_names.items()):
-      ret += '    case %s:\n      return "%s";\n' %  (i, n)
-    return ret
-
-  def GenerateCabNames(self):
-    ret = ""
-    for i, n in sorted(self.cab_names.items()):
-      ret += '    case %s:\n      return "%s";\n' %  (i, n)
-    return ret
+  def BlockTypeValue(self, type_name):
+    for t, n in self.type_id_to_name.items():
+      if n == type_name:
+        return int(t)
+    return -1
+
+  def ParamCount(self, type_name):
+    params = self.block_type_params[type_name][1]
+    return params[-1][0] + 1 if params else 0
+
+  def SortedTypeNames(self):
+    return sorted(self.block_type_params.keys(), key=self.BlockTypeValue)
+
+  def GenerateTables(self):
+    first_block_id = min(self.block_id_values.values())
+    block_id_count = max(self.block_id_values.values()) - first_block_id + 1
+    block_type_count = max([int(t) for t in self.type_id_to_name.keys()]) + 1
+    amp_count = max(self.amp_names.keys()) + 1 if self.amp_names else 0
+    cab_count = max(self.cab_names.keys()) + 1 if self.cab_names else 0
+    blocks = sorted(self.block_id_values.items(), key=lambda b: b[1])
+
+    tables = [
+        "  static constexpr int kFirstBlockId = %d;" % first_block_id,
+        "  static constexpr int kBlockIdCount = %d;" % block_id_count,
+        "  static constexpr int kBlockTypeCount = %d;" % block_type_count,
+        "  static constexpr int kAmpCount = %d;" % amp_count,
+        "  static constexpr int kCabCount = %d;" % cab_count,
+        "",
+        FormatArray("AxeFxBlockType kBlockTypes[kBlockIdCount]",
+            DenseTable([(v - first_block_id,
+                         self.type_id_to_name[self.block_to_type_id[b][0]])
+                        for b, v in blocks],
+                       block_id_count, "BLOCK_TYPE_INVALID"),
+            first_block_id),
+        FormatArray("const char* kBlockNames[kBlockIdCount]",
+            DenseTable([(v - first_block_id,
+                         Quote(self.block_to_type_id[b][1]))
+                        for b, v in blocks],
+                       block_id_count, Quote("")),
+            first_block_id),
+        FormatArray("const char* kBlockTypeNames[kBlockTypeCount]",
+            DenseTable([(self.BlockTypeValue(t), Quote(n))
+                        for t, n in self.type_id_name.items()],
+                       block_type_count, Quote("")), 0),
+        FormatArray("int kBypassParamIds[kBlockTypeCount]",
+            DenseTable([(self.BlockTypeValue(t), p)
+                        for t, p in self.block_type_bypass_ids.items()],
+                       block_type_count, "-1"), 0),
+        ""]
+
+    for t in self.SortedTypeNames():
+      block_name, params = self.block_type_params[t]
+      tables += [FormatArray("const char* k%sParamNames[%d]" %
+                             (block_name, max(1, self.ParamCount(t))),
+          DenseTable([(i, Quote(n.lower())) for i, n in params],
+                     max(1, self.ParamCount(t)), Quote("")), 0)]
+    tables += [FormatArray("ParamNames kParamNames[kBlockTypeCount]",
+        DenseTable([(self.BlockTypeValue(t),
+                     "{ k%sParamNames, %d }" %
+                     (self.block_type_params[t][0], self.ParamCount(t)))
+                    for t in self.SortedTypeNames()],
+                   block_type_count, "{ nullptr, 0 }"), 0), ""]
+
+    tables += [
+        FormatArray("const char* kAmpNames[kAmpCount]",
+            DenseTable([(i, Quote(n)) for i, n in self.amp_names.items()],
+                       amp_count, Quote("")), 0),
+        FormatArray("const char* kCabNames[kCabCount]",
+            DenseTable([(i, Quote(n)) for i, n in self.cab_names.items()],
+                       cab_count, Quote("")), 0),
+        ""]
+
+    # Perfect hash tables for the reverse lookups.  Entries are
+    # (type, name, type enum, id enum).
+    param_entries = []
+    for t in self.SortedTypeNames():
+      for i, n in self.block_type_params[t][1]:
+        param_entries += [(self.BlockTypeValue(t), n.lower(), t, n)]
+    tables += [
+        FormatHashTable("BlockIds",
+            [(0, self.block_to_type_id[b][1], 0, b) for b, v in blocks]),
+        FormatHashTable("BlockTypes",
+            [(0, self.type_id_name[t], 0, t)
+             for t in self.SortedTypeNames()]),
+        FormatHashTable("ParamIds", param_entries),
+        FormatHashTable("AmpIds", self.NameEntries(self.amp_names)),
+        FormatHashTable("CabIds", self.NameEntries(self.cab_names))]
+    return "\n".join(tables)
+
+  def NameEntries(self, names):
+    # Some names may be used more than once, in which case the first id wins.
+    entries = []
+    seen = set()
+    for i, n in sorted(names.items()):
+      if n and n not in seen:
+        seen.add(n)
+        entries += [(0, n, 0, i)]
+    return entries
+
+  def GenerateTableDefinitions(self):
+    definitions = [
+        "constexpr int AxeFxIITables::kFirstBlockId;",
+        "constexpr int AxeFxIITables::kBlockIdCount;",
+        "constexpr int AxeFxIITables::kBlockTypeCount;",
+        "constexpr int AxeFxIITables::kAmpCount;",
+        "constexpr int AxeFxIITables::kCabCount;",
+        "constexpr AxeFxBlockType AxeFxIITables::kBlockTypes[];",
+        "constexpr const char* AxeFxIITables::kBlockNames[];",
+        "constexpr const char* AxeFxIITables::kBlockTypeNames[];",
+        "constexpr int AxeFxIITables::kBypassParamIds[];"]
+    for t in self.SortedTypeNames():
+      definitions += ["constexpr const char* AxeFxIITables::k%sParamNames[];" %
+                      self.block_type_params[t][0]]
+    definitions += [
+        "constexpr AxeFxIITables::ParamNames AxeFxIITables::kParamNames[];",
+        "constexpr const char* AxeFxIITables::kAmpNames[];",
+        "constexpr const char* AxeFxIITables::kCabNames[];"]
+    for name in ["BlockIds", "BlockTypes", "ParamIds", "AmpIds", "CabIds"]:
+      definitions += [
+          "constexpr uint32_t AxeFxIITables::k%sSeeds[];" % name,
+          "constexpr perfect_hash::Slot AxeFxIITables::k%sSlots[];" % name,
+          "constexpr perfect_hash::Table AxeFxIITables::k%sByName;" % name]
+    return "\n".join(definitions)
+
+  def GenerateParamLookupFunctions(self):
+    return "\n".join([PARAM_ID_LOOKUP_FUNCTION_TEMPLATE %
+                    (self.block_type_params[t][0],
+                     self.block_type_params[t][0], self.ParamCount(t),
+                     self.block_type_params[t][0])
+                    for t in self.SortedTypeNames()])
+
+class ProfileParser:
+  """Reads the parameter ranges of each block type and variant from a
+  firmware profile."""
+
+  SCALES = { "LIN": "SCALE_LINEAR", "LOG": "SCALE_LOG", "INT": "SCALE_INT" }
+
+  def __init__(self):
+    # typeID -> (variant param id, { variant: { param id: range } }), where a
+    # range is a tuple of the ParamRange values.
+    self.effects = {}
+    self.current_variants = None
+    self.current_params = None
+    self.parser = xml.parsers.expat.ParserCreate()
+    self.parser.StartElementHandler = self.onStartElement
+    self.parser.EndElementHandler = self.onEndElement
+
+  def parse(self, xml_file):
+    self.parser.ParseFile(open(xml_file, "rb"))
+
+  def onStartElement(self, name, attrs):
+    if name == "Effect":
+      self.current_variants = {}
+      self.effects[int(attrs["typeID"])] = \
+          (int(attrs.get("variantParamID", "-1")), self.current_variants)
+    elif name == "Variant" and self.current_variants is not None:
+      self.current_params = {}
+      self.current_variants[int(attrs["effectVariantID"])] = \
+          self.current_params
+    elif name == "Parameter" and self.current_params is not None:
+      scale = self.SCALES[attrs["paramType"]]
+      value_count = int(attrs["numVals"])
+      # Continuous values go from 0 to numVals, choices are indices.
+      max_raw = max(value_count - 1, 0) if scale == "SCALE_INT" else \
+          value_count
+      # Validate the numbers, but keep them as they're written.
+      float(attrs["minimum"])
+      float(attrs["maximum"])
+      self.current_params[int(attrs["paramID"])] = \
+          (scale, attrs["minimum"], attrs["maximum"],
+           int(attrs["precision"]), Quote(attrs["unit"]), max_raw)
+
+  def onEndElement(self, name):
+    if name == "Effect":
+      self.current_variants = None
+    elif name == "Variant":
+      self.current_params = None
+
+UNKNOWN_RANGE = ("SCALE_UNKNOWN", "0", "0", 0, Quote(""), 0)
+
+def FormatRange(r):
+  return "{ %s, %s, %s, %d, %s, %d }" % r
+
+class SchemaGenerator:
+  """Generates a FirmwareSchema for each firmware.  The newest firmware is
+  the one that axefx_ii_ids.h is generated from, so its schema refers to
+  the tables in AxeFxIITables."""
+
+  def __init__(self, axemls, profiles, latest):
+    # axemls and profiles are lists of (firmware version, parser).
+    self.axemls = sorted(axemls)
+    self.profiles = dict([(v[0], p) for v, p in profiles])
+    self.latest = latest
+    self.block_type_count = \
+        max([int(t) for t in latest.type_id_to_name.keys()]) + 1
+
+  def Generate(self):
+    tables = []
+    schemas = []
+    first_versions = []
+    for version, axeml in self.axemls:
+      if version[0] not in FIRST_PARAMETER_VERSIONS:
+        print >> sys.stderr, \
+            "No parameter version for firmware %d" % version[0]
+        sys.exit(-1)
+      first_version = FIRST_PARAMETER_VERSIONS[version[0]]
+      name = "Firmware%d_%d" % version
+      t, schema = self.GenerateSchema(name, axeml,
+                                      self.profiles.get(version[0]))
+      tables += t
+      schemas += ['  { "AxeFxII %d.%02d", 0x%04x, %s },' %
+                  (version[0], version[1], first_version, schema)]
+      first_versions += [first_version]
+
+    version_count = LAST_SUPPORTED_VERSION - FIRST_SUPPORTED_VERSION + 1
+    index = []
+    for v in range(FIRST_SUPPORTED_VERSION, LAST_SUPPORTED_VERSION + 1):
+      index += [max([0] + [i for i, f in enumerate(first_versions) if f <= v])]
+    rows = []
+    for i in range(0, version_count, 16):
+      rows += ["  " + ", ".join([str(x) for x in index[i:i + 16]]) + ","]
+
+    return SCHEMAS_FILE_TEMPLATE % (
+        "\n\n".join(tables), "\n".join(schemas), FIRST_SUPPORTED_VERSION,
+        version_count, "\n".join(rows), FIRST_SUPPORTED_VERSION,
+        LAST_SUPPORTED_VERSION, FIRST_SUPPORTED_VERSION, len(schemas) - 1)
+
+  def GenerateSchema(self, name, axeml, profile):
+    """Returns the tables of a schema and the FirmwareSchema initializer."""
+    is_latest = axeml is self.latest
+    tables = []
+    block_types = []
+    param_entries = []
+    for type_id in range(self.block_type_count):
+      type_name = axeml.type_id_to_name.get(str(type_id))
+      if type_name is None:
+        block_types += ["{ nullptr, 0, -1, nullptr, -1, nullptr, 0 }"]
+        continue
+      block_name, params = axeml.block_type_params[type_name]
+      param_count = axeml.ParamCount(type_name)
+      prefix = "k%s%s" % (name, block_name)
+      for i, n in params:
+        param_entries += [(type_id, n.lower(), type_id, i)]
+
+      if is_latest:
+        names = "AxeFxIITables::k%sParamNames" % block_name
+      else:
+        names = prefix + "ParamNames"
+        tables += [FormatArray("char* const %s[%d]" %
+                               (names, max(1, param_count)),
+            DenseTable([(i, Quote(n.lower())) for i, n in params],
+                       max(1, param_count), Quote("")), 0, member=False)]
+
+      bypass_name = axeml.block_type_bypass_ids.get(type_name)
+      bypass_id = ([i for i, n in params if n == bypass_name] + [-1])[0]
+
+      ranges, variant_param_id, overrides, override_count = \
+          "nullptr", -1, "nullptr", 0
+      effect = profile.effects.get(type_id) if profile else None
+      if effect:
+        variants = effect[1]
+        base = variants.get(0, variants[min(variants.keys())])
+        ranges = prefix + "Ranges"
+        tables += [FormatArray("ParamRange %s[%d]" %
+                               (ranges, max(1, param_count)),
+            [FormatRange(base.get(i, UNKNOWN_RANGE))
+             for i in range(max(1, param_count))], 0, member=False)]
+        override_values = []
+        for v in sorted(variants.keys()):
+          for i, r in sorted(variants[v].items()):
+            if variants[v] is not base and i < param_count and \
+               r != base.get(i):
+              override_values += ["{ %d, %d, %s }" % (v, i, FormatRange(r))]
+        if override_values:
+          variant_param_id = effect[0]
+          overrides = prefix + "RangeOverrides"
+          override_count = len(override_values)
+          tables += [FormatArray("ParamRangeOverride %s[%d]" %
+                                 (overrides, override_count),
+                                 override_values, member=False)]
+
+      block_types += ["{ %s, %d, %d, %s, %d, %s, %d }" %
+                      (names, param_count, bypass_id, ranges,
+                       variant_param_id, overrides, override_count)]
+
+    tables += [FormatArray("BlockTypeSchema k%sBlockTypes[%d]" %
+                           (name, self.block_type_count), block_types, 0,
+                           member=False)]
+
+    if is_latest:
+      param_hash = "&AxeFxIITables::kParamIdsByName"
+    else:
+      tables += [FormatHashTable(name + "ParamIds", param_entries,
+                                 member=False)]
+      param_hash = "&k%sParamIdsByName" % name
+
+    # Schemas that don't list the amps or cabs share the newest ones.
+    pools = []
+    for pool, names in [("Amp", axeml.amp_names), ("Cab", axeml.cab_names)]:
+      if is_latest or not names:
+        pools += ["AxeFxIITables::k%sNames, AxeFxIITables::k%sCount" %
+                  (pool, pool)]
+      else:
+        count = max(names.keys()) + 1
+        tables += [FormatArray("char* const k%s%sNames[%d]" %
+                               (name, pool, count),
+            DenseTable([(i, Quote(n)) for i, n in names.items()], count,
+                       Quote("")), 0, member=False)]
+        pools += ["k%s%sNames, %d" % (name, pool, count)]
+
+    schema = "k%sBlockTypes, %d, %s, %s" % \
+        (name, self.block_type_count, param_hash, ", ".join(pools))
+    return tables, schema
 
 def WriteIfChanged(path, contents):
   if os.path.exists(path):
@@ -278,52 +686,64 @@ def WriteIfChanged(path, contents):
 
 def main(args):
   # args[0]: this script.
-  # args[1]: '--clean' or input file.
-  # args[2]: output folder
-  if len(args) != 3:
+  # args[1:-1]: '--clean' or the .axeml and .profile files.
+  # args[-1]: output folder
+  if len(args) < 3:
     print >> sys.stderr, "Missing argument"
     print args
     sys.exit(-1)
 
-  output_folder = os.path.normcase(args[2])
+  output_folder = os.path.normcase(args[-1])
   cc_file = os.path.join(output_folder, OUTPUT_CC)
   h_file = os.path.join(output_folder, OUTPUT_H)
+  schemas_file = os.path.join(output_folder, OUTPUT_SCHEMAS_CC)
   if args[1].lower() == "--clean":
     print "Deleting source files."
-    try:
-      os.unlink(cc_file)
-    except:
-      print >> os.stderr, "%s doesn't exist" % cc_file
-    try:
-      os.unlink(h_file)
-    except:
-      print >> os.stderr, "%s doesn't exist" % h_file
+    for f in [cc_file, h_file, schemas_file]:
+      try:
+        os.unlink(f)
+      except:
+        print >> sys.stderr, "%s doesn't exist" % f
     sys.exit(0)
 
-  input_file = os.path.normcase(args[1])
-  if not os.path.exists(input_file):
-    print >> os.stderr, "%s doesn't exist" % input_file
+  axemls = []
+  profiles = []
+  for arg in args[1:-1]:
+    input_file = os.path.normcase(arg)
+    if not os.path.exists(input_file):
+      print >> sys.stderr, "%s doesn't exist" % input_file
+      sys.exit(-1)
+    if input_file.endswith(".profile"):
+      parser = ProfileParser()
+      profiles += [(FirmwareVersion(input_file), parser)]
+    else:
+      parser = AxeMlParser()
+      axemls += [(FirmwareVersion(input_file), parser)]
+    parser.parse(input_file)
+
+  if not axemls:
+    print >> sys.stderr, "No .axeml file given"
     sys.exit(-1)
+  for version, profile in profiles:
+    if version[0] not in [v[0] for v, a in axemls]:
+      print >> sys.stderr, "No .axeml file for firmware %d" % version[0]
+      sys.exit(-1)
 
-  x = AxeMlParser()
-  x.parse(input_file)
+  # The ids and enums come from the newest firmware.
+  x = max(axemls)[1]
   header = BLOCK_TYPE_TEMPLATE % (",\n  ".join(x.block_types)) + \
            "\n\n" + (BLOCK_ID_TEMPLATE % (",\n  ".join(x.block_ids)))
   header += "\n\n"
   header += "\n\n".join(x.param_ids)
 
-  header = HEADER_FILE_TEMPLATE % (header, "\n".join(x.param_lookup_fn_fwd))
+  header = HEADER_FILE_TEMPLATE % (header, x.GenerateTables(),
+                                   x.GenerateParamLookupFunctions())
 
-  source = SOURCE_FILE_TEMPLATE % (x.GenerateBlockTypeFromID(),
-                                   x.GenerateBlockTypeName(),
-                                   x.GenerateBlockNameFromID(),
-                                   x.GenerateBlockBypassParamID(),
-                                   x.GenerateParamNamesForBlocks(),
-                                   x.GenerateAmpNames(),
-                                   x.GenerateCabNames(),
-                                   "\n".join(x.param_lookup_fn_impl))
+  source = SOURCE_FILE_TEMPLATE % x.GenerateTableDefinitions()
+  schemas = SchemaGenerator(axemls, profiles, x).Generate()
   WriteIfChanged(h_file, header)
   WriteIfChanged(cc_file, source)
+  WriteIfChanged(schemas_file, schemas)
 
   return 0
 
@@ -0,0 +1,87 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/allocation_hook.h"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#if defined(OS_WIN)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace {
+std::atomic<size_t> g_allocations(0);
+std::atomic<size_t> g_allocated_bytes(0);
+
+// Plain PODs so that they're usable before any constructors have run.
+THREAD_LOCAL size_t t_allocations = 0;
+THREAD_LOCAL size_t t_allocated_bytes = 0;
+
+void* CountedAlloc(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+  ++t_allocations;
+  t_allocated_bytes += size;
+  return malloc(size ? size : 1);
+}
+}  // namespace
+
+// Replacing the global allocation functions is the only way to see the
+// allocations made inside of the standard library and jsoncpp.
+void* operator new(size_t size) {
+  void* p = CountedAlloc(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size) {
+  void* p = CountedAlloc(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw() {
+  return CountedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw() {
+  return CountedAlloc(size);
+}
+
+void operator delete(void* p) throw() { free(p); }
+void operator delete[](void* p) throw() { free(p); }
+void operator delete(void* p, const std::nothrow_t&) throw() { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) throw() { free(p); }
+
+namespace bench {
+
+size_t AllocationCount() {
+  return g_allocations.load(std::memory_order_relaxed);
+}
+
+size_t AllocatedBytes() {
+  return g_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+AllocationScope::AllocationScope()
+    : count_at_start_(t_allocations), bytes_at_start_(t_allocated_bytes) {
+}
+
+AllocationScope::~AllocationScope() {}
+
+size_t AllocationScope::count() const {
+  return t_allocations - count_at_start_;
+}
+
+size_t AllocationScope::bytes() const {
+  return t_allocated_bytes - bytes_at_start_;
+}
+
+}  // namespace bench
@@ -0,0 +1,45 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef BENCH_ALLOCATION_HOOK_H_
+#define BENCH_ALLOCATION_HOOK_H_
+
+#include "common/common_types.h"
+
+namespace bench {
+
+// Linking this library replaces the global operator new and delete with
+// versions that count every allocation, including the ones made inside of
+// the standard library and jsoncpp.  Only the bench and test executables
+// link it.
+
+// Totals for the whole process.
+size_t AllocationCount();
+size_t AllocatedBytes();
+
+// Counts the allocations made by the calling thread while the object is in
+// scope.  Allocations on other threads, such as a ThreadLoop the code under
+// test posts to, aren't included.  Scopes can be nested.
+//
+//   bench::AllocationScope allocations;
+//   buffer.OnData(data, size);
+//   EXPECT_EQ(0u, allocations.count());
+class AllocationScope {
+ public:
+  AllocationScope();
+  ~AllocationScope();
+
+  size_t count() const;
+  size_t bytes() const;
+
+ private:
+  const size_t count_at_start_;
+  const size_t bytes_at_start_;
+
+  DISALLOW_COPY_AND_ASSIGN(AllocationScope);
+};
+
+}  // namespace bench
+
+#endif  // BENCH_ALLOCATION_HOOK_H_
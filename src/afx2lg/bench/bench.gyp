@@ -0,0 +1,78 @@
+# Copyright (c) 2013 Tomas Gunnarsson. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+{
+  'targets': [
+    {
+      'target_name': 'bench',
+      'type': 'executable',
+      'include_dirs': [
+        '..',
+        '../../jsoncpp/include',
+      ],
+      'dependencies': [
+        '../axefx/axefx.gyp:axefx',
+        '../common/base.gyp:base',
+        '../jsoncpp/jsoncpp.gyp:*',
+        '../lg/lg.gyp:lg',
+        '../midi/midi.gyp:midi',
+        'allocation_hook',
+        'corpus_generator',
+      ],
+      'sources': [
+        'benchmark.cc',
+        'benchmark.h',
+        'codec_bench.cc',
+        'corpus.cc',
+        'corpus.h',
+        'lg_bench.cc',
+        'main.cc',
+        'runtime_bench.cc',
+        'scale_bench.cc',
+        'suites.h',
+      ],
+    },
+    {
+      'target_name': 'allocation_hook',
+      'type': 'static_library',
+      'include_dirs': [
+        '..',
+      ],
+      'sources': [
+        'allocation_hook.cc',
+        'allocation_hook.h',
+      ],
+    },
+    {
+      'target_name': 'corpus_generator',
+      'type': 'static_library',
+      'include_dirs': [
+        '..',
+      ],
+      'dependencies': [
+        '../axefx/axefx.gyp:axefx',
+        '../common/base.gyp:base',
+      ],
+      'sources': [
+        'corpus_generator.cc',
+        'corpus_generator.h',
+      ],
+    },
+    {
+      'target_name': 'generate_corpus',
+      'type': 'executable',
+      'include_dirs': [
+        '..',
+      ],
+      'dependencies': [
+        '../axefx/axefx.gyp:axefx',
+        '../common/base.gyp:base',
+        'corpus_generator',
+      ],
+      'sources': [
+        'generate_corpus.cc',
+      ],
+    },
+  ],
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/benchmark.h"
+
+#include "bench/allocation_hook.h"
+#include "json/value.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+namespace {
+const void* volatile g_result_sink = NULL;
+}  // namespace
+
+namespace bench {
+
+void UseResult(const void* result) {
+  g_result_sink = result;
+}
+
+Iteration::Iteration()
+    : bytes_(0),
+      items_(0),
+      running_(false),
+      manual_time_(false),
+      elapsed_(Clock::duration::zero()),
+      allocations_at_start_(0),
+      allocated_bytes_at_start_(0),
+      allocations_(0),
+      allocated_bytes_(0) {
+}
+
+Iteration::~Iteration() {}
+
+void Iteration::PauseTiming() {
+  ASSERT(running_);
+  Stop();
+}
+
+void Iteration::ResumeTiming() {
+  ASSERT(!running_);
+  Start();
+}
+
+void Iteration::SetManualTime(const std::chrono::nanoseconds& time) {
+  manual_time_ = true;
+  elapsed_ = std::chrono::duration_cast<Clock::duration>(time);
+}
+
+void Iteration::Start() {
+  running_ = true;
+  allocations_at_start_ = AllocationCount();
+  allocated_bytes_at_start_ = AllocatedBytes();
+  started_ = Clock::now();
+}
+
+void Iteration::Stop() {
+  if (!manual_time_)
+    elapsed_ += Clock::now() - started_;
+  allocations_ += AllocationCount() - allocations_at_start_;
+  allocated_bytes_ += AllocatedBytes() - allocated_bytes_at_start_;
+  running_ = false;
+}
+
+Options::Options()
+    : min_time(500), min_iterations(10), max_iterations(100000) {
+}
+
+Runner::Runner(const Options& options) : options_(options), failures_(0) {}
+
+Runner::~Runner() {}
+
+void Runner::Add(const std::string& name, const BenchmarkFunction& function) {
+  Benchmark benchmark = { name, function };
+  benchmarks_.push_back(benchmark);
+}
+
+bool Runner::Run(Json::Value* results) {
+  bool ran = false;
+  failures_ = 0;
+  for (size_t i = 0; i < benchmarks_.size(); ++i) {
+    if (benchmarks_[i].name.find(options_.filter) == std::string::npos)
+      continue;
+    Json::Value result;
+    if (!RunOne(benchmarks_[i], &result))
+      ++failures_;
+    results->append(result);
+    ran = true;
+  }
+  return ran;
+}
+
+bool Runner::RunOne(const Benchmark& benchmark, Json::Value* result) {
+  typedef std::chrono::duration<double, std::micro> Microseconds;
+
+  // Warm up caches and let lazily initialized state get created.
+  {
+    Iteration warm_up;
+    warm_up.Start();
+    benchmark.function(&warm_up);
+    if (!warm_up.error_.empty())
+      return ReportError(benchmark, warm_up.error_, result);
+  }
+
+  std::vector<double> samples;  // Microseconds per iteration.
+  size_t bytes = 0, items = 0, allocations = 0, allocated_bytes = 0;
+  Iteration::Clock::duration total(Iteration::Clock::duration::zero());
+  while (static_cast<int>(samples.size()) < options_.max_iterations &&
+         (static_cast<int>(samples.size()) < options_.min_iterations ||
+          total < options_.min_time)) {
+    Iteration iteration;
+    iteration.Start();
+    benchmark.function(&iteration);
+    if (iteration.running_)
+      iteration.Stop();
+    if (!iteration.error_.empty())
+      return ReportError(benchmark, iteration.error_, result);
+
+    total += iteration.elapsed_;
+    samples.push_back(
+        std::chrono::duration_cast<Microseconds>(iteration.elapsed_).count());
+    bytes = iteration.bytes_;
+    items = iteration.items_;
+    allocations += iteration.allocations_;
+    allocated_bytes += iteration.allocated_bytes_;
+  }
+
+  std::sort(samples.begin(), samples.end());
+  size_t count = samples.size();
+  double p50 = samples[count / 2];
+  double p99 = samples[std::min(count - 1, (count * 99 + 99) / 100 - 1)];
+  double mean =
+      std::chrono::duration_cast<Microseconds>(total).count() / count;
+
+  Json::Value& r = *result;
+  r["name"] = benchmark.name;
+  r["iterations"] = static_cast<Json::UInt>(count);
+  r["min_us"] = samples[0];
+  r["mean_us"] = mean;
+  r["p50_us"] = p50;
+  r["p99_us"] = p99;
+  r["bytes_per_iteration"] = static_cast<Json::UInt>(bytes);
+  r["items_per_iteration"] = static_cast<Json::UInt>(items);
+  // Throughput is based on the median so that outliers don't skew it.
+  // 1 MB == 10^6 bytes, which conveniently is bytes per microsecond.
+  r["mb_per_s"] = p50 > 0 ? bytes / p50 : 0.0;
+  r["items_per_s"] = p50 > 0 ? items * 1e6 / p50 : 0.0;
+  r["allocs_per_iteration"] = static_cast<double>(allocations) / count;
+  r["alloc_bytes_per_iteration"] =
+      static_cast<double>(allocated_bytes) / count;
+
+  std::cerr << std::left << std::setw(48) << benchmark.name << std::right
+            << std::fixed << std::setprecision(1)
+            << std::setw(8) << count << " it"
+            << "  p50 " << std::setw(10) << p50 << " us"
+            << "  p99 " << std::setw(10) << p99 << " us"
+            << std::setprecision(2)
+            << std::setw(10) << r["mb_per_s"].asDouble() << " MB/s"
+            << std::setprecision(1)
+            << std::setw(12) << r["items_per_s"].asDouble() << " items/s"
+            << std::setw(10) << r["allocs_per_iteration"].asDouble()
+            << " allocs\n";
+  return true;
+}
+
+// static
+bool Runner::ReportError(const Benchmark& benchmark, const std::string& error,
+                         Json::Value* result) {
+  (*result)["name"] = benchmark.name;
+  (*result)["error"] = error;
+  std::cerr << std::left << std::setw(48) << benchmark.name << std::right
+            << "  FAILED: " << error << "\n";
+  return false;
+}
+
+}  // namespace bench
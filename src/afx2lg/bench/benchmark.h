@@ -0,0 +1,121 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef BENCH_BENCHMARK_H_
+#define BENCH_BENCHMARK_H_
+
+#include "common/common_types.h"
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Json {
+class Value;
+}
+
+namespace bench {
+
+// Handed to a benchmark function for each iteration.  The function reports
+// how much work it did so that throughput can be calculated.
+class Iteration {
+ public:
+  Iteration();
+  ~Iteration();
+
+  void AddBytes(size_t bytes) { bytes_ += bytes; }
+  void AddItems(size_t items) { items_ += items; }
+
+  // Excludes setup work, such as building input that the measured code
+  // consumes, from both the timing and the allocation counts.
+  void PauseTiming();
+  void ResumeTiming();
+
+  // Reports |time| as the duration of the iteration instead of the measured
+  // time.  For latencies that start or end on another thread.
+  void SetManualTime(const std::chrono::nanoseconds& time);
+
+  // Marks the benchmark as failed, e.g. when the measured code didn't do all
+  // of its work.  The runner stops the benchmark after this iteration.
+  void SetError(const std::string& error) { error_ = error; }
+
+ private:
+  friend class Runner;
+  typedef std::chrono::steady_clock Clock;
+
+  void Start();
+  void Stop();
+
+  size_t bytes_;
+  size_t items_;
+  bool running_;
+  bool manual_time_;
+  Clock::time_point started_;
+  Clock::duration elapsed_;
+  size_t allocations_at_start_;
+  size_t allocated_bytes_at_start_;
+  size_t allocations_;
+  size_t allocated_bytes_;
+  std::string error_;
+
+  DISALLOW_COPY_AND_ASSIGN(Iteration);
+};
+
+typedef std::function<void(Iteration* iteration)> BenchmarkFunction;
+
+struct Options {
+  Options();
+
+  // Only benchmarks whose name contains |filter| are run.
+  std::string filter;
+  // Each benchmark runs for at least |min_time| and |min_iterations|, but
+  // never more than |max_iterations|, after one untimed warm-up iteration.
+  std::chrono::milliseconds min_time;
+  int min_iterations;
+  int max_iterations;
+};
+
+// Runs registered benchmarks and collects their results.
+// Names are of the form "<group>/<what>/<input>".
+class Runner {
+ public:
+  explicit Runner(const Options& options);
+  ~Runner();
+
+  void Add(const std::string& name, const BenchmarkFunction& function);
+
+  // Runs the benchmarks that match the filter.  A summary line per benchmark
+  // is printed to stderr and a result object per benchmark is appended to
+  // |results|, which must be an array.  Returns false if nothing matched.
+  bool Run(Json::Value* results);
+
+  // Number of benchmarks that reported an error in the last Run().
+  size_t failures() const { return failures_; }
+
+ private:
+  struct Benchmark {
+    std::string name;
+    BenchmarkFunction function;
+  };
+
+  // Returns false if an iteration reported an error.
+  bool RunOne(const Benchmark& benchmark, Json::Value* result);
+  static bool ReportError(const Benchmark& benchmark, const std::string& error,
+                          Json::Value* result);
+
+  Options options_;
+  std::vector<Benchmark> benchmarks_;
+  size_t failures_;
+
+  DISALLOW_COPY_AND_ASSIGN(Runner);
+};
+
+// Keeps the compiler from optimizing away a computation whose result is
+// otherwise unused.
+void UseResult(const void* result);
+
+}  // namespace bench
+
+#endif  // BENCH_BENCHMARK_H_
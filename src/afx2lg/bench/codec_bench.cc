@@ -0,0 +1,398 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/benchmark.h"
+#include "bench/corpus.h"
+#include "bench/suites.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/param_converter.h"
+#include "axefx/preset.h"
+#include "axefx/sysex_types.h"
+#include "json/value.h"
+
+#include <iostream>
+
+using std::placeholders::_1;
+
+namespace bench {
+namespace {
+
+using namespace axefx;
+
+// The messages that make up one preset.
+struct PresetFrames {
+  const Corpus::Frame* id;
+  std::vector<const Corpus::Frame*> parameters;
+  const Corpus::Frame* checksum;
+};
+
+// Benchmark input and output buffers are owned by the bound functions.
+typedef shared_ptr<std::vector<uint16_t> > SharedValues;
+typedef shared_ptr<const std::vector<PresetFrames> > SharedPresetFrames;
+
+std::vector<PresetFrames> GroupPresets(const Corpus& corpus) {
+  std::vector<PresetFrames> presets;
+  for (size_t i = 0; i < corpus.frames.size(); ++i) {
+    const Corpus::Frame& frame = corpus.frames[i];
+    switch (frame.header().function()) {
+      case PRESET_ID: {
+        PresetFrames preset = { &frame };
+        presets.push_back(preset);
+        break;
+      }
+      case PRESET_PARAMETERS:
+        presets.back().parameters.push_back(&frame);
+        break;
+      case PRESET_CHECKSUM:
+        presets.back().checksum = &frame;
+        break;
+      default:
+        break;
+    }
+  }
+  return presets;
+}
+
+// Decodes all the preset parameter values in |corpus|.
+std::vector<uint16_t> DecodeParameters(const Corpus& corpus) {
+  std::vector<uint16_t> values;
+  for (size_t i = 0; i < corpus.frames.size(); ++i) {
+    const Corpus::Frame& frame = corpus.frames[i];
+    if (frame.header().function() != PRESET_PARAMETERS)
+      continue;
+    const ParameterBlockHeader& block =
+        reinterpret_cast<const ParameterBlockHeader&>(frame.header());
+    for (uint8_t v = 0; v < block.value_count; ++v)
+      values.push_back(block.values[v].Decode());
+  }
+  return values;
+}
+
+// Benchmarks.
+
+void FrameScan(const SharedCorpus& corpus, Iteration* it) {
+  size_t frames = 0;
+  const uint8_t* begin = NULL;
+  const uint8_t* end = corpus->data.get() + corpus->size;
+  for (const uint8_t* pos = corpus->data.get(); pos < end; ++pos) {
+    if (*pos == kSysExStart) {
+      begin = pos;
+    } else if (*pos == kSysExEnd && begin) {
+      if (IsFractalSysEx(begin, (pos - begin) + 1))
+        ++frames;
+      begin = NULL;
+    }
+  }
+  UseResult(&frames);
+  it->AddBytes(corpus->size);
+  it->AddItems(frames);
+}
+
+void SysExChecksum(const SharedCorpus& corpus, Iteration* it) {
+  uint8_t checksums = 0;
+  for (size_t i = 0; i < corpus->frames.size(); ++i) {
+    const Corpus::Frame& frame = corpus->frames[i];
+    checksums ^= CalculateSysExChecksum(frame.data, frame.size);
+  }
+  UseResult(&checksums);
+  it->AddBytes(corpus->size);
+  it->AddItems(corpus->frames.size());
+}
+
+void PresetChecksum(const SharedValues& values, Iteration* it) {
+  uint16_t checksum = CalculateChecksum(*values);
+  UseResult(&checksum);
+  it->AddBytes(values->size() * sizeof(uint16_t));
+  it->AddItems(values->size());
+}
+
+void Decode16(const SharedCorpus& corpus, const SharedValues& out,
+              Iteration* it) {
+  size_t count = 0;
+  for (size_t i = 0; i < corpus->frames.size(); ++i) {
+    const Corpus::Frame& frame = corpus->frames[i];
+    if (frame.header().function() != PRESET_PARAMETERS)
+      continue;
+    const ParameterBlockHeader& block =
+        reinterpret_cast<const ParameterBlockHeader&>(frame.header());
+    for (uint8_t v = 0; v < block.value_count; ++v)
+      (*out)[count++] = block.values[v].Decode();
+  }
+  UseResult(&(*out)[0]);
+  it->AddBytes(count * sizeof(Fractal16bit));
+  it->AddItems(count);
+}
+
+void Encode16(const SharedValues& values,
+              const shared_ptr<Fractal16bit>& out,
+              Iteration* it) {
+  for (size_t i = 0; i < values->size(); ++i)
+    out.get()[i].Encode((*values)[i]);
+  UseResult(out.get());
+  it->AddBytes(values->size() * sizeof(Fractal16bit));
+  it->AddItems(values->size());
+}
+
+void Decode32(const SharedCorpus& corpus, Iteration* it) {
+  uint32_t sum = 0;
+  size_t count = 0;
+  for (size_t i = 0; i < corpus->frames.size(); ++i) {
+    const Corpus::Frame& frame = corpus->frames[i];
+    if (frame.header().function() != FIRMWARE_DATA)
+      continue;
+    const FirmwareDataHeader& block =
+        reinterpret_cast<const FirmwareDataHeader&>(frame.header());
+    uint16_t value_count = block.value_count.Decode();
+    for (uint16_t v = 0; v < value_count; ++v)
+      sum += block.values[v].Decode();
+    count += value_count;
+  }
+  UseResult(&sum);
+  it->AddBytes(count * sizeof(Fractal32bit));
+  it->AddItems(count);
+}
+
+void Finalize(const SharedCorpus& corpus,
+              const SharedPresetFrames& frames,
+              bool verify_only,
+              Iteration* it) {
+  // Only the Finalize() calls are measured, but the presets have to be
+  // rebuilt for every iteration since finalizing consumes the raw data.
+  it->PauseTiming();
+  std::vector<unique_ptr<Preset> > presets;
+  for (size_t i = 0; i < frames->size(); ++i) {
+    const PresetFrames& p = (*frames)[i];
+    unique_ptr<Preset> preset(new Preset());
+    preset->SetPresetId(
+        reinterpret_cast<const PresetIdHeader&>(p.id->header()), p.id->size);
+    for (size_t j = 0; j < p.parameters.size(); ++j) {
+      preset->AddParameterData(
+          reinterpret_cast<const ParameterBlockHeader&>(
+              p.parameters[j]->header()),
+          p.parameters[j]->size);
+    }
+    presets.push_back(std::move(preset));
+  }
+  it->ResumeTiming();
+
+  for (size_t i = 0; i < presets.size(); ++i) {
+    const Corpus::Frame* checksum = (*frames)[i].checksum;
+    bool ok = presets[i]->Finalize(
+        reinterpret_cast<const PresetChecksumHeader*>(&checksum->header()),
+        checksum->size, verify_only);
+    ASSERT(ok);
+    UseResult(&ok);
+  }
+
+  // Don't count freeing the presets.
+  it->PauseTiming();
+  presets.clear();
+  it->ResumeTiming();
+
+  it->AddBytes(corpus->size);
+  it->AddItems(frames->size());
+}
+
+void Parse(const SharedCorpus& corpus, Iteration* it) {
+  SysExParser parser;
+  bool ok = parser.ParseSysExBuffer(corpus->data.get(),
+                                    corpus->data.get() + corpus->size, true);
+  ASSERT(ok);
+  UseResult(&ok);
+  it->AddBytes(corpus->size);
+  it->AddItems(parser.presets().size());
+}
+
+void ToJson(const shared_ptr<SysExParser>& parser, Iteration* it) {
+  const PresetMap& presets = parser->presets();
+  for (PresetMap::const_iterator i = presets.begin(); i != presets.end();
+       ++i) {
+    Json::Value json;
+    i->second->ToJson(&json);
+    UseResult(&json);
+  }
+  it->AddItems(presets.size());
+}
+
+void CountBytes(size_t* bytes, const std::vector<uint8_t>& data) {
+  *bytes += data.size();
+}
+
+void Serialize(const shared_ptr<SysExParser>& parser, Iteration* it) {
+  size_t bytes = 0;
+  bool ok = parser->Serialize(std::bind(&CountBytes, &bytes, _1));
+  ASSERT(ok);
+  UseResult(&ok);
+  it->AddBytes(bytes);
+  it->AddItems(parser->presets().size());
+}
+
+void FirmwareRoundTrip(const SharedCorpus& corpus, Iteration* it) {
+  SysExParser parser;
+  bool ok = parser.ParseSysExBuffer(corpus->data.get(),
+                                    corpus->data.get() + corpus->size, true);
+  ASSERT(ok && parser.type() == SysExParser::FIRMWARE);
+  size_t bytes = 0;
+  ok = parser.Serialize(std::bind(&CountBytes, &bytes, _1));
+  ASSERT(ok && bytes == corpus->size);
+  UseResult(&ok);
+  it->AddBytes(corpus->size);
+}
+
+// The x values of all the blocks of a set of presets, one block after the
+// other.
+struct BlockValues {
+  struct Block {
+    AxeFxBlockType type;
+    int variant;
+    size_t offset;
+    size_t count;
+  };
+  std::vector<Block> blocks;
+  std::vector<uint16_t> raw;
+  std::vector<double> values;
+};
+typedef shared_ptr<BlockValues> SharedBlockValues;
+
+void ParamToValues(const shared_ptr<ParamConverter>& converter,
+                   const SharedBlockValues& library, Iteration* it) {
+  for (size_t i = 0; i < library->blocks.size(); ++i) {
+    const BlockValues::Block& block = library->blocks[i];
+    converter->ToValues(block.type, block.variant,
+                        &library->raw[block.offset], block.count,
+                        &library->values[block.offset]);
+  }
+  UseResult(&library->values[0]);
+  it->AddBytes(library->raw.size() * sizeof(uint16_t));
+  it->AddItems(library->raw.size());
+}
+
+void ParamToRaw(const shared_ptr<ParamConverter>& converter,
+                const SharedBlockValues& library, Iteration* it) {
+  for (size_t i = 0; i < library->blocks.size(); ++i) {
+    const BlockValues::Block& block = library->blocks[i];
+    converter->ToRawValues(block.type, block.variant,
+                           &library->values[block.offset], block.count,
+                           &library->raw[block.offset]);
+  }
+  UseResult(&library->raw[0]);
+  it->AddBytes(library->raw.size() * sizeof(uint16_t));
+  it->AddItems(library->raw.size());
+}
+
+SharedBlockValues CollectBlockValues(const SysExParser& parser,
+                                     const ParamConverter& converter) {
+  SharedBlockValues library(new BlockValues());
+  const PresetMap& presets = parser.presets();
+  for (PresetMap::const_iterator i = presets.begin(); i != presets.end();
+       ++i) {
+    for (int id = kFirstBlockId; id <= BLOCK_TONE_MATCH; ++id) {
+      const BlockParameters* block =
+          i->second->LookupBlock(static_cast<AxeFxIIBlockID>(id));
+      if (!block)
+        continue;
+      std::vector<double> values;
+      converter.BlockToValues(*block, true, &values);
+      int variant_id = converter.schema().GetVariantParamID(block->type());
+      BlockValues::Block b = {
+        block->type(),
+        variant_id == -1 ? -1 : block->GetParamValue(variant_id, true),
+        library->raw.size(),
+        values.size()
+      };
+      library->blocks.push_back(b);
+      for (size_t j = 0; j < values.size(); ++j) {
+        library->raw.push_back(
+            block->GetParamValue(static_cast<int>(j), true));
+      }
+      library->values.insert(library->values.end(), values.begin(),
+                             values.end());
+    }
+  }
+  return library;
+}
+
+shared_ptr<SysExParser> ParseCorpus(const Corpus& corpus) {
+  shared_ptr<SysExParser> parser(new SysExParser());
+  if (!parser->ParseSysExBuffer(corpus.data.get(),
+                                corpus.data.get() + corpus.size, true)) {
+    std::cerr << "Failed to parse " << corpus.name << "\n";
+    parser.reset();
+  }
+  return parser;
+}
+
+}  // namespace
+
+bool RegisterCodecBenchmarks(const std::string& data_dir, Runner* runner) {
+  // All three banks of a recent firmware, a single bank, a preset that uses
+  // the tone match block (Huffman compressed IR data) and a firmware file.
+  SharedCorpus all_banks = LoadCorpus(data_dir, "axefx2/V12_All_Banks.syx");
+  SharedCorpus bank = LoadCorpus(data_dir, "axefx2/V12_Bank_A.syx");
+  SharedCorpus tone_match =
+      LoadCorpus(data_dir, "axefx2/tone_match_preset.syx");
+  SharedCorpus firmware = LoadCorpus(data_dir, "axefx2/v10/axefx2_10p02.syx");
+  // Only the firmware 7 schema has parameter ranges.
+  SharedCorpus v7_bank = LoadCorpus(data_dir, "axefx2/V7_Bank_A.syx");
+  if (!all_banks || !bank || !tone_match || !firmware || !v7_bank)
+    return false;
+
+  shared_ptr<SysExParser> parsed_bank = ParseCorpus(*bank);
+  shared_ptr<SysExParser> parsed_tone_match = ParseCorpus(*tone_match);
+  shared_ptr<SysExParser> parsed_v7_bank = ParseCorpus(*v7_bank);
+  if (!parsed_bank || !parsed_tone_match || !parsed_v7_bank)
+    return false;
+
+  SharedValues values(new std::vector<uint16_t>(DecodeParameters(*all_banks)));
+  SharedValues decoded(new std::vector<uint16_t>(values->size()));
+  shared_ptr<Fractal16bit> encoded(new Fractal16bit[values->size()],
+                                   std::default_delete<Fractal16bit[]>());
+  SharedPresetFrames bank_frames(
+      new std::vector<PresetFrames>(GroupPresets(*bank)));
+  SharedPresetFrames tone_match_frames(
+      new std::vector<PresetFrames>(GroupPresets(*tone_match)));
+  shared_ptr<ParamConverter> converter(
+      new ParamConverter(&parsed_v7_bank->presets().begin()->second->schema()));
+  SharedBlockValues v7_values = CollectBlockValues(*parsed_v7_bank,
+                                                   *converter);
+
+  const std::string& a = all_banks->name;
+  runner->Add("codec/frame_scan/" + a, std::bind(&FrameScan, all_banks, _1));
+  runner->Add("codec/frame_scan/" + firmware->name,
+              std::bind(&FrameScan, firmware, _1));
+  runner->Add("codec/checksum_sysex/" + a,
+              std::bind(&SysExChecksum, all_banks, _1));
+  runner->Add("codec/checksum_preset/" + a,
+              std::bind(&PresetChecksum, values, _1));
+  runner->Add("codec/septet_decode16/" + a,
+              std::bind(&Decode16, all_banks, decoded, _1));
+  runner->Add("codec/septet_encode16/" + a,
+              std::bind(&Encode16, values, encoded, _1));
+  runner->Add("codec/septet_decode32/" + firmware->name,
+              std::bind(&Decode32, firmware, _1));
+  runner->Add("codec/finalize/" + bank->name,
+              std::bind(&Finalize, bank, bank_frames, false, _1));
+  runner->Add("codec/finalize_verify_only/" + bank->name,
+              std::bind(&Finalize, bank, bank_frames, true, _1));
+  runner->Add("codec/finalize_huffman/" + tone_match->name,
+              std::bind(&Finalize, tone_match, tone_match_frames, false,
+                        _1));
+  runner->Add("codec/parse/" + a, std::bind(&Parse, all_banks, _1));
+  runner->Add("codec/to_json/" + bank->name,
+              std::bind(&ToJson, parsed_bank, _1));
+  runner->Add("codec/serialize/" + bank->name,
+              std::bind(&Serialize, parsed_bank, _1));
+  runner->Add("codec/serialize_huffman/" + tone_match->name,
+              std::bind(&Serialize, parsed_tone_match, _1));
+  runner->Add("codec/firmware_round_trip/" + firmware->name,
+              std::bind(&FirmwareRoundTrip, firmware, _1));
+  runner->Add("codec/param_to_values/" + v7_bank->name,
+              std::bind(&ParamToValues, converter, v7_values, _1));
+  runner->Add("codec/param_to_raw/" + v7_bank->name,
+              std::bind(&ParamToRaw, converter, v7_values, _1));
+
+  return true;
+}
+
+}  // namespace bench
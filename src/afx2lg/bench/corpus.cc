@@ -0,0 +1,55 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/corpus.h"
+
+#include "common/file_utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+namespace bench {
+
+SharedCorpus LoadCorpus(const std::string& data_dir, const std::string& file) {
+  shared_ptr<Corpus> corpus(new Corpus());
+  if (!base::ReadFileIntoBuffer(data_dir + "/" + file, &corpus->data,
+                                &corpus->size)) {
+    std::cerr << "Failed to read " << data_dir << "/" << file << "\n";
+    return SharedCorpus();
+  }
+
+  std::string::size_type slash = file.find_last_of('/');
+  corpus->name = file.substr(slash == std::string::npos ? 0 : slash + 1);
+  corpus->name.resize(corpus->name.find_last_of('.'));
+
+  const uint8_t* begin = NULL;
+  for (size_t i = 0; i < corpus->size; ++i) {
+    const uint8_t* pos = &corpus->data[i];
+    if (*pos == axefx::kSysExStart) {
+      begin = pos;
+    } else if (*pos == axefx::kSysExEnd && begin) {
+      Corpus::Frame frame = { begin, static_cast<size_t>(pos - begin) + 1 };
+      corpus->frames.push_back(frame);
+      begin = NULL;
+    }
+  }
+
+  return corpus;
+}
+
+std::vector<size_t> RandomChunkSizes(size_t total, size_t max_chunk,
+                                     unsigned int seed) {
+  ASSERT(max_chunk > 0u);
+  std::mt19937 generator(seed);
+  std::uniform_int_distribution<size_t> distribution(1u, max_chunk);
+  std::vector<size_t> sizes;
+  while (total) {
+    size_t size = std::min(total, distribution(generator));
+    sizes.push_back(size);
+    total -= size;
+  }
+  return sizes;
+}
+
+}  // namespace bench
@@ -0,0 +1,49 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef BENCH_CORPUS_H_
+#define BENCH_CORPUS_H_
+
+#include "common/common_types.h"
+
+#include "axefx/sysex_types.h"
+
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// A .syx file and the location of each sysex message within it.
+struct Corpus {
+  struct Frame {
+    const uint8_t* data;
+    size_t size;
+    const axefx::FractalSysExHeader& header() const {
+      return *reinterpret_cast<const axefx::FractalSysExHeader*>(data);
+    }
+  };
+
+  Corpus() : size(0) {}
+
+  std::string name;  // File name without the extension.
+  unique_ptr<uint8_t[]> data;
+  size_t size;
+  std::vector<Frame> frames;
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Corpus);
+};
+typedef shared_ptr<const Corpus> SharedCorpus;
+
+// Loads |file|, relative to |data_dir|.  Returns NULL if it can't be read.
+SharedCorpus LoadCorpus(const std::string& data_dir, const std::string& file);
+
+// Splits |total| bytes into chunks of between 1 and |max_chunk| bytes.
+// The sizes are random, but the same |seed| always gives the same sizes.
+std::vector<size_t> RandomChunkSizes(size_t total, size_t max_chunk,
+                                     unsigned int seed);
+
+}  // namespace bench
+
+#endif  // BENCH_CORPUS_H_
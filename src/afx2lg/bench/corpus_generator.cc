@@ -0,0 +1,281 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/corpus_generator.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/blocks.h"
+#include "axefx/ir_data.h"
+#include "axefx/preset.h"
+#include "common/file_utils.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using std::placeholders::_1;
+
+namespace bench {
+namespace {
+
+using namespace axefx;
+
+// The template files have been picked to cover presets from a few firmware
+// versions, X/Y and scene heavy presets and the Tone Match block.
+const char* const kDefaultTemplateFiles[] = {
+  "axefx2/9b_A.syx",
+  "axefx2/9b_B.syx",
+  "axefx2/9b_C.syx",
+  "axefx2/V7_Bank_A.syx",
+  "axefx2/V7_Bank_B.syx",
+  "axefx2/V7_Bank_C.syx",
+  "axefx2/V12_All_Banks.syx",
+  "axefx2/v10/V10_All_Banks.syx",
+  "axefx2/find_y_state.syx",
+  "axefx2/find_y_state(2).syx",
+  "axefx2/manyfx.syx",
+  "axefx2/one_amp.syx",
+  "axefx2/one_amp_8scenes_xy_1.syx",
+  "axefx2/one_amp_8scenes_xy_2.syx",
+  "axefx2/p000318_DynamicJCM800.syx",
+  "axefx2/tone_match_preset.syx",
+  "axefx2/xy_test1.syx",
+  "axefx2/xy_test2.syx",
+};
+
+const char* const kNameWords[] = {
+  "Big", "Blue", "Brit", "Clean", "Crunch", "Dark", "Deluxe", "Dirty",
+  "Drive", "Edge", "Fat", "Fuzz", "Glass", "Hi", "Hot", "Jazz", "Lead",
+  "Liquid", "Lo", "Metal", "Modern", "Plexi", "Rhythm", "Solo", "Space",
+  "Swirl", "Tape", "Twin", "Vintage", "Wah",
+};
+
+const int kScenes = 8;
+const size_t kIRWords = 2048u;
+const size_t kToneMatchIRValues = 1024u;
+
+// Presets use IDs 0-383.  384 and up are system data.
+const size_t kPresetIdCount = 3u * 128u;
+
+struct AppendTo {
+  static void Run(std::vector<uint8_t>* out, const std::vector<uint8_t>& data) {
+    out->insert(out->end(), data.begin(), data.end());
+  }
+};
+
+// The number of X values in a block.  For X/Y blocks the second half of the
+// parameters holds the Y values.
+size_t XParamCount(const BlockParameters& block) {
+  return block.supports_xy() ? block.param_count() / 2 : block.param_count();
+}
+
+// Presets may have fewer parameters than their schema says, so don't assume
+// that the bypass parameter is there.
+bool HasBypassParam(const BlockParameters& block) {
+  int bypass_id = block.schema().GetBypassParamID(block.type());
+  return bypass_id != -1 &&
+         static_cast<size_t>(bypass_id) < XParamCount(block);
+}
+
+std::vector<BlockParameters*> GetBlocks(Preset* preset) {
+  std::vector<BlockParameters*> blocks;
+  const Matrix& matrix = preset->matrix();
+  for (size_t x = 0; x < kMatrixColumns; ++x) {
+    for (size_t y = 0; y < kMatrixRows; ++y) {
+      if (matrix[x][y].is_shunt())
+        continue;
+      BlockParameters* block = preset->LookupBlock(matrix[x][y].block());
+      if (block && !block->is_modifier() && block->param_count())
+        blocks.push_back(block);
+    }
+  }
+  return blocks;
+}
+
+}  // namespace
+
+CorpusGenerator::CorpusGenerator(unsigned int seed)
+    : random_(seed), tone_match_percent_(5) {
+}
+
+CorpusGenerator::~CorpusGenerator() {}
+
+bool CorpusGenerator::AddTemplates(const uint8_t* begin, const uint8_t* end) {
+  SysExParser parser;
+  if (!parser.ParseSysExBuffer(begin, end, true))
+    return false;
+
+  // Store the templates serialized, so that each generated preset can start
+  // out as a fresh copy by parsing its template.
+  for (const auto& pair : parser.presets()) {
+    const Preset& preset = *pair.second.get();
+    if (!preset.valid() || preset.is_global_setting())
+      continue;
+    Template data;
+    preset.Serialize(std::bind(&AppendTo::Run, &data, _1));
+    if (preset.ir_data().empty()) {
+      templates_.push_back(std::move(data));
+    } else {
+      tone_match_templates_.push_back(std::move(data));
+    }
+  }
+
+  return true;
+}
+
+bool CorpusGenerator::AddDefaultTemplates(const std::string& data_dir) {
+  for (size_t i = 0; i < arraysize(kDefaultTemplateFiles); ++i) {
+    std::string path(data_dir + "/" + kDefaultTemplateFiles[i]);
+    unique_ptr<uint8_t[]> buffer;
+    size_t size = 0;
+    if (!base::ReadFileIntoBuffer(path, &buffer, &size)) {
+      std::cerr << "Failed to read " << path << std::endl;
+      return false;
+    }
+    if (!AddTemplates(&buffer[0], &buffer[0] + size)) {
+      std::cerr << "Failed to parse " << path << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+shared_ptr<Preset> CorpusGenerator::GeneratePreset(int id) {
+  ASSERT(!templates_.empty() || !tone_match_templates_.empty());
+  bool tone_match = !tone_match_templates_.empty() &&
+      (templates_.empty() || RandomInt(0, 99) < tone_match_percent_);
+  const std::vector<Template>& templates =
+      tone_match ? tone_match_templates_ : templates_;
+  const Template& data =
+      templates[RandomInt(0, static_cast<int>(templates.size()) - 1)];
+
+  SysExParser parser;
+  if (!parser.ParseSysExBuffer(&data[0], &data[0] + data.size(), true) ||
+      parser.presets().size() != 1u) {
+    std::cerr << "Failed to parse a template for preset " << id << std::endl;
+    return shared_ptr<Preset>();
+  }
+
+  shared_ptr<Preset> preset(parser.presets().begin()->second);
+  preset->set_id(id);
+  preset->set_name(GenerateName());
+  RandomizeScenes(preset.get());
+  if (tone_match) {
+    RandomizeToneMatchIR(preset.get());
+  } else {
+    JitterParameters(preset.get());
+  }
+
+  return preset;
+}
+
+unique_ptr<IRData> CorpusGenerator::GenerateIR(uint16_t id) {
+  std::ostringstream stream;
+  stream << kNameWords[RandomInt(0, arraysize(kNameWords) - 1)] << " IR "
+         << id;
+  std::string name(stream.str());
+  name.resize(std::min<size_t>(name.size(), 28u));
+
+  std::vector<uint32_t> data;
+  data.reserve(kIRWords);
+  for (size_t i = 0; i < name.size(); i += 4) {
+    uint32_t word = 0;
+    for (size_t c = i; c < i + 4; ++c) {
+      word <<= 8;
+      if (c < name.size())
+        word |= static_cast<uint8_t>(name[c]);
+    }
+    data.push_back(word);
+  }
+  data.resize(8u, 0u);  // Zero terminated and padded.
+
+  // A decaying noise burst is close enough to a speaker cabinet response to
+  // be stored and checksummed like one.
+  std::normal_distribution<float> noise(0.0f, 0.25f);
+  float decay = 1.0f;
+  while (data.size() < kIRWords) {
+    float sample = std::max(-1.0f, std::min(1.0f, noise(random_) * decay));
+    data.push_back(static_cast<uint32_t>(static_cast<int32_t>(
+        sample * 0x7FFFFF00)));
+    decay *= 0.997f;
+  }
+
+  unique_ptr<IRData> ir(new IRData());
+  ir->set_id(id);
+  ir->set_data(data);
+  return ir;
+}
+
+bool CorpusGenerator::GenerateArchive(size_t first_id, size_t count,
+                                      std::vector<uint8_t>* out) {
+  ASSERT(count <= kMaxPresetsPerFile);
+  SysExCallback append(std::bind(&AppendTo::Run, out, _1));
+  for (size_t i = 0; i < count; ++i) {
+    int id = static_cast<int>((first_id + i) % kPresetIdCount);
+    shared_ptr<Preset> preset(GeneratePreset(id));
+    if (!preset || !preset->Serialize(append))
+      return false;
+  }
+  return true;
+}
+
+std::string CorpusGenerator::GenerateName() {
+  std::ostringstream stream;
+  stream << kNameWords[RandomInt(0, arraysize(kNameWords) - 1)] << ' '
+         << kNameWords[RandomInt(0, arraysize(kNameWords) - 1)] << ' '
+         << RandomInt(0, 99999);
+  return stream.str();
+}
+
+void CorpusGenerator::RandomizeScenes(Preset* preset) {
+  std::vector<BlockParameters*> blocks(GetBlocks(preset));
+  for (auto block : blocks) {
+    if (!HasBypassParam(*block))
+      continue;
+    BlockSceneState state(block->GetBypassState());
+    bool xy = block->supports_xy();
+    for (int scene = 0; scene < kScenes; ++scene) {
+      // Keep about half of the scenes as they were, so that scenes tend to
+      // have a few things in common like they do in real presets.
+      if (RandomInt(0, 1))
+        continue;
+      state.SetBypassedInScene(scene, RandomInt(0, 3) == 0);
+      if (xy)
+        state.SetConfigYEnabledInScene(scene, RandomInt(0, 2) == 0);
+    }
+    block->SetBypassState(state);
+  }
+}
+
+void CorpusGenerator::JitterParameters(Preset* preset) {
+  std::vector<BlockParameters*> blocks(GetBlocks(preset));
+  for (auto block : blocks) {
+    size_t x_count = XParamCount(*block);
+    if (!x_count)
+      continue;
+    int bypass_id = block->schema().GetBypassParamID(block->type());
+    for (int changes = RandomInt(0, 3); changes > 0; --changes) {
+      int index = RandomInt(0, static_cast<int>(x_count) - 1);
+      if (index == bypass_id)
+        continue;
+      bool x = !block->supports_xy() || RandomInt(0, 1);
+      int value = block->GetParamValue(index, x) + RandomInt(-2, 2);
+      block->SetParamValue(index,
+          static_cast<uint16_t>(std::max(0, std::min(0xFFFF, value))), x);
+    }
+  }
+}
+
+void CorpusGenerator::RandomizeToneMatchIR(Preset* preset) {
+  std::vector<uint16_t> ir(kToneMatchIRValues);
+  std::uniform_int_distribution<int> value(0, 0xFFFF);
+  for (auto& v : ir)
+    v = static_cast<uint16_t>(value(random_));
+  preset->set_ir_data(ir);
+}
+
+int CorpusGenerator::RandomInt(int min, int max) {
+  return std::uniform_int_distribution<int>(min, max)(random_);
+}
+
+}  // namespace bench
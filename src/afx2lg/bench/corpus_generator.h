@@ -0,0 +1,83 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef BENCH_CORPUS_GENERATOR_H_
+#define BENCH_CORPUS_GENERATOR_H_
+
+#include "common/common_types.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+namespace axefx {
+class IRData;
+class Preset;
+}
+
+namespace bench {
+
+// The largest number of presets that a single .syx file can hold without
+// repeating a preset ID (banks A, B and C).
+const size_t kMaxPresetsPerFile = 384u;
+
+// Builds any number of valid AxeFx II presets and IRs for scaling tests.
+// Presets are derived from templates, which gives a realistic mix of block
+// layouts, and then get a new name, random scene bypass and X/Y states and
+// slightly different parameter values.  Presets derived from Tone Match
+// templates get a random IR payload instead of new parameter values, since
+// their parameters must still compress to fit next to the IR.
+//
+// With the same standard library, the output only depends on the seed and
+// the templates, so a corpus can be regenerated instead of checked in.
+class CorpusGenerator {
+ public:
+  explicit CorpusGenerator(unsigned int seed);
+  ~CorpusGenerator();
+
+  // Adds the presets in a .syx buffer as templates.  System data is skipped.
+  bool AddTemplates(const uint8_t* begin, const uint8_t* end);
+  // Adds the presets from the test/data/axefx2 folder.
+  bool AddDefaultTemplates(const std::string& data_dir);
+
+  size_t template_count() const {
+    return templates_.size() + tone_match_templates_.size();
+  }
+
+  // The share of generated presets that use the Tone Match block, if there
+  // are Tone Match templates.  The default is 5.
+  void set_tone_match_percent(int percent) { tone_match_percent_ = percent; }
+
+  // Requires at least one template.  Returns null if the chosen template
+  // fails to parse again.
+  shared_ptr<axefx::Preset> GeneratePreset(int id);
+  unique_ptr<axefx::IRData> GenerateIR(uint16_t id);
+
+  // Appends |count| serialized presets to |out|, numbered from |first_id|
+  // and wrapping around after the last preset of bank C.  |count| must not
+  // be larger than kMaxPresetsPerFile.  Returns false if a preset couldn't
+  // be generated or serialized, in which case |out| is incomplete.
+  bool GenerateArchive(size_t first_id, size_t count,
+                       std::vector<uint8_t>* out);
+
+ private:
+  typedef std::vector<uint8_t> Template;
+
+  std::string GenerateName();
+  void RandomizeScenes(axefx::Preset* preset);
+  void JitterParameters(axefx::Preset* preset);
+  void RandomizeToneMatchIR(axefx::Preset* preset);
+  int RandomInt(int min, int max);
+
+  std::mt19937 random_;
+  std::vector<Template> templates_;
+  std::vector<Template> tone_match_templates_;
+  int tone_match_percent_;
+
+  DISALLOW_COPY_AND_ASSIGN(CorpusGenerator);
+};
+
+}  // namespace bench
+
+#endif  // BENCH_CORPUS_GENERATOR_H_
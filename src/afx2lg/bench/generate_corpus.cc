@@ -0,0 +1,178 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/common_types.h"
+
+#include "axefx/ir_data.h"
+#include "bench/corpus_generator.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+using std::placeholders::_1;
+
+struct Options {
+  Options()
+      : presets(384), presets_per_file(bench::kMaxPresetsPerFile), irs(0),
+        tone_match_percent(5), seed(1) {}
+
+  std::string output_dir;
+  std::string data_dir;
+  size_t presets;
+  size_t presets_per_file;
+  size_t irs;
+  int tone_match_percent;
+  unsigned int seed;
+};
+
+void PrintUsage() {
+  std::cerr <<
+      "Usage:\n\n"
+      "  generate_corpus -o=<output dir> [-n=<presets>] [-p=<per file>]\n"
+      "                  [-i=<IRs>] [-m=<tone match %>] [-s=<seed>]\n"
+      "                  [-d=<data dir>]\n"
+      "\n"
+      "Writes a synthetic library of valid AxeFx II presets and IRs for\n"
+      "scaling tests.  The same seed always gives the same files.\n"
+      "\n"
+      "    -o     Folder to write presets_NNNNN.syx and ir_NNN.syx to.\n"
+      "    -n     Total number of presets.  Default 384.\n"
+      "    -p     Presets per file, at most 384.  Use 128 for bank sized\n"
+      "           files.  Default 384.\n"
+      "    -i     Number of IR files.  Default 0.\n"
+      "    -m     Percentage of presets that use the Tone Match block.\n"
+      "           Default 5.\n"
+      "    -s     Random seed.  Default 1.\n"
+      "    -d     Path to the test/data folder with the template presets.\n"
+      "           By default it's looked for relative to the executable.\n"
+      "\n";
+}
+
+bool ParseArgs(int argc, char* argv[], Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (arg[0] != '-' || strlen(arg) < 4 || arg[2] != '=') {
+      std::cerr << "Unknown/malformed argument: '" << arg << "'\n\n";
+      return false;
+    } else if (arg[1] == 'o') {
+      options->output_dir = &arg[3];
+    } else if (arg[1] == 'd') {
+      options->data_dir = &arg[3];
+    } else if (arg[1] == 'n') {
+      options->presets = strtoul(&arg[3], NULL, 10);
+    } else if (arg[1] == 'p') {
+      options->presets_per_file = strtoul(&arg[3], NULL, 10);
+    } else if (arg[1] == 'i') {
+      options->irs = strtoul(&arg[3], NULL, 10);
+    } else if (arg[1] == 'm') {
+      options->tone_match_percent = atoi(&arg[3]);
+    } else if (arg[1] == 's') {
+      options->seed = static_cast<unsigned int>(strtoul(&arg[3], NULL, 10));
+    } else {
+      std::cerr << "Unknown argument: '" << arg << "'\n\n";
+      return false;
+    }
+  }
+
+  if (options->output_dir.empty()) {
+    std::cerr << "No output folder specified.\n\n";
+    return false;
+  }
+
+  if (!options->presets_per_file ||
+      options->presets_per_file > bench::kMaxPresetsPerFile) {
+    std::cerr << "Presets per file must be between 1 and "
+              << bench::kMaxPresetsPerFile << ".\n\n";
+    return false;
+  }
+
+  return true;
+}
+
+// Same layout as the tests assume: <out>/<config>/generate_corpus and
+// afx2lg/test/data two levels up.
+std::string DefaultDataDir(const char* argv0) {
+  std::string dir(argv0);
+  std::string::size_type slash = dir.find_last_of("/\\");
+  dir.resize(slash == std::string::npos ? 0 : slash + 1);
+  return dir + "../../afx2lg/test/data";
+}
+
+std::string FileName(const std::string& dir, const char* prefix,
+                     size_t index, int digits) {
+  std::ostringstream stream;
+  stream << dir << "/" << prefix << std::setw(digits) << std::setfill('0')
+         << index << ".syx";
+  return stream.str();
+}
+
+bool WriteFile(const std::string& path, const std::vector<uint8_t>& data) {
+  std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+  if (!data.empty())
+    file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+  if (!file.good()) {
+    std::cerr << "Failed to write " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+struct AppendTo {
+  static void Run(std::vector<uint8_t>* out, const std::vector<uint8_t>& data) {
+    out->insert(out->end(), data.begin(), data.end());
+  }
+};
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!ParseArgs(argc, argv, &options)) {
+    PrintUsage();
+    return -1;
+  }
+
+  if (options.data_dir.empty())
+    options.data_dir = DefaultDataDir(argv[0]);
+
+  bench::CorpusGenerator generator(options.seed);
+  if (!generator.AddDefaultTemplates(options.data_dir)) {
+    std::cerr << "Use -d to point to the test/data folder.\n";
+    return -1;
+  }
+  generator.set_tone_match_percent(options.tone_match_percent);
+
+  std::vector<uint8_t> data;
+  size_t files = 0;
+  for (size_t first = 0; first < options.presets;
+       first += options.presets_per_file) {
+    size_t count = std::min(options.presets_per_file,
+                            options.presets - first);
+    data.clear();
+    if (!generator.GenerateArchive(first, count, &data)) {
+      std::cerr << "Failed to generate presets " << first << " to "
+                << first + count - 1 << std::endl;
+      return -1;
+    }
+    if (!WriteFile(FileName(options.output_dir, "presets_", files++, 5), data))
+      return -1;
+  }
+
+  for (size_t i = 0; i < options.irs; ++i) {
+    // User cab slots are numbered 0-99.
+    unique_ptr<axefx::IRData> ir(
+        generator.GenerateIR(static_cast<uint16_t>(i % 100)));
+    data.clear();
+    ir->Serialize(std::bind(&AppendTo::Run, &data, _1));
+    if (!WriteFile(FileName(options.output_dir, "ir_", i, 3), data))
+      return -1;
+  }
+
+  std::cerr << "Wrote " << options.presets << " presets in " << files
+            << " files and " << options.irs << " IRs to "
+            << options.output_dir << std::endl;
+
+  return 0;
+}
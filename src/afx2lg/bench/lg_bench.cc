@@ -0,0 +1,149 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/benchmark.h"
+#include "bench/suites.h"
+
+#include "axefx/preset.h"
+#include "common/file_utils.h"
+#include "lg/lg_parser.h"
+#include "lg/lg_utils.h"
+#include "lg/lg_writer.h"
+
+#include <iostream>
+
+using std::placeholders::_1;
+
+namespace bench {
+namespace {
+
+// Enough presets to fill all three banks.
+const int kGeneratedPresets = 3 * 128;
+
+typedef shared_ptr<const std::string> SharedText;
+typedef shared_ptr<const axefx::PresetMap> SharedPresets;
+
+class OutputCollector : public lg::BufferedLgWriter {
+ public:
+  explicit OutputCollector(const axefx::PresetMap& presets)
+      : presets_(presets) {}
+  virtual ~OutputCollector() {}
+
+  virtual const axefx::PresetMap& GetPresetMap() { return presets_; }
+
+  std::string* output() { return &output_; }
+
+ protected:
+  virtual bool Write(const char* data, size_t size) {
+    output_.append(data, size);
+    return true;
+  }
+
+ private:
+  const axefx::PresetMap& presets_;
+  std::string output_;
+};
+
+SharedPresets CreatePresets(int count) {
+  shared_ptr<axefx::PresetMap> presets(new axefx::PresetMap());
+  for (int i = 0; i < count; ++i) {
+    shared_ptr<axefx::Preset> preset(new axefx::Preset());
+    preset->set_id(i);
+    preset->set_name("Preset " + std::to_string(i));
+    (*presets)[i] = preset;
+  }
+  return presets;
+}
+
+bool Generate(const std::string& setup, const axefx::PresetMap& presets,
+              std::string* output) {
+  OutputCollector collector(presets);
+  lg::LgParser parser;
+  if (!parser.ParseBuffer(&collector, setup.data(),
+                          setup.data() + setup.size()) ||
+      !collector.Flush()) {
+    return false;
+  }
+  output->swap(*collector.output());
+  return true;
+}
+
+// Splits |text| into lines the way LgParser stores them, without the '\n'.
+std::vector<std::string> SplitLines(const std::string& text) {
+  std::vector<std::string> lines;
+  std::string::size_type pos = 0;
+  while (pos < text.size()) {
+    std::string::size_type eol = text.find('\n', pos);
+    if (eol == std::string::npos)
+      break;
+    lines.push_back(text.substr(pos, eol - pos));
+    pos = eol + 1;
+  }
+  return lines;
+}
+
+// Runs the line matchers that parsing a setup file uses over every line.
+void ScanLines(const shared_ptr<const std::vector<std::string> >& lines,
+               Iteration* it) {
+  int matches = 0;
+  std::string name;
+  int channel, cc, value;
+  for (const auto& line : *lines) {
+    if (lg::ParseEntryName(line, &name) ||
+        lg::ParseCC(line, &channel, &cc, &value) ||
+        lg::ParseProgramChange(line, &channel, &value) ||
+        lg::IsDefaultPreset(line, &name)) {
+      ++matches;
+    }
+    it->AddBytes(line.size());
+  }
+  UseResult(&matches);
+  it->AddItems(lines->size());
+}
+
+// Parses a setup file and generates a new one for |presets|.
+void GenerateSetup(const SharedText& setup, const SharedPresets& presets,
+                   Iteration* it) {
+  std::string output;
+  bool ok = Generate(*setup, *presets, &output);
+  ASSERT(ok);
+  UseResult(&ok);
+  it->AddBytes(setup->size());
+  it->AddItems(presets->size());
+}
+
+void AddSetupBenchmarks(const std::string& name, const SharedText& setup,
+                        const SharedPresets& presets, Runner* runner) {
+  shared_ptr<std::vector<std::string> > lines(
+      new std::vector<std::string>(SplitLines(*setup)));
+  runner->Add("lg/scan_lines/" + name,
+              std::bind(&ScanLines, lines, _1));
+  runner->Add("lg/generate/" + name,
+              std::bind(&GenerateSetup, setup, presets, _1));
+}
+
+}  // namespace
+
+bool RegisterLgBenchmarks(const std::string& data_dir, Runner* runner) {
+  unique_ptr<uint8_t[]> buffer;
+  size_t size = 0;
+  if (!base::ReadFileIntoBuffer(data_dir + "/lg2/input.txt", &buffer, &size))
+    return false;
+  SharedText input(
+      new std::string(reinterpret_cast<const char*>(buffer.get()), size));
+
+  // A setup that already has a patch for every preset in all three banks,
+  // generated from input.txt.  Most of the work is updating existing patches.
+  SharedPresets presets(CreatePresets(kGeneratedPresets));
+  shared_ptr<std::string> scaled(new std::string());
+  if (!Generate(*input, *presets, scaled.get())) {
+    std::cerr << "Failed to generate a setup from input.txt\n";
+    return false;
+  }
+
+  AddSetupBenchmarks("input", input, presets, runner);
+  AddSetupBenchmarks("input_384_patches", scaled, presets, runner);
+  return true;
+}
+
+}  // namespace bench
@@ -0,0 +1,144 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/common_types.h"
+
+#include "bench/benchmark.h"
+#include "bench/suites.h"
+#include "json/value.h"
+#include "json/writer.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+void PrintUsage() {
+  std::cerr <<
+      "Usage:\n\n"
+      "  bench [-f=<filter>] [-d=<data dir>] [-o=<output file>]\n"
+      "        [-t=<min time ms>] [-n=<min iterations>] [-g=<presets>]\n"
+      "\n"
+      "Runs benchmarks over the files in the test/data folder and writes\n"
+      "the results as JSON, to stdout unless an output file is given.\n"
+      "A summary is printed to stderr as the benchmarks run.\n"
+      "\n"
+      "    -f     Only run benchmarks whose name contains <filter>.\n"
+      "           Names have the form group/benchmark/input, e.g.\n"
+      "           codec/parse/V12_All_Banks, lg/generate/input or\n"
+      "           transport/bank_dump.\n"
+      "    -d     Path to the test/data folder.  By default it's looked\n"
+      "           for relative to the executable, like the tests do.\n"
+      "    -t     Minimum time to spend on each benchmark.  Default 500.\n"
+      "    -n     Minimum number of iterations per benchmark.  Default 10.\n"
+      "    -g     Also run the scale benchmarks over a generated library\n"
+      "           of <presets> presets, e.g. -g=100000.\n"
+      "\n"
+      "Build in release mode before comparing numbers.\n"
+      "\n";
+}
+
+bool ParseArgs(int argc,
+               char* argv[],
+               bench::Options* options,
+               std::string* data_dir,
+               std::string* output,
+               size_t* generated_presets) {
+  for (int i = 1; i < argc; ++i) {
+    const char* arg = argv[i];
+    if (arg[0] != '-' || strlen(arg) < 4 || arg[2] != '=') {
+      std::cerr << "Unknown/malformed argument: '" << arg << "'\n\n";
+      return false;
+    } else if (arg[1] == 'f') {
+      options->filter = &arg[3];
+    } else if (arg[1] == 'd') {
+      *data_dir = &arg[3];
+    } else if (arg[1] == 'o') {
+      *output = &arg[3];
+    } else if (arg[1] == 't') {
+      options->min_time = std::chrono::milliseconds(atoi(&arg[3]));
+    } else if (arg[1] == 'n') {
+      options->min_iterations = atoi(&arg[3]);
+    } else if (arg[1] == 'g') {
+      *generated_presets = strtoul(&arg[3], NULL, 10);
+    } else {
+      std::cerr << "Unknown argument: '" << arg << "'\n\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Same layout as the tests assume: <out>/<config>/bench and
+// afx2lg/test/data two levels up.
+std::string DefaultDataDir(const char* argv0) {
+  std::string dir(argv0);
+  std::string::size_type slash = dir.find_last_of("/\\");
+  dir.resize(slash == std::string::npos ? 0 : slash + 1);
+  return dir + "../../afx2lg/test/data";
+}
+
+int main(int argc, char* argv[]) {
+  bench::Options options;
+  std::string data_dir, output;
+  size_t generated_presets = 0;
+  if (!ParseArgs(argc, argv, &options, &data_dir, &output,
+                 &generated_presets)) {
+    PrintUsage();
+    return -1;
+  }
+
+  if (data_dir.empty())
+    data_dir = DefaultDataDir(argv[0]);
+
+  bench::Runner runner(options);
+  if (!bench::RegisterCodecBenchmarks(data_dir, &runner) ||
+      !bench::RegisterLgBenchmarks(data_dir, &runner) ||
+      !bench::RegisterRuntimeBenchmarks(data_dir, &runner) ||
+      (generated_presets &&
+       !bench::RegisterScaleBenchmarks(data_dir, generated_presets,
+                                       &runner))) {
+    std::cerr << "Failed to load the benchmark data.  Use -d to point to "
+                 "the test/data folder.\n";
+    return -1;
+  }
+
+  Json::Value report(Json::objectValue);
+  Json::Value& context = report["context"];
+#ifdef NDEBUG
+  context["build"] = "release";
+#else
+  context["build"] = "debug";
+#endif
+  context["hardware_threads"] = std::thread::hardware_concurrency();
+  context["min_time_ms"] = static_cast<Json::Int>(options.min_time.count());
+  context["min_iterations"] = options.min_iterations;
+  context["generated_presets"] = static_cast<Json::UInt>(generated_presets);
+
+  Json::Value& results = report["benchmarks"];
+  results = Json::Value(Json::arrayValue);
+  if (!runner.Run(&results)) {
+    std::cerr << "No benchmark matches '" << options.filter << "'\n";
+    return -1;
+  }
+
+  Json::StyledWriter writer;
+  if (output.empty()) {
+    std::cout << writer.write(report);
+  } else {
+    std::ofstream file(output.c_str());
+    file << writer.write(report);
+    if (!file.good()) {
+      std::cerr << "Failed to write " << output << "\n";
+      return -1;
+    }
+  }
+
+  if (runner.failures()) {
+    std::cerr << runner.failures() << " benchmark(s) failed\n";
+    return -1;
+  }
+
+  return 0;
+}
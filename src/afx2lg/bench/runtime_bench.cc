@@ -0,0 +1,469 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/benchmark.h"
+#include "bench/corpus.h"
+#include "bench/suites.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/sysex_types.h"
+#include "common/thread_loop.h"
+#include "midi/device_session.h"
+#include "midi/midi_in.h"
+#include "midi/midi_out.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+
+using std::placeholders::_1;
+using std::placeholders::_2;
+
+namespace bench {
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef shared_ptr<const std::vector<size_t> > SharedChunkSizes;
+
+const unsigned int kChunkSeed = 20130601;
+
+// Auto-reset event for waiting on work done by another thread.
+class Event {
+ public:
+  Event() : signaled_(false) {}
+
+  void Signal() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      signaled_ = true;
+    }
+    signal_.notify_one();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(lock_);
+    while (!signaled_)
+      signal_.wait(lock);
+    signaled_ = false;
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable signal_;
+  bool signaled_;
+
+  DISALLOW_COPY_AND_ASSIGN(Event);
+};
+
+// A ThreadLoop running on its own thread.
+class LoopThread {
+ public:
+  LoopThread() : loop_(new base::ThreadLoop()) {
+    loop_->set_timeout(std::chrono::hours(24));
+    thread_ = std::thread(&base::ThreadLoop::Run, loop_.get());
+  }
+
+  ~LoopThread() {
+    loop_->Quit();
+    thread_.join();
+  }
+
+  const base::SharedThreadLoop& loop() const { return loop_; }
+
+  // Returns once the tasks queued so far have run.
+  void Flush() {
+    Event done;
+    loop_->QueueTask(std::bind(&Event::Signal, &done));
+    done.Wait();
+  }
+
+ private:
+  base::SharedThreadLoop loop_;
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopThread);
+};
+
+// Records when a task ran and wakes up the thread waiting for it.
+struct Probe {
+  static void Run(Probe* probe) {
+    probe->ran_at = Clock::now();
+    probe->done.Signal();
+  }
+
+  // Measures a post from the loop's own thread, where no wakeup is needed.
+  static void PostFromLoop(base::ThreadLoop* loop, Probe* probe) {
+    probe->posted_at = Clock::now();
+    loop->QueueTask(std::bind(&Probe::Run, probe));
+  }
+
+  Clock::time_point posted_at;
+  Clock::time_point ran_at;
+  Event done;
+};
+
+// The MidiIn side of an in-memory MIDI connection.  Like the real backends,
+// data arrives on a driver thread and is handed over to the worker loop.
+class LoopbackMidiIn : public midi::MidiIn {
+ public:
+  explicit LoopbackMidiIn(const base::SharedThreadLoop& worker)
+      : midi::MidiIn(nullptr, worker) {}
+
+  static shared_ptr<LoopbackMidiIn> Create(
+      const base::SharedThreadLoop& worker) {
+    shared_ptr<LoopbackMidiIn> midi_in(new LoopbackMidiIn(worker));
+    midi_in->weak_this_ = midi_in;
+    return midi_in;
+  }
+
+  // Called on the driver thread.  |data| must stay valid until it has been
+  // delivered.
+  void Deliver(const uint8_t* data, size_t size) {
+    shared_ptr<base::ThreadLoop> worker = worker_.lock();
+    if (worker) {
+      worker->QueueTask(
+          std::bind(&LoopbackMidiIn::OnData, weak_this_, data, size));
+    }
+  }
+
+ private:
+  static void OnData(const std::weak_ptr<LoopbackMidiIn>& weak_this,
+                     const uint8_t* data, size_t size) {
+    shared_ptr<LoopbackMidiIn> me = weak_this.lock();
+    if (me && me->data_available_)
+      me->data_available_(data, size);
+  }
+
+  std::weak_ptr<LoopbackMidiIn> weak_this_;
+};
+
+// The MidiOut side of the connection, with a simulated AxeFx at the other
+// end.  Messages are "written" on the driver thread, which answers bank dump
+// requests by streaming |bank| back in chunks of |chunk_sizes| and accepts
+// anything else as preset data being restored.  There is no MIDI baud rate
+// to wait for, so what's measured is the overhead of our own pipeline.
+class LoopbackMidiOut : public midi::MidiOut {
+ public:
+  LoopbackMidiOut(LoopThread* driver,
+                  const SharedCorpus& bank,
+                  const SharedChunkSizes& chunk_sizes)
+      : midi::MidiOut(nullptr),
+        driver_(driver),
+        bank_(bank),
+        chunk_sizes_(chunk_sizes),
+        messages_received_(0) {}
+
+  void set_midi_in(const shared_ptr<LoopbackMidiIn>& midi_in) {
+    midi_in_ = midi_in;
+  }
+
+  // Only touched on the driver thread, so call LoopThread::Flush() first.
+  size_t messages_received() const { return messages_received_; }
+
+  virtual bool Send(unique_ptr<midi::Message> message,
+                    const std::function<void()>& on_complete) {
+    driver_->loop()->QueueTask(std::bind(&LoopbackMidiOut::Write, this,
+                                         std::move(message), on_complete));
+    return true;
+  }
+
+ private:
+  void Write(const unique_ptr<midi::Message>& message,
+             const std::function<void()>& on_complete) {
+    ++messages_received_;
+    const axefx::FractalSysExHeader& header =
+        *reinterpret_cast<const axefx::FractalSysExHeader*>(&message->at(0));
+    bool dump_request = header.function() == axefx::BANK_DUMP_REQUEST;
+    if (on_complete)
+      on_complete();
+
+    if (dump_request) {
+      const uint8_t* pos = bank_->data.get();
+      for (size_t i = 0; i < chunk_sizes_->size(); ++i) {
+        midi_in_->Deliver(pos, (*chunk_sizes_)[i]);
+        pos += (*chunk_sizes_)[i];
+      }
+    }
+  }
+
+  LoopThread* driver_;
+  SharedCorpus bank_;
+  SharedChunkSizes chunk_sizes_;
+  shared_ptr<LoopbackMidiIn> midi_in_;
+  size_t messages_received_;
+
+  DISALLOW_COPY_AND_ASSIGN(LoopbackMidiOut);
+};
+
+// The driver thread and MIDI connection shared by the pipeline benchmarks.
+struct Loopback {
+  Loopback(const SharedCorpus& bank, const SharedChunkSizes& chunk_sizes)
+      : midi_out(&driver, bank, chunk_sizes) {}
+
+  LoopThread driver;
+  LoopbackMidiOut midi_out;
+};
+
+// A MidiIn that delivers data synchronously on the calling thread.
+class DirectMidiIn : public midi::MidiIn {
+ public:
+  DirectMidiIn() : midi::MidiIn(nullptr, nullptr) {}
+
+  void Deliver(const uint8_t* data, size_t size) {
+    data_available_(data, size);
+  }
+};
+
+// ThreadLoop benchmarks.
+
+void PostToRunCrossThread(const shared_ptr<LoopThread>& thread,
+                          Iteration* it) {
+  Probe probe;
+  probe.posted_at = Clock::now();
+  thread->loop()->QueueTask(std::bind(&Probe::Run, &probe));
+  probe.done.Wait();
+  it->SetManualTime(probe.ran_at - probe.posted_at);
+  it->AddItems(1);
+}
+
+void PostToRunSameThread(const shared_ptr<LoopThread>& thread,
+                         Iteration* it) {
+  Probe probe;
+  thread->loop()->QueueTask(
+      std::bind(&Probe::PostFromLoop, thread->loop().get(), &probe));
+  probe.done.Wait();
+  it->SetManualTime(probe.ran_at - probe.posted_at);
+  it->AddItems(1);
+}
+
+void DelayedTaskLateness(const shared_ptr<LoopThread>& thread,
+                         Iteration* it) {
+  const std::chrono::milliseconds kDelay(1);
+  Probe probe;
+  probe.posted_at = Clock::now();
+  thread->loop()->PostDelayedTask(std::bind(&Probe::Run, &probe), kDelay);
+  probe.done.Wait();
+  it->SetManualTime(probe.ran_at - (probe.posted_at + kDelay));
+  it->AddItems(1);
+}
+
+void Increment(int* count) { ++(*count); }
+
+void DispatchThroughput(const shared_ptr<LoopThread>& thread, Iteration* it) {
+  const int kTasks = 10000;
+  int count = 0;  // Only touched on the loop thread.
+  Probe probe;
+  for (int i = 0; i < kTasks; ++i)
+    thread->loop()->QueueTask(std::bind(&Increment, &count));
+  thread->loop()->QueueTask(std::bind(&Probe::Run, &probe));
+  probe.done.Wait();
+  if (count != kTasks) {
+    std::ostringstream error;
+    error << "Ran " << count << " of " << kTasks << " tasks";
+    it->SetError(error.str());
+  }
+  it->AddItems(kTasks);
+}
+
+// SysExDataBuffer benchmarks.
+
+void CountMessage(size_t* count, midi::Message* message) {
+  ++(*count);
+}
+
+void Framing(const SharedCorpus& corpus,
+             const SharedChunkSizes& chunk_sizes,
+             Iteration* it) {
+  shared_ptr<DirectMidiIn> midi_in(new DirectMidiIn());
+  size_t messages = 0;
+  midi::SysExDataBuffer buffer(std::bind(&CountMessage, &messages, _1));
+  buffer.Attach(midi_in);
+
+  const uint8_t* pos = corpus->data.get();
+  for (size_t i = 0; i < chunk_sizes->size(); ++i) {
+    midi_in->Deliver(pos, (*chunk_sizes)[i]);
+    pos += (*chunk_sizes)[i];
+  }
+  if (messages != corpus->frames.size()) {
+    std::ostringstream error;
+    error << "Framed " << messages << " of " << corpus->frames.size()
+          << " messages";
+    it->SetError(error.str());
+  }
+
+  it->AddBytes(corpus->size);
+  it->AddItems(messages);
+}
+
+// Pipeline benchmarks.
+
+void AssignResponse(midi::DeviceSession::Status* status, size_t* messages,
+                    midi::DeviceSession::Status response_status,
+                    midi::MessageList* response) {
+  *status = response_status;
+  *messages = response->size();
+}
+
+// What axebackup does: request a bank and collect the messages that come
+// back until the bank is complete.
+void BankDump(const SharedCorpus& bank, const shared_ptr<Loopback>& loopback,
+              Iteration* it) {
+  it->PauseTiming();
+  base::SharedThreadLoop loop(new base::ThreadLoop());
+  shared_ptr<LoopbackMidiIn> midi_in(LoopbackMidiIn::Create(loop));
+  loopback->midi_out.set_midi_in(midi_in);
+  midi::DeviceSession session(midi_in, &loopback->midi_out, loop);
+  it->ResumeTiming();
+
+  midi::DeviceSession::Status status = midi::DeviceSession::CANCELLED;
+  size_t messages = 0;
+  session.RequestBankDump(axefx::BankDumpRequest::BANK_A,
+                          std::chrono::milliseconds(2000),
+                          std::bind(&AssignResponse, &status, &messages, _1,
+                                    _2));
+  session.Run();
+  if (status != midi::DeviceSession::OK ||
+      messages != bank->frames.size()) {
+    std::ostringstream error;
+    error << "Bank dump finished with status " << status << " after "
+          << messages << " of " << bank->frames.size() << " messages";
+    it->SetError(error.str());
+  }
+
+  it->PauseTiming();
+  loopback->driver.Flush();
+  it->ResumeTiming();
+
+  it->AddBytes(bank->size);
+  it->AddItems(messages);
+}
+
+typedef std::queue<unique_ptr<midi::Message> > MessageQueue;
+
+void QueueMessage(MessageQueue* queue, size_t* bytes,
+                  const std::vector<uint8_t>& data) {
+  *bytes += data.size();
+  queue->push(unique_ptr<midi::Message>(
+      new midi::Message(static_cast<const midi::Message&>(data))));
+}
+
+// What axeloader does: send a message, wait for it to be written and then
+// queue the next one on the loop.
+struct Restore {
+  static void QueueNext(Restore* restore) {
+    if (restore->queue.empty()) {
+      restore->loop->Quit();
+    } else {
+      restore->loop->QueueTask(std::bind(&Restore::SendNext, restore));
+    }
+  }
+
+  static void SendNext(Restore* restore) {
+    unique_ptr<midi::Message> message(std::move(restore->queue.front()));
+    restore->queue.pop();
+    restore->midi_out->Send(std::move(message), restore->on_complete);
+  }
+
+  struct OnSent {
+    Restore* restore;
+    void operator()() const { QueueNext(restore); }
+  };
+
+  base::SharedThreadLoop loop;
+  midi::MidiOut* midi_out;
+  MessageQueue queue;
+  std::function<void()> on_complete;
+};
+
+void BankRestore(const shared_ptr<axefx::SysExParser>& bank,
+                 const shared_ptr<Loopback>& loopback,
+                 Iteration* it) {
+  it->PauseTiming();
+  loopback->driver.Flush();
+  size_t received_before = loopback->midi_out.messages_received();
+  Restore restore;
+  restore.loop.reset(new base::ThreadLoop());
+  restore.midi_out = &loopback->midi_out;
+  Restore::OnSent on_sent = { &restore };
+  restore.on_complete = on_sent;
+  size_t bytes = 0;
+  bank->Serialize(std::bind(&QueueMessage, &restore.queue, &bytes, _1));
+  size_t messages = restore.queue.size();
+  it->ResumeTiming();
+
+  Restore::QueueNext(&restore);
+  restore.loop->Run();
+
+  it->PauseTiming();
+  loopback->driver.Flush();
+  size_t received = loopback->midi_out.messages_received() - received_before;
+  if (received != messages) {
+    std::ostringstream error;
+    error << "Sent " << messages << " messages but " << received
+          << " arrived";
+    it->SetError(error.str());
+  }
+  it->ResumeTiming();
+
+  it->AddBytes(bytes);
+  it->AddItems(messages);
+}
+
+std::string ChunkName(size_t max_chunk) {
+  std::ostringstream name;
+  name << "chunks_1-" << max_chunk;
+  return name.str();
+}
+
+}  // namespace
+
+bool RegisterRuntimeBenchmarks(const std::string& data_dir, Runner* runner) {
+  SharedCorpus bank = LoadCorpus(data_dir, "axefx2/V12_Bank_A.syx");
+  if (!bank)
+    return false;
+
+  shared_ptr<axefx::SysExParser> parsed_bank(new axefx::SysExParser());
+  if (!parsed_bank->ParseSysExBuffer(bank->data.get(),
+                                     bank->data.get() + bank->size, true)) {
+    return false;
+  }
+
+  shared_ptr<LoopThread> thread(new LoopThread());
+  runner->Add("runtime/post_to_run/cross_thread",
+              std::bind(&PostToRunCrossThread, thread, _1));
+  runner->Add("runtime/post_to_run/same_thread",
+              std::bind(&PostToRunSameThread, thread, _1));
+  runner->Add("runtime/delayed_task_lateness/1ms",
+              std::bind(&DelayedTaskLateness, thread, _1));
+  runner->Add("runtime/dispatch_throughput/cross_thread",
+              std::bind(&DispatchThroughput, thread, _1));
+
+  // Driver callbacks range from a few bytes (USB MIDI packets) to several
+  // KB.  Whole messages at a time is the best case.
+  const size_t kMaxChunks[] = { 16, 256, 4096 };
+  for (size_t i = 0; i < arraysize(kMaxChunks); ++i) {
+    SharedChunkSizes chunks(new std::vector<size_t>(
+        RandomChunkSizes(bank->size, kMaxChunks[i], kChunkSeed)));
+    runner->Add("transport/framing/" + ChunkName(kMaxChunks[i]),
+                std::bind(&Framing, bank, chunks, _1));
+  }
+  shared_ptr<std::vector<size_t> > whole(new std::vector<size_t>());
+  for (size_t i = 0; i < bank->frames.size(); ++i)
+    whole->push_back(bank->frames[i].size);
+  runner->Add("transport/framing/whole_messages",
+              std::bind(&Framing, bank, SharedChunkSizes(whole), _1));
+
+  SharedChunkSizes dump_chunks(new std::vector<size_t>(
+      RandomChunkSizes(bank->size, 256, kChunkSeed)));
+  shared_ptr<Loopback> loopback(new Loopback(bank, dump_chunks));
+  runner->Add("transport/bank_dump/" + bank->name,
+              std::bind(&BankDump, bank, loopback, _1));
+  runner->Add("transport/bank_restore/" + bank->name,
+              std::bind(&BankRestore, parsed_bank, loopback, _1));
+
+  return true;
+}
+
+}  // namespace bench
@@ -0,0 +1,73 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "bench/benchmark.h"
+#include "bench/corpus_generator.h"
+#include "bench/suites.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "common/thread_pool.h"
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+using std::placeholders::_1;
+
+namespace bench {
+namespace {
+
+using namespace axefx;
+
+// A generated library, one archive per element.
+typedef shared_ptr<const std::vector<std::vector<uint8_t> > > SharedLibrary;
+
+void ParseLibrary(const SharedLibrary& library, size_t presets,
+                  const shared_ptr<base::ThreadPool>& pool, Iteration* it) {
+  for (const auto& archive : *library) {
+    SysExParser parser;
+    parser.set_thread_pool(pool.get());
+    bool ok = parser.ParseSysExBuffer(&archive[0],
+                                      &archive[0] + archive.size(), true);
+    UseResult(&ok);
+    if (!ok)
+      it->SetError("Failed to parse a generated archive");
+    it->AddBytes(archive.size());
+  }
+  it->AddItems(presets);
+}
+
+}  // namespace
+
+bool RegisterScaleBenchmarks(const std::string& data_dir, size_t presets,
+                             Runner* runner) {
+  CorpusGenerator generator(1);
+  if (!generator.AddDefaultTemplates(data_dir))
+    return false;
+
+  std::cerr << "Generating " << presets << " presets..." << std::endl;
+  shared_ptr<std::vector<std::vector<uint8_t> > > library(
+      new std::vector<std::vector<uint8_t> >());
+  for (size_t first = 0; first < presets; first += kMaxPresetsPerFile) {
+    library->push_back(std::vector<uint8_t>());
+    if (!generator.GenerateArchive(
+            first, std::min(kMaxPresetsPerFile, presets - first),
+            &library->back())) {
+      return false;
+    }
+  }
+
+  std::ostringstream input;
+  input << presets << "_presets";
+  shared_ptr<base::ThreadPool> pool(new base::ThreadPool(0));
+  runner->Add("scale/parse/" + input.str(),
+              std::bind(&ParseLibrary, SharedLibrary(library), presets,
+                        shared_ptr<base::ThreadPool>(), _1));
+  runner->Add("scale/parse_thread_pool/" + input.str(),
+              std::bind(&ParseLibrary, SharedLibrary(library), presets, pool,
+                        _1));
+
+  return true;
+}
+
+}  // namespace bench
@@ -0,0 +1,27 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef BENCH_SUITES_H_
+#define BENCH_SUITES_H_
+
+#include "common/common_types.h"
+
+#include <string>
+
+namespace bench {
+
+class Runner;
+
+// Each suite loads its input from |data_dir| (the test/data folder) and adds
+// its benchmarks to |runner|.  Returns false if input files are missing.
+bool RegisterCodecBenchmarks(const std::string& data_dir, Runner* runner);
+bool RegisterLgBenchmarks(const std::string& data_dir, Runner* runner);
+bool RegisterRuntimeBenchmarks(const std::string& data_dir, Runner* runner);
+// Generates a library of |presets| presets from the test/data presets.
+bool RegisterScaleBenchmarks(const std::string& data_dir, size_t presets,
+                             Runner* runner);
+
+}  // namespace bench
+
+#endif  // BENCH_SUITES_H_
@@ -15,11 +15,22 @@
         '..',
       ],
       'sources': [
+        'bounded_queue.h',
         'common_types.h',
         'file_utils.cc',
         'file_utils.h',
+        'memory_usage.h',
+        'metrics.cc',
+        'metrics.h',
+        'ring_queue.h',
+        'string_piece.h',
+        'task.h',
         'thread_loop.cc',
         'thread_loop.h',
+        'thread_pool.cc',
+        'thread_pool.h',
+        'trace.cc',
+        'trace.h',
       ],
     },
   ],
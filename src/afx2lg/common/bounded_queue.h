@@ -0,0 +1,100 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_BOUNDED_QUEUE_H_
+#define COMMON_BOUNDED_QUEUE_H_
+
+#include "common_types.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace base {
+
+// A fixed capacity FIFO for handing items from one thread to another.
+// Push() blocks while the queue is full and Pop() blocks while it's empty.
+// Producers that must never block use TryPush() instead.
+// Once Close() has been called, Push() fails and Pop() returns the items
+// that are left in the queue before it starts failing.
+template <typename T>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue(size_t capacity)
+      : capacity_(capacity), closed_(false) {
+    ASSERT(capacity_ > 0u);
+  }
+
+  ~BoundedQueue() {}
+
+  size_t capacity() const { return capacity_; }
+
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(lock_);
+    return queue_.size();
+  }
+
+  bool Push(T item) {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      while (!closed_ && queue_.size() >= capacity_)
+        not_full_.wait(lock);
+      if (closed_)
+        return false;
+      queue_.push_back(std::move(item));
+    }
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Fails instead of blocking when the queue is full.  |item| is only moved
+  // from if it was added.
+  bool TryPush(T* item) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (closed_ || queue_.size() >= capacity_)
+        return false;
+      queue_.push_back(std::move(*item));
+    }
+    not_empty_.notify_one();
+    return true;
+  }
+
+  bool Pop(T* item) {
+    {
+      std::unique_lock<std::mutex> lock(lock_);
+      while (!closed_ && queue_.empty())
+        not_empty_.wait(lock);
+      if (queue_.empty())
+        return false;
+      *item = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      closed_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+ private:
+  const size_t capacity_;
+  mutable std::mutex lock_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<T> queue_;
+  bool closed_;
+
+  DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+}  // namespace base
+
+#endif  // COMMON_BOUNDED_QUEUE_H_
@@ -3,8 +3,22 @@
 
 #include "common/file_utils.h"
 
+#include "common/trace.h"
+
 #include <fstream>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(OS_WIN)
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace base {
 
 bool FileExists(const std::string& path) {
@@ -12,8 +26,42 @@ bool FileExists(const std::string& path) {
   return file.good();
 }
 
+bool GetFileStamp(const std::string& path, FileStamp* stamp) {
+#if defined(OS_WIN)
+  struct _stat64 st;
+  if (_stat64(path.c_str(), &st) != 0)
+    return false;
+  // _stat64 only has whole seconds.  The last write time is in 100 ns
+  // ticks.
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  int32_t nanoseconds = 0;
+  if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard,
+                           &attributes)) {
+    uint64_t ticks =
+        (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime)
+             << 32) |
+        attributes.ftLastWriteTime.dwLowDateTime;
+    nanoseconds = static_cast<int32_t>(ticks % 10000000) * 100;
+  }
+#else
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+#if defined(OS_MACOSX)
+  int32_t nanoseconds = static_cast<int32_t>(st.st_mtimespec.tv_nsec);
+#else
+  int32_t nanoseconds = static_cast<int32_t>(st.st_mtim.tv_nsec);
+#endif
+#endif
+  stamp->size = static_cast<int64_t>(st.st_size);
+  stamp->modified = static_cast<int64_t>(st.st_mtime);
+  stamp->modified_ns = nanoseconds;
+  return true;
+}
+
 bool ReadFileIntoBuffer(const std::string& path, unique_ptr<uint8_t[]>* buffer,
                         size_t* file_size) {
+  TRACE_EVENT0("io", "ReadFileIntoBuffer");
   std::ifstream f;
   f.open(path, std::fstream::in | std::ios::binary);
   if (!f.is_open())
@@ -33,4 +81,22 @@ bool ReadFileIntoBuffer(const std::string& path, unique_ptr<uint8_t[]>* buffer,
   return true;
 }
 
+bool SyncFile(const std::string& path) {
+  TRACE_EVENT0("io", "SyncFile");
+#if defined(OS_WIN)
+  int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+  if (fd == -1)
+    return false;
+  bool ret = _commit(fd) == 0;
+  _close(fd);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  bool ret = fsync(fd) == 0;
+  close(fd);
+#endif
+  return ret;
+}
+
 }  // namespace common
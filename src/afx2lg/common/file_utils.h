@@ -13,9 +13,35 @@ namespace base {
 
 bool FileExists(const std::string& path);
 
+// Size and modification time of a file, for telling when it has changed.
+struct FileStamp {
+  FileStamp() : size(0), modified(0), modified_ns(0) {}
+
+  bool operator==(const FileStamp& other) const {
+    return size == other.size && modified == other.modified &&
+           modified_ns == other.modified_ns;
+  }
+  bool operator!=(const FileStamp& other) const { return !(*this == other); }
+
+  int64_t size;
+  // The modification time is |modified| seconds since the epoch plus
+  // |modified_ns| nanoseconds, so that a file rewritten within the same
+  // second still gets a new stamp.  The resolution of the nanoseconds
+  // depends on the file system (100 ns on NTFS).
+  int64_t modified;
+  int32_t modified_ns;
+};
+
+// Returns false if the file doesn't exist.
+bool GetFileStamp(const std::string& path, FileStamp* stamp);
+
 bool ReadFileIntoBuffer(const std::string& path, unique_ptr<uint8_t[]>* buffer,
                         size_t* file_size);
 
+// Makes sure that the contents of the file have been written to disk.
+// The file must have been flushed and closed by the writer beforehand.
+bool SyncFile(const std::string& path);
+
 }  // namespace base
 
 #endif  // COMMON_FILE_UTILS_H_
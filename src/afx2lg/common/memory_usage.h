@@ -0,0 +1,59 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_MEMORY_USAGE_H_
+#define COMMON_MEMORY_USAGE_H_
+
+#include "common_types.h"
+
+#include <string>
+#include <vector>
+
+namespace base {
+
+// Memory held by an object and everything it owns, for putting budgets on
+// caches of parsed data.  Containers are counted by capacity, not size, so
+// the numbers reflect what would be freed by destroying the object.
+struct MemoryUsage {
+  MemoryUsage() : bytes(0), objects(0) {}
+  MemoryUsage(size_t bytes, size_t objects) : bytes(bytes), objects(objects) {}
+
+  MemoryUsage& operator+=(const MemoryUsage& other) {
+    bytes += other.bytes;
+    objects += other.objects;
+    return *this;
+  }
+
+  // Includes the object itself.
+  size_t bytes;
+  // The number of heap blocks, counting the object itself as one.
+  size_t objects;
+};
+
+// Usage of the heap buffer of a container.  The container object itself is
+// part of the object that holds it, so it isn't included.
+template <typename T>
+MemoryUsage HeapUsage(const std::vector<T>& v) {
+  return v.capacity() ? MemoryUsage(v.capacity() * sizeof(T), 1)
+                      : MemoryUsage();
+}
+
+inline MemoryUsage HeapUsage(const std::string& s) {
+  // Short strings are stored inside of the string object.
+  const char* data = s.data();
+  const char* self = reinterpret_cast<const char*>(&s);
+  if (data >= self && data < self + sizeof(s))
+    return MemoryUsage();
+  return MemoryUsage(s.capacity() + 1, 1);
+}
+
+// Rough overhead of a std::map or std::set node, excluding the value.
+const size_t kTreeNodeOverhead = 4 * sizeof(void*);
+// Rough size of the control block that shared_ptr allocates when it takes
+// ownership of a pointer.
+const size_t kSharedPtrControlBlock = 2 * sizeof(void*) + 2 * sizeof(int);
+
+}  // namespace base
+
+#endif  // COMMON_MEMORY_USAGE_H_
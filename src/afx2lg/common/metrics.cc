@@ -0,0 +1,193 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/metrics.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace base {
+
+static const char kMetricsVariable[] = "AFX2LG_METRICS";
+
+namespace internal {
+std::atomic<bool> g_metrics_enabled(getenv(kMetricsVariable) != NULL);
+}
+
+void SetMetricsEnabled(bool enabled) {
+  internal::g_metrics_enabled = enabled;
+}
+
+// Metrics are pushed onto the list as they are constructed, which is
+// usually during static initialization, and never removed.
+struct MetricList {
+  static std::atomic<Metric*> head;
+
+  static void Add(Metric* metric) {
+    metric->next_ = head.load();
+    while (!head.compare_exchange_weak(metric->next_, metric)) {}
+  }
+
+  static Metric* next(const Metric* metric) { return metric->next_; }
+};
+
+std::atomic<Metric*> MetricList::head(NULL);
+
+Metric::Metric(const char* name, Type type)
+    : name_(name), type_(type), next_(NULL) {
+  MetricList::Add(this);
+}
+
+void Gauge::UpdateMax(int64_t value) {
+  int64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+Histogram::Histogram(const char* name)
+    : Metric(name, HISTOGRAM), count_(0), sum_(0), max_(0) {
+  Reset();
+}
+
+void Histogram::Reset() {
+  count_ = 0;
+  sum_ = 0;
+  max_ = 0;
+  for (int i = 0; i < kBuckets; ++i)
+    buckets_[i] = 0;
+}
+
+// static
+int Histogram::BucketIndex(uint64_t value) {
+  int index = 0;
+  while (value && index < kBuckets - 1) {
+    value >>= 1;
+    ++index;
+  }
+  return index;
+}
+
+// static
+uint64_t Histogram::BucketLimit(int index) {
+  return static_cast<uint64_t>(1) << index;
+}
+
+void Histogram::RecordAlways(uint64_t value) {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max = max_.load(std::memory_order_relaxed);
+  while (value > max &&
+         !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+MetricSnapshot::MetricSnapshot()
+    : type(Metric::COUNTER), value(0), max(0), count(0) {}
+
+uint64_t MetricSnapshot::Percentile(int percent) const {
+  if (!count)
+    return 0;
+  // The rank of the value we're after, rounded up.
+  uint64_t rank = (count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    seen += buckets[i];
+    if (seen >= rank) {
+      // Report the top of the bucket, but never more than the largest value
+      // that was actually recorded.
+      uint64_t limit = Histogram::BucketLimit(static_cast<int>(i)) - 1;
+      return std::min(limit, static_cast<uint64_t>(max));
+    }
+  }
+  return static_cast<uint64_t>(max);
+}
+
+std::vector<MetricSnapshot> SnapshotMetrics() {
+  std::vector<MetricSnapshot> snapshots;
+  for (Metric* m = MetricList::head.load(); m; m = MetricList::next(m)) {
+    MetricSnapshot s;
+    s.name = m->name();
+    s.type = m->type();
+    switch (m->type()) {
+      case Metric::COUNTER:
+        s.value = static_cast<int64_t>(static_cast<Counter*>(m)->value());
+        break;
+      case Metric::GAUGE: {
+        Gauge* gauge = static_cast<Gauge*>(m);
+        s.value = gauge->value();
+        s.max = gauge->max();
+        break;
+      }
+      case Metric::HISTOGRAM: {
+        Histogram* histogram = static_cast<Histogram*>(m);
+        s.count = histogram->count();
+        s.value = static_cast<int64_t>(histogram->sum());
+        s.max = static_cast<int64_t>(histogram->max());
+        for (int i = 0; i < Histogram::kBuckets; ++i)
+          s.buckets.push_back(histogram->bucket(i));
+        break;
+      }
+    }
+    snapshots.push_back(s);
+  }
+
+  struct ByName {
+    bool operator()(const MetricSnapshot& a, const MetricSnapshot& b) const {
+      return a.name < b.name;
+    }
+  };
+  std::sort(snapshots.begin(), snapshots.end(), ByName());
+  return snapshots;
+}
+
+void ResetMetrics() {
+  for (Metric* m = MetricList::head.load(); m; m = MetricList::next(m)) {
+    switch (m->type()) {
+      case Metric::COUNTER:
+        static_cast<Counter*>(m)->Reset();
+        break;
+      case Metric::GAUGE:
+        static_cast<Gauge*>(m)->Reset();
+        break;
+      case Metric::HISTOGRAM:
+        static_cast<Histogram*>(m)->Reset();
+        break;
+    }
+  }
+}
+
+void WriteMetricsSummary(std::ostream* out) {
+  std::vector<MetricSnapshot> snapshots(SnapshotMetrics());
+  for (const auto& s : snapshots) {
+    switch (s.type) {
+      case Metric::COUNTER:
+        if (s.value)
+          *out << s.name << ": " << s.value << "\n";
+        break;
+      case Metric::GAUGE:
+        if (s.max)
+          *out << s.name << ": " << s.value << " (max " << s.max << ")\n";
+        break;
+      case Metric::HISTOGRAM:
+        if (s.count) {
+          *out << s.name << ": count " << s.count
+               << " mean " << (s.value / static_cast<int64_t>(s.count))
+               << " p50 " << s.Percentile(50)
+               << " p99 " << s.Percentile(99)
+               << " max " << s.max << "\n";
+        }
+        break;
+    }
+  }
+}
+
+ScopedMetricsSummary::~ScopedMetricsSummary() {
+  if (MetricsEnabled())
+    WriteMetricsSummary(&std::cerr);
+}
+
+}  // namespace base
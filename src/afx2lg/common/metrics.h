@@ -0,0 +1,216 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_METRICS_H_
+#define COMMON_METRICS_H_
+
+#include "common_types.h"
+
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace base {
+
+// Process wide counters, gauges and histograms for the hot paths of the
+// parsers and the midi code.  Metrics are defined as globals next to the code
+// that updates them:
+//
+//   static base::Counter g_frames_parsed("axefx.frames_parsed");
+//   ...
+//   g_frames_parsed.Add();
+//
+// Updating a metric is a relaxed atomic operation and when metrics are
+// disabled, which is the default, it's a single load and branch.  Metrics
+// must have static storage duration since they register themselves in a
+// global list that is never pruned.
+
+// Metrics are enabled at startup if the AFX2LG_METRICS environment variable
+// is set, or later by calling SetMetricsEnabled().
+void SetMetricsEnabled(bool enabled);
+
+namespace internal {
+extern std::atomic<bool> g_metrics_enabled;
+}
+
+inline bool MetricsEnabled() {
+  return internal::g_metrics_enabled.load(std::memory_order_relaxed);
+}
+
+class Metric {
+ public:
+  enum Type {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM,
+  };
+
+  const char* name() const { return name_; }
+  Type type() const { return type_; }
+
+ protected:
+  Metric(const char* name, Type type);
+  ~Metric() {}
+
+ private:
+  friend struct MetricList;
+
+  const char* const name_;
+  const Type type_;
+  Metric* next_;
+
+  DISALLOW_COPY_AND_ASSIGN(Metric);
+};
+
+// A value that only goes up, such as the number of bytes received.
+class Counter : public Metric {
+ public:
+  explicit Counter(const char* name) : Metric(name, COUNTER), value_(0) {}
+
+  void Add(uint64_t count = 1) {
+    if (MetricsEnabled())
+      value_.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+  void Reset() { value_ = 0; }
+
+ private:
+  std::atomic<uint64_t> value_;
+};
+
+// A value that goes up and down, such as a queue depth.  The highest value
+// seen since the last reset is kept as well.
+class Gauge : public Metric {
+ public:
+  explicit Gauge(const char* name)
+      : Metric(name, GAUGE), value_(0), max_(0) {}
+
+  void Set(int64_t value) {
+    if (MetricsEnabled()) {
+      value_.store(value, std::memory_order_relaxed);
+      UpdateMax(value);
+    }
+  }
+
+  void Add(int64_t delta) {
+    if (MetricsEnabled())
+      UpdateMax(value_.fetch_add(delta, std::memory_order_relaxed) + delta);
+  }
+
+  int64_t value() const { return value_.load(std::memory_order_relaxed); }
+  int64_t max() const { return max_.load(std::memory_order_relaxed); }
+  void Reset() { value_ = 0; max_ = 0; }
+
+ private:
+  void UpdateMax(int64_t value);
+
+  std::atomic<int64_t> value_;
+  std::atomic<int64_t> max_;
+};
+
+// A distribution of values, such as latencies in microseconds.  Bucket 0
+// counts zeros and bucket i > 0 counts values in [2^(i-1), 2^i), except that
+// the last bucket also takes everything larger.
+class Histogram : public Metric {
+ public:
+  static const int kBuckets = 32;
+
+  explicit Histogram(const char* name);
+
+  void Record(uint64_t value) {
+    if (MetricsEnabled())
+      RecordAlways(value);
+  }
+
+  uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+  uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+  uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+  uint64_t bucket(int index) const {
+    return buckets_[index].load(std::memory_order_relaxed);
+  }
+  void Reset();
+
+  static int BucketIndex(uint64_t value);
+  // The smallest value that falls in the bucket after |index|.
+  static uint64_t BucketLimit(int index);
+
+ private:
+  void RecordAlways(uint64_t value);
+
+  std::atomic<uint64_t> count_;
+  std::atomic<uint64_t> sum_;
+  std::atomic<uint64_t> max_;
+  std::atomic<uint64_t> buckets_[kBuckets];
+};
+
+// Records the lifetime of the object in microseconds.  The clock isn't read
+// when metrics are disabled.
+class ScopedHistogramTimer {
+ public:
+  explicit ScopedHistogramTimer(Histogram* histogram)
+      : histogram_(MetricsEnabled() ? histogram : NULL) {
+    if (histogram_)
+      start_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedHistogramTimer() {
+    if (histogram_) {
+      histogram_->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - start_).count());
+    }
+  }
+
+ private:
+  Histogram* histogram_;
+  std::chrono::steady_clock::time_point start_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedHistogramTimer);
+};
+
+// A copy of a metric's state at one point in time.
+struct MetricSnapshot {
+  MetricSnapshot();
+
+  // Estimates the value below which |percent| of the recorded values fall,
+  // from the histogram buckets.
+  uint64_t Percentile(int percent) const;
+
+  std::string name;
+  Metric::Type type;
+  // The counter value, current gauge value or histogram sum.
+  int64_t value;
+  // The gauge or histogram maximum.
+  int64_t max;
+  // Histograms only.
+  uint64_t count;
+  std::vector<uint64_t> buckets;
+};
+
+// Returns the registered metrics sorted by name.
+std::vector<MetricSnapshot> SnapshotMetrics();
+
+// Resets all registered metrics to 0.
+void ResetMetrics();
+
+// Writes a line per metric that has been updated, for printing when a tool
+// exits.
+void WriteMetricsSummary(std::ostream* out);
+
+// Writes the summary to stderr when it goes out of scope, if metrics are
+// enabled.  Meant for the top of main().
+class ScopedMetricsSummary {
+ public:
+  ScopedMetricsSummary() {}
+  ~ScopedMetricsSummary();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ScopedMetricsSummary);
+};
+
+}  // namespace base
+
+#endif  // COMMON_METRICS_H_
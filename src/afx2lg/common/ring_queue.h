@@ -0,0 +1,75 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_RING_QUEUE_H_
+#define COMMON_RING_QUEUE_H_
+
+#include "common_types.h"
+
+#include <utility>
+#include <vector>
+
+namespace base {
+
+// A FIFO backed by a circular buffer.  Unlike std::queue, which allocates and
+// frees blocks as items pass through it, the buffer only grows (doubling in
+// size) when it's full, so a queue that sees a steady flow of items settles
+// at a fixed size and stops allocating.  Popped slots are reset to T() so
+// that whatever they held is released right away.
+// Not thread safe.
+template <typename T>
+class RingQueue {
+ public:
+  explicit RingQueue(size_t initial_capacity = 16)
+      : slots_(initial_capacity ? initial_capacity : 1), head_(0), size_(0) {}
+  ~RingQueue() {}
+
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return slots_.size(); }
+
+  void push(T&& item) {
+    if (size_ == slots_.size())
+      Grow();
+    slots_[(head_ + size_) % slots_.size()] = std::move(item);
+    ++size_;
+  }
+
+  T& front() {
+    ASSERT(size_);
+    return slots_[head_];
+  }
+
+  // The item |i| places from the front.
+  T& operator[](size_t i) {
+    ASSERT(i < size_);
+    return slots_[(head_ + i) % slots_.size()];
+  }
+
+  void pop() {
+    ASSERT(size_);
+    slots_[head_] = T();
+    head_ = (head_ + 1) % slots_.size();
+    --size_;
+  }
+
+ private:
+  void Grow() {
+    std::vector<T> slots(slots_.size() * 2);
+    for (size_t i = 0; i < size_; ++i)
+      slots[i] = std::move(slots_[(head_ + i) % slots_.size()]);
+    slots_.swap(slots);
+    head_ = 0;
+  }
+
+  std::vector<T> slots_;
+  size_t head_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(RingQueue);
+};
+
+}  // namespace base
+
+#endif  // COMMON_RING_QUEUE_H_
@@ -0,0 +1,75 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_STRING_PIECE_H_
+#define COMMON_STRING_PIECE_H_
+
+#include "common_types.h"
+
+#include <string.h>
+
+#include <string>
+
+namespace base {
+
+// A reference to a range of characters that someone else owns, for passing
+// around parts of a larger buffer without copying them.  The characters have
+// to outlive the StringPiece and aren't necessarily zero terminated.
+class StringPiece {
+ public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  StringPiece() : ptr_(""), length_(0) {}
+  StringPiece(const char* str) : ptr_(str), length_(strlen(str)) {}
+  StringPiece(const std::string& str)
+      : ptr_(str.data()), length_(str.size()) {}
+  StringPiece(const char* data, size_t length)
+      : ptr_(data), length_(length) {}
+
+  const char* data() const { return ptr_; }
+  size_t size() const { return length_; }
+  size_t length() const { return length_; }
+  bool empty() const { return length_ == 0; }
+
+  const char* begin() const { return ptr_; }
+  const char* end() const { return ptr_ + length_; }
+  char operator[](size_t i) const { return ptr_[i]; }
+
+  StringPiece substr(size_t pos, size_t n = npos) const {
+    if (pos > length_)
+      pos = length_;
+    if (n > length_ - pos)
+      n = length_ - pos;
+    return StringPiece(ptr_ + pos, n);
+  }
+
+  bool starts_with(const StringPiece& x) const {
+    return length_ >= x.length_ && memcmp(ptr_, x.ptr_, x.length_) == 0;
+  }
+
+  int compare(const StringPiece& x) const {
+    int r = memcmp(ptr_, x.ptr_, length_ < x.length_ ? length_ : x.length_);
+    if (r == 0 && length_ != x.length_)
+      r = length_ < x.length_ ? -1 : 1;
+    return r;
+  }
+
+  std::string as_string() const { return std::string(ptr_, length_); }
+
+ private:
+  const char* ptr_;
+  size_t length_;
+};
+
+inline bool operator==(const StringPiece& a, const StringPiece& b) {
+  return a.size() == b.size() && memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+inline bool operator!=(const StringPiece& a, const StringPiece& b) {
+  return !(a == b);
+}
+
+}  // namespace base
+
+#endif  // COMMON_STRING_PIECE_H_
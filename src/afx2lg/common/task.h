@@ -0,0 +1,146 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_TASK_H_
+#define COMMON_TASK_H_
+
+#include "common_types.h"
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace base {
+
+// A move-only alternative to std::function<void()> for work that's posted to
+// a queue and run once.  Callables of up to kInlineSize bytes, which covers
+// std::bind with a handful of bound pointers or a shared_ptr, are stored in
+// the Task itself so that posting them doesn't allocate.  Larger callables
+// are moved to the heap.
+class Task {
+ public:
+  static const size_t kInlineSize = 8 * sizeof(void*);
+
+  Task() : ops_(NULL) {}
+  Task(std::nullptr_t) : ops_(NULL) {}
+
+  template <typename F>
+  Task(F f,
+       typename std::enable_if<!std::is_same<F, Task>::value>::type* = NULL)
+      : ops_(NULL) {
+    Init(std::move(f), std::integral_constant<bool, FitsInline<F>::value>());
+  }
+
+  Task(Task&& other) : ops_(other.ops_) {
+    if (ops_) {
+      ops_->move(&other.storage_, &storage_);
+      other.ops_ = NULL;
+    }
+  }
+
+  ~Task() { Reset(); }
+
+  Task& operator=(Task&& other) {
+    if (this != &other) {
+      Reset();
+      if (other.ops_) {
+        other.ops_->move(&other.storage_, &storage_);
+        ops_ = other.ops_;
+        other.ops_ = NULL;
+      }
+    }
+    return *this;
+  }
+
+  Task& operator=(std::nullptr_t) {
+    Reset();
+    return *this;
+  }
+
+  bool is_null() const { return ops_ == NULL; }
+
+  // True if the callable lives inside the Task.  Mostly useful for tests.
+  bool is_inline() const { return ops_ && ops_->is_inline; }
+
+  void operator()() {
+    ASSERT(ops_);
+    ops_->invoke(&storage_);
+  }
+
+ private:
+  typedef std::aligned_storage<kInlineSize>::type Storage;
+
+  struct Ops {
+    void (*invoke)(void* storage);
+    // Move constructs into |to| and destroys what's left in |from|.
+    void (*move)(void* from, void* to);
+    void (*destroy)(void* storage);
+    bool is_inline;
+  };
+
+  template <typename F>
+  struct FitsInline {
+    static const bool value =
+        sizeof(F) <= sizeof(Storage) &&
+        std::alignment_of<Storage>::value % std::alignment_of<F>::value == 0 &&
+        std::is_nothrow_move_constructible<F>::value;
+  };
+
+  template <typename F>
+  struct InlineOps {
+    static F* Get(void* storage) { return static_cast<F*>(storage); }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Move(void* from, void* to) {
+      new (to) F(std::move(*Get(from)));
+      Get(from)->~F();
+    }
+    static void Destroy(void* storage) { Get(storage)->~F(); }
+    static const Ops* ops() {
+      static const Ops ops = { &Invoke, &Move, &Destroy, true };
+      return &ops;
+    }
+  };
+
+  template <typename F>
+  struct HeapOps {
+    static F*& Get(void* storage) { return *static_cast<F**>(storage); }
+    static void Invoke(void* storage) { (*Get(storage))(); }
+    static void Move(void* from, void* to) {
+      new (to) F*(Get(from));
+    }
+    static void Destroy(void* storage) { delete Get(storage); }
+    static const Ops* ops() {
+      static const Ops ops = { &Invoke, &Move, &Destroy, false };
+      return &ops;
+    }
+  };
+
+  template <typename F>
+  void Init(F&& f, std::true_type /* inline */) {
+    new (&storage_) F(std::move(f));
+    ops_ = InlineOps<F>::ops();
+  }
+
+  template <typename F>
+  void Init(F&& f, std::false_type /* inline */) {
+    new (&storage_) F*(new F(std::move(f)));
+    ops_ = HeapOps<F>::ops();
+  }
+
+  void Reset() {
+    if (ops_) {
+      ops_->destroy(&storage_);
+      ops_ = NULL;
+    }
+  }
+
+  const Ops* ops_;
+  Storage storage_;
+
+  DISALLOW_COPY_AND_ASSIGN(Task);
+};
+
+}  // namespace base
+
+#endif  // COMMON_TASK_H_
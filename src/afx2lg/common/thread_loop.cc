@@ -3,8 +3,14 @@
 
 #include "common/thread_loop.h"
 
+#include "common/metrics.h"
+#include "common/trace.h"
+
 namespace base {
 
+static Counter g_tasks_run("thread_loop.tasks_run");
+static Gauge g_queue_depth("thread_loop.queue_depth");
+
 #if defined(OS_WIN)
 using std::cv_status::cv_status;
 #else
@@ -13,7 +19,9 @@ using std::cv_status;
 
 ThreadLoop::ThreadLoop()
     : timeout_(std::chrono::milliseconds(1000 * 60 * 10)),
-      is_running_(false) {
+      next_timer_id_(1),
+      is_running_(false),
+      batch_left_(0) {
 }
 
 ThreadLoop::~ThreadLoop() {}
@@ -38,11 +46,19 @@ bool ThreadLoop::Run() {
     std::lock_guard<std::mutex> lock(lock_);
     ASSERT(!is_running_);
     is_running_ = true;
+    batch_left_ = 0;
   }
 
   Task task;
-  while (PopTask(&task)) {
-    task();
+  TimerId repeating = 0;
+  while (PopTask(&task, &repeating)) {
+    g_tasks_run.Add();
+    {
+      TRACE_EVENT0("base", "ThreadLoop::RunTask");
+      task();
+    }
+    if (repeating)
+      RestoreRepeatingTask(repeating, &task);
     if (!is_running())
       return true;
   }
@@ -56,12 +72,51 @@ void ThreadLoop::Quit() {
   QueueTask(std::bind(&ThreadLoop::SetQuit, this));
 }
 
-void ThreadLoop::QueueTask(const Task& task) {
+void ThreadLoop::QueueTask(Task&& task) {
   {
     std::lock_guard<std::mutex> lock(lock_);
     queue_.push(std::move(task));
+    g_queue_depth.Set(static_cast<int64_t>(queue_.size()));
+  }
+  signal_.notify_one();
+}
+
+ThreadLoop::TimerId ThreadLoop::PostDelayedTask(
+    Task&& task, const std::chrono::milliseconds& delay) {
+  return AddTimer(std::move(task), delay, std::chrono::milliseconds::zero());
+}
+
+ThreadLoop::TimerId ThreadLoop::PostRepeatingTask(
+    Task&& task, const std::chrono::milliseconds& interval) {
+  ASSERT(interval > std::chrono::milliseconds::zero());
+  return AddTimer(std::move(task), interval, interval);
+}
+
+bool ThreadLoop::CancelTimer(TimerId id) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (!timers_.erase(id))
+    return false;
+  DropCancelledTimers();
+  return true;
+}
+
+ThreadLoop::TimerId ThreadLoop::AddTimer(
+    Task&& task,
+    const std::chrono::milliseconds& delay,
+    const std::chrono::milliseconds& interval) {
+  TimerId id;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    id = next_timer_id_++;
+    Timer& timer = timers_[id];
+    timer.task = std::move(task);
+    timer.interval = interval;
+    ScheduledTimer scheduled = { Clock::now() + delay, id };
+    timer_heap_.push(scheduled);
   }
+  // The loop may need to wake up earlier than it planned to.
   signal_.notify_one();
+  return id;
 }
 
 void ThreadLoop::SetQuit() {
@@ -69,19 +124,97 @@ void ThreadLoop::SetQuit() {
   is_running_ = false;
 }
 
-bool ThreadLoop::PopTask(ThreadLoop::Task* task) {
+bool ThreadLoop::PopTask(ThreadLoop::Task* task, TimerId* repeating) {
+  *repeating = 0;
   std::unique_lock<std::mutex> lock(lock_);
-  while (queue_.empty()) {
-    cv_status status = signal_.wait_for(lock, timeout_);
-    if (status == cv_status::timeout)
+  // Only set once we have to wait, so that popping a task that is already
+  // queued doesn't read the clock.
+  Clock::time_point timeout;
+  bool waited = false;
+  while (true) {
+    // Only look at the clock if there are timers, and then only between
+    // batches of tasks.  Timers that are due go ahead of the next batch so
+    // that a busy loop doesn't starve them.
+    if (!timer_heap_.empty()) {
+      if (!batch_left_) {
+        now_ = Clock::now();
+        batch_left_ = queue_.size();
+      }
+      if (PopDueTimer(now_, task, repeating))
+        return true;
+    }
+
+    if (!queue_.empty())
+      break;
+
+    if (!waited) {
+      timeout = Clock::now() + timeout_;
+      waited = true;
+    }
+    Clock::time_point wake_up = timeout;
+    if (!timer_heap_.empty() && timer_heap_.top().due < wake_up)
+      wake_up = timer_heap_.top().due;
+
+    if (signal_.wait_until(lock, wake_up) == cv_status::timeout &&
+        queue_.empty() && Clock::now() >= timeout &&
+        (timer_heap_.empty() || timer_heap_.top().due > Clock::now())) {
       return false;
+    }
   }
 
   ASSERT(lock.owns_lock());
   *task = std::move(queue_.front());
   queue_.pop();
+  if (batch_left_)
+    --batch_left_;
+  g_queue_depth.Set(static_cast<int64_t>(queue_.size()));
 
   return true;
 }
 
+void ThreadLoop::RestoreRepeatingTask(TimerId id, Task* task) {
+  std::lock_guard<std::mutex> lock(lock_);
+  // The timer may have been cancelled while it was running.
+  auto found = timers_.find(id);
+  if (found != timers_.end())
+    found->second.task = std::move(*task);
+  *task = nullptr;
+}
+
+bool ThreadLoop::PopDueTimer(const Clock::time_point& now, Task* task,
+                             TimerId* repeating) {
+  if (timer_heap_.empty() || timer_heap_.top().due > now)
+    return false;
+
+  ScheduledTimer scheduled = timer_heap_.top();
+  timer_heap_.pop();
+  // Cancelled timers never stay at the top.
+  auto found = timers_.find(scheduled.id);
+  ASSERT(found != timers_.end());
+  if (found->second.interval == std::chrono::milliseconds::zero()) {
+    *task = std::move(found->second.task);
+    timers_.erase(found);
+  } else {
+    // Tasks can't be copied, so the task is lent out while it runs.
+    // Being the only thread that pops timers, we get it back before the
+    // timer can come up again.
+    *task = std::move(found->second.task);
+    *repeating = scheduled.id;
+    // Keep to the original schedule unless we've fallen behind.
+    scheduled.due += found->second.interval;
+    if (scheduled.due < now)
+      scheduled.due = now + found->second.interval;
+    timer_heap_.push(scheduled);
+  }
+  DropCancelledTimers();
+  return true;
+}
+
+void ThreadLoop::DropCancelledTimers() {
+  while (!timer_heap_.empty() &&
+         timers_.find(timer_heap_.top().id) == timers_.end()) {
+    timer_heap_.pop();
+  }
+}
+
 }  // namespace base
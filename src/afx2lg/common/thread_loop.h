@@ -6,18 +6,26 @@
 #define COMMON_THREAD_LOOP_H_
 
 #include "common_types.h"
+#include "common/ring_queue.h"
+#include "common/task.h"
 
+#include <chrono>
 #include <condition_variable>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <queue>
 #include <thread>
+#include <vector>
 
 namespace base {
 
 class ThreadLoop {
  public:
-  typedef std::function<void()> Task;
+  // Move-only.  Tasks with small captures don't allocate when queued.
+  typedef base::Task Task;
+  // Identifies a delayed or repeating task.  Never 0.
+  typedef int TimerId;
 
   ThreadLoop();
   ~ThreadLoop();
@@ -32,17 +40,68 @@ class ThreadLoop {
 
   void Quit();
 
-  void QueueTask(const Task& task);
+  void QueueTask(Task&& task);
+
+  // Runs |task| on the loop once |delay| has passed.
+  // Delayed tasks count as activity as far as the timeout is concerned.
+  TimerId PostDelayedTask(Task&& task,
+                          const std::chrono::milliseconds& delay);
+
+  // Runs |task| on the loop every |interval| until cancelled.
+  TimerId PostRepeatingTask(Task&& task,
+                            const std::chrono::milliseconds& interval);
+
+  // Cancels a delayed or repeating task.  Returns false if the task has
+  // already run (for delayed tasks) or has already been cancelled.
+  // Can be called from any thread, including from within the task itself.
+  bool CancelTimer(TimerId id);
 
  private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Timer {
+    Task task;
+    std::chrono::milliseconds interval;  // Zero for one-shot timers.
+  };
+
+  // An entry in |timer_heap_|.  Cancelled timers are removed from |timers_|
+  // right away and from the heap once they reach the top of it.
+  struct ScheduledTimer {
+    Clock::time_point due;
+    TimerId id;
+    bool operator>(const ScheduledTimer& other) const {
+      return due > other.due;
+    }
+  };
+
   void SetQuit();
-  bool PopTask(Task* task);
+  // If the task is a repeating timer, |*repeating| is set to its ID and the
+  // task must be handed back via RestoreRepeatingTask() once it has run.
+  bool PopTask(Task* task, TimerId* repeating);
+  void RestoreRepeatingTask(TimerId id, Task* task);
+  TimerId AddTimer(Task&& task, const std::chrono::milliseconds& delay,
+                   const std::chrono::milliseconds& interval);
+  // Must be called while holding |lock_|.
+  bool PopDueTimer(const Clock::time_point& now, Task* task,
+                   TimerId* repeating);
+  // Pops cancelled timers off the top of the heap, so that the top is always
+  // the next timer to run.  Must be called while holding |lock_|.
+  void DropCancelledTimers();
 
   std::condition_variable signal_;
   std::chrono::milliseconds timeout_;
   mutable std::mutex lock_;
-  std::queue<Task> queue_;
+  RingQueue<Task> queue_;
+  std::map<TimerId, Timer> timers_;
+  std::priority_queue<ScheduledTimer, std::vector<ScheduledTimer>,
+                      std::greater<ScheduledTimer> > timer_heap_;
+  TimerId next_timer_id_;
   bool is_running_;
+  // The clock is read once per batch of tasks instead of for every task.
+  // |now_| is when the current batch started and |batch_left_| is the number
+  // of queued tasks that run before the timers are checked again.
+  Clock::time_point now_;
+  size_t batch_left_;
 };
 
 typedef std::shared_ptr<ThreadLoop> SharedThreadLoop;
@@ -0,0 +1,220 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/thread_pool.h"
+
+#include "common/metrics.h"
+#include "common/trace.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#if defined(OS_WIN)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace base {
+
+namespace {
+// The pool that the current thread is a worker of, and its index in it.  Set
+// by the worker itself, so there's no race with the constructor.
+THREAD_LOCAL const ThreadPool* t_pool = NULL;
+THREAD_LOCAL int t_worker_index = -1;
+}  // namespace
+
+static const char kThreadCountVariable[] = "AFX2LG_THREADS";
+
+// ParallelFor splits its range into about this many chunks per worker, so
+// that uneven chunks even out without too much overhead per index.
+static const size_t kChunksPerWorker = 4;
+
+static Counter g_tasks_run("thread_pool.tasks_run");
+static Counter g_tasks_stolen("thread_pool.tasks_stolen");
+
+ThreadPool::ThreadPool(size_t num_workers)
+    : pending_(0), next_worker_(0), quit_(false) {
+  if (!num_workers)
+    num_workers = DefaultWorkerCount();
+  for (size_t i = 0; i < num_workers; ++i)
+    workers_.push_back(unique_ptr<Worker>(new Worker()));
+  for (size_t i = 0; i < num_workers; ++i)
+    workers_[i]->thread = std::thread(&ThreadPool::WorkerMain, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    quit_ = true;
+  }
+  signal_.notify_all();
+  for (auto& w : workers_)
+    w->thread.join();
+}
+
+// static
+size_t ThreadPool::DefaultWorkerCount() {
+  const char* env = getenv(kThreadCountVariable);
+  if (env) {
+    int count = atoi(env);
+    if (count > 0)
+      return static_cast<size_t>(count);
+  }
+  size_t count = std::thread::hardware_concurrency();
+  return count ? count : 1u;
+}
+
+void ThreadPool::PostTask(const Task& task) {
+  int current = CurrentWorkerIndex();
+  if (current != -1) {
+    Worker* w = workers_[current].get();
+    std::lock_guard<std::mutex> lock(w->lock);
+    w->tasks.push_front(task);
+  } else {
+    Worker* w = workers_[next_worker_++ % workers_.size()].get();
+    std::lock_guard<std::mutex> lock(w->lock);
+    w->tasks.push_back(task);
+  }
+
+  ++pending_;
+  // Taking the lock makes sure that a worker that's about to go to sleep
+  // either sees the new task or gets the notification.
+  { std::lock_guard<std::mutex> lock(lock_); }
+  signal_.notify_one();
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end,
+                             const std::function<void(size_t)>& fn) {
+  if (begin >= end)
+    return;
+
+  struct Chunk {
+    static void Run(const std::function<void(size_t)>* fn, size_t begin,
+                    size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        (*fn)(i);
+    }
+  };
+
+  size_t chunk_size = std::max<size_t>(
+      1u, (end - begin) / (workers_.size() * kChunksPerWorker));
+  TaskGroup group(this);
+  for (size_t i = begin; i < end; i += chunk_size) {
+    group.PostTask(std::bind(&Chunk::Run, &fn, i,
+                             std::min(i + chunk_size, end)));
+  }
+  group.Wait();
+}
+
+bool ThreadPool::RunPendingTask() {
+  int current = CurrentWorkerIndex();
+  Task task;
+  if (!PopTask(current == -1 ? 0 : current, &task))
+    return false;
+  TRACE_EVENT0("base", "ThreadPool::RunTask");
+  task();
+  return true;
+}
+
+void ThreadPool::WorkerMain(size_t index) {
+  t_pool = this;
+  t_worker_index = static_cast<int>(index);
+  SetTraceThreadName("ThreadPool worker");
+  Task task;
+  while (true) {
+    if (PopTask(index, &task)) {
+      TRACE_EVENT0("base", "ThreadPool::RunTask");
+      task();
+      task = nullptr;
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(lock_);
+    while (!pending_ && !quit_)
+      signal_.wait(lock);
+    if (!pending_ && quit_)
+      break;
+  }
+}
+
+bool ThreadPool::PopTask(size_t index, Task* task) {
+  if (!pending_)
+    return false;
+
+  for (size_t i = 0; i < workers_.size(); ++i) {
+    Worker* w = workers_[(index + i) % workers_.size()].get();
+    std::lock_guard<std::mutex> lock(w->lock);
+    if (w->tasks.empty())
+      continue;
+    if (i == 0) {
+      *task = std::move(w->tasks.front());
+      w->tasks.pop_front();
+    } else {
+      *task = std::move(w->tasks.back());
+      w->tasks.pop_back();
+      g_tasks_stolen.Add();
+    }
+    --pending_;
+    g_tasks_run.Add();
+    return true;
+  }
+
+  return false;
+}
+
+int ThreadPool::CurrentWorkerIndex() const {
+  return t_pool == this ? t_worker_index : -1;
+}
+
+TaskGroup::TaskGroup(ThreadPool* pool)
+    : pool_(pool), outstanding_(0), cancelled_(false) {
+}
+
+TaskGroup::~TaskGroup() {
+  Wait();
+}
+
+void TaskGroup::PostTask(const ThreadPool::Task& task) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    ++outstanding_;
+  }
+  pool_->PostTask(std::bind(&TaskGroup::RunTask, this, task));
+}
+
+void TaskGroup::Wait() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (!outstanding_)
+        return;
+    }
+
+    if (!pool_->RunPendingTask()) {
+      // Nothing is queued, so the remaining tasks are running on other
+      // threads.  RunTask() wakes us up when the last one is done.
+      std::unique_lock<std::mutex> lock(lock_);
+      while (outstanding_)
+        done_.wait(lock);
+      return;
+    }
+  }
+}
+
+void TaskGroup::Cancel() {
+  cancelled_ = true;
+}
+
+void TaskGroup::RunTask(const ThreadPool::Task& task) {
+  if (!cancelled_)
+    task();
+
+  // |this| may be deleted as soon as the lock is released.
+  std::lock_guard<std::mutex> lock(lock_);
+  if (--outstanding_ == 0)
+    done_.notify_all();
+}
+
+}  // namespace base
@@ -0,0 +1,108 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_THREAD_POOL_H_
+#define COMMON_THREAD_POOL_H_
+
+#include "common_types.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace base {
+
+// A fixed set of worker threads for CPU bound work such as parsing presets
+// or generating output files.  Each worker has its own task queue.  Tasks
+// posted from a worker go to the front of that worker's queue and workers
+// that run out of work steal from the back of the other queues.
+class ThreadPool {
+ public:
+  typedef std::function<void()> Task;
+
+  // A |num_workers| of 0 means DefaultWorkerCount().
+  explicit ThreadPool(size_t num_workers);
+  // Runs the tasks that are still queued, then joins the workers.
+  ~ThreadPool();
+
+  // The value of the AFX2LG_THREADS environment variable if set, otherwise
+  // the number of hardware threads.
+  static size_t DefaultWorkerCount();
+
+  size_t num_workers() const { return workers_.size(); }
+
+  void PostTask(const Task& task);
+
+  // Calls |fn| for each index in [begin, end) and returns when all calls have
+  // completed.  The calling thread runs tasks too while it waits, so this
+  // can be used from within a task.
+  void ParallelFor(size_t begin, size_t end,
+                   const std::function<void(size_t)>& fn);
+
+  // Runs one queued task on the calling thread if there is one.
+  // Returns false if there was nothing to do.
+  bool RunPendingTask();
+
+ private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  void WorkerMain(size_t index);
+  // Takes a task from the front of worker |index|'s queue or, failing that,
+  // from the back of another worker's queue.
+  bool PopTask(size_t index, Task* task);
+  // Returns the index of the worker running on the current thread or -1.
+  int CurrentWorkerIndex() const;
+
+  std::vector<unique_ptr<Worker> > workers_;
+  std::atomic<size_t> pending_;  // Tasks in all the queues.
+  std::atomic<size_t> next_worker_;  // For spreading out external tasks.
+  std::mutex lock_;
+  std::condition_variable signal_;
+  bool quit_;  // Guarded by |lock_|.
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadPool);
+};
+
+// Tracks a set of tasks posted to a ThreadPool so that they can be waited
+// for or cancelled together.
+class TaskGroup {
+ public:
+  explicit TaskGroup(ThreadPool* pool);
+  // Waits for the outstanding tasks.
+  ~TaskGroup();
+
+  void PostTask(const ThreadPool::Task& task);
+
+  // Returns when all tasks posted to the group have completed or been
+  // skipped.  The calling thread helps out with queued tasks meanwhile.
+  void Wait();
+
+  // Tasks that haven't started yet will be skipped.  Tasks that are already
+  // running can poll cancelled() to stop early.
+  void Cancel();
+  bool cancelled() const { return cancelled_; }
+
+ private:
+  void RunTask(const ThreadPool::Task& task);
+
+  ThreadPool* pool_;
+  std::mutex lock_;
+  std::condition_variable done_;
+  size_t outstanding_;  // Guarded by |lock_|.
+  std::atomic<bool> cancelled_;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskGroup);
+};
+
+}  // namespace base
+
+#endif  // COMMON_THREAD_POOL_H_
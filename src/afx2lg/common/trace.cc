@@ -0,0 +1,224 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#if defined(OS_WIN)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+namespace base {
+namespace {
+
+const char kTraceVariable[] = "AFX2LG_TRACE";
+const char kTraceArgument[] = "--trace=";
+const size_t kEventsPerChunk = 1024;
+
+struct Event {
+  const char* category;
+  const char* name;
+  const char* arg_name;
+  int64_t arg_value;
+  int64_t begin_us;
+  int64_t duration_us;
+};
+
+// Events are written by the owning thread only.  |used| and |next| are
+// published with release semantics so that StopTracing() can read the
+// chunks while the owner keeps appending.
+struct Chunk {
+  Chunk() : used(0), next(NULL) {}
+
+  Event events[kEventsPerChunk];
+  std::atomic<size_t> used;
+  std::atomic<Chunk*> next;
+};
+
+struct ThreadBuffer {
+  explicit ThreadBuffer(int id) : id(id), name(NULL), tail(&head) {}
+
+  const int id;
+  std::atomic<const char*> name;
+  Chunk head;
+  Chunk* tail;  // Only used by the owning thread.
+};
+
+// Buffers are never freed since threads keep a pointer to theirs.  That's
+// fine as long as tracing is only done once per process.
+std::mutex g_lock;
+std::vector<ThreadBuffer*> g_buffers;  // Guarded by |g_lock|.
+std::string g_path;  // Guarded by |g_lock|.
+bool g_started = false;  // Guarded by |g_lock|.
+TraceTime g_start_time;  // Set before tracing is enabled.
+
+THREAD_LOCAL ThreadBuffer* t_buffer = NULL;
+
+ThreadBuffer* GetThreadBuffer() {
+  if (!t_buffer) {
+    std::lock_guard<std::mutex> lock(g_lock);
+    t_buffer = new ThreadBuffer(static_cast<int>(g_buffers.size()) + 1);
+    g_buffers.push_back(t_buffer);
+  }
+  return t_buffer;
+}
+
+int64_t MicrosecondsSinceStart(const TraceTime& time) {
+  if (time < g_start_time)
+    return 0;
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      time - g_start_time).count();
+}
+
+// Names are expected to be plain identifiers, but quotes and backslashes
+// would break the file so escape them anyway.
+void WriteString(std::ostream* out, const char* str) {
+  *out << '"';
+  for (; *str; ++str) {
+    if (*str == '"' || *str == '\\')
+      *out << '\\';
+    *out << *str;
+  }
+  *out << '"';
+}
+
+void WriteEvent(std::ostream* out, int tid, const Event& e) {
+  *out << "{\"name\":";
+  WriteString(out, e.name);
+  *out << ",\"cat\":";
+  WriteString(out, e.category);
+  *out << ",\"ph\":\"X\",\"ts\":" << e.begin_us << ",\"dur\":"
+       << e.duration_us << ",\"pid\":1,\"tid\":" << tid;
+  if (e.arg_name) {
+    *out << ",\"args\":{";
+    WriteString(out, e.arg_name);
+    *out << ":" << e.arg_value << "}";
+  }
+  *out << "}";
+}
+
+}  // namespace
+
+namespace internal {
+std::atomic<bool> g_tracing_enabled(false);
+}
+
+bool StartTracing(const std::string& path) {
+  std::lock_guard<std::mutex> lock(g_lock);
+  if (g_started)
+    return false;
+  g_started = true;
+  g_path = path;
+  g_start_time = std::chrono::steady_clock::now();
+  internal::g_tracing_enabled = true;
+  return true;
+}
+
+bool StopTracing() {
+  std::lock_guard<std::mutex> lock(g_lock);
+  if (!internal::g_tracing_enabled)
+    return false;
+  internal::g_tracing_enabled = false;
+
+  std::ofstream file(g_path.c_str());
+  file << "{\"traceEvents\":[\n";
+  bool first = true;
+  for (auto buffer : g_buffers) {
+    const char* name = buffer->name.load();
+    if (name) {
+      file << (first ? "" : ",\n")
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+           << buffer->id << ",\"args\":{\"name\":";
+      WriteString(&file, name);
+      file << "}}";
+      first = false;
+    }
+
+    for (Chunk* c = &buffer->head; c;
+         c = c->next.load(std::memory_order_acquire)) {
+      size_t used = c->used.load(std::memory_order_acquire);
+      for (size_t i = 0; i < used; ++i) {
+        file << (first ? "" : ",\n");
+        WriteEvent(&file, buffer->id, c->events[i]);
+        first = false;
+      }
+    }
+  }
+  file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+  if (!file.good()) {
+    std::cerr << "Failed to write the trace to " << g_path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+void SetTraceThreadName(const char* name) {
+  if (TracingEnabled())
+    GetThreadBuffer()->name = name;
+}
+
+void AddTraceEvent(const char* category, const char* name,
+                   const TraceTime& begin, const TraceTime& end,
+                   const char* arg_name, int64_t arg_value) {
+  if (!TracingEnabled())
+    return;
+
+  ThreadBuffer* buffer = GetThreadBuffer();
+  Chunk* chunk = buffer->tail;
+  size_t used = chunk->used.load(std::memory_order_relaxed);
+  if (used == kEventsPerChunk) {
+    chunk = new Chunk();
+    buffer->tail->next.store(chunk, std::memory_order_release);
+    buffer->tail = chunk;
+    used = 0;
+  }
+
+  Event& e = chunk->events[used];
+  e.category = category;
+  e.name = name;
+  e.arg_name = arg_name;
+  e.arg_value = arg_value;
+  e.begin_us = MicrosecondsSinceStart(begin);
+  e.duration_us = MicrosecondsSinceStart(end) - e.begin_us;
+  chunk->used.store(used + 1, std::memory_order_release);
+}
+
+std::string TakeTraceArgument(int* argc, char* argv[]) {
+  const size_t prefix = sizeof(kTraceArgument) - 1;
+  for (int i = 1; i < *argc; ++i) {
+    if (strncmp(argv[i], kTraceArgument, prefix) == 0) {
+      std::string path(argv[i] + prefix);
+      // Also moves the terminating NULL.
+      for (int j = i; j < *argc; ++j)
+        argv[j] = argv[j + 1];
+      --(*argc);
+      return path;
+    }
+  }
+
+  const char* env = getenv(kTraceVariable);
+  return env ? std::string(env) : std::string();
+}
+
+ScopedTracing::ScopedTracing(const std::string& path)
+    : started_(!path.empty() && StartTracing(path)) {
+  if (started_)
+    SetTraceThreadName("main");
+}
+
+ScopedTracing::~ScopedTracing() {
+  if (started_)
+    StopTracing();
+}
+
+}  // namespace base
@@ -0,0 +1,119 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef COMMON_TRACE_H_
+#define COMMON_TRACE_H_
+
+#include "common_types.h"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace base {
+
+// Records timed spans that can be written out in the Chrome trace event
+// format and viewed in chrome://tracing or Perfetto.  Each thread appends
+// to its own buffer, so recording an event takes no locks.  When tracing
+// is off, a TRACE_EVENT costs a load and a branch.
+//
+//   void Preset::Serialize(...) {
+//     TRACE_EVENT0("axefx", "Preset::Serialize");
+//     ...
+//   }
+//
+// Category and event names must be string literals or otherwise outlive
+// the trace.
+
+typedef std::chrono::steady_clock::time_point TraceTime;
+
+namespace internal {
+extern std::atomic<bool> g_tracing_enabled;
+}
+
+inline bool TracingEnabled() {
+  return internal::g_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Starts recording.  The trace is written to |path| by StopTracing().
+// Tracing can only be started once per process.
+bool StartTracing(const std::string& path);
+// Stops recording and writes the trace file.  Threads that are still
+// running may lose the events they record from this point on.
+bool StopTracing();
+
+// Names the calling thread in the trace.
+void SetTraceThreadName(const char* name);
+
+// Records a span from |begin| to |end| on the calling thread.  For spans
+// that start on another thread, such as the time a message waits to be sent.
+// |arg_name| may be NULL.
+void AddTraceEvent(const char* category, const char* name,
+                   const TraceTime& begin, const TraceTime& end,
+                   const char* arg_name, int64_t arg_value);
+
+// Records the lifetime of the object.
+class ScopedTraceEvent {
+ public:
+  ScopedTraceEvent(const char* category, const char* name)
+      : category_(TracingEnabled() ? category : NULL), name_(name),
+        arg_name_(NULL), arg_value_(0) {
+    if (category_)
+      begin_ = std::chrono::steady_clock::now();
+  }
+
+  ScopedTraceEvent(const char* category, const char* name,
+                   const char* arg_name, int64_t arg_value)
+      : category_(TracingEnabled() ? category : NULL), name_(name),
+        arg_name_(arg_name), arg_value_(arg_value) {
+    if (category_)
+      begin_ = std::chrono::steady_clock::now();
+  }
+
+  ~ScopedTraceEvent() {
+    if (category_) {
+      AddTraceEvent(category_, name_, begin_, std::chrono::steady_clock::now(),
+                    arg_name_, arg_value_);
+    }
+  }
+
+ private:
+  const char* category_;  // NULL if tracing was off.
+  const char* name_;
+  const char* arg_name_;
+  int64_t arg_value_;
+  TraceTime begin_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedTraceEvent);
+};
+
+// For main().  Removes a --trace=<file> argument from |argv| if there is
+// one and returns the file name.  Otherwise returns the value of the
+// AFX2LG_TRACE environment variable, if set.
+std::string TakeTraceArgument(int* argc, char* argv[]);
+
+// Traces for as long as it's in scope, if |path| isn't empty.
+class ScopedTracing {
+ public:
+  explicit ScopedTracing(const std::string& path);
+  ~ScopedTracing();
+
+ private:
+  bool started_;
+
+  DISALLOW_COPY_AND_ASSIGN(ScopedTracing);
+};
+
+}  // namespace base
+
+#define TRACE_EVENT_CONCAT_(a, b) a##b
+#define TRACE_EVENT_CONCAT(a, b) TRACE_EVENT_CONCAT_(a, b)
+#define TRACE_EVENT0(category, name) \
+    base::ScopedTraceEvent TRACE_EVENT_CONCAT(trace_event_, __LINE__)( \
+        category, name)
+#define TRACE_EVENT1(category, name, arg_name, arg_value) \
+    base::ScopedTraceEvent TRACE_EVENT_CONCAT(trace_event_, __LINE__)( \
+        category, name, arg_name, static_cast<int64_t>(arg_value))
+
+#endif  // COMMON_TRACE_H_
@@ -20,10 +20,15 @@
       'sources': [
         'lg_entry.cc',
         'lg_entry.h',
+        'lg_hashes.cc',
+        'lg_hashes.h',
+        'lg_line.h',
         'lg_parser.cc',
         'lg_parser.h',
         'lg_utils.cc',
         'lg_utils.h',
+        'lg_writer.cc',
+        'lg_writer.h',
       ],
     },
   ],
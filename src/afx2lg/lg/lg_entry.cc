@@ -8,72 +8,60 @@
 #include "lg/lg_utils.h"
 
 #include <iomanip>
-#include <regex>
 #include <sstream>
 
 namespace lg {
 
-using std::match_results;
-using std::regex;
-using std::regex_match;
-
 void LgEntry::AppendLine(const char* line, const char* eol) {
-  lines_.push_back(std::string(line, eol + 1));  // \n inclusive.
   // LG export files can have superfluous whitespace at the end of names.
-  // Let's trim that now.
-  std::string& s= lines_.back();
-  size_t chars = 0, i = s.length() > 2 ? s.length() - 2 : 0;
-  while (i > 0 && isspace(s[i])) {
-    --i;
-    ++chars;
+  // Let's trim that now.  The line keeps referring to the buffer.
+  const char* end = eol;
+  if (end - line >= 2) {
+    end = eol - 1;
+    while (end > line && isspace(*end))
+      --end;
+    ++end;
   }
-  if (chars)
-    s.erase(i + 1, chars);
+  lines_.push_back(Line(line, end));
 }
 
 void LgEntry::WriteLines(LgParserCallback* callback) {
-  std::vector<std::string>::const_iterator it = lines_.begin();
-  for (; it != lines_.end(); ++it)
-    callback->WriteLine(*it);
+  if (!lines_.empty())
+    callback->WriteLines(lines_.data(), lines_.size());
 }
 
 void NamedEntry::SetName(const std::string& name) {
-  if (!lines_.empty())
-    ReplaceEntryName(&lines_[0], name);
+  size_t pos, length;
+  if (!lines_.empty() && FindEntryName(lines_[0].text(), &pos, &length))
+    lines_[0].Replace(pos, length, name);
   name_ = name;
 }
 
 void NamedEntry::AppendLine(const char* line, const char* eol) {
   LgEntry::AppendLine(line, eol);
   if (lines_.size() == 1)
-    ParseEntryName(lines_.back(), &name_);
+    ParseEntryName(lines_.back().text(), &name_);
 }
 
 void BankList::AppendLine(const char* line, const char* eol) {
   NamedEntry::AppendLine(line, eol);
   if (lines_.size() > 1) {
-    std::string& str = lines_.back();
-    // Remove the trailing '\n' temporarily.  We'll put it back in WriteLines.
-    str.erase(str.end() - 1);
-    if (str.empty() || IsComment(str.c_str())) {
+    const Line& l = lines_.back();
+    if (l.empty() || IsComment(l.data()))
       lines_.pop_back();
-    }
   }
 }
 
 void BankList::WriteLines(LgParserCallback* callback) {
+  NamedEntry::WriteLines(callback);
   if (!lines_.empty()) {
-    std::vector<std::string>::iterator it = lines_.begin();
-    ++it;
-    for (; it != lines_.end(); ++it)
-      (*it) += '\n';
-    lines_.push_back(";-----------------------------------------\n");
+    const char separator[] = ";-----------------------------------------";
+    callback->WriteLine(separator, arraysize(separator) - 1);
   }
-  NamedEntry::WriteLines(callback);
 }
 
 void BankList::AppendBank(const std::string& bank_name) {
-  lines_.push_back(bank_name);
+  lines_.push_back(Line(bank_name));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -81,7 +69,7 @@ void BankList::AppendBank(const std::string& bank_name) {
 void Bank::AppendLine(const char* line, const char* eol) {
   NamedEntry::AppendLine(line, eol);
   if (lines_.size() > 1 && default_preset_.empty()) {
-    if (IsDefaultPreset(lines_.back(), &default_preset_)) {
+    if (IsDefaultPreset(lines_.back().text(), &default_preset_)) {
       lines_.pop_back();
     }
   }
@@ -91,30 +79,20 @@ void Bank::WriteLines(LgParserCallback* callback) {
   if (lines_.empty())
     return;
 
-  std::vector<std::string>::const_iterator it = lines_.begin();
-  callback->WriteLine(*it);
-  ++it;
+  callback->WriteLines(lines_.data(), 1);
 
-  if (!inherited_from_name_.empty()) {
-    std::string line("DERIVED FROM ");
-    line += inherited_from_name_;
-    line += '\n';
-    callback->WriteLine(line);
-  }
+  if (!inherited_from_name_.empty())
+    callback->WriteLine("DERIVED FROM " + inherited_from_name_);
 
-  if (!default_preset_.empty()) {
-    std::string line("DEFAULTPRESET ");
-    line += default_preset_;
-    line += '\n';
-    callback->WriteLine(line);
-  }
+  if (!default_preset_.empty())
+    callback->WriteLine("DEFAULTPRESET " + default_preset_);
 
-  for (; it != lines_.end(); ++it)
-    callback->WriteLine(*it);
+  callback->WriteLines(lines_.data() + 1, lines_.size() - 1);
 
-  if (!IsComment(lines_.back().c_str())) {
+  const Line& last = lines_.back();
+  if (last.empty() || !IsComment(last.data())) {
     const char separator[] =
-        ";---------------------------------------------------------------\n";
+        ";---------------------------------------------------------------";
     callback->WriteLine(separator, arraysize(separator) - 1);
   }
 }
@@ -133,9 +111,13 @@ void Bank::OnPatchNameChange(const std::string& old_name,
     default_preset_ = new_name;
 
   Lines::iterator it = lines_.begin() + 1;
-  const char* reg_exp = "switch \\d+\\s+\\:\\s+PA\\s+([\\w ]+)\n";
-  for (; it != lines_.end(); ++it)
-    ReplaceIfMatch(&(*it), reg_exp, old_name.c_str(), new_name.c_str());
+  size_t pos, length;
+  for (; it != lines_.end(); ++it) {
+    if (FindSwitchPatchName(it->text(), &pos, &length) &&
+        it->text().substr(pos, length) == old_name) {
+      it->Replace(pos, length, new_name);
+    }
+  }
 }
 
 std::vector<std::string> Bank::GetPatchNames() const {
@@ -144,11 +126,10 @@ std::vector<std::string> Bank::GetPatchNames() const {
     return ret;
 
   Lines::const_iterator it = lines_.begin() + 1;
-  const char* reg_exp = "switch \\d+\\s+\\:\\s+PA\\s+([\\w ]+)\n";
-  std::string str;
+  size_t pos, length;
   for (; it != lines_.end(); ++it) {
-    if (ExtractSubstring(*it, reg_exp, &str))
-      ret.push_back(str);
+    if (FindSwitchPatchName(it->text(), &pos, &length))
+      ret.push_back(it->text().substr(pos, length).as_string());
   }
 
   return ret;
@@ -163,10 +144,9 @@ void Bank::RemoveNonPatchEntries() {
     return;
 
   Lines::iterator it = lines_.begin() + 1;
-  regex rx("switch \\d+\\s+\\:\\s+PA\\s+([\\w ]+)\n");
+  size_t pos, length;
   for (; it != lines_.end(); ++it) {
-    match_results<std::string::const_iterator> match;
-    if (!regex_match(*it, match, rx))
+    if (!FindSwitchPatchName(it->text(), &pos, &length))
       it = lines_.erase(it) - 1;
   }
 }
@@ -180,7 +160,7 @@ int Patch::preset() const {
 
 void Patch::AppendLine(const char* line, const char* eol) {
   NamedEntry::AppendLine(line, eol);
-  const std::string& str = lines_.back();
+  const base::StringPiece& str = lines_.back().text();
 
   if (lines_.size() > 1) {
     // TODO(tommi): Right now we are not _really_ aware of different midi
@@ -202,9 +182,7 @@ void Patch::SetName(const std::string& name) {
     bank_->OnPatchNameChange(name_, name);
 
   if (lines_.empty()) {
-    std::string str(kPatchStart);
-    str += ": " + name + "\n";
-    lines_.push_back(str);
+    lines_.push_back(Line(kPatchStart + (": " + name)));
     name_ = name;
   } else {
     NamedEntry::SetName(name);
@@ -220,9 +198,7 @@ void Patch::Update(const axefx::Preset& p) {
     bank_->OnPatchNameChange(name_, name);
 
   if (lines_.empty()) {
-    std::string str(kPatchStart);
-    str += ": " + name + "\n";
-    lines_.push_back(str);
+    lines_.push_back(Line(kPatchStart + (": " + name)));
     name_ = name;
     SetPreset(p.id());
   } else {
@@ -238,31 +214,31 @@ void Patch::SetPreset(int preset_number) {
   bank_id_ = preset_number >> 7;
 
   std::ostringstream stream;
-  // Same as "+ %02i CC    000 %03i\n".
+  // Same as "+ %02i CC    000 %03i".
   stream << "+ " << std::setfill('0') << std::setw(2) << channel_
-      << " CC    000 " << std::setw(3) << bank_id_ << std::endl;
+      << " CC    000 " << std::setw(3) << bank_id_;
 
   if (cc_index_ == -1) {
     cc_index_ = static_cast<int>(lines_.size());
     if (pc_index_ == -1) {
-      lines_.push_back(stream.str());
+      lines_.push_back(Line(stream.str()));
     } else {
-      lines_.insert(lines_.begin() + pc_index_, stream.str());
+      lines_.insert(lines_.begin() + pc_index_, Line(stream.str()));
     }
   } else {
-    lines_[cc_index_] = stream.str();
+    lines_[cc_index_] = Line(stream.str());
   }
 
-  stream.clear();
-  // Same as "+ %02i PC    %03i\n".
+  stream.str(std::string());
+  // Same as "+ %02i PC    %03i".
   stream << "+ " << std::setfill('0') << std::setw(2) << channel_
-         << " PC    " << std::setw(3) << preset_ << std::endl;
+         << " PC    " << std::setw(3) << preset_;
 
   if (pc_index_ == -1) {
     pc_index_ = static_cast<int>(lines_.size());
-    lines_.push_back(stream.str());
+    lines_.push_back(Line(stream.str()));
   } else {
-    lines_[pc_index_] = stream.str();
+    lines_[pc_index_] = Line(stream.str());
   }
 }
 
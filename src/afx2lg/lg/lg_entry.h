@@ -8,6 +8,7 @@
 
 #include "common/common_types.h"
 #include "axefx/preset.h"
+#include "lg/lg_line.h"
 
 #include <vector>
 
@@ -15,9 +16,13 @@ namespace lg {
 
 class LgParserCallback;
 
+// Entries keep the lines they were read from and rewrite only the lines that
+// change.  Lines refer to the buffer given to LgParser::ParseBuffer, and
+// copying an entry, as is done when a patch or bank is used as a template,
+// shares the text of the lines with the original.
 class LgEntry {
  public:
-  typedef std::vector<std::string> Lines;
+  typedef std::vector<Line> Lines;
 
   LgEntry() {}
   virtual ~LgEntry() {}
@@ -0,0 +1,186 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/common_types.h"
+
+#include "lg/lg_hashes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+
+namespace lg {
+
+namespace {
+const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+const uint64_t kFnvPrime = 0x100000001b3ULL;
+const char kHashFileHeader[] = "afx2lg-hashes 1";
+
+uint64_t HashBytes(uint64_t hash, const char* data, size_t size) {
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= kFnvPrime;
+  }
+  return hash;
+}
+
+// Folds |hash| into |combined| so that the order of the entries matters.
+uint64_t CombineHashes(uint64_t combined, uint64_t hash) {
+  for (int i = 0; i < 8; ++i) {
+    combined ^= (hash >> (i * 8)) & 0xff;
+    combined *= kFnvPrime;
+  }
+  return combined;
+}
+
+char TypeCode(SetupHashes::EntryType type) {
+  switch (type) {
+    case SetupHashes::PATCH: return 'P';
+    case SetupHashes::BANK: return 'B';
+    case SetupHashes::OTHER: return 'O';
+  }
+  ASSERT(false);
+  return '?';
+}
+
+std::string FormatHash(uint64_t hash) {
+  char buffer[17];
+  snprintf(buffer, sizeof(buffer), "%016llx",
+           static_cast<unsigned long long>(hash));
+  return buffer;
+}
+}  // namespace
+
+LineHasher::LineHasher() : hash_(kFnvOffsetBasis) {}
+
+LineHasher::~LineHasher() {}
+
+const axefx::PresetMap& LineHasher::GetPresetMap() {
+  return presets_;
+}
+
+void LineHasher::WriteLine(const char* line, size_t length) {
+  hash_ = HashBytes(hash_, line, length);
+  hash_ = HashBytes(hash_, "\n", 1);
+}
+
+void LineHasher::Reset() {
+  hash_ = kFnvOffsetBasis;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+SetupHashes::SetupHashes() : other_(kFnvOffsetBasis), has_other_(false) {}
+
+SetupHashes::~SetupHashes() {}
+
+void SetupHashes::Add(EntryType type, const std::string& name,
+                      uint64_t hash) {
+  if (type == OTHER) {
+    other_ = has_other_ ? CombineHashes(other_, hash) : hash;
+    has_other_ = true;
+    return;
+  }
+
+  HashMap& map = type == PATCH ? patches_ : banks_;
+  std::pair<HashMap::iterator, bool> inserted =
+      map.insert(std::make_pair(name, hash));
+  if (!inserted.second)
+    inserted.first->second = CombineHashes(inserted.first->second, hash);
+}
+
+bool SetupHashes::Load(const std::string& path) {
+  std::ifstream file(path);
+  std::string line;
+  if (!file.is_open() || !std::getline(file, line) ||
+      line != kHashFileHeader) {
+    return false;
+  }
+
+  patches_.clear();
+  banks_.clear();
+  has_other_ = false;
+  while (std::getline(file, line)) {
+    // "<type> <16 hex digits>[ <name>]"
+    if (line.size() < 18 || line[1] != ' ' ||
+        (line.size() > 18 && line[18] != ' ')) {
+      std::cerr << "Malformed line in " << path << ": " << line << "\n";
+      return false;
+    }
+    uint64_t hash = strtoull(line.substr(2, 16).c_str(), NULL, 16);
+    std::string name(line.size() > 18 ? line.substr(19) : std::string());
+    switch (line[0]) {
+      case 'P': patches_[name] = hash; break;
+      case 'B': banks_[name] = hash; break;
+      case 'O': other_ = hash; has_other_ = true; break;
+      default:
+        std::cerr << "Malformed line in " << path << ": " << line << "\n";
+        return false;
+    }
+  }
+
+  return true;
+}
+
+bool SetupHashes::Save(const std::string& path) const {
+  std::ofstream file(path, std::ios::out | std::ios::trunc);
+  if (!file.is_open())
+    return false;
+
+  file << kHashFileHeader << "\n";
+  if (has_other_)
+    file << TypeCode(OTHER) << ' ' << FormatHash(other_) << "\n";
+  for (HashMap::const_iterator it = patches_.begin(); it != patches_.end();
+       ++it) {
+    file << TypeCode(PATCH) << ' ' << FormatHash(it->second) << ' '
+         << it->first << "\n";
+  }
+  for (HashMap::const_iterator it = banks_.begin(); it != banks_.end();
+       ++it) {
+    file << TypeCode(BANK) << ' ' << FormatHash(it->second) << ' '
+         << it->first << "\n";
+  }
+
+  file.close();
+  return !file.fail();
+}
+
+SetupHashes::Changes SetupHashes::CompareTo(
+    const SetupHashes& previous) const {
+  Changes changes;
+  Compare(PATCH, patches_, previous.patches_, &changes);
+  Compare(BANK, banks_, previous.banks_, &changes);
+  if (has_other_ != previous.has_other_ ||
+      (has_other_ && other_ != previous.other_)) {
+    changes.push_back(Change(
+        !previous.has_other_ ? Change::ADDED :
+            !has_other_ ? Change::REMOVED : Change::CHANGED,
+        OTHER, std::string()));
+  }
+  return changes;
+}
+
+// static
+void SetupHashes::Compare(EntryType type, const HashMap& current,
+                          const HashMap& previous, Changes* changes) {
+  // Both maps are sorted, so walk them side by side.
+  HashMap::const_iterator c = current.begin(), p = previous.begin();
+  while (c != current.end() || p != previous.end()) {
+    if (p == previous.end() || (c != current.end() && c->first < p->first)) {
+      changes->push_back(Change(Change::ADDED, type, c->first));
+      ++c;
+    } else if (c == current.end() || p->first < c->first) {
+      changes->push_back(Change(Change::REMOVED, type, p->first));
+      ++p;
+    } else {
+      if (c->second != p->second)
+        changes->push_back(Change(Change::CHANGED, type, c->first));
+      ++c;
+      ++p;
+    }
+  }
+}
+
+}  // namespace lg
@@ -0,0 +1,105 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef LG_HASHES_H_
+#define LG_HASHES_H_
+
+#include "common/common_types.h"
+#include "lg/lg_parser.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace lg {
+
+// Hashes the lines it's given with 64 bit FNV-1a, which unlike std::hash
+// gives the same result in every run and on every platform.
+class LineHasher : public LgParserCallback {
+ public:
+  LineHasher();
+  virtual ~LineHasher();
+
+  virtual const axefx::PresetMap& GetPresetMap();
+  virtual void WriteLine(const char* line, size_t length);
+
+  uint64_t hash() const { return hash_; }
+  void Reset();
+
+ private:
+  uint64_t hash_;
+  axefx::PresetMap presets_;
+
+  DISALLOW_COPY_AND_ASSIGN(LineHasher);
+};
+
+// The content hashes of the patches and banks of a generated setup file,
+// keyed by name, plus one hash for all other entries.  Comparing the hashes
+// of two runs gives the entries that have to be imported again.
+// Stored next to the setup file as text, one entry per line:
+//   afx2lg-hashes 1
+//   O <hash>
+//   P <hash> <patch name>
+//   B <hash> <bank name>
+class SetupHashes {
+ public:
+  enum EntryType {
+    PATCH,
+    BANK,
+    // Everything that isn't a patch or a bank.
+    OTHER,
+  };
+
+  struct Change {
+    enum Kind {
+      ADDED,
+      CHANGED,
+      REMOVED,
+    };
+
+    Change(Kind kind, EntryType type, const std::string& name)
+        : kind(kind), type(type), name(name) {}
+
+    Kind kind;
+    EntryType type;
+    std::string name;
+  };
+
+  typedef std::vector<Change> Changes;
+
+  SetupHashes();
+  ~SetupHashes();
+
+  bool empty() const {
+    return patches_.empty() && banks_.empty() && !has_other_;
+  }
+
+  // Entries that share a name are combined.
+  void Add(EntryType type, const std::string& name, uint64_t hash);
+
+  // Returns false if the file doesn't exist or isn't a hash file.
+  bool Load(const std::string& path);
+  bool Save(const std::string& path) const;
+
+  // What has changed since |previous|, sorted by type and name.
+  Changes CompareTo(const SetupHashes& previous) const;
+
+ private:
+  typedef std::map<std::string, uint64_t> HashMap;
+
+  static void Compare(EntryType type, const HashMap& current,
+                      const HashMap& previous, Changes* changes);
+
+  HashMap patches_;
+  HashMap banks_;
+  uint64_t other_;
+  bool has_other_;
+
+  DISALLOW_COPY_AND_ASSIGN(SetupHashes);
+};
+
+}  // namespace lg
+
+#endif  // LG_HASHES_H_
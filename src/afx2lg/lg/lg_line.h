@@ -0,0 +1,56 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef LG_LINE_H_
+#define LG_LINE_H_
+
+#include "common/common_types.h"
+#include "common/string_piece.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace lg {
+
+// A line of a setup file, without the line terminator.  Lines that are read
+// from a file refer to the buffer that's being parsed, so only lines that get
+// rewritten have text of their own.  That text is never modified once it's
+// been created and copies of a line share it, so copying a line (or an entry
+// made of lines) never copies text.
+class Line {
+ public:
+  Line() {}
+  // Refers to [begin, end) of a buffer that has to outlive the line.
+  Line(const char* begin, const char* end) : text_(begin, end - begin) {}
+  // Owns |text|.
+  explicit Line(std::string text)
+      : owned_(std::make_shared<const std::string>(std::move(text))),
+        text_(*owned_) {}
+
+  const base::StringPiece& text() const { return text_; }
+  const char* data() const { return text_.data(); }
+  size_t size() const { return text_.size(); }
+  bool empty() const { return text_.empty(); }
+  bool owns_text() const { return owned_.get() != NULL; }
+
+  // Replaces |length| characters at |pos| with |str|.
+  void Replace(size_t pos, size_t length, const base::StringPiece& str) {
+    std::string text;
+    text.reserve(text_.size() - length + str.size());
+    text.append(text_.data(), pos);
+    text.append(str.data(), str.size());
+    text.append(text_.data() + pos + length, text_.size() - pos - length);
+    *this = Line(std::move(text));
+  }
+
+ private:
+  shared_ptr<const std::string> owned_;
+  base::StringPiece text_;
+};
+
+}  // namespace lg
+
+#endif  // LG_LINE_H_
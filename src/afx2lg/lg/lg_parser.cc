@@ -3,12 +3,14 @@
 
 #include "common/common_types.h"
 
+#include "common/trace.h"
+#include "lg/lg_hashes.h"
 #include "lg/lg_parser.h"
 #include "lg/lg_utils.h"
 
-#include <algorithm>
 #include <iostream>
 #include <string>
+#include <unordered_set>
 
 // TODO: Use MIDICHANNEL variables to get a hint for what channel to assume?
 // TODO: Use DEFAULT_BANKLIST to choose a banklist to add banks to.
@@ -27,6 +29,7 @@ LgParser::~LgParser() {
 bool LgParser::ParseBuffer(LgParserCallback* callback,
                            const char* begin,
                            const char* end) {
+  TRACE_EVENT1("lg", "LgParser::ParseBuffer", "bytes", end - begin);
   const char* pos = begin;
   while (pos < end) {
     const char* bol = pos;
@@ -44,8 +47,7 @@ bool LgParser::ParseBuffer(LgParserCallback* callback,
     return false;
   }
 
-  // Begin quick-n-dirty O(n^2) algos. :-|
-
+  IndexPatches();
   ConnectBanksToBankLists();
   ConnectPatchesToBanks();
 
@@ -64,13 +66,16 @@ bool LgParser::ParseBuffer(LgParserCallback* callback,
       template_patch_names.begin();
 
   shared_ptr<Bank> new_bank;
-  Entries::iterator patch_insert_point = GetPatchInsertPoint();
-  // Keep track of how many banks we have now, before we start creating banks,
-  // so we'll know how many to add to the entry list.
-  size_t bank_size = banks_.size();
-  size_t bank_id = bank_size;
-
-  ReservedNames taken_names;
+  // New patches go after the last patch of the setup file and new banks
+  // after the last bank.
+  shared_ptr<LgEntry> last_patch(patches_.back());
+  shared_ptr<LgEntry> last_bank(
+      banks_.empty() ? shared_ptr<LgEntry>() : banks_.back());
+  Patches new_patches;
+  Banks new_banks;
+  size_t bank_id = banks_.size();
+
+  UniqueNameAllocator names;
   const axefx::PresetMap& presets = callback->GetPresetMap();
   axefx::PresetMap::const_iterator it = presets.begin();
   for (; it != presets.end(); ++it) {
@@ -91,6 +96,7 @@ bool LgParser::ParseBuffer(LgParserCallback* callback,
         new_bank->SetName(bank);
         new_bank->bank_list()->AppendBank(new_bank->name());
         banks_.push_back(new_bank);
+        new_banks.push_back(new_bank);
       }
 
       p->SetBank(new_bank);
@@ -101,22 +107,19 @@ bool LgParser::ParseBuffer(LgParserCallback* callback,
         new_bank.reset();
       }
 
-      if (taken_names.find(p->name()) != taken_names.end())
-        p->SetName(GenerateUniqueName(taken_names, p->name()));
-      taken_names.insert(p->name());
+      std::string name(names.Allocate(p->name()));
+      if (name != p->name())
+        p->SetName(name);
 
       patches_.push_back(p);
-      patch_insert_point = entries_.insert(patch_insert_point, p) + 1;
+      patches_by_preset_.insert(std::make_pair(p->preset(), p));
+      new_patches.push_back(p);
     }
   }
 
-  if (banks_.size() > bank_size) {
-    Entries::iterator pos = std::find(entries_.begin(), entries_.end(),
-                                      banks_[bank_size - 1]);
-    ++pos;
-    entries_.insert(pos, banks_.begin() + bank_size, banks_.end());
-  }
+  InsertEntries(last_patch, new_patches, last_bank, new_banks);
 
+  TRACE_EVENT0("lg", "LgParser::WriteLines");
   for (Entries::const_iterator it = entries_.begin();
        it != entries_.end(); ++it) {
     (*it)->WriteLines(callback);
@@ -125,20 +128,63 @@ bool LgParser::ParseBuffer(LgParserCallback* callback,
   return true;
 }
 
+void LgParser::ComputeHashes(SetupHashes* hashes) const {
+  TRACE_EVENT0("lg", "LgParser::ComputeHashes");
+  LineHasher hasher;
+  std::unordered_set<const LgEntry*> named;
+  for (Patches::const_iterator it = patches_.begin(); it != patches_.end();
+       ++it) {
+    hasher.Reset();
+    (*it)->WriteLines(&hasher);
+    hashes->Add(SetupHashes::PATCH, (*it)->name(), hasher.hash());
+    named.insert(it->get());
+  }
+
+  for (Banks::const_iterator it = banks_.begin(); it != banks_.end(); ++it) {
+    hasher.Reset();
+    (*it)->WriteLines(&hasher);
+    hashes->Add(SetupHashes::BANK, (*it)->name(), hasher.hash());
+    named.insert(it->get());
+  }
+
+  hasher.Reset();
+  for (Entries::const_iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    if (named.find(it->get()) == named.end())
+      (*it)->WriteLines(&hasher);
+  }
+  hashes->Add(SetupHashes::OTHER, std::string(), hasher.hash());
+}
+
+void LgParser::IndexPatches() {
+  patches_by_name_.clear();
+  patches_by_preset_.clear();
+  for (Patches::const_iterator it = patches_.begin(); it != patches_.end();
+       ++it) {
+    patches_by_name_.insert(std::make_pair((*it)->name(), *it));
+    patches_by_preset_.insert(std::make_pair((*it)->preset(), *it));
+  }
+}
+
 void LgParser::ConnectBanksToBankLists() {
+  // Bank name -> the list that contains it.  If a bank is in more than one
+  // list, the last one wins.
+  std::unordered_map<std::string, shared_ptr<BankList> > lists_by_bank;
   BankLists::const_iterator bl = bank_lists_.begin();
   for (; bl!= bank_lists_.end(); ++bl) {
     const LgEntry::Lines& lines = (*bl)->lines();
     if (lines.size() > 1) {
       LgEntry::Lines::const_iterator l = lines.begin() + 1;
-      for (; l != lines.end(); ++l) {
-        for (Banks::iterator b = banks_.begin(); b != banks_.end(); ++b) {
-          if ((*b)->name() == *l)
-            (*b)->SetBankList(*bl);
-        }
-      }
+      for (; l != lines.end(); ++l)
+        lists_by_bank[l->text().as_string()] = *bl;
     }
   }
+
+  for (Banks::iterator b = banks_.begin(); b != banks_.end(); ++b) {
+    auto found = lists_by_bank.find((*b)->name());
+    if (found != lists_by_bank.end())
+      (*b)->SetBankList(found->second);
+  }
 }
 
 void LgParser::ConnectPatchesToBanks() {
@@ -155,37 +201,48 @@ void LgParser::ConnectPatchesToBanks() {
 
 LgParser::Patches::value_type LgParser::LookupPatch(
     const std::string& name) {
-  // If this turns out to be a perf problem we could build hash maps of
-  // name->patch.
-  Patches::const_iterator it = patches_.begin();
-  for (; it != patches_.end(); ++it) {
-    if ((*it)->name() == name)
-      return *it;
-  }
-
-  return LgParser::Patches::value_type();
+  auto found = patches_by_name_.find(name);
+  return found != patches_by_name_.end() ? found->second
+                                         : LgParser::Patches::value_type();
 }
 
 LgParser::Patches::value_type LgParser::LookupPatch(int preset_id) {
-  // If this turns out to be a perf problem we could build hash maps of
-  // id->patch.
-  Patches::const_iterator it = patches_.begin();
-  for (; it != patches_.end(); ++it) {
-    if ((*it)->preset() == preset_id)
-      return *it;
+  auto found = patches_by_preset_.find(preset_id);
+  return found != patches_by_preset_.end() ? found->second
+                                           : LgParser::Patches::value_type();
+}
+
+void LgParser::InsertEntries(const shared_ptr<LgEntry>& last_patch,
+                             const Patches& new_patches,
+                             const shared_ptr<LgEntry>& last_bank,
+                             const Banks& new_banks) {
+  if (new_patches.empty() && new_banks.empty())
+    return;
+
+  // Rebuild the list in one pass rather than inserting into the middle of
+  // it, which would move everything that follows.
+  Entries entries;
+  entries.reserve(entries_.size() + new_patches.size() + new_banks.size());
+  bool patches_added = false, banks_added = false;
+  for (Entries::const_iterator it = entries_.begin(); it != entries_.end();
+       ++it) {
+    entries.push_back(*it);
+    if (!patches_added && *it == last_patch) {
+      entries.insert(entries.end(), new_patches.begin(), new_patches.end());
+      patches_added = true;
+    }
+    if (!banks_added && *it == last_bank) {
+      entries.insert(entries.end(), new_banks.begin(), new_banks.end());
+      banks_added = true;
+    }
   }
 
-  return LgParser::Patches::value_type();
-}
+  if (!patches_added)
+    entries.insert(entries.end(), new_patches.begin(), new_patches.end());
+  if (!banks_added)
+    entries.insert(entries.end(), new_banks.begin(), new_banks.end());
 
-LgParser::Entries::iterator LgParser::GetPatchInsertPoint() {
-  if (patches_.empty())
-    return entries_.end();
-  Entries::iterator ret = std::find(entries_.begin(), entries_.end(),
-                                    patches_.back());
-  if (ret != entries_.end())
-    ++ret;
-  return ret;
+  entries_.swap(entries);
 }
 
 shared_ptr<LgEntry> LgParser::CreateEntry(const char* line) {
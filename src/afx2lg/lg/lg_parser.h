@@ -10,12 +10,24 @@
 #include "axefx/preset.h"
 #include "lg/lg_entry.h"
 
+#include <unordered_map>
+
 namespace lg {
 
+class SetupHashes;
+
 class LgParserCallback {
  public:
   virtual const axefx::PresetMap& GetPresetMap() = 0;
+  // Called for each line of the generated setup file.  |line| doesn't include
+  // the line terminator.
   virtual void WriteLine(const char* line, size_t length) = 0;
+  // Called with runs of consecutive lines that entries write unchanged or
+  // have rewritten.  By default each line is passed to WriteLine().
+  virtual void WriteLines(const Line* lines, size_t count) {
+    for (size_t i = 0; i < count; ++i)
+      WriteLine(lines[i].data(), lines[i].size());
+  }
 
   void WriteLine(const std::string& line) {
     WriteLine(line.c_str(), line.length());
@@ -27,9 +39,16 @@ class LgParser {
   LgParser();
   ~LgParser();
 
+  // The parsed entries refer to [begin, end), so the buffer must not be
+  // freed or modified while the parser is in use.
   bool ParseBuffer(LgParserCallback* callback, const char* begin,
       const char* end);
 
+  // Hashes every patch and bank of the setup that ParseBuffer() generated,
+  // as well as the rest of the entries, so that the next run can tell which
+  // of them have changed.
+  void ComputeHashes(SetupHashes* hashes) const;
+
  protected:
   typedef std::vector<shared_ptr<LgEntry> > Entries;
   typedef std::vector<shared_ptr<Patch> > Patches;
@@ -38,11 +57,17 @@ class LgParser {
 
   void ProcessLine(const char* line, const char* end);
   shared_ptr<LgEntry> CreateEntry(const char* line);
+  void IndexPatches();
   void ConnectBanksToBankLists();
   void ConnectPatchesToBanks();
   Patches::value_type LookupPatch(const std::string& name);
   Patches::value_type LookupPatch(int preset_id);
-  Entries::iterator GetPatchInsertPoint();
+  // Inserts |new_patches| after |last_patch| and |new_banks| after
+  // |last_bank| in the entry list.  Entries that aren't found are appended.
+  void InsertEntries(const shared_ptr<LgEntry>& last_patch,
+                     const Patches& new_patches,
+                     const shared_ptr<LgEntry>& last_bank,
+                     const Banks& new_banks);
 
  private:
   Entries entries_;
@@ -51,6 +76,11 @@ class LgParser {
   Patches patches_;
   Banks banks_;
   BankLists bank_lists_;
+
+  // Built by IndexPatches() once the setup file has been read.  When names
+  // or presets appear more than once, the first patch wins.
+  std::unordered_map<std::string, shared_ptr<Patch> > patches_by_name_;
+  std::unordered_map<int, shared_ptr<Patch> > patches_by_preset_;
 };
 
 }  // namespace lg
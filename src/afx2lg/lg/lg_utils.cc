@@ -4,12 +4,8 @@
 #include "common/common_types.h"
 #include "lg/lg_utils.h"
 
+#include <algorithm>
 #include <locale>
-#include <regex>
-
-using std::match_results;
-using std::regex;
-using std::regex_match;
 
 namespace lg {
 
@@ -21,21 +17,60 @@ const char kPatchStart[] = "* PATCH ";
 static const char kBankStart[] = "* BANK ";
 static const char kBankListStart[] = "* BANKLIST ";
 
+namespace {
+
+// Writes |name| with |suffix| appended to |candidate|.  When the result
+// would be too long, as many characters as the suffix has are dropped from
+// the end of the name.
+void BuildCandidate(const std::string& name, size_t suffix,
+                    std::string* candidate) {
+  char digits[20];
+  size_t count = 0;
+  do {
+    digits[count++] = static_cast<char>('0' + suffix % 10);
+    suffix /= 10;
+  } while (suffix);
+
+  size_t keep = name.size();
+  if (keep + count > kMaxNameLength)
+    keep -= std::min(count, keep);
+  candidate->assign(name, 0, keep);
+  while (count)
+    candidate->push_back(digits[--count]);
+}
+
+}  // namespace
+
+UniqueNameAllocator::UniqueNameAllocator() {}
+
+UniqueNameAllocator::~UniqueNameAllocator() {}
+
+std::string UniqueNameAllocator::Allocate(const std::string& name) {
+  if (taken_.insert(name).second)
+    return name;
+
+  // Names are never released, so every suffix below the stored one is
+  // still taken.
+  size_t& next = next_suffix_[name];
+  if (!next)
+    next = 1;
+  while (true) {
+    BuildCandidate(name, next++, &candidate_);
+    if (taken_.insert(candidate_).second)
+      break;
+  }
+
+  ASSERT(candidate_.length() <= kMaxNameLength);
+  return candidate_;
+}
+
 std::string GenerateUniqueName(const ReservedNames& taken_names,
                                const std::string& original_name) {
   ASSERT(taken_names.find(original_name) != taken_names.end());
   std::string new_name;
   size_t counter = 0u;
   do {
-    new_name = original_name + std::to_string(++counter);
-    if (new_name.length() > kMaxNameLength) {
-      size_t chars = 0, temp_count = counter;
-      while (temp_count) {
-        ++chars;
-        temp_count /= 10;
-      }
-      new_name.erase(new_name.length() - (chars * 2), chars);
-    }
+    BuildCandidate(original_name, ++counter, &new_name);
   } while (taken_names.find(new_name) != taken_names.end());
 
   ASSERT(new_name.length() <= kMaxNameLength);
@@ -47,17 +82,18 @@ void CheckNameSizeLimit(std::string* name) {
   if (name->size() <= kMaxNameLength)
     return;
 
-  // Start by converting to CamelCapsNaming.
-  std::string::iterator it = name->begin();
-  for (; it != name->end(); ++it) {
+  // Start by converting to CamelCapsNaming, in place and in one pass.
+  std::string::iterator out = name->begin();
+  bool capitalize = false;
+  for (std::string::iterator it = name->begin(); it != name->end(); ++it) {
     if (isspace(*it)) {
-      std::string::iterator next = it + 1;
-      if (next != name->end()) {
-        *next = toupper(*next, std::locale::classic());
-      }
-      it = name->erase(it) - 1;
+      capitalize = true;
+    } else {
+      *out++ = capitalize ? toupper(*it, std::locale::classic()) : *it;
+      capitalize = false;
     }
   }
+  name->erase(out, name->end());
   
   if (name->size() <= kMaxNameLength)
     return;
@@ -95,79 +131,189 @@ bool FindEol(const char** ptr, const char* end) {
   return *ptr[0] == '\n';
 }
 
-bool ParseInts(const std::string& str, const char* reg_exp, int* ints[],
-               int size) {
-  if (str[0] != '+')
-    return false;
+namespace {
+
+// Matches the LG line grammar in a single pass over a line, one token at a
+// time.  The tokens mirror the regular expressions that used to describe the
+// lines: \s is any whitespace other than the end of line, \w is
+// [A-Za-z0-9_] and a name is [\w ]+.  Lines don't include their terminator
+// and everything up to the end of the line has to be matched.
+class LineScanner {
+ public:
+  explicit LineScanner(const base::StringPiece& line)
+      : begin_(line.data()), pos_(begin_), end_(begin_ + line.size()) {}
+
+  static bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+  }
 
-  regex rx(reg_exp);
-  match_results<std::string::const_iterator> match;
-  bool ret = regex_match(str, match, rx);
-  if (ret) {
-    for (int i = 0; i < size; ++i) {
-      if (ints[i])
-        *ints[i] = atoi(match.str(i + 1).c_str());
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  static bool IsWordChar(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           c == '_';
+  }
+
+  size_t offset() const { return pos_ - begin_; }
+
+  bool Literal(const char* str) {
+    const char* p = pos_;
+    for (; *str; ++str, ++p) {
+      if (p == end_ || *p != *str)
+        return false;
     }
+    pos_ = p;
+    return true;
+  }
+
+  // \s+
+  bool Whitespace() {
+    const char* p = pos_;
+    while (p < end_ && IsSpace(*p))
+      ++p;
+    return Advance(p);
   }
 
-  return ret;
+  // (\d+).  |value| may be NULL.
+  bool Number(int* value) {
+    const char* p = pos_;
+    int v = 0;
+    while (p < end_ && IsDigit(*p)) {
+      v = v * 10 + (*p - '0');
+      ++p;
+    }
+    if (!Advance(p))
+      return false;
+    if (value)
+      *value = v;
+    return true;
+  }
+
+  // \w+
+  bool Word() {
+    const char* p = pos_;
+    while (p < end_ && IsWordChar(*p))
+      ++p;
+    return Advance(p);
+  }
+
+  // ([\w ]+)$.  Since the preceding \s+ is greedy, the name starts with a
+  // word character.
+  bool NameToEnd(size_t* name_pos, size_t* name_length) {
+    const char* p = pos_;
+    while (p < end_ && (IsWordChar(*p) || *p == ' '))
+      ++p;
+    if (p == pos_ || !IsWordChar(*pos_) || p != end_)
+      return false;
+    *name_pos = offset();
+    *name_length = p - pos_;
+    pos_ = end_;
+    return true;
+  }
+
+  // .*$, where . is anything but a line terminator.
+  bool RestOfLine() {
+    const char* p = pos_;
+    while (p < end_ && *p != '\n' && *p != '\r')
+      ++p;
+    if (p != end_)
+      return false;
+    pos_ = end_;
+    return true;
+  }
+
+ private:
+  bool Advance(const char* p) {
+    if (p == pos_)
+      return false;
+    pos_ = p;
+    return true;
+  }
+
+  const char* const begin_;
+  const char* pos_;
+  const char* const end_;
+};
+
+// \+\s+(\d+)\s+<type>\s+(\d+)
+bool ScanMidiCommand(LineScanner* s, const char* type, int* channel,
+                     int* value) {
+  return s->Literal("+") && s->Whitespace() && s->Number(channel) &&
+         s->Whitespace() && s->Literal(type) && s->Whitespace() &&
+         s->Number(value);
 }
 
-bool ParseCC(const std::string& str, int* channel, int* cc, int* value) {
-  int* ints[] = { channel, cc, value };
-  return ParseInts(str, "\\+\\s+(\\d+)\\s+CC\\s+(\\d+)\\s+(\\d+).*\n", ints,
-                   arraysize(ints));
+}  // namespace
+
+bool ParseCC(const base::StringPiece& str, int* channel, int* cc, int* value) {
+  LineScanner s(str);
+  int ch, c, v;
+  if (!ScanMidiCommand(&s, "CC", &ch, &c) || !s.Whitespace() ||
+      !s.Number(&v) || !s.RestOfLine()) {
+    return false;
+  }
+  if (channel)
+    *channel = ch;
+  if (cc)
+    *cc = c;
+  if (value)
+    *value = v;
+  return true;
+}
+
+bool ParseProgramChange(const base::StringPiece& str, int* channel,
+                        int* preset) {
+  LineScanner s(str);
+  int ch, p;
+  if (!ScanMidiCommand(&s, "PC", &ch, &p) || !s.RestOfLine())
+    return false;
+  if (channel)
+    *channel = ch;
+  if (preset)
+    *preset = p;
+  return true;
 }
 
-bool ParseProgramChange(const std::string& str, int* channel, int* preset) {
-  int* ints[] = { channel, preset };
-  return ParseInts(str, "\\+\\s+(\\d+)\\s+PC\\s+(\\d+).*\n", ints,
-                   arraysize(ints));
+bool ParseEntryName(const base::StringPiece& str, std::string* name) {
+  size_t pos, length;
+  if (!FindEntryName(str, &pos, &length))
+    return false;
+  name->assign(str.data() + pos, length);
+  return true;
 }
 
-bool ParseEntryName(const std::string& str, std::string* name) {
-  regex rx("\\*\\s+(\\w+)\\s+:\\s+([\\w ]+)\n");
-  match_results<std::string::const_iterator> match;
-  bool ret = regex_match(str, match, rx);
-  if (ret)
-    *name = match.str(2);
-  return ret;
+// \*\s+\w+\s+:\s+([\w ]+)$
+bool FindEntryName(const base::StringPiece& str, size_t* pos, size_t* length) {
+  LineScanner s(str);
+  return s.Literal("*") && s.Whitespace() && s.Word() && s.Whitespace() &&
+         s.Literal(":") && s.Whitespace() && s.NameToEnd(pos, length);
 }
 
 bool ReplaceEntryName(std::string* str, const std::string& name) {
-  regex rx("\\*\\s+\\w+\\s+:\\s+([\\w ]+)\n");
-  match_results<std::string::const_iterator> match;
-  bool ret = regex_match(*str, match, rx);
-  if (ret)
-    str->replace(match.position(1), match.length(1), name);
-  return ret;
-}
-
-bool ReplaceIfMatch(std::string* str, const char* reg_exp, const char* find,
-                    const char* replace) {
-  regex rx(reg_exp);
-  match_results<std::string::const_iterator> match;
-  bool ret = regex_match(*str, match, rx);
-  if (ret) {
-    ret = (match.str(1).compare(find) == 0);
-    if (ret)
-      str->replace(match.position(1), match.length(1), replace);
-  }
-  return ret;
+  size_t pos, length;
+  if (!FindEntryName(*str, &pos, &length))
+    return false;
+  str->replace(pos, length, name);
+  return true;
 }
 
-bool ExtractSubstring(const std::string& search, const char* reg_exp,
-                      std::string* found) {
-  regex rx(reg_exp);
-  match_results<std::string::const_iterator> match;
-  bool ret = regex_match(search, match, rx);
-  if (ret)
-    *found = match.str(1);
-  return ret;
+bool FindSwitchPatchName(const base::StringPiece& str, size_t* pos,
+                         size_t* length) {
+  LineScanner s(str);
+  return s.Literal("switch ") && s.Number(NULL) && s.Whitespace() &&
+         s.Literal(":") && s.Whitespace() && s.Literal("PA") &&
+         s.Whitespace() && s.NameToEnd(pos, length);
 }
 
-bool IsDefaultPreset(const std::string& str, std::string* name) {
-  const char regex[] = "DEFAULTPRESET\\s+([\\w ]+)\n";
-  return ExtractSubstring(str, regex, name);
+bool IsDefaultPreset(const base::StringPiece& str, std::string* name) {
+  LineScanner s(str);
+  size_t pos, length;
+  if (!s.Literal("DEFAULTPRESET") || !s.Whitespace() ||
+      !s.NameToEnd(&pos, &length)) {
+    return false;
+  }
+  name->assign(str.data() + pos, length);
+  return true;
 }
+
 }  // namespace lg
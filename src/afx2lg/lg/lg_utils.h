@@ -6,7 +6,10 @@
 #ifndef LG_UTILS_H_
 #define LG_UTILS_H_
 
+#include "common/string_piece.h"
+
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace lg {
@@ -16,6 +19,29 @@ typedef std::unordered_set<std::string> ReservedNames;
 extern const char kPatchStart[];
 extern const size_t kMaxNameLength;
 
+// Hands out unique names.  A name that's taken gets the first free numeric
+// suffix, with the name shortened so that the result fits in
+// kMaxNameLength.  The next suffix to try is kept for each name, so assigning
+// the same name over and over doesn't probe every suffix that's already in
+// use each time.
+class UniqueNameAllocator {
+ public:
+  UniqueNameAllocator();
+  ~UniqueNameAllocator();
+
+  // Returns |name|, or a variation of it if it's taken, and marks the
+  // returned name as taken.
+  std::string Allocate(const std::string& name);
+
+ private:
+  ReservedNames taken_;
+  std::unordered_map<std::string, size_t> next_suffix_;
+  // Reused for the candidates so that probing doesn't allocate.
+  std::string candidate_;
+};
+
+// Like UniqueNameAllocator::Allocate() for a single name that's known to be
+// in |taken_names|.
 std::string GenerateUniqueName(const ReservedNames& taken_names,
                                const std::string& original_name);
 void CheckNameSizeLimit(std::string* name);
@@ -26,15 +52,18 @@ bool IsPatchStart(const char* line);
 bool IsBankStart(const char* line);
 bool IsBankListStart(const char* line);
 bool FindEol(const char** ptr, const char* end);
-bool ParseCC(const std::string& str, int* channel, int* cc, int* value);
-bool ParseProgramChange(const std::string& str, int* channel, int* preset);
-bool ParseEntryName(const std::string& str, std::string* name);
+// The matchers below take a single line without its line terminator.
+bool ParseCC(const base::StringPiece& str, int* channel, int* cc, int* value);
+bool ParseProgramChange(const base::StringPiece& str, int* channel,
+                        int* preset);
+bool ParseEntryName(const base::StringPiece& str, std::string* name);
+// Finds the name in an entry's "* <type> : <name>" line.
+bool FindEntryName(const base::StringPiece& str, size_t* pos, size_t* length);
 bool ReplaceEntryName(std::string* str, const std::string& name);
-bool ReplaceIfMatch(std::string* str, const char* reg_exp, const char* find,
-                    const char* replace);
-bool ExtractSubstring(const std::string& search, const char* reg_exp,
-                      std::string* found);
-bool IsDefaultPreset(const std::string& str, std::string* name);
+// Finds the patch name in a bank's "switch <n> : PA <name>" line.
+bool FindSwitchPatchName(const base::StringPiece& str, size_t* pos,
+                         size_t* length);
+bool IsDefaultPreset(const base::StringPiece& str, std::string* name);
 
 }  // namespace lg
 
@@ -0,0 +1,60 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "common/common_types.h"
+
+#include "common/trace.h"
+#include "lg/lg_writer.h"
+
+#include <string.h>
+
+namespace lg {
+
+BufferedLgWriter::BufferedLgWriter(size_t buffer_size)
+    : buffer_(new char[buffer_size]),
+      buffer_size_(buffer_size),
+      used_(0),
+      failed_(false) {
+  ASSERT(buffer_size > 0);
+}
+
+BufferedLgWriter::~BufferedLgWriter() {
+  // Flush() has to be called by the owner while Write() can still be called.
+  ASSERT(!used_);
+}
+
+void BufferedLgWriter::WriteLine(const char* line, size_t length) {
+  Append(line, length);
+}
+
+void BufferedLgWriter::WriteLines(const Line* lines, size_t count) {
+  for (size_t i = 0; i < count; ++i)
+    Append(lines[i].data(), lines[i].size());
+}
+
+bool BufferedLgWriter::Flush() {
+  if (used_) {
+    TRACE_EVENT1("io", "BufferedLgWriter::Flush", "bytes", used_);
+    if (!Write(buffer_.get(), used_))
+      failed_ = true;
+    used_ = 0;
+  }
+  return !failed_;
+}
+
+void BufferedLgWriter::Append(const char* line, size_t length) {
+  if (used_ + length + 1 > buffer_size_) {
+    Flush();
+    // Lines that don't fit in the buffer are written as they are.
+    if (length + 1 > buffer_size_) {
+      if (!Write(line, length))
+        failed_ = true;
+      length = 0;
+    }
+  }
+  memcpy(buffer_.get() + used_, line, length);
+  used_ += length;
+  buffer_[used_++] = '\n';
+}
+
+}  // namespace lg
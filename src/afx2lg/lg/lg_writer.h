@@ -0,0 +1,50 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+
+#ifndef LG_WRITER_H_
+#define LG_WRITER_H_
+
+#include "common/common_types.h"
+#include "lg/lg_parser.h"
+
+namespace lg {
+
+// An LgParserCallback that collects the generated lines in a large buffer
+// and hands them to Write() a buffer at a time, so that writing a setup file
+// takes a handful of writes rather than one per line.  Implementations
+// provide GetPresetMap() and Write(), and must call Flush() once the parser
+// is done, since the destructor can't call Write().
+class BufferedLgWriter : public LgParserCallback {
+ public:
+  static const size_t kDefaultBufferSize = 64 * 1024;
+
+  explicit BufferedLgWriter(size_t buffer_size = kDefaultBufferSize);
+  virtual ~BufferedLgWriter();
+
+  virtual void WriteLine(const char* line, size_t length);
+  virtual void WriteLines(const Line* lines, size_t count);
+
+  // Writes out whatever is buffered.  Returns false if this or any earlier
+  // call to Write() failed.
+  bool Flush();
+
+ protected:
+  // Writes out the next |size| bytes of the setup file.
+  virtual bool Write(const char* data, size_t size) = 0;
+
+ private:
+  void Append(const char* line, size_t length);
+
+  unique_ptr<char[]> buffer_;
+  const size_t buffer_size_;
+  size_t used_;
+  bool failed_;
+
+  DISALLOW_COPY_AND_ASSIGN(BufferedLgWriter);
+};
+
+}  // namespace lg
+
+#endif  // LG_WRITER_H_
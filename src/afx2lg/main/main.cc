@@ -3,31 +3,44 @@
 
 #include "axefx/axe_fx_sysex_parser.h"
 #include "common/file_utils.h"
+#include "common/metrics.h"
+#include "common/thread_pool.h"
+#include "common/trace.h"
+#include "lg/lg_hashes.h"
 #include "lg/lg_parser.h"
+#include "lg/lg_writer.h"
 
+#include <stdlib.h>
+
+#include <chrono>
 #include <climits>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
 
 using base::FileExists;
 using base::ReadFileIntoBuffer;
 
-class LgSetupFileWriter : public lg::LgParserCallback {
+class LgSetupFileWriter : public lg::BufferedLgWriter {
  public:
-  explicit LgSetupFileWriter(const axefx::PresetMap& presets)
-      : presets_(presets) {}
+  LgSetupFileWriter(const axefx::PresetMap& presets, std::ostream* output)
+      : presets_(presets), output_(output) {}
   ~LgSetupFileWriter() {}
 
-  virtual void WriteLine(const char* line, size_t length) {
-    std::cout << std::string(line, length);
-  }
-
   virtual const axefx::PresetMap& GetPresetMap() {
     return presets_;
   }
 
+ protected:
+  virtual bool Write(const char* data, size_t size) {
+    return !output_->write(data, size).fail();
+  }
+
  private:
   const axefx::PresetMap& presets_;
+  std::ostream* output_;
   DISALLOW_COPY_AND_ASSIGN(LgSetupFileWriter);
 };
 
@@ -49,6 +62,33 @@ void PrintUsage() {
     "           your setup file from LG Control Center as a via the\n"
     "           'File->Export to...->Text...' command.\n"
     "\n"
+    "    -j     Number of threads to use for parsing the .syx files.\n"
+    "           Defaults to the AFX2LG_THREADS environment variable or\n"
+    "           the number of CPU cores.\n"
+    "\n"
+    "    -o     Write the setup file to this file instead of stdout.\n"
+    "           Hashes of the generated patches and banks are kept in\n"
+    "           <file>.hashes, and later runs list the patches and banks\n"
+    "           that have changed since.  The file isn't rewritten if\n"
+    "           nothing has changed.\n"
+    "\n"
+    "    --watch  Requires -o.  Keep running and update the setup file\n"
+    "           whenever the .syx files or the template change.\n"
+    "\n"
+    "    -b     Generate several setup files in one go, as listed in a\n"
+    "           batch file.  Each line of the file describes one setup\n"
+    "           with the -t, -s, -r and -o arguments, e.g.:\n"
+    "             -t=rig1.txt -s=BankA.syx -r=0-63 -o=rig1_setup.txt\n"
+    "           Lines starting with # are ignored.  Each .syx file is\n"
+    "           only parsed once and the setups are generated in\n"
+    "           parallel.\n"
+    "\n"
+    "Set the AFX2LG_METRICS environment variable to print parser\n"
+    "statistics to stderr when done.\n"
+    "\n"
+    "Add --trace=<file> or set the AFX2LG_TRACE environment variable to\n"
+    "write a trace that can be loaded in chrome://tracing.\n"
+    "\n"
     "The generated output will be written to stdout, so just pipe it\n"
     "to a file of your choosing.\n\n"
     "Example:\n\n"
@@ -157,13 +197,20 @@ bool ParseArgs(int argc,
                char* argv[],
                std::vector<SysExFileParam>* syx_files,
                std::string* input_template,
+               std::string* output_file,
+               std::string* batch_file,
+               size_t* threads,
+               bool* watch,
                bool* did_prompt) {
   *did_prompt = false;
+  *watch = false;
   SysExFileParam* prev_sysex = NULL;
 
   for (int i = 1; i < argc; ++i) {
     const char* arg = argv[i];
-    if (arg[0] != '-' || strlen(arg) < 4 || arg[2] != '=') {
+    if (strcmp(arg, "--watch") == 0) {
+      *watch = true;
+    } else if (arg[0] != '-' || strlen(arg) < 4 || arg[2] != '=') {
       std::cerr << "Unknown/malformed argument: '" << arg << "'\n\n";
       return false;
     } else if (arg[1] == '?') {
@@ -184,7 +231,27 @@ bool ParseArgs(int argc,
         return false;
       }
       *input_template = &arg[3];
+    } else if (arg[1] == 'o') {
+      *output_file = &arg[3];
+    } else if (arg[1] == 'b') {
+      *batch_file = &arg[3];
+    } else if (arg[1] == 'j') {
+      int count = atoi(&arg[3]);
+      if (count <= 0) {
+        std::cerr << "Invalid thread count: " << &arg[3] << "\n\n";
+        return false;
+      }
+      *threads = static_cast<size_t>(count);
+    }
+  }
+
+  if (!batch_file->empty()) {
+    if (!syx_files->empty() || !input_template->empty() ||
+        !output_file->empty() || *watch) {
+      std::cerr << "-b can only be combined with -j\n\n";
+      return false;
     }
+    return true;
   }
 
   if (input_template->empty()) {
@@ -206,18 +273,404 @@ bool ParseArgs(int argc,
     syx_files->push_back(entry);
   }
 
+  if (*watch && output_file->empty()) {
+    std::cerr << "--watch requires an output file (-o)\n\n";
+    return false;
+  }
+
   return !syx_files->empty() && !input_template->empty();
 }
 
+// Reads and parses one of the .syx files given on the command line.
+// Runs on the thread pool.
+struct SysExFileJob {
+  SysExFileJob() : read(false), parsed(false) {}
+
+  void Run(const std::string& path) {
+    std::unique_ptr<uint8_t[]> buffer;
+    size_t size = 0;
+    read = ReadFileIntoBuffer(path, &buffer, &size);
+    if (read) {
+      const uint8_t* b = &buffer[0];
+      parsed = parser.ParseSysExBuffer(b, b + size, true);
+    }
+  }
+
+  axefx::SysExParser parser;
+  bool read;
+  bool parsed;
+};
+
+// The parsed .syx files, by path.  Each file is only parsed once, however
+// many times it's referred to.
+typedef std::map<std::string, unique_ptr<SysExFileJob> > ParsedFiles;
+
+// Parses the files in |syx_files| that aren't in |parsed| yet.
+bool ParseSysExFiles(const std::vector<SysExFileParam>& syx_files,
+                     base::ThreadPool* pool,
+                     ParsedFiles* parsed) {
+  // The files are parsed in parallel, and the presets within each bank too.
+  {
+    base::TaskGroup group(pool);
+    for (size_t i = 0; i < syx_files.size(); ++i) {
+      unique_ptr<SysExFileJob>& job = (*parsed)[syx_files[i].path()];
+      if (job)
+        continue;
+      job.reset(new SysExFileJob());
+      job->parser.set_thread_pool(pool);
+      group.PostTask(std::bind(&SysExFileJob::Run, job.get(),
+                               syx_files[i].path()));
+    }
+    group.Wait();
+  }
+
+  for (size_t i = 0; i < syx_files.size(); ++i) {
+    const SysExFileJob& job = *(*parsed)[syx_files[i].path()];
+    if (!job.read) {
+      std::cerr << "Failed to open " << syx_files[i].path() << std::endl;
+      return false;
+    } else if (!job.parsed) {
+      std::cerr << "Failed to parse " << syx_files[i].path() << std::endl;
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// Picks the presets that |syx_files| select.  The files are merged in the
+// order they were given so that the first file wins when there are
+// duplicate preset IDs.  The presets themselves are shared, not copied.
+void SelectPresets(const std::vector<SysExFileParam>& syx_files,
+                   const ParsedFiles& parsed,
+                   axefx::PresetMap* presets) {
+  for (size_t i = 0; i < syx_files.size(); ++i) {
+    ParsedFiles::const_iterator found = parsed.find(syx_files[i].path());
+    ASSERT(found != parsed.end());
+    const axefx::PresetMap& file_presets = found->second->parser.presets();
+    for (auto it = file_presets.begin(); it != file_presets.end(); ++it) {
+      if (syx_files[i].ShouldIncludePreset(it->first))
+        presets->insert(*it);
+    }
+  }
+}
+
+// Generates a setup file for |presets| from the template.  When |hashes|
+// isn't NULL, it receives the hashes of the generated entries.  Errors are
+// written to |log|.
+bool GenerateSetup(const axefx::PresetMap& presets,
+                   const std::string& input_template,
+                   std::ostream* output,
+                   std::ostream* log,
+                   lg::SetupHashes* hashes) {
+  lg::LgParser lg_parser;
+  std::unique_ptr<uint8_t[]> buffer;
+  size_t size = 0;
+  if (!ReadFileIntoBuffer(input_template, &buffer, &size)) {
+    *log << "Failed to open " << input_template << std::endl;
+    return false;
+  }
+
+  LgSetupFileWriter callback(presets, output);
+  if (!lg_parser.ParseBuffer(&callback, reinterpret_cast<char*>(buffer.get()),
+          reinterpret_cast<char*>(buffer.get()) + size)) {
+    *log << "No patches found in " << input_template << std::endl;
+    return false;
+  }
+  if (!callback.Flush() || !output->flush()) {
+    *log << "Failed to write the setup file\n";
+    return false;
+  }
+
+  if (hashes)
+    lg_parser.ComputeHashes(hashes);
+
+  return true;
+}
+
+void PrintChanges(const lg::SetupHashes::Changes& changes, std::ostream* log) {
+  static const char* const kKinds[] = { "added", "changed", "removed" };
+  static const char* const kTypes[] = { "patch", "bank", "other entries" };
+  *log << changes.size() << " change(s) since the last run:\n";
+  lg::SetupHashes::Changes::const_iterator it = changes.begin();
+  for (; it != changes.end(); ++it) {
+    *log << "  " << kKinds[it->kind] << " " << kTypes[it->type];
+    if (!it->name.empty())
+      *log << " '" << it->name << "'";
+    *log << "\n";
+  }
+}
+
+// Generates the setup file in memory and only writes it, along with the
+// hashes of its entries, if something has changed since the last run.
+bool UpdateSetupFile(const axefx::PresetMap& presets,
+                     const std::string& input_template,
+                     const std::string& output_file,
+                     std::ostream* log) {
+  std::ostringstream setup;
+  lg::SetupHashes hashes;
+  if (!GenerateSetup(presets, input_template, &setup, log, &hashes))
+    return false;
+
+  const std::string hash_file(output_file + ".hashes");
+  lg::SetupHashes previous;
+  if (FileExists(output_file) && previous.Load(hash_file)) {
+    lg::SetupHashes::Changes changes(hashes.CompareTo(previous));
+    if (changes.empty()) {
+      *log << output_file << " is up to date\n";
+      return true;
+    }
+    PrintChanges(changes, log);
+  }
+
+  std::ofstream file(output_file, std::ios::out | std::ios::trunc);
+  const std::string& text = setup.str();
+  if (!file.is_open() || !file.write(text.data(), text.size()) ||
+      !file.flush()) {
+    *log << "Failed to write " << output_file << std::endl;
+    return false;
+  }
+
+  if (!hashes.Save(hash_file))
+    *log << "Failed to write " << hash_file << std::endl;
+
+  *log << "Wrote " << output_file << std::endl;
+  return true;
+}
+
+// One line of a batch file: a template, the .syx files and ranges to take
+// presets from, and where to write the setup file.
+struct BatchJob {
+  BatchJob() : ok(false) {}
+
+  // Runs on the thread pool.
+  void Run(const ParsedFiles* parsed) {
+    axefx::PresetMap presets;
+    SelectPresets(syx_files, *parsed, &presets);
+    ok = UpdateSetupFile(presets, input_template, output_file, &log);
+  }
+
+  std::vector<SysExFileParam> syx_files;
+  std::string input_template;
+  std::string output_file;
+  // Buffered so that the output of jobs running in parallel isn't mixed up.
+  std::ostringstream log;
+  bool ok;
+};
+
+// Splits |line| at whitespace.  Double quotes can be used around paths that
+// contain spaces, e.g. -s="My Bank.syx".
+std::vector<std::string> SplitArguments(const std::string& line) {
+  std::vector<std::string> args;
+  std::string arg;
+  bool quoted = false, in_arg = false;
+  for (size_t i = 0; i < line.size(); ++i) {
+    char c = line[i];
+    if (c == '"') {
+      quoted = !quoted;
+      in_arg = true;
+    } else if (!quoted && isspace(static_cast<unsigned char>(c))) {
+      if (in_arg)
+        args.push_back(arg);
+      arg.clear();
+      in_arg = false;
+    } else {
+      arg.push_back(c);
+      in_arg = true;
+    }
+  }
+  if (in_arg)
+    args.push_back(arg);
+  return args;
+}
+
+// Removes "./" components and repeated separators so that different
+// spellings of the same relative path compare equal.
+std::string NormalizePath(const std::string& path) {
+  std::string normalized;
+  size_t begin = 0;
+  while (begin <= path.size()) {
+    size_t end = path.find_first_of("/\\", begin);
+    if (end == std::string::npos)
+      end = path.size();
+    std::string component(path.substr(begin, end - begin));
+    if (begin == 0 && component.empty()) {
+      normalized = "/";  // Absolute path.
+    } else if (!component.empty() && component != ".") {
+      if (!normalized.empty() && normalized.back() != '/')
+        normalized.push_back('/');
+      normalized += component;
+    }
+    begin = end + 1;
+  }
+  return normalized;
+}
+
+// Reads a batch file.  Each line that isn't empty or a # comment describes
+// one setup file with the -t, -s, -r and -o arguments, e.g.:
+//   -t=rig1.txt -s=BankA.syx -r=0-63 -s=BankB.syx -o=rig1_setup.txt
+// Jobs run in parallel, so no two jobs may write the same output file.
+bool ReadBatchFile(const std::string& path,
+                   std::vector<unique_ptr<BatchJob> >* jobs) {
+  std::ifstream file(path);
+  if (!file.is_open()) {
+    std::cerr << "Failed to open " << path << std::endl;
+    return false;
+  }
+
+  // Output file -> the line that writes it.
+  std::map<std::string, int> outputs;
+  std::string line;
+  int line_number = 0;
+  while (std::getline(file, line)) {
+    ++line_number;
+    std::vector<std::string> args(SplitArguments(line));
+    if (args.empty() || args[0][0] == '#')
+      continue;
+
+    unique_ptr<BatchJob> job(new BatchJob());
+    for (size_t i = 0; i < args.size(); ++i) {
+      const std::string& arg = args[i];
+      if (arg.size() < 4 || arg[0] != '-' || arg[2] != '=' ||
+          (arg[1] == 'r' && job->syx_files.empty())) {
+        std::cerr << path << ":" << line_number << ": Unexpected argument '"
+                  << arg << "'\n";
+        return false;
+      }
+      if (arg[1] == 's') {
+        job->syx_files.push_back(SysExFileParam(arg.substr(3)));
+      } else if (arg[1] == 'r') {
+        job->syx_files.back().SetRange(&arg[3]);
+      } else if (arg[1] == 't') {
+        job->input_template = arg.substr(3);
+      } else if (arg[1] == 'o') {
+        job->output_file = arg.substr(3);
+      }
+    }
+
+    if (job->syx_files.empty() || job->input_template.empty() ||
+        job->output_file.empty()) {
+      std::cerr << path << ":" << line_number
+                << ": Each job needs -t, -s and -o\n";
+      return false;
+    }
+
+    auto inserted = outputs.insert(
+        std::make_pair(NormalizePath(job->output_file), line_number));
+    if (!inserted.second) {
+      std::cerr << path << ":" << line_number << ": " << job->output_file
+                << " is already written by line " << inserted.first->second
+                << "\n";
+      return false;
+    }
+    jobs->push_back(std::move(job));
+  }
+
+  return true;
+}
+
+// Parses every .syx file that the jobs refer to once and then generates the
+// setup files in parallel.
+bool RunBatch(const std::string& batch_file, base::ThreadPool* pool) {
+  std::vector<unique_ptr<BatchJob> > jobs;
+  if (!ReadBatchFile(batch_file, &jobs))
+    return false;
+
+  std::vector<SysExFileParam> syx_files;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    syx_files.insert(syx_files.end(), jobs[i]->syx_files.begin(),
+                     jobs[i]->syx_files.end());
+  }
+  ParsedFiles parsed;
+  if (!ParseSysExFiles(syx_files, pool, &parsed))
+    return false;
+
+  {
+    base::TaskGroup group(pool);
+    for (size_t i = 0; i < jobs.size(); ++i)
+      group.PostTask(std::bind(&BatchJob::Run, jobs[i].get(), &parsed));
+    group.Wait();
+  }
+
+  bool ok = true;
+  for (size_t i = 0; i < jobs.size(); ++i) {
+    std::cerr << jobs[i]->log.str();
+    ok &= jobs[i]->ok;
+  }
+  return ok;
+}
+
+std::vector<base::FileStamp> GetFileStamps(
+    const std::vector<std::string>& paths) {
+  std::vector<base::FileStamp> stamps(paths.size());
+  for (size_t i = 0; i < paths.size(); ++i)
+    base::GetFileStamp(paths[i], &stamps[i]);  // Missing files stay zeroed.
+  return stamps;
+}
+
+// Polls |paths| until they differ from |stamps| and then until they've
+// stopped changing, so that a file that's still being written isn't read.
+void WaitForChanges(const std::vector<std::string>& paths,
+                    std::vector<base::FileStamp> stamps) {
+  bool changed = false;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    std::vector<base::FileStamp> current(GetFileStamps(paths));
+    if (current != stamps) {
+      stamps.swap(current);
+      changed = true;
+    } else if (changed) {
+      return;
+    }
+  }
+}
+
 int main(int argc, char* argv[]) {
+  base::ScopedMetricsSummary metrics_summary;
+  base::ScopedTracing tracing(base::TakeTraceArgument(&argc, argv));
   std::vector<SysExFileParam> syx_files;
   std::string input_template;
+  std::string output_file;
+  std::string batch_file;
+  size_t threads = 0;
+  bool watch = false;
   bool did_prompt = false;
-  if (!ParseArgs(argc, argv, &syx_files, &input_template, &did_prompt)) {
+  if (!ParseArgs(argc, argv, &syx_files, &input_template, &output_file,
+                 &batch_file, &threads, &watch, &did_prompt)) {
     PrintUsage();
     return -1;
   }
 
+  base::ThreadPool pool(threads);
+
+  if (!batch_file.empty())
+    return RunBatch(batch_file, &pool) ? 0 : -1;
+
+  if (!output_file.empty()) {
+    std::vector<std::string> inputs;
+    for (size_t i = 0; i < syx_files.size(); ++i)
+      inputs.push_back(syx_files[i].path());
+    inputs.push_back(input_template);
+
+    while (true) {
+      // Taken before reading the files so that changes made while the setup
+      // is being generated aren't missed.
+      std::vector<base::FileStamp> stamps(GetFileStamps(inputs));
+      ParsedFiles parsed;
+      axefx::PresetMap presets;
+      bool ok = ParseSysExFiles(syx_files, &pool, &parsed);
+      if (ok) {
+        SelectPresets(syx_files, parsed, &presets);
+        ok = UpdateSetupFile(presets, input_template, output_file,
+                             &std::cerr);
+      }
+      if (!watch)
+        return ok ? 0 : -1;
+      std::cerr << "Waiting for the input files to change...\n";
+      WaitForChanges(inputs, stamps);
+    }
+  }
+
   std::filebuf output_stream;
   std::streambuf* original_streambuf = nullptr;
   if (did_prompt) {
@@ -235,44 +688,16 @@ int main(int argc, char* argv[]) {
     original_streambuf = std::cout.rdbuf(&output_stream);
   }
 
-  axefx::PresetMap presets;
-  axefx::SysExParser parser;
-  for (size_t i = 0; i < syx_files.size(); ++i) {
-    std::unique_ptr<uint8_t[]> buffer;
-    size_t size = 0;
-    if (ReadFileIntoBuffer(syx_files[i].path(), &buffer, &size)) {
-      const uint8_t* b = &buffer[0];
-      if (!parser.ParseSysExBuffer(b, b + size, true)) {
-        std::cerr << "Failed to parse " << syx_files[i].path() << std::endl;
-        return -1;
-      }
-      axefx::PresetMap::const_iterator it = parser.presets().begin();
-      for (; it != parser.presets().end(); ++it) {
-        if (syx_files[i].ShouldIncludePreset(it->first))
-          presets.insert(*it);
-      }
-    } else {
-      std::cerr << "Failed to open " << syx_files[i].path() << std::endl;
-      return -1;
-    }
-  }
-
-  lg::LgParser lg_parser;
-  std::unique_ptr<uint8_t[]> buffer;
-  size_t size = 0;
-  if (ReadFileIntoBuffer(input_template, &buffer, &size)) {
-    LgSetupFileWriter callback(presets);
-    if (!lg_parser.ParseBuffer(&callback, reinterpret_cast<char*>(buffer.get()),
-            reinterpret_cast<char*>(buffer.get()) + size)) {
-      std::cerr << "No patches found in " << input_template << std::endl;
-      return -1;
-    }
-  } else {
-    std::cerr << "Failed to open " << input_template << std::endl;
+  ParsedFiles parsed;
+  bool ok = ParseSysExFiles(syx_files, &pool, &parsed);
+  if (ok) {
+    axefx::PresetMap presets;
+    SelectPresets(syx_files, parsed, &presets);
+    ok = GenerateSetup(presets, input_template, &std::cout, &std::cerr, NULL);
   }
 
   if (original_streambuf)
     std::cout.rdbuf(original_streambuf);
 
-  return 0;
+  return ok ? 0 : -1;
 }
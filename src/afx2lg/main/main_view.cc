@@ -6,9 +6,10 @@
 #include "axefx/axe_fx_sysex_parser.h"
 #include "axys/tree_preset_item.h"
 #include "lg/lg_parser.h"
+#include "lg/lg_writer.h"
 
 namespace {
-class SetupFileWriter : public lg::LgParserCallback {
+class SetupFileWriter : public lg::BufferedLgWriter {
  public:
   explicit SetupFileWriter() {}
   ~SetupFileWriter() {}
@@ -31,8 +32,8 @@ class SetupFileWriter : public lg::LgParserCallback {
   }
 
  private:
-  virtual void WriteLine(const char* line, size_t length) {
-    file_->write(line, length);
+  virtual bool Write(const char* data, size_t size) {
+    return file_->write(data, size);
   }
 
   virtual const axefx::PresetMap& GetPresetMap() {
@@ -146,6 +147,11 @@ void MainView::OnGenerateSetup() {
     return;
   }
 
+  if (!writer.Flush()) {
+    ShowError("Failed to write to the output file.");
+    return;
+  }
+
   NativeMessageBox::showMessageBoxAsync(AlertWindow::InfoIcon,
       "Done",
       "A new setup file has been successfully generated.\n"
@@ -0,0 +1,449 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "midi/device_session.h"
+
+#include "axefx/bank_dump_tracker.h"
+#include "common/metrics.h"
+
+#include <algorithm>
+#include <utility>
+
+using std::placeholders::_1;
+
+namespace midi {
+
+static base::Counter g_timeouts("midi.session.timeouts");
+static base::Counter g_device_errors("midi.session.device_errors");
+// Messages that failed checksum verification or weren't from an AxeFx.
+static base::Counter g_rejected("midi.session.rejected_messages");
+
+// Base class for the outstanding requests.  Subclasses decide which of the
+// incoming messages belong to the response.
+class DeviceSession::Request {
+ public:
+  enum Match {
+    NO_MATCH,  // The message isn't part of the response.
+    MORE,      // Part of the response, more messages are expected.
+    DONE,      // The last message of the response.
+    FAILED,    // The AxeFx reported an error or sent bad data.
+  };
+
+  Request(axefx::FunctionId function,
+          const std::chrono::milliseconds& timeout,
+          const OnResponse& on_response)
+      : id(0),
+        function(function),
+        timeout(timeout),
+        on_response(on_response),
+        send_failed(false) {
+  }
+  virtual ~Request() {}
+
+  Match OnMessage(const axefx::FractalSysExHeader* header, size_t size) {
+    if (header->function() == axefx::REPLY) {
+      auto reply = static_cast<const axefx::ReplyMessage*>(header);
+      if (size < sizeof(axefx::ReplyMessage) || reply->reply_to() != function)
+        return NO_MATCH;
+      return reply->error_id == 0 ? OnSuccessReply() : FAILED;
+    }
+    return OnResponseMessage(header, size);
+  }
+
+  RequestId id;
+  const axefx::FunctionId function;
+  const std::chrono::milliseconds timeout;
+  Clock::time_point deadline;
+  OnResponse on_response;
+  // Set if the request couldn't be sent.  The request is then completed
+  // with SEND_FAILED when its (immediate) deadline is checked and doesn't
+  // take part in matching.
+  bool send_failed;
+  MessageList response;
+
+ protected:
+  // Called when the AxeFx acknowledges the request without an error.
+  virtual Match OnSuccessReply() { return NO_MATCH; }
+  virtual Match OnResponseMessage(const axefx::FractalSysExHeader* header,
+                                  size_t size) = 0;
+};
+
+namespace {
+
+typedef DeviceSession::Request Request;
+
+class PendingPresetName : public Request {
+ public:
+  PendingPresetName(const std::chrono::milliseconds& timeout,
+                    const DeviceSession::OnResponse& on_response)
+      : Request(axefx::PRESET_NAME, timeout, on_response) {}
+
+ protected:
+  virtual Match OnResponseMessage(const axefx::FractalSysExHeader* header,
+                                  size_t size) {
+    return header->function() == axefx::PRESET_NAME ? DONE : NO_MATCH;
+  }
+};
+
+class PendingPresetDump : public Request {
+ public:
+  // |any_id| is used when requesting the edit buffer, since we don't know
+  // which preset ID the AxeFx will report for it.
+  PendingPresetDump(uint16_t preset_id, bool any_id,
+                    const std::chrono::milliseconds& timeout,
+                    const DeviceSession::OnResponse& on_response)
+      : Request(axefx::REQUEST_PRESET_DUMP, timeout, on_response),
+        preset_id_(preset_id), any_id_(any_id), started_(false),
+        parameter_blocks_(0) {
+  }
+
+ protected:
+  virtual Match OnResponseMessage(const axefx::FractalSysExHeader* header,
+                                  size_t size) {
+    switch (header->function()) {
+      case axefx::PRESET_ID: {
+        auto id = static_cast<const axefx::PresetIdHeader*>(header);
+        if (started_ || size < sizeof(axefx::PresetIdHeader) ||
+            (!any_id_ && id->id.As16bit() != preset_id_)) {
+          return NO_MATCH;
+        }
+        started_ = true;
+        return MORE;
+      }
+
+      case axefx::PRESET_PARAMETERS:
+        if (!started_)
+          return NO_MATCH;
+        return ++parameter_blocks_ <= axefx::kParameterBlocksPerPreset ?
+            MORE : FAILED;
+
+      case axefx::PRESET_CHECKSUM:
+        if (!started_)
+          return NO_MATCH;
+        return parameter_blocks_ == axefx::kParameterBlocksPerPreset ?
+            DONE : FAILED;
+
+      default:
+        return NO_MATCH;
+    }
+  }
+
+ private:
+  const uint16_t preset_id_;
+  const bool any_id_;
+  bool started_;
+  int parameter_blocks_;
+};
+
+class PendingBankDump : public Request {
+ public:
+  PendingBankDump(axefx::BankDumpRequest::BankId bank,
+                  const std::chrono::milliseconds& timeout,
+                  const DeviceSession::OnResponse& on_response)
+      : Request(axefx::BANK_DUMP_REQUEST, timeout, on_response),
+        tracker_(bank) {
+  }
+
+ protected:
+  // The preset checksums are verified by whoever parses the response, so
+  // only the structure of the dump is checked here.
+  virtual Match OnResponseMessage(const axefx::FractalSysExHeader* header,
+                                  size_t size) {
+    bool accepted;
+    switch (header->function()) {
+      case axefx::PRESET_ID:
+        accepted = size >= sizeof(axefx::PresetIdHeader) &&
+            tracker_.OnPresetId(
+                static_cast<const axefx::PresetIdHeader*>(header)->
+                    id.As16bit());
+        break;
+      case axefx::PRESET_PARAMETERS:
+        accepted = tracker_.OnParameterBlock();
+        break;
+      case axefx::PRESET_CHECKSUM:
+        accepted = tracker_.OnChecksum(true);
+        break;
+      default:
+        return NO_MATCH;
+    }
+
+    if (!tracker_.complete())
+      return accepted ? MORE : NO_MATCH;
+
+    return tracker_.all_received() ? DONE : FAILED;
+  }
+
+ private:
+  axefx::BankDumpTracker tracker_;
+};
+
+class PendingFirmwareUpdate : public Request {
+ public:
+  PendingFirmwareUpdate(const std::chrono::milliseconds& timeout,
+                        const DeviceSession::OnResponse& on_response)
+      : Request(axefx::FIRMWARE_UPDATE, timeout, on_response) {}
+
+ protected:
+  virtual Match OnSuccessReply() { return DONE; }
+  virtual Match OnResponseMessage(const axefx::FractalSysExHeader* header,
+                                  size_t size) {
+    return NO_MATCH;
+  }
+};
+
+}  // namespace
+
+DeviceSession::DeviceSession(const shared_ptr<MidiIn>& midi_in,
+                             MidiOut* midi_out,
+                             const base::SharedThreadLoop& loop)
+    : midi_in_(midi_in),
+      midi_out_(midi_out),
+      loop_(loop),
+      buffer_(std::bind(&DeviceSession::OnSysEx, this, _1)),
+      next_id_(1),
+      expiry_timer_(0),
+      running_(false),
+      disconnected_(false) {
+  buffer_.Attach(midi_in_);
+  midi_in_->set_onclosed(std::bind(&DeviceSession::OnInputClosed, this));
+}
+
+DeviceSession::~DeviceSession() {
+  if (expiry_timer_)
+    loop_->CancelTimer(expiry_timer_);
+  midi_in_->set_ondataavailable(nullptr);
+  midi_in_->set_onclosed(nullptr);
+}
+
+DeviceSession::RequestId DeviceSession::RequestPresetName(
+    const std::chrono::milliseconds& timeout,
+    const OnResponse& on_response) {
+  axefx::GenericNoDataMessage request(axefx::PRESET_NAME);
+  return Send(
+      unique_ptr<Request>(new PendingPresetName(timeout, on_response)),
+      unique_ptr<Message>(new Message(&request, sizeof(request))));
+}
+
+DeviceSession::RequestId DeviceSession::RequestPresetDump(
+    uint16_t preset_id,
+    const std::chrono::milliseconds& timeout,
+    const OnResponse& on_response) {
+  axefx::PresetDumpRequest request(preset_id);
+  return Send(
+      unique_ptr<Request>(
+          new PendingPresetDump(preset_id, false, timeout, on_response)),
+      unique_ptr<Message>(new Message(&request, sizeof(request))));
+}
+
+DeviceSession::RequestId DeviceSession::RequestEditBufferDump(
+    const std::chrono::milliseconds& timeout,
+    const OnResponse& on_response) {
+  axefx::PresetDumpRequest request;
+  return Send(
+      unique_ptr<Request>(
+          new PendingPresetDump(0, true, timeout, on_response)),
+      unique_ptr<Message>(new Message(&request, sizeof(request))));
+}
+
+DeviceSession::RequestId DeviceSession::RequestBankDump(
+    axefx::BankDumpRequest::BankId bank,
+    const std::chrono::milliseconds& timeout,
+    const OnResponse& on_response) {
+  axefx::BankDumpRequest request(bank);
+  return Send(
+      unique_ptr<Request>(new PendingBankDump(bank, timeout, on_response)),
+      unique_ptr<Message>(new Message(&request, sizeof(request))));
+}
+
+DeviceSession::RequestId DeviceSession::SwitchToFirmwareUpdate(
+    const std::chrono::milliseconds& timeout,
+    const OnResponse& on_response) {
+  axefx::GenericNoDataMessage request(axefx::FIRMWARE_UPDATE);
+  return Send(
+      unique_ptr<Request>(new PendingFirmwareUpdate(timeout, on_response)),
+      unique_ptr<Message>(new Message(&request, sizeof(request))));
+}
+
+bool DeviceSession::Cancel(RequestId id) {
+  for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+    if ((*it)->id == id) {
+      Complete(it, CANCELLED);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeviceSession::Run() {
+  ASSERT(!running_);
+  if (requests_.empty())
+    return true;
+
+  running_ = true;
+  loop_->Run();
+  running_ = false;
+  return requests_.empty();
+}
+
+DeviceSession::RequestId DeviceSession::Send(unique_ptr<Request> request,
+                                             unique_ptr<Message> message) {
+  request->id = next_id_++;
+  request->deadline = Clock::now() + request->timeout;
+  // Failures are reported the next time the deadlines are checked, so that
+  // the callback isn't invoked before the caller knows the ID of the request.
+  if (disconnected_) {
+    request->deadline = Clock::now();
+  } else if (!midi_out_->Send(std::move(message), nullptr)) {
+    request->send_failed = true;
+    request->deadline = Clock::now();
+  }
+  RequestId id = request->id;
+  requests_.push_back(std::move(request));
+  ScheduleExpiry();
+  return id;
+}
+
+void DeviceSession::OnSysEx(Message* msg) {
+  if (!msg->IsFractalMessageWithChecksum()) {
+    g_rejected.Add();
+    return;
+  }
+
+  auto header = reinterpret_cast<const axefx::FractalSysExHeader*>(&msg->at(0));
+  if (header->function() == axefx::TEMPO_HEARTBEAT ||
+      header->function() == axefx::TUNER_DATA) {
+    return;
+  }
+
+  // Response data goes to every request that expects it, so that e.g. a
+  // preset dump and a bank dump that covers the same preset both get it.
+  // A reply acknowledges a single request, so it only goes to the oldest
+  // request that it could be for.
+  bool is_reply = header->function() == axefx::REPLY;
+  std::vector<Request*> matched;
+  std::vector<std::pair<RequestId, Status> > completed;
+  for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+    Request* r = it->get();
+    if (r->send_failed)
+      continue;
+
+    Request::Match match = r->OnMessage(header, msg->size());
+    if (match == Request::NO_MATCH)
+      continue;
+
+    matched.push_back(r);
+    if (match != Request::MORE) {
+      completed.push_back(
+          std::make_pair(r->id, match == Request::DONE ? OK : DEVICE_ERROR));
+    }
+    if (is_reply)
+      break;
+  }
+
+  Clock::time_point now = Clock::now();
+  for (size_t i = 0; i < matched.size(); ++i) {
+    // The last request takes the buffer, the others get copies.
+    bool last = i + 1 == matched.size();
+    unique_ptr<Message> m(last ? new Message() : new Message(*msg));
+    if (last)
+      m->swap(*msg);
+    matched[i]->response.push_back(std::move(m));
+    matched[i]->deadline = now + matched[i]->timeout;
+  }
+
+  // Callbacks may issue or cancel requests, so look each one up again.
+  for (size_t i = 0; i < completed.size(); ++i) {
+    for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+      if ((*it)->id == completed[i].first) {
+        Complete(it, completed[i].second);
+        break;
+      }
+    }
+  }
+}
+
+void DeviceSession::OnInputClosed() {
+  // No response is coming, so there's no point in waiting for the timeouts.
+  disconnected_ = true;
+  Clock::time_point now = Clock::now();
+  for (auto& r : requests_)
+    r->deadline = now;
+  ExpireRequests(now);
+  ScheduleExpiry();
+}
+
+void DeviceSession::ExpireRequests(const Clock::time_point& now) {
+  // Callbacks may issue or cancel requests, so start over after each one.
+  bool found;
+  do {
+    found = false;
+    for (auto it = requests_.begin(); it != requests_.end(); ++it) {
+      if ((*it)->deadline <= now) {
+        Status status = TIMED_OUT;
+        if ((*it)->send_failed) {
+          status = SEND_FAILED;
+        } else if (disconnected_) {
+          status = DISCONNECTED;
+        }
+        Complete(it, status);
+        found = true;
+        break;
+      }
+    }
+  } while (found);
+}
+
+void DeviceSession::ScheduleExpiry() {
+  if (requests_.empty()) {
+    if (expiry_timer_) {
+      loop_->CancelTimer(expiry_timer_);
+      expiry_timer_ = 0;
+    }
+    return;
+  }
+
+  Clock::time_point next_deadline = requests_.front()->deadline;
+  for (const auto& r : requests_)
+    next_deadline = std::min(next_deadline, r->deadline);
+
+  // Deadlines move forward as messages arrive, so a timer that fires too
+  // early is fine.  It'll just schedule the next one.
+  if (expiry_timer_) {
+    if (expiry_time_ <= next_deadline)
+      return;
+    loop_->CancelTimer(expiry_timer_);
+  }
+
+  Clock::time_point now = Clock::now();
+  std::chrono::milliseconds delay(0);
+  if (next_deadline > now) {
+    // Round up so that we don't wake up just before the deadline.
+    delay = std::chrono::duration_cast<std::chrono::milliseconds>(
+        next_deadline - now) + std::chrono::milliseconds(1);
+  }
+  expiry_time_ = next_deadline;
+  expiry_timer_ = loop_->PostDelayedTask(
+      std::bind(&DeviceSession::OnExpiryTimer, this), delay);
+}
+
+void DeviceSession::OnExpiryTimer() {
+  expiry_timer_ = 0;
+  ExpireRequests(Clock::now());
+  ScheduleExpiry();
+}
+
+void DeviceSession::Complete(RequestList::iterator it, Status status) {
+  unique_ptr<Request> request(std::move(*it));
+  requests_.erase(it);
+  if (status == TIMED_OUT) {
+    g_timeouts.Add();
+  } else if (status == DEVICE_ERROR) {
+    g_device_errors.Add();
+  }
+  if (request->on_response)
+    request->on_response(status, &request->response);
+  if (running_ && requests_.empty())
+    loop_->Quit();
+}
+
+}  // namespace midi
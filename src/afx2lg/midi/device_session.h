@@ -0,0 +1,127 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef MIDI_DEVICE_SESSION_H_
+#define MIDI_DEVICE_SESSION_H_
+
+#include "common/common_types.h"
+#include "common/thread_loop.h"
+
+#include "axefx/sysex_types.h"
+#include "midi/midi_in.h"
+#include "midi/midi_out.h"
+
+#include <chrono>
+#include <list>
+#include <vector>
+
+namespace midi {
+
+// The messages that make up a response, in the order they were received.
+typedef std::vector<unique_ptr<Message> > MessageList;
+
+// Sends requests to an AxeFx and matches the messages that come back to the
+// request they belong to, so that callers don't have to run the loop and
+// sift through the incoming messages themselves.  Tempo and tuner messages
+// as well as messages that fail checksum verification are filtered out.
+//
+// Any number of requests can be outstanding at the same time.  Each incoming
+// message is added to the response of every outstanding request that expects
+// it, so overlapping requests (e.g. a preset dump while a bank dump is in
+// progress) all complete.  Replies (acknowledgements and errors) only go to
+// the oldest request that they could be for.
+//
+// The session attaches itself to |midi_in| and all callbacks are delivered on
+// the worker loop of |midi_in|.  The session must only be used on that
+// thread, or while the loop isn't running.
+class DeviceSession {
+ public:
+  enum Status {
+    OK,
+    TIMED_OUT,
+    CANCELLED,
+    SEND_FAILED,
+    // The AxeFx replied with an error, or the response didn't have the
+    // expected structure: a preset dump with the wrong number of parameter
+    // blocks, or a bank dump that skipped presets or blocks.  Preset
+    // checksums aren't verified here, that's left to whoever parses the
+    // response.
+    DEVICE_ERROR,
+    // The connection to the AxeFx was lost (see MidiIn::set_onclosed()).
+    // Requests made after that complete with this status right away.
+    DISCONNECTED,
+  };
+
+  typedef int RequestId;
+  // |response| holds the messages received for the request, if any.
+  // The callback is free to take ownership of them.
+  typedef std::function<void(Status status, MessageList* response)>
+      OnResponse;
+
+  DeviceSession(const shared_ptr<MidiIn>& midi_in,
+                MidiOut* midi_out,
+                const base::SharedThreadLoop& loop);
+  // Outstanding requests are dropped without invoking their callbacks.
+  ~DeviceSession();
+
+  size_t outstanding() const { return requests_.size(); }
+
+  // Each of these sends a request and returns an ID that can be passed to
+  // Cancel().  |timeout| is the longest time to wait for the next message of
+  // the response, so for multi-message responses such as bank dumps it does
+  // not need to cover the whole transfer.
+  RequestId RequestPresetName(const std::chrono::milliseconds& timeout,
+                              const OnResponse& on_response);
+  RequestId RequestPresetDump(uint16_t preset_id,
+                              const std::chrono::milliseconds& timeout,
+                              const OnResponse& on_response);
+  RequestId RequestEditBufferDump(const std::chrono::milliseconds& timeout,
+                                  const OnResponse& on_response);
+  RequestId RequestBankDump(axefx::BankDumpRequest::BankId bank,
+                            const std::chrono::milliseconds& timeout,
+                            const OnResponse& on_response);
+  RequestId SwitchToFirmwareUpdate(const std::chrono::milliseconds& timeout,
+                                   const OnResponse& on_response);
+
+  // Cancels an outstanding request.  The callback is invoked with CANCELLED.
+  // Returns false if the request has already completed.
+  bool Cancel(RequestId id);
+
+  // Runs the loop until there are no outstanding requests.  Returns false if
+  // the loop was quit by someone else before that.
+  bool Run();
+
+  // Implemented in the .cc file.
+  class Request;
+
+ private:
+  typedef std::chrono::steady_clock Clock;
+  typedef std::list<unique_ptr<Request> > RequestList;
+
+  RequestId Send(unique_ptr<Request> request, unique_ptr<Message> message);
+  void OnSysEx(Message* msg);
+  void OnInputClosed();
+  void ExpireRequests(const Clock::time_point& now);
+  // Makes sure that the loop wakes us up when the next deadline is due.
+  void ScheduleExpiry();
+  void OnExpiryTimer();
+  void Complete(RequestList::iterator it, Status status);
+
+  shared_ptr<MidiIn> midi_in_;
+  MidiOut* midi_out_;
+  base::SharedThreadLoop loop_;
+  SysExDataBuffer buffer_;
+  RequestList requests_;
+  RequestId next_id_;
+  base::ThreadLoop::TimerId expiry_timer_;  // 0 if not scheduled.
+  Clock::time_point expiry_time_;
+  bool running_;
+  bool disconnected_;
+
+  DISALLOW_COPY_AND_ASSIGN(DeviceSession);
+};
+
+}  // namespace midi
+
+#endif  // MIDI_DEVICE_SESSION_H_
@@ -13,6 +13,8 @@
         '..',
       ],
       'sources': [
+        'device_session.cc',
+        'device_session.h',
         'midi_in.cc',
         'midi_in.h',
         'midi_out.cc',
@@ -44,6 +46,19 @@
             ],
           },
         }],
+        ['OS=="linux"', {
+          'sources': [
+            'midi_in_linux.cc',
+            'midi_linux.cc',
+            'midi_linux.h',
+            'midi_out_linux.cc',
+          ],
+          'link_settings': {
+            'libraries': [
+              '-lpthread',
+            ],
+          },
+        }],
       ],
     },
   ],
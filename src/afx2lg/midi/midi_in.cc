@@ -5,6 +5,7 @@
 
 // todo: remove
 #include "axefx/sysex_types.h"
+#include "common/metrics.h"
 
 #include <iostream>
 
@@ -16,7 +17,11 @@ static const uint8_t kSysExStart = 0xF0;
 
 namespace midi {
 
-#if !defined(OS_WIN) && !defined(OS_MACOSX)
+static base::Counter g_bytes_in("midi.in.bytes");
+static base::Counter g_messages_in("midi.in.messages");
+static base::Counter g_partial_messages("midi.in.partial_messages");
+
+#if !defined(OS_WIN) && !defined(OS_MACOSX) && !defined(OS_LINUX)
 // static
 shared_ptr<MidiIn> MidiIn::Create(
     const shared_ptr<MidiDeviceInfo>& device,
@@ -59,6 +64,7 @@ void SysExDataBuffer::Attach(const shared_ptr<MidiIn>& midi_in) {
 }
 
 void SysExDataBuffer::OnData(const uint8_t* data, size_t size) {
+  g_bytes_in.Add(size);
   size_t i = 0u;
   size_t pos_begin = 0u;
   for (; i < size; ++i) {
@@ -66,6 +72,7 @@ void SysExDataBuffer::OnData(const uint8_t* data, size_t size) {
       buffer_.insert(buffer_.end(), &data[pos_begin], &data[i + 1u]);
       ASSERT(buffer_[buffer_.size() - 1u] == kSysExEnd);
       if (buffer_[0] != kSysExStart) {
+        g_partial_messages.Add();
 #ifndef NDEBUG
         std::cerr << "WRN: Received partial midi message.  Dropping.\n";
 #endif
@@ -101,6 +108,7 @@ void SysExDataBuffer::OnData(const uint8_t* data, size_t size) {
 #endif
       if (!buffer_.empty()) {
         ASSERT(buffer_[0] == kSysExStart);
+        g_messages_in.Add();
         on_sysex_(&buffer_);
       }
       buffer_.clear();
@@ -12,6 +12,7 @@
 namespace midi {
 
 typedef std::function<void(const uint8_t*, size_t)> DataAvailable;
+typedef std::function<void()> OnClosed;
 
 // Interface class for a midi-in connection + device enumeration.
 class MidiIn {
@@ -36,6 +37,13 @@ class MidiIn {
     data_available_ = data_available;
   }
 
+  // Called on the worker thread when the connection to the device is lost.
+  // No more data arrives after that.  Only the Linux backend detects this
+  // at the moment.
+  void set_onclosed(const OnClosed& on_closed) {
+    on_closed_ = on_closed;
+  }
+
  protected:
   MidiIn(const shared_ptr<MidiDeviceInfo>& device,
          const shared_ptr<base::ThreadLoop>& worker_thread);
@@ -43,6 +51,7 @@ class MidiIn {
   shared_ptr<MidiDeviceInfo> device_;
   std::weak_ptr<base::ThreadLoop> worker_;
   DataAvailable data_available_;
+  OnClosed on_closed_;
 };
 
 // This is an in-between class that receives callbacks from a MidiIn
@@ -0,0 +1,143 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "midi/midi_in.h"
+
+#include "midi/midi_linux.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace midi {
+
+// Each read() takes what's available, up to kMaxReadSize, into a buffer
+// that's handed to the worker as is.  The maximum is large enough to hold a
+// whole bank dump's worth of messages if the reader has fallen behind, which
+// means we normally get away with one read() per wakeup.
+static const size_t kMaxReadSize = 64 * 1024;
+// Used when the fd can't tell how much is available.
+static const size_t kDefaultReadSize = 4 * 1024;
+
+class MidiInLinux : public MidiIn, public IoEventHandler {
+ public:
+  MidiInLinux(const shared_ptr<MidiDeviceInfo>& device,
+              const shared_ptr<base::ThreadLoop>& worker_thread)
+      : MidiIn(device, worker_thread),
+        fd_(-1) {
+  }
+
+  virtual ~MidiInLinux() {
+    Close();
+  }
+
+  bool Init(const shared_ptr<MidiInLinux>& shared_this) {
+    weak_this_ = shared_this;
+    ASSERT(shared_this.get() == this);
+
+    std::vector<LinuxMidiPort> ports(GetLinuxMidiPorts());
+    if (device_->id() < 0 ||
+        static_cast<size_t>(device_->id()) >= ports.size()) {
+      return false;
+    }
+
+    fd_ = OpenLinuxMidiPort(ports[device_->id()].in_path, true);
+    if (fd_ == -1)
+      return false;
+
+    return MidiIoThread::instance()->Watch(fd_, EPOLLIN, this);
+  }
+
+  void Close() {
+    if (fd_ != -1) {
+      MidiIoThread::instance()->Unwatch(fd_);
+      close(fd_);
+      fd_ = -1;
+    }
+  }
+
+ protected:
+  static void OnProcessBuffer(
+      const std::weak_ptr<MidiInLinux>& me,
+      uint8_t* buffer,
+      size_t size) {
+    std::shared_ptr<MidiInLinux> locked(me.lock());
+    if (locked) {
+      if (locked->data_available_ != nullptr) {
+        locked->data_available_(buffer, size);
+      }
+    }
+    delete [] buffer;
+  }
+
+  static void OnConnectionClosed(const std::weak_ptr<MidiInLinux>& me) {
+    std::shared_ptr<MidiInLinux> locked(me.lock());
+    if (locked && locked->on_closed_ != nullptr)
+      locked->on_closed_();
+  }
+
+  // IoEventHandler implementation.  Called on the I/O thread.
+  virtual void OnIoEvent(uint32_t events) {
+    if (events & EPOLLIN) {
+      int available = 0;
+      size_t size = kDefaultReadSize;
+      if (ioctl(fd_, FIONREAD, &available) == 0 && available > 0)
+        size = std::min(static_cast<size_t>(available), kMaxReadSize);
+      unique_ptr<uint8_t[]> buffer(new uint8_t[size]);
+      ssize_t bytes_read = read(fd_, buffer.get(), size);
+      if (bytes_read > 0) {
+        shared_ptr<base::ThreadLoop> worker(worker_.lock());
+        if (!worker)
+          return;
+        worker->QueueTask(std::bind(&MidiInLinux::OnProcessBuffer, weak_this_,
+                                    buffer.release(),
+                                    static_cast<size_t>(bytes_read)));
+        return;
+      }
+
+      if (bytes_read == -1 && (errno == EAGAIN || errno == EINTR))
+        return;
+    } else if (!(events & (EPOLLHUP | EPOLLERR))) {
+      return;
+    }
+
+    // EOF or error.  The other end has gone away.
+    std::cerr << "Midi input closed: " << device_->name() << "\n";
+    MidiIoThread::instance()->Unwatch(fd_);
+    shared_ptr<base::ThreadLoop> worker(worker_.lock());
+    if (worker) {
+      worker->QueueTask(std::bind(&MidiInLinux::OnConnectionClosed,
+                                  weak_this_));
+    }
+  }
+
+  int fd_;
+  std::weak_ptr<MidiInLinux> weak_this_;
+};
+
+// static
+shared_ptr<MidiIn> MidiIn::Create(
+    const shared_ptr<MidiDeviceInfo>& device,
+    const shared_ptr<base::ThreadLoop>& worker_thread) {
+  shared_ptr<MidiInLinux> ret(new MidiInLinux(device, worker_thread));
+  if (!ret->Init(ret))
+    ret.reset();
+  return ret;
+}
+
+// static
+bool MidiIn::EnumerateDevices(DeviceInfos* devices) {
+  std::vector<LinuxMidiPort> ports(GetLinuxMidiPorts());
+  for (size_t i = 0; i < ports.size(); ++i) {
+    devices->push_back(
+        shared_ptr<MidiDeviceInfo>(
+            new MidiDeviceInfo(static_cast<int>(i), ports[i].name)));
+  }
+  return true;
+}
+
+}  // namespace midi
@@ -0,0 +1,246 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "midi/midi_linux.h"
+
+#include "common/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <iostream>
+
+namespace midi {
+
+static const char kPortsVariable[] = "AFX2LG_MIDI_PORTS";
+
+namespace {
+
+void SplitString(const std::string& str, char separator,
+                 std::vector<std::string>* out) {
+  std::string::size_type begin = 0;
+  while (begin <= str.length()) {
+    std::string::size_type end = str.find(separator, begin);
+    if (end == std::string::npos)
+      end = str.length();
+    if (end > begin)
+      out->push_back(str.substr(begin, end - begin));
+    begin = end + 1;
+  }
+}
+
+bool SetNonBlocking(int fd) {
+  int flags = fcntl(fd, F_GETFL);
+  return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+int ConnectUnixSocket(const std::string& path) {
+  sockaddr_un addr = {0};
+  addr.sun_family = AF_UNIX;
+  if (path.length() >= sizeof(addr.sun_path))
+    return -1;
+  memcpy(addr.sun_path, path.c_str(), path.length());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return -1;
+
+  if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      !SetNonBlocking(fd)) {
+    close(fd);
+    return -1;
+  }
+
+  return fd;
+}
+
+}  // namespace
+
+std::vector<LinuxMidiPort> GetLinuxMidiPorts() {
+  std::vector<LinuxMidiPort> ports;
+  const char* env = getenv(kPortsVariable);
+  if (!env)
+    return ports;
+
+  std::vector<std::string> entries;
+  SplitString(env, ';', &entries);
+  for (const auto& e : entries) {
+    LinuxMidiPort port;
+    std::string paths;
+    std::string::size_type eq = e.find('=');
+    if (eq == std::string::npos) {
+      paths = e;
+    } else {
+      port.name = e.substr(0, eq);
+      paths = e.substr(eq + 1);
+    }
+
+    std::string::size_type comma = paths.find(',');
+    if (comma == std::string::npos) {
+      port.in_path = paths;
+      port.out_path = paths;
+    } else {
+      port.in_path = paths.substr(0, comma);
+      port.out_path = paths.substr(comma + 1);
+    }
+
+    if (port.in_path.empty() || port.out_path.empty()) {
+      std::cerr << "Ignoring malformed midi port: " << e << "\n";
+      continue;
+    }
+
+    if (port.name.empty())
+      port.name = paths;
+
+    ports.push_back(port);
+  }
+
+  return ports;
+}
+
+int OpenLinuxMidiPort(const std::string& path, bool for_input) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return -1;
+
+  if (S_ISSOCK(st.st_mode))
+    return ConnectUnixSocket(path);
+
+  // FIFOs are opened read/write regardless of direction so that the open
+  // call doesn't block waiting for the other end and so that we don't get
+  // a constant EOF while there's no writer.
+  int flags = O_NONBLOCK | O_NOCTTY | O_CLOEXEC;
+  flags |= (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode)) ?
+      O_RDWR : (for_input ? O_RDONLY : O_WRONLY);
+  int fd = open(path.c_str(), flags);
+  if (fd == -1)
+    return -1;
+
+  if (isatty(fd)) {
+    // Make sure the line discipline doesn't interpret or buffer the data.
+    termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+  }
+
+  return fd;
+}
+
+MidiIoThread::MidiIoThread()
+    : epoll_(epoll_create1(EPOLL_CLOEXEC)),
+      wakeup_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      dispatching_(NULL) {
+  ASSERT(epoll_ != -1);
+  ASSERT(wakeup_ != -1);
+  epoll_event ev = {0};
+  ev.events = EPOLLIN;
+  ev.data.fd = wakeup_;
+  epoll_ctl(epoll_, EPOLL_CTL_ADD, wakeup_, &ev);
+  thread_ = std::thread(&MidiIoThread::ThreadMain, this);
+}
+
+MidiIoThread::~MidiIoThread() {
+  uint64_t one = 1;
+  if (write(wakeup_, &one, sizeof(one)) == sizeof(one))
+    thread_.join();
+  else
+    thread_.detach();
+  close(wakeup_);
+  close(epoll_);
+}
+
+// static
+MidiIoThread* MidiIoThread::instance() {
+  // Function local statics aren't thread safe in our builds
+  // (-fno-threadsafe-statics), and ports can be opened from any thread.
+  // The instance is never deleted so that the thread can't go away under
+  // ports that are closed during static destruction.
+  static std::once_flag once;
+  static MidiIoThread* io_thread = NULL;
+  std::call_once(once, [] { io_thread = new MidiIoThread(); });
+  return io_thread;
+}
+
+bool MidiIoThread::Watch(int fd, uint32_t events, IoEventHandler* handler) {
+  std::lock_guard<std::mutex> lock(lock_);
+  ASSERT(handlers_.find(fd) == handlers_.end());
+  epoll_event ev = {0};
+  ev.events = events;
+  ev.data.fd = fd;
+  if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev) != 0)
+    return false;
+  handlers_[fd] = handler;
+  return true;
+}
+
+bool MidiIoThread::Modify(int fd, uint32_t events) {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (handlers_.find(fd) == handlers_.end())
+    return false;
+  epoll_event ev = {0};
+  ev.events = events;
+  ev.data.fd = fd;
+  return epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void MidiIoThread::Unwatch(int fd) {
+  std::unique_lock<std::mutex> lock(lock_);
+  auto found = handlers_.find(fd);
+  if (found == handlers_.end())
+    return;
+  IoEventHandler* handler = found->second;
+  epoll_ctl(epoll_, EPOLL_CTL_DEL, fd, NULL);
+  handlers_.erase(found);
+
+  // A handler that unwatches itself is already on the stack of the I/O
+  // thread, so there's nothing to wait for.
+  if (std::this_thread::get_id() == thread_.get_id())
+    return;
+  while (dispatching_ == handler)
+    dispatch_done_.wait(lock);
+}
+
+void MidiIoThread::ThreadMain() {
+  base::SetTraceThreadName("midi I/O");
+  epoll_event events[16];
+  while (true) {
+    int count = epoll_wait(epoll_, &events[0], arraysize(events), -1);
+    if (count == -1) {
+      if (errno == EINTR)
+        continue;
+      std::cerr << "epoll_wait failed: " << errno << "\n";
+      return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+      if (events[i].data.fd == wakeup_)
+        return;
+
+      std::unique_lock<std::mutex> lock(lock_);
+      auto found = handlers_.find(events[i].data.fd);
+      if (found == handlers_.end())
+        continue;
+      // Unwatch() waits while |dispatching_| points to the handler, which
+      // keeps it alive while we call it without the lock.
+      IoEventHandler* handler = found->second;
+      dispatching_ = handler;
+      lock.unlock();
+      handler->OnIoEvent(events[i].events);
+      lock.lock();
+      dispatching_ = NULL;
+      dispatch_done_.notify_all();
+    }
+  }
+}
+
+}  // namespace midi
@@ -0,0 +1,92 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#pragma once
+#ifndef MIDI_MIDI_LINUX_H_
+#define MIDI_MIDI_LINUX_H_
+
+#include "common/common_types.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace midi {
+
+// The Linux midi backend doesn't talk to ALSA.  Instead it exchanges raw midi
+// bytes over a file descriptor, which can be a Unix domain socket, a FIFO
+// or a (pseudo) terminal.  Since sysex messages are delimited by F0/F7 bytes,
+// no additional framing is needed on the wire.
+//
+// The available ports are read from the AFX2LG_MIDI_PORTS environment
+// variable.  The variable contains a ';' separated list of entries on the
+// form "[name=]path" or "[name=]in_path,out_path".  The second form is
+// useful with FIFOs, since those are unidirectional.  If the name is omitted,
+// the path is used as the name.  Example:
+//
+//   AFX2LG_MIDI_PORTS="AXE-FX II=/tmp/axefx.sock"
+//
+// MidiIn and MidiOut each open their own connection to the path.
+struct LinuxMidiPort {
+  std::string name;
+  std::string in_path;
+  std::string out_path;
+};
+
+// Returns the list of ports configured in the environment.  The index of
+// a port in the returned list is used as the MidiDeviceInfo id.
+std::vector<LinuxMidiPort> GetLinuxMidiPorts();
+
+// Opens |path| for non-blocking reading or writing, depending on |for_input|.
+// Returns -1 on failure.
+int OpenLinuxMidiPort(const std::string& path, bool for_input);
+
+// Receives readiness notifications from MidiIoThread.
+class IoEventHandler {
+ public:
+  virtual ~IoEventHandler() {}
+  virtual void OnIoEvent(uint32_t events) = 0;
+};
+
+// A single epoll driven thread that services all open midi ports.
+// Handlers are called on the I/O thread, without holding any of the
+// thread's locks, so a slow handler doesn't hold up Watch() or Unwatch() for
+// other ports.
+class MidiIoThread {
+ public:
+  MidiIoThread();
+  ~MidiIoThread();
+
+  // The thread is created on first use and lives until the process exits.
+  static MidiIoThread* instance();
+
+  // |events| is a combination of EPOLLIN/EPOLLOUT.
+  bool Watch(int fd, uint32_t events, IoEventHandler* handler);
+  bool Modify(int fd, uint32_t events);
+
+  // After Unwatch returns, the handler will not be called again for |fd|.
+  // If the handler is being called on the I/O thread, Unwatch waits for it
+  // to return.  Can be called from within a handler.
+  void Unwatch(int fd);
+
+ private:
+  void ThreadMain();
+
+  int epoll_;
+  int wakeup_;  // eventfd used to stop the thread.
+  std::mutex lock_;
+  std::map<int, IoEventHandler*> handlers_;
+  // The handler that the I/O thread is calling, if any.
+  IoEventHandler* dispatching_;
+  std::condition_variable dispatch_done_;
+  std::thread thread_;
+
+  DISALLOW_COPY_AND_ASSIGN(MidiIoThread);
+};
+
+}  // namespace midi
+
+#endif  // MIDI_MIDI_LINUX_H_
@@ -3,11 +3,21 @@
 
 #include "midi/midi_out.h"
 
+#include "common/metrics.h"
+#include "common/trace.h"
+
 #include <algorithm>
 
 namespace midi {
 
-#if !defined(OS_WIN) && !defined(OS_MACOSX)
+static base::Counter g_bytes_out("midi.out.bytes");
+static base::Counter g_messages_out("midi.out.messages");
+// Messages that were cancelled or couldn't be sent.
+static base::Counter g_failed_messages("midi.out.failed_messages");
+static base::Gauge g_pending("midi.out.pending");
+static base::Histogram g_send_latency("midi.out.send_latency_us");
+
+#if !defined(OS_WIN) && !defined(OS_MACOSX) && !defined(OS_LINUX)
 // static
 unique_ptr<MidiOut> MidiOut::Create(const shared_ptr<MidiDeviceInfo>& device) {
   return nullptr;
@@ -91,18 +101,87 @@ unique_ptr<MidiOut> MidiOut::OpenAxeFx() {
   return Create(*found);
 }
 
+MessageBufferOwner::MessageBufferOwner() : cancelled_(false) {}
+
 MessageBufferOwner::MessageBufferOwner(
     unique_ptr<Message>& message, const std::function<void()>& on_complete)
-    : on_complete_(on_complete), message_(std::move(message)) {
+    : cancelled_(false) {
+  Reset(message, on_complete);
+}
+
+MessageBufferOwner::MessageBufferOwner(MessageBufferOwner&& other)
+    : cancelled_(false) {
+  *this = std::move(other);
 }
 
 MessageBufferOwner::~MessageBufferOwner() {
-  if (on_complete_ != nullptr)
-    on_complete_();
+  if (message_)
+    Complete();
+}
+
+MessageBufferOwner& MessageBufferOwner::operator=(MessageBufferOwner&& other) {
+  ASSERT(!message_);
+  on_complete_ = std::move(other.on_complete_);
+  message_ = std::move(other.message_);
+  cancelled_ = other.cancelled_;
+  queued_ = other.queued_;
+  other.Clear();
+  return *this;
+}
+
+void MessageBufferOwner::Reset(unique_ptr<Message>& message,
+                               const std::function<void()>& on_complete) {
+  ASSERT(!message_);
+  ASSERT(message);
+  on_complete_ = on_complete;
+  message_ = std::move(message);
+  if (base::MetricsEnabled() || base::TracingEnabled()) {
+    queued_ = std::chrono::steady_clock::now();
+    g_pending.Add(1);
+  }
+}
+
+void MessageBufferOwner::Complete() {
+  ASSERT(message_);
+  if (!cancelled_ && queued_ != std::chrono::steady_clock::time_point()) {
+    auto now = std::chrono::steady_clock::now();
+    g_pending.Add(-1);
+    g_bytes_out.Add(message_->size());
+    g_messages_out.Add();
+    g_send_latency.Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - queued_).count());
+    // From the Send() call until the message is out, on the thread that
+    // completes it.
+    base::AddTraceEvent("midi", "MidiOut::Send", queued_, now, "bytes",
+                        static_cast<int64_t>(message_->size()));
+  }
+
+  // The owner is idle by the time the callback runs, so the callback can
+  // give it the next message.
+  std::function<void()> on_complete;
+  on_complete.swap(on_complete_);
+  Clear();
+  if (on_complete != nullptr)
+    on_complete();
 }
 
 void MessageBufferOwner::CancelCallback() {
+  if (cancelled_)
+    return;
+  cancelled_ = true;
+  on_complete_ = nullptr;
+  // The message won't be sent, so it only counts as failed.
+  g_failed_messages.Add();
+  if (queued_ != std::chrono::steady_clock::time_point())
+    g_pending.Add(-1);
+}
+
+void MessageBufferOwner::Clear() {
   on_complete_ = nullptr;
+  message_.reset();
+  cancelled_ = false;
+  queued_ = std::chrono::steady_clock::time_point();
 }
 
 }  // namespace midi
@@ -9,7 +9,9 @@
 
 #include "axefx/sysex_types.h"
 
+#include <chrono>
 #include <functional>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -76,7 +78,9 @@ class MidiOut {
   // Enumerate all midi output devices.
   static bool EnumerateDevices(DeviceInfos* devices);
 
-  // Send assumes ownership of the message.
+  // Send assumes ownership of the message.  |on_complete| is invoked on
+  // whichever thread the implementation completes sends on, and must not
+  // delete the MidiOut.
   virtual bool Send(unique_ptr<Message> message,
                     const std::function<void()>& on_complete) = 0;
 
@@ -88,18 +92,96 @@ class MidiOut {
 };
 
 // Used for owning a message buffer and deliver a callback when
-// a message has been sent.
+// a message has been sent.  Also keeps the midi.out metrics, since all
+// MidiOut implementations hand their messages to one of these.
+// Complete() (or deleting an owner that holds a message) means that the
+// message has been sent, unless CancelCallback() has been called, in which
+// case the message counts as failed.
+//
+// An owner is idle once it has completed, and can then be given the next
+// message with Reset().  Implementations keep owners in their send queue or
+// in a FreeList so that sending doesn't allocate in the steady state.
 class MessageBufferOwner {
  public:
+  MessageBufferOwner();
   MessageBufferOwner(unique_ptr<Message>& message,
                      const std::function<void()>& on_complete);
+  MessageBufferOwner(MessageBufferOwner&& other);
   ~MessageBufferOwner();
 
+  // Only idle owners can be assigned to.
+  MessageBufferOwner& operator=(MessageBufferOwner&& other);
+
+  // Takes ownership of the next message.  The owner must be idle.
+  void Reset(unique_ptr<Message>& message,
+             const std::function<void()>& on_complete);
+
+  // NULL when idle.
+  const Message* message() const { return message_.get(); }
+
+  // Releases the message and, unless cancelled, records it as sent and
+  // invokes the callback.  Leaves the owner idle.
+  void Complete();
   void CancelCallback();
 
  private:
+  void Clear();
+
+
   std::function<void()> on_complete_;
   unique_ptr<Message> message_;
+  bool cancelled_;
+  // Only set when metrics or tracing are enabled.
+  std::chrono::steady_clock::time_point queued_;
+
+  DISALLOW_COPY_AND_ASSIGN(MessageBufferOwner);
+};
+
+// A thread safe stack of objects that MidiOut implementations reuse for the
+// per-message state that the system APIs need, so that it isn't allocated
+// for every message.  Holds on to at most |max_size| objects.
+template <typename T>
+class FreeList {
+ public:
+  explicit FreeList(size_t max_size) : max_size_(max_size) {
+    items_.reserve(max_size);
+  }
+
+  ~FreeList() {
+    for (T* item : items_)
+      delete item;
+  }
+
+  // Returns a recycled object, or a new one if there are none.
+  T* Acquire() {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (!items_.empty()) {
+        T* item = items_.back();
+        items_.pop_back();
+        return item;
+      }
+    }
+    return new T();
+  }
+
+  void Release(T* item) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (items_.size() < max_size_) {
+        items_.push_back(item);
+        return;
+      }
+    }
+    delete item;
+  }
+
+ private:
+  std::mutex lock_;
+  std::vector<T*> items_;
+  const size_t max_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(FreeList);
 };
 
 }  // namespace midi
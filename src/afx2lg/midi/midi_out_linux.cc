@@ -0,0 +1,219 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "midi/midi_out.h"
+
+#include "common/ring_queue.h"
+#include "midi/midi_linux.h"
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+namespace midi {
+
+// Maximum number of queued messages handed to the kernel in one call.
+static const size_t kMaxMessagesPerWrite = 64;
+
+class MidiOutLinux : public MidiOut, public IoEventHandler {
+ public:
+  MidiOutLinux(const shared_ptr<MidiDeviceInfo>& device)
+      : MidiOut(device),
+        fd_(-1),
+        is_socket_(false),
+        write_pending_(false),
+        failed_(false) {
+    done_.reserve(kMaxMessagesPerWrite);
+  }
+
+  virtual ~MidiOutLinux() {
+    Close();
+  }
+
+  bool Init() {
+    std::vector<LinuxMidiPort> ports(GetLinuxMidiPorts());
+    if (device_->id() < 0 ||
+        static_cast<size_t>(device_->id()) >= ports.size()) {
+      return false;
+    }
+
+    fd_ = OpenLinuxMidiPort(ports[device_->id()].out_path, false);
+    if (fd_ == -1)
+      return false;
+
+    struct stat st;
+    is_socket_ = fstat(fd_, &st) == 0 && S_ISSOCK(st.st_mode);
+
+    // We only ask for EPOLLOUT while there's something in the queue.
+    return MidiIoThread::instance()->Watch(fd_, 0, this);
+  }
+
+  void Close() {
+    if (fd_ != -1) {
+      MidiIoThread::instance()->Unwatch(fd_);
+      close(fd_);
+      fd_ = -1;
+    }
+
+    std::vector<MessageBufferOwner> cancelled;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      cancelled.reserve(queue_.size());
+      while (!queue_.empty()) {
+        queue_.front().owner.CancelCallback();
+        cancelled.push_back(std::move(queue_.front().owner));
+        queue_.pop();
+      }
+    }
+    // The owners release their messages when |cancelled| goes away.
+  }
+
+  // MidiOut implementation.
+
+  virtual bool Send(unique_ptr<Message> message,
+                    const std::function<void()>& on_complete) {
+    ASSERT(!message->empty());
+
+    std::lock_guard<std::mutex> lock(lock_);
+    if (failed_) {
+      MessageBufferOwner owner(message, on_complete);
+      owner.CancelCallback();
+      return false;
+    }
+
+    // The queue reuses its slots, so this doesn't allocate once the queue
+    // has grown to the number of messages in flight.
+    queue_.push(Pending());
+    queue_[queue_.size() - 1].owner.Reset(message, on_complete);
+    if (!write_pending_) {
+      write_pending_ = true;
+      MidiIoThread::instance()->Modify(fd_, EPOLLOUT);
+    }
+
+    return true;
+  }
+
+ protected:
+  struct Pending {
+    Pending() : offset(0u) {}
+
+    size_t offset;
+    MessageBufferOwner owner;
+  };
+
+  // IoEventHandler implementation.  Called on the I/O thread.
+  virtual void OnIoEvent(uint32_t events) {
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (events & (EPOLLHUP | EPOLLERR)) {
+        OnError();
+      } else if (events & EPOLLOUT) {
+        Flush();
+      }
+    }
+
+    // Completion callbacks are issued without holding the lock since they
+    // typically queue up the next message.
+    for (auto& owner : done_)
+      owner.Complete();
+    done_.clear();
+  }
+
+  // Writes as much of the queue as the kernel will take in one go.
+  // Must be called while holding |lock_|.
+  void Flush() {
+    iovec iov[kMaxMessagesPerWrite];
+    size_t count = std::min(queue_.size(), kMaxMessagesPerWrite);
+    for (size_t i = 0; i < count; ++i) {
+      const Message& message = *queue_[i].owner.message();
+      iov[i].iov_base = const_cast<uint8_t*>(&message[queue_[i].offset]);
+      iov[i].iov_len = message.size() - queue_[i].offset;
+    }
+
+    ssize_t written;
+    if (is_socket_) {
+      msghdr msg = {0};
+      msg.msg_iov = &iov[0];
+      msg.msg_iovlen = count;
+      written = sendmsg(fd_, &msg, MSG_NOSIGNAL);
+    } else {
+      written = writev(fd_, &iov[0], static_cast<int>(count));
+    }
+
+    if (written == -1) {
+      if (errno != EAGAIN && errno != EINTR)
+        OnError();
+      return;
+    }
+
+    size_t remaining = static_cast<size_t>(written);
+    while (remaining && !queue_.empty()) {
+      Pending& p = queue_.front();
+      size_t left = p.owner.message()->size() - p.offset;
+      if (remaining < left) {
+        p.offset += remaining;
+        break;
+      }
+      remaining -= left;
+      done_.push_back(std::move(p.owner));
+      queue_.pop();
+    }
+
+    if (queue_.empty()) {
+      write_pending_ = false;
+      MidiIoThread::instance()->Modify(fd_, 0);
+    }
+  }
+
+  // Must be called while holding |lock_|.
+  void OnError() {
+    std::cerr << "Failed to write to midi output: " << device_->name() << "\n";
+    failed_ = true;
+    write_pending_ = false;
+    MidiIoThread::instance()->Unwatch(fd_);
+    while (!queue_.empty()) {
+      queue_.front().owner.CancelCallback();
+      done_.push_back(std::move(queue_.front().owner));
+      queue_.pop();
+    }
+  }
+
+  int fd_;
+  bool is_socket_;
+  std::mutex lock_;
+  base::RingQueue<Pending> queue_;
+  bool write_pending_;
+  bool failed_;
+  // Owners of the messages that have been written (or failed), waiting for
+  // their callbacks.  Only used on the I/O thread.
+  std::vector<MessageBufferOwner> done_;
+};
+
+// static
+unique_ptr<MidiOut> MidiOut::Create(const shared_ptr<MidiDeviceInfo>& device) {
+  unique_ptr<MidiOutLinux> ret(new MidiOutLinux(device));
+  if (!ret->Init())
+    ret.reset();
+  return std::move(ret);
+}
+
+// static
+bool MidiOut::EnumerateDevices(DeviceInfos* devices) {
+  std::vector<LinuxMidiPort> ports(GetLinuxMidiPorts());
+  for (size_t i = 0; i < ports.size(); ++i) {
+    devices->push_back(
+        shared_ptr<MidiDeviceInfo>(
+            new MidiDeviceInfo(static_cast<int>(i), ports[i].name)));
+  }
+  return true;
+}
+
+}  // namespace midi
@@ -12,6 +12,21 @@
 #include <iostream>
 
 namespace midi {
+
+namespace {
+
+// A message that has been handed to CoreMIDI.
+struct PendingSend {
+  MIDISysexSendRequest request;
+  MessageBufferOwner owner;
+};
+
+// Shared by all ports, since CoreMIDI may complete a send after the port
+// has been closed.
+FreeList<PendingSend> g_free_sends(256);
+
+}  // namespace
+
 class MidiOutMac : public MidiOut {
  public:
   MidiOutMac(const shared_ptr<MidiDeviceInfo>& device)
@@ -48,22 +63,23 @@ class MidiOutMac : public MidiOut {
                     const std::function<void()>& on_complete) {
     ASSERT(!message->empty());
 
-    MIDISysexSendRequest* sysex = new MIDISysexSendRequest();
+    PendingSend* send = g_free_sends.Acquire();
+    MIDISysexSendRequest* sysex = &send->request;
     memset(sysex, 0, sizeof(*sysex));
     sysex->destination = end_point_;
     sysex->data = &(message->at(0));
     sysex->bytesToSend = static_cast<UInt32>(message->size());
     sysex->complete = false;
     sysex->completionProc = &OnDone;
+    sysex->completionRefCon = send;
+    send->owner.Reset(message, on_complete);
 
-    auto owner = new MessageBufferOwner(message, on_complete);
-    sysex->completionRefCon = owner;
     OSStatus result = MIDISendSysex(sysex);
 
     if (result != noErr) {
-      owner->CancelCallback();
-      delete owner;
-      delete sysex;
+      send->owner.CancelCallback();
+      send->owner.Complete();
+      g_free_sends.Release(send);
     }
 
     return result == noErr;
@@ -71,10 +87,10 @@ class MidiOutMac : public MidiOut {
 
  protected:
   static void OnDone(MIDISysexSendRequest* request) {
-    MessageBufferOwner* buffer =
-        reinterpret_cast<MessageBufferOwner*>(request->completionRefCon);
-    delete buffer;
-    delete request;
+    PendingSend* send =
+        reinterpret_cast<PendingSend*>(request->completionRefCon);
+    send->owner.Complete();
+    g_free_sends.Release(send);
   }
 
   MIDIPortRef midi_out_;
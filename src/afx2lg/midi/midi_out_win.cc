@@ -10,6 +10,20 @@
 
 namespace midi {
 
+namespace {
+
+// A message that has been handed to the driver.
+struct PendingSend {
+  MIDIHDR header;
+  MessageBufferOwner owner;
+};
+
+// Shared by all ports, since the driver may complete a send after the port
+// has been closed.
+FreeList<PendingSend> g_free_sends(256);
+
+}  // namespace
+
 class MidiOutWin : public MidiOut {
  public:
   MidiOutWin(const shared_ptr<MidiDeviceInfo>& device)
@@ -41,12 +55,13 @@ class MidiOutWin : public MidiOut {
                     const std::function<void()>& on_complete) {
     ASSERT(!message->empty());
 
-    MIDIHDR* header = new MIDIHDR();
+    PendingSend* send = g_free_sends.Acquire();
+    MIDIHDR* header = &send->header;
+    memset(header, 0, sizeof(*header));
     header->dwBufferLength = static_cast<DWORD>(message->size());
     header->lpData = reinterpret_cast<char*>(&message->at(0));
-
-    auto owner = new MessageBufferOwner(message, on_complete);
-    header->dwUser = reinterpret_cast<DWORD_PTR>(owner);
+    header->dwUser = reinterpret_cast<DWORD_PTR>(send);
+    send->owner.Reset(message, on_complete);
 
     MMRESULT res = midiOutPrepareHeader(midi_out_, header,
                                         sizeof(*header));
@@ -54,9 +69,9 @@ class MidiOutWin : public MidiOut {
       res = midiOutLongMsg(midi_out_, header, sizeof(*header));
     
     if (res != MMSYSERR_NOERROR) {
-      owner->CancelCallback();
-      delete owner;
-      delete header;
+      send->owner.CancelCallback();
+      send->owner.Complete();
+      g_free_sends.Release(send);
     }
 
     return res == MMSYSERR_NOERROR;
@@ -64,12 +79,11 @@ class MidiOutWin : public MidiOut {
 
  protected:
   void OnDone(MIDIHDR* header) {
-    MessageBufferOwner* buffer =
-        reinterpret_cast<MessageBufferOwner*>(header->dwUser);
+    PendingSend* send = reinterpret_cast<PendingSend*>(header->dwUser);
     MMRESULT res = midiOutUnprepareHeader(midi_out_, header, sizeof(*header));
     ASSERT(res == MMSYSERR_NOERROR);
-    delete buffer;
-    delete header;
+    send->owner.Complete();
+    g_free_sends.Release(send);
   }
 
   void OnCallback(UINT msg, DWORD_PTR param1, DWORD_PTR param2) {
@@ -0,0 +1,254 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/preset.h"
+#include "bench/allocation_hook.h"
+#include "lg/lg_parser.h"
+#include "midi/midi_in.h"
+#include "midi/midi_out.h"
+#include "test/test_utils.h"
+
+#if defined(OS_LINUX)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <thread>
+#endif
+
+// Allocation budgets for steady state paths.  The numbers are upper bounds
+// rather than exact counts, but lowering one after an optimization is
+// encouraged so that regressions get caught.
+
+namespace {
+
+void* volatile g_sink = NULL;
+
+// Feeds data straight to the DataAvailable callback instead of going
+// through a driver thread.
+class FakeMidiIn : public midi::MidiIn {
+ public:
+  FakeMidiIn() : midi::MidiIn(nullptr, nullptr) {}
+
+  void Deliver(const uint8_t* data, size_t size) {
+    data_available_(data, size);
+  }
+};
+
+struct MessageCounter {
+  MessageCounter() : messages(0), bytes(0) {}
+
+  void OnSysEx(midi::Message* message) {
+    ++messages;
+    bytes += message->size();
+  }
+
+  void OnData(const std::vector<uint8_t>& data) {
+    ++messages;
+    bytes += data.size();
+  }
+
+  int messages;
+  size_t bytes;
+};
+
+std::vector<uint8_t> FramedMessage(size_t size) {
+  std::vector<uint8_t> data(size, 0x12);
+  data.front() = 0xF0;
+  data.back() = 0xF7;
+  return data;
+}
+
+class NullLgCallback : public lg::LgParserCallback {
+ public:
+  virtual const axefx::PresetMap& GetPresetMap() { return presets_; }
+  virtual void WriteLine(const char* line, size_t length) {}
+
+ private:
+  axefx::PresetMap presets_;
+};
+
+bool ParseBank(axefx::SysExParser* parser) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  return ReadTestFileIntoBuffer("axefx2/V12_Bank_A.syx", &buffer, &size) &&
+         parser->ParseSysExBuffer(buffer.get(), buffer.get() + size, true);
+}
+
+}  // namespace
+
+TEST(Allocation, ScopeCountsCallingThread) {
+  size_t outer_count, outer_bytes, inner_count, inner_bytes;
+  {
+    bench::AllocationScope outer;
+    // Stored in a volatile so that the compiler can't elide the allocations.
+    g_sink = new int(1);
+    delete static_cast<int*>(g_sink);
+    {
+      bench::AllocationScope inner;
+      g_sink = new char[100];
+      delete[] static_cast<char*>(g_sink);
+      inner_count = inner.count();
+      inner_bytes = inner.bytes();
+    }
+    outer_count = outer.count();
+    outer_bytes = outer.bytes();
+  }
+  EXPECT_EQ(1u, inner_count);
+  EXPECT_EQ(100u, inner_bytes);
+  EXPECT_EQ(2u, outer_count);
+  EXPECT_EQ(100u + sizeof(int), outer_bytes);
+}
+
+TEST(Allocation, SysExDataBufferOnData) {
+  MessageCounter counter;
+  midi::SysExDataBuffer buffer(
+      std::bind(&MessageCounter::OnSysEx, &counter, std::placeholders::_1));
+  shared_ptr<FakeMidiIn> midi_in(new FakeMidiIn());
+  buffer.Attach(midi_in);
+
+  // The first message grows the buffer.  After that, whole messages and
+  // messages split over several callbacks reuse it.
+  std::vector<uint8_t> message(FramedMessage(200));
+  midi_in->Deliver(&message[0], message.size());
+  ASSERT_EQ(1, counter.messages);
+
+  bench::AllocationScope allocations;
+  for (int i = 0; i < 10; ++i)
+    midi_in->Deliver(&message[0], message.size());
+  midi_in->Deliver(&message[0], 120);
+  midi_in->Deliver(&message[120], message.size() - 120);
+  size_t count = allocations.count();
+  EXPECT_EQ(0u, count);
+  EXPECT_EQ(12, counter.messages);
+  EXPECT_EQ(12 * message.size(), counter.bytes);
+}
+
+#if defined(OS_LINUX)
+namespace {
+
+// Small enough for std::function to store without allocating.
+struct CountCompletions {
+  void operator()() const { ++(*count); }
+  std::atomic<int>* count;
+};
+
+// Reads what the MidiOut writes until |expected| sends have completed.
+void DrainUntil(int fd, const std::atomic<int>& completed, int expected) {
+  uint8_t buffer[4096];
+  while (completed < expected) {
+    if (read(fd, &buffer[0], sizeof(buffer)) <= 0)
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+}  // namespace
+
+TEST(Allocation, MidiOutSend) {
+  std::string path("/tmp/afx2lg_alloc_test_" + std::to_string(getpid()));
+  unlink(path.c_str());
+  ASSERT_EQ(0, mkfifo(path.c_str(), 0600));
+  setenv("AFX2LG_MIDI_PORTS", ("AXE-FX Test=" + path).c_str(), 1);
+  unique_ptr<midi::MidiOut> midi_out(midi::MidiOut::OpenAxeFx());
+  unsetenv("AFX2LG_MIDI_PORTS");
+  ASSERT_TRUE(midi_out.get() != NULL);
+  int reader = open(path.c_str(), O_RDONLY | O_NONBLOCK);
+  int writer = open(path.c_str(), O_WRONLY | O_NONBLOCK);
+  ASSERT_NE(-1, reader);
+  ASSERT_NE(-1, writer);
+
+  // The messages are built up front, like axe_loader does.
+  const int kMessages = 100;
+  std::vector<uint8_t> data(FramedMessage(200));
+  std::vector<unique_ptr<midi::Message> > messages;
+  for (int i = 0; i < 2 * kMessages; ++i) {
+    messages.push_back(unique_ptr<midi::Message>(new midi::Message()));
+    messages.back()->assign(data.begin(), data.end());
+  }
+
+  std::atomic<int> completed(0);
+  CountCompletions count = { &completed };
+  std::function<void()> on_complete(count);
+
+  // Fill the FIFO so that the first round queues up every message, which
+  // grows the send queue to its steady state size.
+  while (write(writer, &data[0], data.size()) > 0) {}
+  for (int i = 0; i < kMessages; ++i)
+    ASSERT_TRUE(midi_out->Send(std::move(messages[i]), on_complete));
+  DrainUntil(reader, completed, kMessages);
+
+  // Counted for the whole process, since the sends complete on the I/O
+  // thread.
+  size_t allocations_before = bench::AllocationCount();
+  for (int i = kMessages; i < 2 * kMessages; ++i)
+    ASSERT_TRUE(midi_out->Send(std::move(messages[i]), on_complete));
+  DrainUntil(reader, completed, 2 * kMessages);
+  size_t allocations = bench::AllocationCount() - allocations_before;
+  EXPECT_EQ(0u, allocations);
+
+  midi_out.reset();
+  close(writer);
+  close(reader);
+  unlink(path.c_str());
+}
+#endif  // OS_LINUX
+
+TEST(Allocation, PresetSerialize) {
+  axefx::SysExParser parser;
+  ASSERT_TRUE(ParseBank(&parser));
+  const axefx::PresetMap& presets = parser.presets();
+  ASSERT_FALSE(presets.empty());
+  const axefx::Preset& preset = *presets.begin()->second;
+
+  MessageCounter counter;
+  axefx::SysExCallback callback(
+      std::bind(&MessageCounter::OnData, &counter, std::placeholders::_1));
+  ASSERT_TRUE(preset.Serialize(callback));
+  int messages_per_preset = counter.messages;
+
+  bench::AllocationScope allocations;
+  ASSERT_TRUE(preset.Serialize(callback));
+  size_t count = allocations.count();
+  EXPECT_EQ(2 * messages_per_preset, counter.messages);
+  // The header, the parameter values, the block buffer and the checksum,
+  // no matter how many parameter blocks are sent.
+  EXPECT_LE(count, 4u);
+}
+
+TEST(Allocation, LgParseBufferDoesNotCopyLines) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("lg2/input.txt", &buffer, &size));
+  std::string setup(reinterpret_cast<const char*>(buffer.get()), size);
+
+  // The same setup with every comment line made much longer.
+  std::string padded;
+  std::string::size_type pos = 0, eol;
+  while ((eol = setup.find('\n', pos)) != std::string::npos) {
+    padded.append(setup, pos, eol - pos);
+    if (setup[pos] == ';')
+      padded.append(200, '-');
+    padded += '\n';
+    pos = eol + 1;
+  }
+  ASSERT_GT(padded.size(), setup.size());
+
+  // Lines that aren't rewritten refer to the buffer, so what parsing
+  // allocates doesn't depend on how long they are.
+  size_t bytes[2];
+  const std::string* setups[] = { &setup, &padded };
+  for (int i = 0; i < 2; ++i) {
+    NullLgCallback callback;
+    lg::LgParser parser;
+    const char* begin = setups[i]->data();
+    bench::AllocationScope allocations;
+    ASSERT_TRUE(parser.ParseBuffer(&callback, begin,
+                                   begin + setups[i]->size()));
+    bytes[i] = allocations.bytes();
+  }
+  EXPECT_EQ(bytes[0], bytes[1]);
+}
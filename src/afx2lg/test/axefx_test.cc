@@ -4,13 +4,18 @@
 #include "gtest/gtest.h"
 
 #include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/bank_dump_tracker.h"
 #include "axefx/blocks.h"
 #include "axefx/ir_data.h"
+#include "axefx/param_converter.h"
 #include "axefx/preset.h"
+#include "axefx/schema.h"
 #include "axefx/sysex_types.h"
+#include "common/thread_pool.h"
 #include "json/writer.h"
 #include "test/test_utils.h"
 
+#include <algorithm>
 #include <functional>
 
 using std::placeholders::_1;
@@ -70,6 +75,7 @@ class ParserTestUtil {
   size_t preset_count() const { return parser_->presets().size(); }
   const PresetMap& presets() const { return parser_->presets(); }
   IRDataArray& ir_array() { return parser_->ir_array(); }
+  SysExParser* parser() { return parser_.get(); }
   int file_size() const { return file_size_; }
 
   static void SerializeCallback(const std::vector<uint8_t>& data,
@@ -187,6 +193,183 @@ TEST(FractalTypes, BlockSceneState) {
   EXPECT_EQ(y_enabled, state.IsConfigYEnabledInScene(1));
 }
 
+TEST(FractalTypes, IdLookups) {
+  // The lookups can be evaluated at compile time.
+  static_assert(GetBlockType(BLOCK_AMP_1) == BLOCK_TYPE_AMP, "");
+  static_assert(GetBlockIdByName(GetBlockName(BLOCK_CABINET_2)) ==
+                BLOCK_CABINET_2, "");
+  static_assert(GetParamIdByName(BLOCK_TYPE_AMP, "distort_type") ==
+                DISTORT_TYPE, "");
+
+  for (int id = 0; id <= BLOCK_SHUNT_200; ++id) {
+    AxeFxIIBlockID block = static_cast<AxeFxIIBlockID>(id);
+    const char* name = GetBlockName(block);
+    if (!name[0]) {
+      EXPECT_EQ(BLOCK_TYPE_INVALID, GetBlockType(block));
+      continue;
+    }
+    EXPECT_EQ(block, GetBlockIdByName(name)) << name;
+
+    AxeFxBlockType type = GetBlockType(block);
+    ASSERT_NE(BLOCK_TYPE_INVALID, type) << name;
+    EXPECT_EQ(type, GetBlockTypeByName(GetBlockTypeName(type))) << name;
+    // Blocks such as the mixer can't be bypassed.
+    int bypass_id = GetBlockBypassParamID(type);
+    if (bypass_id != -1) {
+      EXPECT_TRUE(GetParamName(type, bypass_id)[0]) << name;
+    }
+
+    int param_count = 0;
+    for (; GetParamName(type, param_count)[0]; ++param_count) {
+      EXPECT_EQ(param_count,
+                GetParamIdByName(type, GetParamName(type, param_count)));
+    }
+    EXPECT_GT(param_count, 0) << name;
+    EXPECT_EQ(-1, GetParamIdByName(type, "no_such_param"));
+  }
+
+  // Parameter names are only found for the block type they belong to.
+  EXPECT_EQ(-1, GetParamIdByName(BLOCK_TYPE_CAB, "distort_type"));
+  EXPECT_EQ(BLOCK_INVALID, GetBlockIdByName("Amp 3"));
+  EXPECT_EQ(BLOCK_TYPE_INVALID, GetBlockTypeByName(""));
+
+  for (int i = 0; GetAmpName(i)[0]; ++i)
+    EXPECT_EQ(i, GetAmpIdByName(GetAmpName(i))) << GetAmpName(i);
+  for (int i = 0; GetCabName(i)[0]; ++i)
+    EXPECT_EQ(i, GetCabIdByName(GetCabName(i))) << GetCabName(i);
+  EXPECT_EQ(-1, GetAmpIdByName("No Such Amp"));
+  EXPECT_EQ(-1, GetCabIdByName("No Such Cab"));
+}
+
+TEST(FractalTypes, FirmwareSchemas) {
+  EXPECT_EQ(NULL, FindSchema(0x00ff));
+  EXPECT_EQ(NULL, FindSchema(0x0300));
+  const FirmwareSchema* v7 = FindSchema(0x0202);
+  ASSERT_TRUE(v7 != NULL);
+  EXPECT_EQ(0x0202, v7->first_version);
+  // Older versions get the oldest schema and newer ones the newest.
+  EXPECT_EQ(v7, FindSchema(0x0100));
+  EXPECT_EQ(v7, FindSchema(0x0203));
+  const FirmwareSchema& latest = GetLatestSchema();
+  EXPECT_NE(v7, &latest);
+  EXPECT_EQ(&latest, FindSchema(0x0204));
+  EXPECT_EQ(&latest, FindSchema(0x020d));
+
+  // The newest schema is the one that axefx_ii_ids.h describes.
+  for (int type = 0; type < latest.block_type_count; ++type) {
+    AxeFxBlockType t = static_cast<AxeFxBlockType>(type);
+    EXPECT_EQ(GetBlockBypassParamID(t), latest.GetBypassParamID(t));
+    for (int id = 0; GetParamName(t, id)[0]; ++id)
+      EXPECT_STREQ(GetParamName(t, id), latest.GetParamName(t, id));
+  }
+
+  // Parameters that changed between firmware versions.
+  EXPECT_STREQ("distort_comp", v7->GetParamName(BLOCK_TYPE_AMP, 80));
+  EXPECT_STREQ("distort_predynamics", latest.GetParamName(BLOCK_TYPE_AMP, 80));
+  EXPECT_EQ(80, v7->GetParamIdByName(BLOCK_TYPE_AMP, "distort_comp"));
+  EXPECT_EQ(-1, v7->GetParamIdByName(BLOCK_TYPE_AMP, "distort_pickattack"));
+  EXPECT_EQ(12, v7->GetBypassParamID(BLOCK_TYPE_OUTPUT));
+  EXPECT_EQ(19, latest.GetBypassParamID(BLOCK_TYPE_OUTPUT));
+  EXPECT_STREQ("", v7->GetParamName(BLOCK_TYPE_MODIFIER, 0));
+  for (int id = 0; v7->GetParamName(BLOCK_TYPE_DELAY, id)[0]; ++id) {
+    EXPECT_EQ(id, v7->GetParamIdByName(BLOCK_TYPE_DELAY,
+                                       v7->GetParamName(BLOCK_TYPE_DELAY, id)));
+  }
+
+  // Ranges come from the 7.03 profile.
+  const ParamRange* range = v7->GetParamRange(BLOCK_TYPE_COMPRESSOR, 0, 0);
+  ASSERT_TRUE(range != NULL);
+  EXPECT_EQ(SCALE_LINEAR, range->scale);
+  EXPECT_EQ(-80.0, range->minimum);
+  EXPECT_EQ(0.0, range->maximum);
+  EXPECT_STREQ("dB", range->unit);
+  EXPECT_EQ(65534, range->max_raw_value);
+  range = v7->GetParamRange(BLOCK_TYPE_COMPRESSOR, 5, 0);
+  ASSERT_TRUE(range != NULL);
+  EXPECT_EQ(SCALE_INT, range->scale);
+  EXPECT_EQ(3, range->max_raw_value);
+  EXPECT_TRUE(v7->IsValidValue(BLOCK_TYPE_COMPRESSOR, 5, 0, 3));
+  EXPECT_FALSE(v7->IsValidValue(BLOCK_TYPE_COMPRESSOR, 5, 0, 4));
+  EXPECT_TRUE(latest.IsValidValue(BLOCK_TYPE_COMPRESSOR, 5, 0, 4));
+  EXPECT_EQ(NULL, latest.GetParamRange(BLOCK_TYPE_COMPRESSOR, 0, 0));
+
+  // Some amp types have their own ranges.
+  EXPECT_EQ(0, v7->GetVariantParamID(BLOCK_TYPE_AMP));
+  range = v7->GetParamRange(BLOCK_TYPE_AMP, 12, 15);
+  ASSERT_TRUE(range != NULL);
+  EXPECT_EQ(SCALE_LOG, range->scale);
+  EXPECT_EQ(100.0, range->minimum);
+  EXPECT_NE(range, v7->GetParamRange(BLOCK_TYPE_AMP, 12, 0));
+  EXPECT_EQ(v7->GetParamRange(BLOCK_TYPE_AMP, 12, 0),
+            v7->GetParamRange(BLOCK_TYPE_AMP, 12, 1));
+}
+
+TEST(FractalTypes, ParamConverter) {
+  const FirmwareSchema* v7 = FindSchema(0x0202);
+  ASSERT_TRUE(v7 != NULL);
+  ParamConverter converter(v7);
+
+  // Linear, -80 to 0 dB.
+  EXPECT_DOUBLE_EQ(-80.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 0, -1, 0));
+  EXPECT_DOUBLE_EQ(-40.0,
+                   converter.ToValue(BLOCK_TYPE_COMPRESSOR, 0, -1, 32767));
+  EXPECT_DOUBLE_EQ(0.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 0, -1, 65534));
+  EXPECT_EQ(32767, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 0, -1, -40.0));
+  EXPECT_EQ(0, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 0, -1, -100.0));
+  EXPECT_EQ(65534, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 0, -1, 10.0));
+  // Logarithmic, 10 to 1000 ms.
+  EXPECT_NEAR(10.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 3, -1, 0), 1e-9);
+  EXPECT_NEAR(100.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 3, -1, 32767),
+              1e-9);
+  EXPECT_NEAR(1000.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 3, -1, 65534),
+              1e-9);
+  EXPECT_EQ(32767, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 3, -1, 100.0));
+  EXPECT_EQ(0, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 3, -1, 0.0));
+  // List of choices.
+  EXPECT_EQ(2.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 5, -1, 2));
+  EXPECT_EQ(3, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 5, -1, 7.0));
+  // Unknown parameters keep their raw values.
+  EXPECT_EQ(1234.0, converter.ToValue(BLOCK_TYPE_COMPRESSOR, 100, -1, 1234));
+  EXPECT_EQ(65535, converter.ToRaw(BLOCK_TYPE_COMPRESSOR, 100, -1, 1e9));
+  ParamConverter latest(&GetLatestSchema());
+  EXPECT_EQ(1234.0, latest.ToValue(BLOCK_TYPE_COMPRESSOR, 0, -1, 1234));
+
+  // Amp type 15 has its own range for parameter 12.
+  EXPECT_NEAR(100.0, converter.ToValue(BLOCK_TYPE_AMP, 12, 15, 0), 1e-9);
+  EXPECT_NE(converter.ToValue(BLOCK_TYPE_AMP, 12, 0, 0),
+            converter.ToValue(BLOCK_TYPE_AMP, 12, 15, 0));
+
+  // The batch conversions match the scalar ones, for every parameter of
+  // every block type and both with and without a variant override.
+  const int kVariants[] = { -1, 0, 15, 85, 94 };
+  for (int type = 0; type < v7->block_type_count; ++type) {
+    AxeFxBlockType t = static_cast<AxeFxBlockType>(type);
+    // A few more than the block has, to cover unknown parameters.
+    size_t count = v7->block_types[type].param_count + 3;
+    for (size_t v = 0; v < arraysize(kVariants); ++v) {
+      std::vector<uint16_t> raw(count), round_trip(count);
+      std::vector<double> values(count);
+      for (size_t i = 0; i < count; ++i)
+        raw[i] = static_cast<uint16_t>((i * 7919 + type * 31) % 65535);
+      converter.ToValues(t, kVariants[v], &raw[0], count, &values[0]);
+      converter.ToRawValues(t, kVariants[v], &values[0], count,
+                            &round_trip[0]);
+      for (size_t i = 0; i < count; ++i) {
+        int id = static_cast<int>(i);
+        EXPECT_DOUBLE_EQ(converter.ToValue(t, id, kVariants[v], raw[i]),
+                         values[i]) << type << " " << id;
+        EXPECT_EQ(converter.ToRaw(t, id, kVariants[v], values[i]),
+                  round_trip[i]) << type << " " << id;
+        const ParamRange* range = v7->GetParamRange(t, id, kVariants[v]);
+        if (!range || (raw[i] <= range->max_raw_value &&
+                       range->minimum != range->maximum)) {
+          EXPECT_EQ(raw[i], round_trip[i]) << type << " " << id;
+        }
+      }
+    }
+  }
+}
+
 TEST_F(AxeFxII, ParseBankFile) {
   ASSERT_TRUE(ParseFile("axefx2/V7_Bank_A.syx"));
   EXPECT_EQ(SysExParser::PRESET_ARCHIVE, parser_.type());
@@ -217,6 +400,47 @@ TEST_F(AxeFxII, ParseFw9bBankFile) {
 #endif
 }
 
+TEST_F(AxeFxII, ParseBankFileOnThreadPool) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &buffer, &size));
+
+  SysExParser serial;
+  ASSERT_TRUE(serial.ParseSysExBuffer(buffer.get(), buffer.get() + size,
+                                      true));
+
+  base::ThreadPool pool(4);
+  SysExParser parallel;
+  parallel.set_thread_pool(&pool);
+  ASSERT_TRUE(parallel.ParseSysExBuffer(buffer.get(), buffer.get() + size,
+                                        true));
+  ASSERT_EQ(serial.presets().size(), parallel.presets().size());
+
+  PresetMap::const_iterator a = serial.presets().begin();
+  PresetMap::const_iterator b = parallel.presets().begin();
+  for (; a != serial.presets().end(); ++a, ++b) {
+    EXPECT_EQ(a->first, b->first);
+    EXPECT_EQ(a->second->name(), b->second->name());
+  }
+
+  std::vector<uint8_t> serialized_serial, serialized_parallel;
+  serial.Serialize(std::bind(&ParserTestUtil::SerializeCallback, _1,
+                             &serialized_serial));
+  parallel.Serialize(std::bind(&ParserTestUtil::SerializeCallback, _1,
+                               &serialized_parallel));
+  EXPECT_TRUE(serialized_serial == serialized_parallel);
+
+  // A damaged preset fails the whole buffer, just like in the serial case.
+  int offset = size / 2;
+  while (buffer[offset] & 0x80)
+    ++offset;
+  buffer[offset] ^= 0x01;
+  SysExParser damaged;
+  damaged.set_thread_pool(&pool);
+  EXPECT_FALSE(damaged.ParseSysExBuffer(buffer.get(), buffer.get() + size,
+                                        true));
+}
+
 TEST_F(AxeFxII, ParseMultipleBankFiles) {
   const char* files[] = {
     "axefx2/V7_Bank_A.syx",
@@ -270,6 +494,51 @@ TEST_F(AxeFxII, ParseFirmwareFileV10) {
 #endif
 }
 
+TEST_F(AxeFxII, PresetsUseSchemaOfTheirFirmware) {
+  ASSERT_TRUE(ParseFile("axefx2/V7_Bank_A.syx"));
+  const PresetMap& presets = parser_.presets();
+  ASSERT_FALSE(presets.empty());
+  for (const auto& p : presets) {
+    EXPECT_EQ(FindSchema(0x0202), &p.second->schema());
+    // Uses the bypass parameter of the firmware 7 output block, which has
+    // fewer parameters than the current one.
+    Json::Value json;
+    p.second->ToJson(&json);
+  }
+
+  parser_.Reset();
+  ASSERT_TRUE(ParseFile("axefx2/V12_Bank_A.syx"));
+  EXPECT_EQ(&GetLatestSchema(), &parser_.presets().begin()->second->schema());
+}
+
+TEST_F(AxeFxII, ConvertBlockValues) {
+  ASSERT_TRUE(ParseFile("axefx2/V7_Bank_A.syx"));
+  ParamConverter converter(FindSchema(0x0202));
+  size_t blocks = 0;
+  for (const auto& p : parser_.presets()) {
+    for (int id = kFirstBlockId; id <= BLOCK_TONE_MATCH; ++id) {
+      const BlockParameters* block =
+          p.second->LookupBlock(static_cast<AxeFxIIBlockID>(id));
+      if (!block)
+        continue;
+      ++blocks;
+      std::vector<double> values;
+      converter.BlockToValues(*block, true, &values);
+      ASSERT_FALSE(values.empty());
+      int variant_id = converter.schema().GetVariantParamID(block->type());
+      int variant = variant_id == -1 ? -1 :
+          block->GetParamValue(variant_id, true);
+      for (size_t i = 0; i < values.size(); ++i) {
+        int param = static_cast<int>(i);
+        uint16_t raw = block->GetParamValue(param, true);
+        EXPECT_DOUBLE_EQ(converter.ToValue(block->type(), param, variant, raw),
+                         values[i]);
+      }
+    }
+  }
+  EXPECT_LT(0u, blocks);
+}
+
 TEST_F(AxeFxII, ParsePresetFile) {
   ASSERT_TRUE(ParseFile("axefx2/p000318_DynamicJCM800.syx"));
   EXPECT_EQ(SysExParser::PRESET, parser_.type());
@@ -536,4 +805,188 @@ TEST_F(AxeFxII, SerializeIRFile) {
   }
 }
 
+TEST_F(AxeFxII, MemoryUsage) {
+  ASSERT_TRUE(ParseFile("axefx2/V12_Bank_A.syx"));
+  size_t preset_bytes = 0, preset_objects = 0;
+  for (const auto& entry: parser_.presets()) {
+    // The raw parameter data is released once a preset has been parsed.
+    EXPECT_EQ(0u, entry.second->params().capacity());
+    base::MemoryUsage usage = entry.second->MemoryUsage();
+    EXPECT_GT(usage.bytes, sizeof(Preset));
+    preset_bytes += usage.bytes;
+    preset_objects += usage.objects;
+  }
+
+  // Each preset also has a map node and a shared_ptr control block.
+  base::MemoryUsage usage = parser_.parser()->MemoryUsage();
+  EXPECT_GT(usage.bytes, preset_bytes);
+  EXPECT_EQ(1u + preset_objects + 2 * parser_.preset_count(), usage.objects);
+
+  parser_.Reset();
+  ASSERT_TRUE(ParseFile("axefx2/FreakIR.syx"));
+  ASSERT_EQ(1u, parser_.ir_array().size());
+  EXPECT_GE(parser_.ir_array()[0]->MemoryUsage().bytes,
+            parser_.ir_array()[0]->data().size() * sizeof(uint32_t));
+}
+
+TEST_F(AxeFxII, CompactKeepsData) {
+  const char* test_files[] = {
+    "axefx2/tone_match_preset.syx",
+    "axefx2/FreakIR.syx",
+    "axefx2/v10/axefx2_10p02.syx",
+  };
+
+  for (size_t i = 0; i < arraysize(test_files); ++i) {
+    ASSERT_TRUE(ParseFile(test_files[i]));
+    base::MemoryUsage before = parser_.parser()->MemoryUsage();
+    parser_.parser()->Compact();
+    base::MemoryUsage after = parser_.parser()->MemoryUsage();
+    EXPECT_LE(after.bytes, before.bytes);
+    EXPECT_LE(after.objects, before.objects);
+
+    std::vector<uint8_t> serialized;
+    parser_.Serialize(&serialized);
+    EXPECT_TRUE(parser_.MatchesFileContent(serialized, 0x70)) << test_files[i];
+    parser_.Reset();
+  }
+}
+
+namespace {
+// Feeds all messages in |data| to |tracker| and returns the number of
+// messages consumed before the tracker reported completion.
+size_t FeedTracker(const uint8_t* data, size_t size,
+                   BankDumpTracker* tracker) {
+  size_t messages = 0;
+  const uint8_t* begin = NULL;
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == kSysExStart) {
+      begin = &data[i];
+    } else if (data[i] == kSysExEnd) {
+      ++messages;
+      size_t msg_size = &data[i] - begin + 1;
+      auto header = reinterpret_cast<const FractalSysExHeader*>(begin);
+      switch (header->function()) {
+        case PRESET_ID:
+          tracker->OnPresetId(
+              static_cast<const PresetIdHeader*>(header)->id.As16bit());
+          break;
+        case PRESET_PARAMETERS:
+          tracker->OnParameterBlock();
+          break;
+        case PRESET_CHECKSUM:
+          tracker->OnChecksum(IsFractalSysEx(begin, msg_size));
+          break;
+        default:
+          break;
+      }
+      if (tracker->complete())
+        break;
+    }
+  }
+  return messages;
+}
+
+// Returns a pointer to the start of message number |index| in |data|.
+uint8_t* FindMessage(uint8_t* data, size_t size, size_t index) {
+  for (size_t i = 0; i < size; ++i) {
+    if (data[i] == kSysExStart && index-- == 0)
+      return &data[i];
+  }
+  return NULL;
+}
+
+// Makes the tracker skip the message by turning it into a heartbeat.
+void DropMessage(uint8_t* data, size_t size, size_t index) {
+  uint8_t* msg = FindMessage(data, size, index);
+  ASSERT_TRUE(msg != NULL);
+  msg[5] = TEMPO_HEARTBEAT;
+}
+}  // namespace
+
+TEST(BankDumpTracker, CompletesOnLastChecksum) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &buffer, &size));
+
+  BankDumpTracker tracker(BankDumpRequest::BANK_A);
+  size_t messages = FeedTracker(buffer.get(), size, &tracker);
+  EXPECT_TRUE(tracker.complete());
+  EXPECT_TRUE(tracker.all_received());
+  EXPECT_EQ(128, tracker.presets_received());
+  EXPECT_TRUE(tracker.failed_presets().empty());
+  EXPECT_EQ(128u * (kParameterBlocksPerPreset + 2), messages);
+
+  // The system bank uses the preset IDs 384-511.
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/system_backup.syx", &buffer,
+                                     &size));
+  BankDumpTracker system(BankDumpRequest::SYSTEM_BANK);
+  FeedTracker(buffer.get(), size, &system);
+  EXPECT_TRUE(system.all_received());
+}
+
+TEST(BankDumpTracker, RecordsFailedPresets) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &buffer, &size));
+  const size_t kMessagesPerPreset = kParameterBlocksPerPreset + 2;
+
+  // A parameter block missing from preset 5, the ID of preset 10, the
+  // checksum of preset 20 and all of preset 77.
+  DropMessage(buffer.get(), size, 5 * kMessagesPerPreset + 3);
+  DropMessage(buffer.get(), size, 10 * kMessagesPerPreset);
+  DropMessage(buffer.get(), size, 21 * kMessagesPerPreset - 1);
+  for (size_t i = 0; i < kMessagesPerPreset; ++i)
+    DropMessage(buffer.get(), size, 77 * kMessagesPerPreset + i);
+
+  BankDumpTracker tracker(BankDumpRequest::BANK_A);
+  FeedTracker(buffer.get(), size, &tracker);
+  EXPECT_TRUE(tracker.complete());
+  EXPECT_FALSE(tracker.all_received());
+  EXPECT_EQ(124, tracker.presets_received());
+  std::vector<int> failed(tracker.failed_presets());
+  int expected[] = { 5, 10, 20, 77 };
+  ASSERT_EQ(arraysize(expected), failed.size());
+  EXPECT_TRUE(std::equal(failed.begin(), failed.end(), &expected[0]));
+
+  // Feed a good copy of each failed preset, as if requested individually.
+  std::unique_ptr<uint8_t[]> good;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &good, &size));
+  for (int id : failed) {
+    tracker.Retry(id);
+    EXPECT_FALSE(tracker.complete());
+    const uint8_t* begin = FindMessage(good.get(), size,
+                                       id * kMessagesPerPreset);
+    const uint8_t* end = FindMessage(good.get(), size,
+                                     (id + 1) * kMessagesPerPreset);
+    ASSERT_TRUE(begin != NULL && end != NULL);
+    FeedTracker(begin, end - begin, &tracker);
+    EXPECT_TRUE(tracker.complete());
+  }
+  EXPECT_TRUE(tracker.all_received());
+}
+
+TEST(BankDumpTracker, TimeoutAndUnexpectedData) {
+  BankDumpTracker wrong_bank(BankDumpRequest::BANK_B);
+  EXPECT_FALSE(wrong_bank.OnPresetId(0));
+  EXPECT_FALSE(wrong_bank.complete());
+
+  BankDumpTracker tracker(BankDumpRequest::BANK_A);
+  EXPECT_FALSE(tracker.OnParameterBlock());
+  EXPECT_TRUE(tracker.OnPresetId(0));
+  EXPECT_TRUE(tracker.OnParameterBlock());
+  // Checksum before all parameter blocks have arrived.
+  EXPECT_FALSE(tracker.OnChecksum(true));
+  EXPECT_EQ(1u, tracker.failed_presets().size());
+  // A preset that's already been dealt with isn't accepted again.
+  EXPECT_FALSE(tracker.OnPresetId(0));
+
+  EXPECT_TRUE(tracker.OnPresetId(1));
+  EXPECT_FALSE(tracker.complete());
+  tracker.OnTimeout();
+  EXPECT_TRUE(tracker.complete());
+  EXPECT_EQ(0, tracker.presets_received());
+  EXPECT_EQ(static_cast<size_t>(kPresetsPerBank),
+            tracker.failed_presets().size());
+}
+
 }  // namespace axefx
@@ -0,0 +1,80 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "common/bounded_queue.h"
+
+#include <thread>
+
+namespace base {
+namespace {
+void Produce(BoundedQueue<int>* queue, int count) {
+  for (int i = 0; i < count; ++i)
+    queue->Push(i);
+  queue->Close();
+}
+}  // namespace
+
+TEST(BoundedQueue, PopAfterClose) {
+  BoundedQueue<int> queue(4);
+  EXPECT_TRUE(queue.Push(1));
+  EXPECT_TRUE(queue.Push(2));
+  queue.Close();
+  EXPECT_FALSE(queue.Push(3));
+
+  int i = 0;
+  EXPECT_TRUE(queue.Pop(&i));
+  EXPECT_EQ(1, i);
+  EXPECT_TRUE(queue.Pop(&i));
+  EXPECT_EQ(2, i);
+  EXPECT_FALSE(queue.Pop(&i));
+}
+
+TEST(BoundedQueue, ProducerBlocksWhenFull) {
+  // The producer has to wait for the consumer many times over, since the
+  // queue only has room for a couple of items.
+  BoundedQueue<int> queue(2);
+  std::thread producer(std::bind(&Produce, &queue, 1000));
+  int expected = 0;
+  int i;
+  while (queue.Pop(&i)) {
+    EXPECT_EQ(expected, i);
+    EXPECT_LE(queue.size(), queue.capacity());
+    ++expected;
+  }
+  producer.join();
+  EXPECT_EQ(1000, expected);
+}
+
+TEST(BoundedQueue, TryPushDoesNotBlock) {
+  BoundedQueue<unique_ptr<int> > queue(1);
+  unique_ptr<int> first(new int(1)), second(new int(2));
+  EXPECT_TRUE(queue.TryPush(&first));
+  EXPECT_TRUE(first.get() == NULL);
+  // Full.  The item stays with the caller.
+  EXPECT_FALSE(queue.TryPush(&second));
+  ASSERT_TRUE(second.get() != NULL);
+  EXPECT_EQ(2, *second);
+
+  unique_ptr<int> i;
+  EXPECT_TRUE(queue.Pop(&i));
+  EXPECT_EQ(1, *i);
+  EXPECT_TRUE(queue.TryPush(&second));
+  queue.Close();
+  unique_ptr<int> third(new int(3));
+  EXPECT_FALSE(queue.TryPush(&third));
+  EXPECT_TRUE(queue.Pop(&i));
+  EXPECT_EQ(2, *i);
+}
+
+TEST(BoundedQueue, MoveOnly) {
+  BoundedQueue<unique_ptr<int> > queue(1);
+  EXPECT_TRUE(queue.Push(unique_ptr<int>(new int(5))));
+  unique_ptr<int> i;
+  EXPECT_TRUE(queue.Pop(&i));
+  ASSERT_TRUE(i.get() != NULL);
+  EXPECT_EQ(5, *i);
+}
+
+}  // namespace base
@@ -0,0 +1,137 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "axefx/ir_data.h"
+#include "axefx/preset.h"
+#include "bench/corpus_generator.h"
+#include "test/test_utils.h"
+
+#include <map>
+#include <set>
+
+using std::placeholders::_1;
+
+namespace bench {
+namespace {
+
+using namespace axefx;
+
+void AppendTo(std::vector<uint8_t>* out, const std::vector<uint8_t>& data) {
+  out->insert(out->end(), data.begin(), data.end());
+}
+
+bool AddTemplateFile(CorpusGenerator* generator, const std::string& file) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  return ReadTestFileIntoBuffer(file, &buffer, &size) &&
+         generator->AddTemplates(buffer.get(), buffer.get() + size);
+}
+
+// Splits an archive into the messages of each preset, keyed by preset id.
+std::map<int, std::vector<uint8_t> > SplitPresets(
+    const std::vector<uint8_t>& data) {
+  std::map<int, std::vector<uint8_t> > presets;
+  std::vector<uint8_t>* current = NULL;
+  size_t begin = 0;
+  for (size_t i = 0; i < data.size(); ++i) {
+    if (data[i] == kSysExStart) {
+      begin = i;
+    } else if (data[i] == kSysExEnd) {
+      auto header =
+          reinterpret_cast<const FractalSysExHeader*>(&data[begin]);
+      if (i + 1 - begin >= sizeof(PresetIdHeader) &&
+          header->function() == PRESET_ID) {
+        current = &presets[
+            static_cast<const PresetIdHeader*>(header)->id.As16bit()];
+      }
+      if (current)
+        current->insert(current->end(), &data[begin], &data[i] + 1);
+    }
+  }
+  return presets;
+}
+
+bool AddTemplates(CorpusGenerator* generator) {
+  return AddTemplateFile(generator, "axefx2/V12_Bank_A.syx") &&
+         AddTemplateFile(generator, "axefx2/tone_match_preset.syx") &&
+         AddTemplateFile(generator, "axefx2/xy_test1.syx");
+}
+
+}  // namespace
+
+TEST(CorpusGenerator, GeneratesParsableArchive) {
+  CorpusGenerator generator(7);
+  ASSERT_TRUE(AddTemplates(&generator));
+  EXPECT_EQ(130u, generator.template_count());
+  generator.set_tone_match_percent(20);
+
+  // Start in bank C to check that the IDs wrap around.
+  std::vector<uint8_t> data;
+  ASSERT_TRUE(generator.GenerateArchive(300, kMaxPresetsPerFile, &data));
+
+  SysExParser parser;
+  ASSERT_TRUE(parser.ParseSysExBuffer(&data[0], &data[0] + data.size(), true));
+  ASSERT_EQ(kMaxPresetsPerFile, parser.presets().size());
+  EXPECT_EQ(0, parser.presets().begin()->first);
+  EXPECT_EQ(383, parser.presets().rbegin()->first);
+
+  std::set<std::string> names;
+  std::set<std::vector<uint16_t> > irs;
+  for (const auto& pair : parser.presets()) {
+    names.insert(pair.second->name());
+    if (!pair.second->ir_data().empty())
+      irs.insert(pair.second->ir_data());
+  }
+  EXPECT_GT(names.size(), kMaxPresetsPerFile / 2);
+  EXPECT_GT(irs.size(), 10u);
+
+  // The presets must survive another round trip unchanged.  The parser
+  // orders the presets by id, so compare them one by one.
+  std::vector<uint8_t> serialized;
+  parser.Serialize(std::bind(&AppendTo, &serialized, _1));
+  EXPECT_EQ(data.size(), serialized.size());
+  std::map<int, std::vector<uint8_t> > generated = SplitPresets(data);
+  std::map<int, std::vector<uint8_t> > round_trip = SplitPresets(serialized);
+  EXPECT_EQ(kMaxPresetsPerFile, generated.size());
+  ASSERT_EQ(generated.size(), round_trip.size());
+  for (const auto& pair : generated) {
+    auto found = round_trip.find(pair.first);
+    ASSERT_TRUE(found != round_trip.end()) << pair.first;
+    EXPECT_TRUE(pair.second == found->second) << pair.first;
+  }
+}
+
+TEST(CorpusGenerator, SeedDeterminesOutput) {
+  std::vector<uint8_t> outputs[3];
+  const unsigned int seeds[] = { 1, 1, 2 };
+  for (int i = 0; i < 3; ++i) {
+    CorpusGenerator generator(seeds[i]);
+    ASSERT_TRUE(AddTemplates(&generator));
+    ASSERT_TRUE(generator.GenerateArchive(0, 128, &outputs[i]));
+    unique_ptr<IRData> ir(generator.GenerateIR(5));
+    ir->Serialize(std::bind(&AppendTo, &outputs[i], _1));
+  }
+  EXPECT_TRUE(outputs[0] == outputs[1]);
+  EXPECT_FALSE(outputs[0] == outputs[2]);
+}
+
+TEST(CorpusGenerator, GeneratesIR) {
+  CorpusGenerator generator(3);
+  unique_ptr<IRData> ir(generator.GenerateIR(42));
+  EXPECT_EQ(42, ir->id());
+  EXPECT_NE(std::string::npos, ir->name().find(" IR 42"));
+
+  std::vector<uint8_t> data;
+  ir->Serialize(std::bind(&AppendTo, &data, _1));
+  SysExParser parser;
+  ASSERT_TRUE(parser.ParseSysExBuffer(&data[0], &data[0] + data.size(), true));
+  EXPECT_EQ(SysExParser::IR, parser.type());
+  ASSERT_EQ(1u, parser.ir_array().size());
+  EXPECT_EQ(ir->Checksum(), parser.ir_array()[0]->Checksum());
+  EXPECT_EQ(ir->name(), parser.ir_array()[0]->name());
+}
+
+}  // namespace bench
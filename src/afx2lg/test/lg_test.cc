@@ -4,10 +4,14 @@
 #include "gtest/gtest.h"
 
 #include "common/common_types.h"
+#include "lg/lg_hashes.h"
 #include "lg/lg_parser.h"
 #include "lg/lg_utils.h"
+#include "lg/lg_writer.h"
 #include "test_utils.h"
 
+#include <map>
+
 namespace lg {
 
 class MockCallback : public LgParserCallback {
@@ -26,6 +30,25 @@ class MockCallback : public LgParserCallback {
   std::vector<std::string> lines_;
 };
 
+class StringWriter : public BufferedLgWriter {
+ public:
+  explicit StringWriter(size_t buffer_size)
+      : BufferedLgWriter(buffer_size), writes_(0) {}
+  virtual ~StringWriter() {}
+
+  virtual const axefx::PresetMap& GetPresetMap() { return map_; }
+
+  virtual bool Write(const char* data, size_t size) {
+    output_.append(data, size);
+    ++writes_;
+    return true;
+  }
+
+  axefx::PresetMap map_;
+  std::string output_;
+  int writes_;
+};
+
 TEST(LittleGiant, BasicReadInputFile) {
   std::unique_ptr<uint8_t[]> buffer;
   int file_size;
@@ -41,6 +64,188 @@ TEST(LittleGiant, BasicReadInputFile) {
   EXPECT_FALSE(callback.lines_.empty());
 }
 
+TEST(LittleGiant, GenerateManyPatches) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int file_size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("lg2/input.txt", &buffer,
+                                     &file_size));
+  MockCallback callback;
+  const int kPresetCount = 200;
+  for (int i = 0; i < kPresetCount; ++i) {
+    shared_ptr<axefx::Preset> preset(new axefx::Preset());
+    preset->set_id(i);
+    preset->set_name("Preset " + std::to_string(i));
+    callback.map_[i] = preset;
+  }
+
+  LgParser parser;
+  EXPECT_TRUE(parser.ParseBuffer(&callback,
+      reinterpret_cast<const char*>(buffer.get()),
+      reinterpret_cast<const char*>(buffer.get()) + file_size));
+
+  // The four patches in the file are updated and the rest are added after
+  // them.  New banks go after the last bank, before the bank list.
+  std::map<std::string, int> patches;
+  int last_patch = -1, first_bank = -1, last_bank = -1, bank_list = -1;
+  for (size_t i = 0; i < callback.lines_.size(); ++i) {
+    const std::string& line = callback.lines_[i];
+    if (IsPatchStart(line.c_str())) {
+      std::string name;
+      ASSERT_TRUE(ParseEntryName(line, &name));
+      ++patches[name];
+      last_patch = static_cast<int>(i);
+    } else if (IsBankStart(line.c_str())) {
+      if (first_bank == -1)
+        first_bank = static_cast<int>(i);
+      last_bank = static_cast<int>(i);
+    } else if (IsBankListStart(line.c_str())) {
+      bank_list = static_cast<int>(i);
+    }
+  }
+
+  EXPECT_EQ(static_cast<size_t>(kPresetCount), patches.size());
+  for (int i = 0; i < kPresetCount; ++i)
+    EXPECT_EQ(1, patches["Preset " + std::to_string(i)]) << i;
+  EXPECT_LT(last_patch, first_bank);
+  EXPECT_LT(last_bank, bank_list);
+}
+
+TEST(LittleGiant, BufferedWriter) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int file_size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("lg2/input.txt", &buffer,
+                                     &file_size));
+  const char* begin = reinterpret_cast<const char*>(buffer.get());
+
+  MockCallback callback;
+  LgParser parser;
+  ASSERT_TRUE(parser.ParseBuffer(&callback, begin, begin + file_size));
+  std::string expected;
+  for (size_t i = 0; i < callback.lines_.size(); ++i)
+    expected += callback.lines_[i] + '\n';
+
+  // The whole file fits in the default buffer.
+  StringWriter writer(BufferedLgWriter::kDefaultBufferSize);
+  LgParser parser2;
+  ASSERT_TRUE(parser2.ParseBuffer(&writer, begin, begin + file_size));
+  EXPECT_EQ(0, writer.writes_);
+  EXPECT_TRUE(writer.Flush());
+  EXPECT_EQ(1, writer.writes_);
+  EXPECT_EQ(expected, writer.output_);
+
+  // A buffer that's smaller than some of the lines.
+  StringWriter small_writer(16);
+  LgParser parser3;
+  ASSERT_TRUE(parser3.ParseBuffer(&small_writer, begin, begin + file_size));
+  EXPECT_TRUE(small_writer.Flush());
+  EXPECT_GT(small_writer.writes_, 1);
+  EXPECT_EQ(expected, small_writer.output_);
+}
+
+namespace {
+void GenerateHashes(const std::string& setup, const axefx::PresetMap& presets,
+                    SetupHashes* hashes) {
+  MockCallback callback;
+  callback.map_ = presets;
+  LgParser parser;
+  ASSERT_TRUE(parser.ParseBuffer(&callback, setup.data(),
+                                 setup.data() + setup.size()));
+  parser.ComputeHashes(hashes);
+}
+}  // namespace
+
+TEST(LittleGiant, SetupHashes) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int file_size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("lg2/input.txt", &buffer,
+                                     &file_size));
+  std::string setup(reinterpret_cast<const char*>(buffer.get()), file_size);
+
+  axefx::PresetMap presets;
+  for (int i = 0; i < 20; ++i) {
+    shared_ptr<axefx::Preset> preset(new axefx::Preset());
+    preset->set_id(i);
+    preset->set_name("Preset " + std::to_string(i));
+    presets[i] = preset;
+  }
+
+  SetupHashes first, second;
+  GenerateHashes(setup, presets, &first);
+  GenerateHashes(setup, presets, &second);
+  EXPECT_FALSE(first.empty());
+  EXPECT_TRUE(second.CompareTo(first).empty());
+
+  // Renaming a preset replaces its patch and changes the bank it's in.
+  shared_ptr<axefx::Preset> renamed(new axefx::Preset());
+  renamed->set_id(12);
+  renamed->set_name("Renamed");
+  presets[12] = renamed;
+  SetupHashes third;
+  GenerateHashes(setup, presets, &third);
+  SetupHashes::Changes changes(third.CompareTo(first));
+  ASSERT_EQ(3u, changes.size());
+  EXPECT_EQ(SetupHashes::Change::REMOVED, changes[0].kind);
+  EXPECT_EQ(SetupHashes::PATCH, changes[0].type);
+  EXPECT_EQ("Preset 12", changes[0].name);
+  EXPECT_EQ(SetupHashes::Change::ADDED, changes[1].kind);
+  EXPECT_EQ("Renamed", changes[1].name);
+  EXPECT_EQ(SetupHashes::Change::CHANGED, changes[2].kind);
+  EXPECT_EQ(SetupHashes::BANK, changes[2].type);
+
+  // The hashes survive a round trip through a file.
+  const std::string path("lg_test_" + std::to_string(file_size) + ".hashes");
+  ASSERT_TRUE(third.Save(path));
+  SetupHashes loaded;
+  EXPECT_TRUE(loaded.Load(path));
+  remove(path.c_str());
+  EXPECT_TRUE(third.CompareTo(loaded).empty());
+  EXPECT_EQ(3u, loaded.CompareTo(first).size());
+  EXPECT_FALSE(loaded.Load(path));
+}
+
+TEST(LittleGiant, LineScanners) {
+  int channel = 0, cc = 0, value = 0;
+  EXPECT_TRUE(ParseCC("+ 01 CC    000 012", &channel, &cc, &value));
+  EXPECT_EQ(1, channel);
+  EXPECT_EQ(0, cc);
+  EXPECT_EQ(12, value);
+  EXPECT_TRUE(ParseCC("+ 02 CC 7 127 ; volume", &channel, &cc, &value));
+  EXPECT_EQ(7, cc);
+  EXPECT_EQ(127, value);
+  EXPECT_FALSE(ParseCC("+ 01 PC    003", &channel, &cc, &value));
+  EXPECT_FALSE(ParseCC("+ 01 CC    000", &channel, &cc, &value));
+  // Lines are given without their terminator.
+  EXPECT_FALSE(ParseCC("+ 01 CC    000 012\n", &channel, &cc, &value));
+
+  EXPECT_TRUE(ParseProgramChange("+ 01 PC    003    ", &channel, &value));
+  EXPECT_EQ(3, value);
+  EXPECT_FALSE(ParseProgramChange("+01 PC 003", &channel, &value));
+  EXPECT_FALSE(ParseProgramChange("+ 01 PC 003\r", &channel, &value));
+
+  std::string name;
+  EXPECT_TRUE(ParseEntryName("* PATCH : My Patch 1", &name));
+  EXPECT_EQ("My Patch 1", name);
+  EXPECT_TRUE(ParseEntryName("*  BANK   :   D1", &name));
+  EXPECT_EQ("D1", name);
+  EXPECT_FALSE(ParseEntryName("* PATCH : Bad-Name", &name));
+  EXPECT_FALSE(ParseEntryName("* PATCH :", &name));
+
+  std::string line("* PATCH : Old Name");
+  EXPECT_TRUE(ReplaceEntryName(&line, "New"));
+  EXPECT_EQ("* PATCH : New", line);
+
+  size_t pos = 0, length = 0;
+  line = "switch 12 : PA Clean Tone";
+  ASSERT_TRUE(FindSwitchPatchName(line, &pos, &length));
+  EXPECT_EQ("Clean Tone", line.substr(pos, length));
+  EXPECT_FALSE(FindSwitchPatchName("switch 12 : SB Clean", &pos, &length));
+  EXPECT_FALSE(FindSwitchPatchName("switch x : PA Clean", &pos, &length));
+
+  EXPECT_TRUE(IsDefaultPreset("DEFAULTPRESET PATCH 001", &name));
+  EXPECT_EQ("PATCH 001", name);
+  EXPECT_FALSE(IsDefaultPreset("DEFAULTPRESET", &name));
+}
+
 TEST(LittleGiant, UniqueName) {
   ReservedNames reserved;
   std::string name("MyName");
@@ -57,4 +262,37 @@ TEST(LittleGiant, UniqueName) {
   EXPECT_NE(reserved.find("myreallylongn128"), reserved.end());
 }
 
+TEST(LittleGiant, UniqueNameAllocator) {
+  UniqueNameAllocator names;
+  EXPECT_EQ("Clean", names.Allocate("Clean"));
+  EXPECT_EQ("Clean1", names.Allocate("Clean"));
+  // A preset that happens to have a generated name pushes the next one on.
+  EXPECT_EQ("Clean2", names.Allocate("Clean2"));
+  EXPECT_EQ("Clean3", names.Allocate("Clean"));
+  EXPECT_EQ("Clean11", names.Allocate("Clean1"));
+
+  // Matches what GenerateUniqueName() gives for the same set of names.
+  ReservedNames reserved;
+  std::string name("myreallylongname");
+  reserved.insert(names.Allocate(name));
+  for (size_t i = 0u; i < 1000u; ++i) {
+    std::string expected(GenerateUniqueName(reserved, name));
+    std::string allocated(names.Allocate(name));
+    ASSERT_EQ(expected, allocated);
+    EXPECT_LE(allocated.size(), kMaxNameLength);
+    reserved.insert(allocated);
+  }
+  EXPECT_NE(reserved.find("myreallylong1000"), reserved.end());
+}
+
+TEST(LittleGiant, CheckNameSizeLimit) {
+  std::string name("short name");
+  CheckNameSizeLimit(&name);
+  EXPECT_EQ("short name", name);
+
+  name = "a much  longer name";
+  CheckNameSizeLimit(&name);
+  EXPECT_EQ("aMuchLongerName", name);
+}
+
 }  // namespace lg
@@ -0,0 +1,155 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "axefx/axe_fx_sysex_parser.h"
+#include "common/metrics.h"
+#include "midi/midi_out.h"
+#include "test/test_utils.h"
+
+#include <sstream>
+
+namespace base {
+namespace {
+
+Counter g_test_counter("test.counter");
+Gauge g_test_gauge("test.gauge");
+Histogram g_test_histogram("test.histogram");
+
+const MetricSnapshot* Find(const std::vector<MetricSnapshot>& snapshots,
+                           const std::string& name) {
+  for (const auto& s : snapshots) {
+    if (s.name == name)
+      return &s;
+  }
+  return NULL;
+}
+
+class Metrics : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    ResetMetrics();
+    SetMetricsEnabled(true);
+  }
+
+  virtual void TearDown() {
+    SetMetricsEnabled(false);
+    ResetMetrics();
+  }
+};
+
+}  // namespace
+
+TEST_F(Metrics, DisabledMetricsDontChange) {
+  SetMetricsEnabled(false);
+  g_test_counter.Add(5);
+  g_test_gauge.Set(3);
+  g_test_histogram.Record(100);
+  {
+    ScopedHistogramTimer timer(&g_test_histogram);
+  }
+  EXPECT_EQ(0u, g_test_counter.value());
+  EXPECT_EQ(0, g_test_gauge.value());
+  EXPECT_EQ(0u, g_test_histogram.count());
+}
+
+TEST_F(Metrics, CounterAndGauge) {
+  g_test_counter.Add();
+  g_test_counter.Add(9);
+  EXPECT_EQ(10u, g_test_counter.value());
+
+  g_test_gauge.Add(4);
+  g_test_gauge.Add(-3);
+  g_test_gauge.Set(2);
+  EXPECT_EQ(2, g_test_gauge.value());
+  EXPECT_EQ(4, g_test_gauge.max());
+}
+
+TEST_F(Metrics, HistogramBuckets) {
+  EXPECT_EQ(0, Histogram::BucketIndex(0));
+  EXPECT_EQ(1, Histogram::BucketIndex(1));
+  EXPECT_EQ(2, Histogram::BucketIndex(3));
+  EXPECT_EQ(3, Histogram::BucketIndex(4));
+  EXPECT_EQ(Histogram::kBuckets - 1, Histogram::BucketIndex(~0ULL));
+
+  for (int i = 1; i <= 100; ++i)
+    g_test_histogram.Record(i);
+  EXPECT_EQ(100u, g_test_histogram.count());
+  EXPECT_EQ(5050u, g_test_histogram.sum());
+  EXPECT_EQ(100u, g_test_histogram.max());
+
+  std::vector<MetricSnapshot> snapshots(SnapshotMetrics());
+  const MetricSnapshot* s = Find(snapshots, "test.histogram");
+  ASSERT_TRUE(s != NULL);
+  EXPECT_EQ(Metric::HISTOGRAM, s->type);
+  EXPECT_EQ(100u, s->count);
+  // 50 falls in [32, 64) and 99 in [64, 128), capped by the max.
+  EXPECT_EQ(63u, s->Percentile(50));
+  EXPECT_EQ(100u, s->Percentile(99));
+}
+
+TEST_F(Metrics, SnapshotAndSummary) {
+  g_test_counter.Add(3);
+  std::vector<MetricSnapshot> snapshots(SnapshotMetrics());
+  for (size_t i = 1; i < snapshots.size(); ++i)
+    EXPECT_LT(snapshots[i - 1].name, snapshots[i].name);
+  const MetricSnapshot* s = Find(snapshots, "test.counter");
+  ASSERT_TRUE(s != NULL);
+  EXPECT_EQ(3, s->value);
+
+  // Only metrics that have been touched are in the summary.
+  std::ostringstream summary;
+  WriteMetricsSummary(&summary);
+  EXPECT_NE(std::string::npos, summary.str().find("test.counter: 3\n"));
+  EXPECT_EQ(std::string::npos, summary.str().find("test.gauge"));
+}
+
+TEST_F(Metrics, ParserCountsFrames) {
+  std::unique_ptr<uint8_t[]> buffer;
+  int size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V12_Bank_A.syx", &buffer, &size));
+  axefx::SysExParser parser;
+  ASSERT_TRUE(parser.ParseSysExBuffer(buffer.get(), buffer.get() + size,
+                                      true));
+
+  std::vector<MetricSnapshot> snapshots(SnapshotMetrics());
+  const MetricSnapshot* bytes = Find(snapshots, "axefx.parser.bytes");
+  const MetricSnapshot* frames = Find(snapshots, "axefx.parser.frames");
+  const MetricSnapshot* presets = Find(snapshots, "axefx.preset.finalized");
+  ASSERT_TRUE(bytes && frames && presets);
+  EXPECT_EQ(size, bytes->value);
+  EXPECT_GT(frames->value, 128);
+  EXPECT_EQ(128, presets->value);
+}
+
+TEST_F(Metrics, MidiOutCountsOnlyCompletedSends) {
+  int callbacks = 0;
+  std::function<void()> on_complete([&callbacks]() { ++callbacks; });
+  unique_ptr<midi::Message> sent(new midi::Message());
+  sent->resize(10);
+  unique_ptr<midi::Message> failed(new midi::Message());
+  failed->resize(20);
+  delete new midi::MessageBufferOwner(sent, on_complete);
+  midi::MessageBufferOwner* owner =
+      new midi::MessageBufferOwner(failed, on_complete);
+  owner->CancelCallback();
+  delete owner;
+  EXPECT_EQ(1, callbacks);
+
+  std::vector<MetricSnapshot> snapshots(SnapshotMetrics());
+  const MetricSnapshot* messages = Find(snapshots, "midi.out.messages");
+  const MetricSnapshot* bytes = Find(snapshots, "midi.out.bytes");
+  const MetricSnapshot* failures = Find(snapshots, "midi.out.failed_messages");
+  const MetricSnapshot* pending = Find(snapshots, "midi.out.pending");
+  const MetricSnapshot* latency =
+      Find(snapshots, "midi.out.send_latency_us");
+  ASSERT_TRUE(messages && bytes && failures && pending && latency);
+  EXPECT_EQ(1, messages->value);
+  EXPECT_EQ(10, bytes->value);
+  EXPECT_EQ(1, failures->value);
+  EXPECT_EQ(0, pending->value);
+  EXPECT_EQ(1u, latency->count);
+}
+
+}  // namespace base
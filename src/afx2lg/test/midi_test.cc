@@ -7,11 +7,20 @@
 
 #include "axefx/axe_fx_sysex_parser.h"
 #include "axefx/preset.h"
+#include "axefx/bank_dump_tracker.h"
 #include "axefx/sysex_types.h"
+#include "midi/device_session.h"
 #include "midi/midi_in.h"
 #include "midi/midi_out.h"
 #include "test_utils.h"
 
+#if defined(OS_LINUX)
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
 using base::ThreadLoop;
 using base::SharedThreadLoop;
 
@@ -101,6 +110,13 @@ void AssignToBufferAndQuit(Message* new_message,
   loop->Quit();
 }
 
+void TakeResponse(DeviceSession::Status* status, MessageList* received,
+                  DeviceSession::Status response_status,
+                  MessageList* response) {
+  *status = response_status;
+  received->swap(*response);
+}
+
 TEST(Midi, GetPresetName) {
   SharedThreadLoop loop(new ThreadLoop());
   shared_ptr<MidiIn> in_device(MidiIn::OpenAxeFx(loop));
@@ -108,35 +124,22 @@ TEST(Midi, GetPresetName) {
   unique_ptr<MidiOut> out_device(MidiOut::OpenAxeFx());
   ASSERT_TRUE(out_device.get() != NULL);
 
-  loop->set_timeout(std::chrono::milliseconds(5000));
-
-  axefx::GenericNoDataMessage request(axefx::PRESET_NAME);
-  unique_ptr<Message> message(new Message(&request, sizeof(request)));
-
-  Message data;
-  SysExDataBuffer buffer(
-      std::bind(&AssignToBufferAndQuit, _1, loop, &data));
-  buffer.Attach(in_device);
-  EXPECT_TRUE(out_device->Send(std::move(message), nullptr));
-
-  std::vector<uint8_t> received;
-  while (loop->Run()) {
-    if (IsTempoOrTuner(&data)) {
-      if (!received.empty())
-        break;
-    } else {
-      received.insert(received.end(), data.begin(), data.end());
-    }
-    data.clear();
-  }
-
-  ASSERT_FALSE(received.empty()) << "size: " << received.size();
-  ASSERT_TRUE(axefx::IsFractalSysEx(&received[0], received.size()));
-  auto p = reinterpret_cast<const axefx::FractalSysExHeader*>(&received[0]);
+  DeviceSession session(in_device, out_device.get(), loop);
+  DeviceSession::Status status = DeviceSession::CANCELLED;
+  MessageList received;
+  session.RequestPresetName(std::chrono::milliseconds(5000),
+                            std::bind(&TakeResponse, &status, &received,
+                                      _1, _2));
+  EXPECT_TRUE(session.Run());
+
+  ASSERT_EQ(DeviceSession::OK, status);
+  ASSERT_EQ(1u, received.size());
+  const Message& msg = *received[0];
+  auto p = reinterpret_cast<const axefx::FractalSysExHeader*>(&msg[0]);
   ASSERT_EQ(axefx::PRESET_NAME, p->function());
   std::string name(
       reinterpret_cast<const char*>(p + 1),
-      reinterpret_cast<const char*>(&received[received.size() - 2]));
+      reinterpret_cast<const char*>(&msg[msg.size() - 2]));
   EXPECT_FALSE(name.empty());
 #ifndef NDEBUG
   std::cout << "preset name: " << name << std::endl;
@@ -250,66 +253,39 @@ TEST(Midi, GetSystemBankDump) {
   unique_ptr<MidiOut> midi_out(MidiOut::OpenAxeFx());
   ASSERT_TRUE(midi_out.get() != NULL);
 
-  axefx::BankDumpRequest request(axefx::BankDumpRequest::SYSTEM_BANK);
-  unique_ptr<Message> message(new Message(&request, sizeof(request)));
-
-  // Set the timeout between buffer receives to be 1 second.
-  // We'll quit 1 second after receiving the last message.
-  loop->set_timeout(std::chrono::milliseconds(1000));
-  midi::Message data;
-  midi::SysExDataBuffer buffer(
-      std::bind(&AssignToBufferAndQuit, _1, loop, &data));
-  buffer.Attach(midi_in);
-
-  EXPECT_TRUE(midi_out->Send(std::move(message), nullptr));
-
-  std::vector<uint8_t> received;
-  while (loop->Run()) {
-    if (IsTempoOrTuner(&data)) {
-      if (!received.empty())
-        break;
-    } else {
-      received.insert(received.end(), data.begin(), data.end());
-    }
-    data.clear();
-  }
-
-  std::cout << "Received bytes: " << received.size() << std::endl;
+  DeviceSession session(midi_in, midi_out.get(), loop);
+  DeviceSession::Status status = DeviceSession::CANCELLED;
+  MessageList received;
+  session.RequestBankDump(axefx::BankDumpRequest::SYSTEM_BANK,
+                          std::chrono::milliseconds(1000),
+                          std::bind(&TakeResponse, &status, &received,
+                                    _1, _2));
+  EXPECT_TRUE(session.Run());
+  EXPECT_EQ(DeviceSession::OK, status);
+  EXPECT_EQ(static_cast<size_t>(axefx::kPresetsPerBank *
+                                (axefx::kParameterBlocksPerPreset + 2)),
+            received.size());
 }
 
 TEST(Midi, GetPresetDump) {
   SharedThreadLoop loop(new ThreadLoop());
-  // Set the timeout between buffer receives to be 1 second.
-  // We'll quit 1 second after receiving the last message.
-  loop->set_timeout(std::chrono::milliseconds(1000));
-
   shared_ptr<MidiIn> midi_in(MidiIn::OpenAxeFx(loop));
   ASSERT_TRUE(midi_in.get() != NULL);
   unique_ptr<MidiOut> midi_out(MidiOut::OpenAxeFx());
   ASSERT_TRUE(midi_out.get() != NULL);
 
-  axefx::PresetDumpRequest request;
-  unique_ptr<Message> message(new Message(&request, sizeof(request)));
-
-  midi::Message data;
-
-  midi::SysExDataBuffer buffer(
-      std::bind(&AssignToBufferAndQuit, _1, loop, &data));
-  buffer.Attach(midi_in);
-
-  EXPECT_TRUE(midi_out->Send(std::move(message), nullptr));
+  DeviceSession session(midi_in, midi_out.get(), loop);
+  DeviceSession::Status status = DeviceSession::CANCELLED;
+  MessageList messages;
+  session.RequestEditBufferDump(std::chrono::milliseconds(1000),
+                                std::bind(&TakeResponse, &status, &messages,
+                                          _1, _2));
+  EXPECT_TRUE(session.Run());
+  ASSERT_EQ(DeviceSession::OK, status);
 
   std::vector<uint8_t> received;
-  while (loop->Run()) {
-    if (IsTempoOrTuner(&data)) {
-      if (!received.empty())
-        break;
-    } else {
-      received.insert(received.end(), data.begin(), data.end());
-    }
-    data.clear();
-  }
-
+  for (const auto& m : messages)
+    received.insert(received.end(), m->begin(), m->end());
   ASSERT_FALSE(received.empty());
 
   axefx::SysExParser parser;
@@ -374,6 +350,11 @@ class MockMidiIn : public MidiIn {
       data_available_(data, size);
   }
 
+  void ReportClosed() {
+    if (on_closed_)
+      on_closed_();
+  }
+
   int message_count_;
 };
 
@@ -411,4 +392,325 @@ TEST(SysExDataBuffer, Basic) {
   }
 }
 
+namespace {
+class MockMidiOut : public MidiOut {
+ public:
+  MockMidiOut() : MidiOut(nullptr), fail_sends_(false) {}
+  ~MockMidiOut() {}
+
+  virtual bool Send(unique_ptr<Message> message,
+                    const std::function<void()>& on_complete) {
+    if (fail_sends_)
+      return false;
+    sent_.push_back(std::move(message));
+    if (on_complete)
+      on_complete();
+    return true;
+  }
+
+  std::vector<unique_ptr<Message> > sent_;
+  bool fail_sends_;
+};
+
+struct SessionResult {
+  SessionResult() : status(DeviceSession::CANCELLED), messages(0u),
+                    called(false) {}
+  DeviceSession::Status status;
+  size_t messages;
+  bool called;
+};
+
+void OnSessionResponse(SessionResult* result, DeviceSession::Status status,
+                       MessageList* response) {
+  EXPECT_FALSE(result->called);
+  result->called = true;
+  result->status = status;
+  result->messages = response->size();
+}
+
+void ReportMessage(MockMidiIn* midi_in, const axefx::FractalSysExHeader* msg,
+                   size_t size) {
+  midi_in->ReportBytes(reinterpret_cast<const uint8_t*>(msg), size);
+}
+
+// Builds a REPLY message for |reply_to| with the given error code.
+Message MakeReply(axefx::FunctionId reply_to, uint8_t error) {
+  axefx::GenericNoDataMessage header(axefx::REPLY);
+  Message reply(&header, sizeof(axefx::FractalSysExHeader));
+  reply.push_back(static_cast<uint8_t>(reply_to));
+  reply.push_back(error);
+  uint8_t checksum = 0;
+  for (auto b : reply)
+    checksum ^= b;
+  reply.push_back(checksum & 0x7F);
+  reply.push_back(axefx::kSysExEnd);
+  return reply;
+}
+}  // namespace
+
+TEST(DeviceSession, PipelinedRequests) {
+  std::unique_ptr<uint8_t[]> bank;
+  int bank_size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &bank,
+                                     &bank_size));
+
+  SharedThreadLoop loop(new ThreadLoop());
+  shared_ptr<MockMidiIn> midi_in(new MockMidiIn());
+  MockMidiOut midi_out;
+  DeviceSession session(midi_in, &midi_out, loop);
+
+  const std::chrono::milliseconds kTimeout(1000);
+  SessionResult name, preset, bank_dump;
+  session.RequestPresetName(kTimeout, std::bind(&OnSessionResponse, &name,
+                                                _1, _2));
+  session.RequestPresetDump(5, kTimeout,
+                            std::bind(&OnSessionResponse, &preset, _1, _2));
+  session.RequestBankDump(axefx::BankDumpRequest::BANK_A, kTimeout,
+                          std::bind(&OnSessionResponse, &bank_dump, _1, _2));
+  EXPECT_EQ(3u, midi_out.sent_.size());
+  EXPECT_EQ(3u, session.outstanding());
+
+  // Noise that doesn't belong to any of the requests.
+  axefx::GenericNoDataMessage tempo(axefx::TEMPO_HEARTBEAT);
+  ReportMessage(midi_in.get(), &tempo, sizeof(tempo));
+
+  // The bank dump arrives first.  Preset 5 is part of it and goes to both
+  // the preset dump and the bank dump.
+  midi_in->ReportBytes(bank.get(), bank_size);
+  EXPECT_TRUE(preset.called);
+  EXPECT_EQ(DeviceSession::OK, preset.status);
+  EXPECT_EQ(static_cast<size_t>(axefx::kParameterBlocksPerPreset + 2),
+            preset.messages);
+  EXPECT_TRUE(bank_dump.called);
+  EXPECT_EQ(DeviceSession::OK, bank_dump.status);
+  EXPECT_EQ(128u * (axefx::kParameterBlocksPerPreset + 2),
+            bank_dump.messages);
+  EXPECT_FALSE(name.called);
+
+  axefx::GenericNoDataMessage name_response(axefx::PRESET_NAME);
+  ReportMessage(midi_in.get(), &name_response, sizeof(name_response));
+  EXPECT_TRUE(name.called);
+  EXPECT_EQ(DeviceSession::OK, name.status);
+  EXPECT_EQ(1u, name.messages);
+  EXPECT_EQ(0u, session.outstanding());
+  EXPECT_TRUE(session.Run());
+}
+
+TEST(DeviceSession, TimeoutCancelAndErrors) {
+  SharedThreadLoop loop(new ThreadLoop());
+  shared_ptr<MockMidiIn> midi_in(new MockMidiIn());
+  MockMidiOut midi_out;
+  DeviceSession session(midi_in, &midi_out, loop);
+
+  SessionResult timed_out, cancelled, error;
+  session.RequestPresetName(std::chrono::milliseconds(10),
+      std::bind(&OnSessionResponse, &timed_out, _1, _2));
+  DeviceSession::RequestId id = session.RequestEditBufferDump(
+      std::chrono::milliseconds(10000),
+      std::bind(&OnSessionResponse, &cancelled, _1, _2));
+  session.SwitchToFirmwareUpdate(std::chrono::milliseconds(10000),
+      std::bind(&OnSessionResponse, &error, _1, _2));
+
+  EXPECT_TRUE(session.Cancel(id));
+  EXPECT_FALSE(session.Cancel(id));
+  EXPECT_TRUE(cancelled.called);
+  EXPECT_EQ(DeviceSession::CANCELLED, cancelled.status);
+
+  Message reply(MakeReply(axefx::FIRMWARE_UPDATE, 1));
+  midi_in->ReportBytes(&reply[0], reply.size());
+  EXPECT_TRUE(error.called);
+  EXPECT_EQ(DeviceSession::DEVICE_ERROR, error.status);
+  EXPECT_EQ(1u, error.messages);
+
+  EXPECT_FALSE(timed_out.called);
+  EXPECT_TRUE(session.Run());
+  EXPECT_TRUE(timed_out.called);
+  EXPECT_EQ(DeviceSession::TIMED_OUT, timed_out.status);
+  EXPECT_EQ(0u, timed_out.messages);
+}
+
+TEST(DeviceSession, SendFailure) {
+  SharedThreadLoop loop(new ThreadLoop());
+  shared_ptr<MockMidiIn> midi_in(new MockMidiIn());
+  MockMidiOut midi_out;
+  DeviceSession session(midi_in, &midi_out, loop);
+
+  SessionResult failed, sent;
+  midi_out.fail_sends_ = true;
+  session.RequestPresetName(std::chrono::milliseconds(10000),
+      std::bind(&OnSessionResponse, &failed, _1, _2));
+  midi_out.fail_sends_ = false;
+  session.RequestPresetName(std::chrono::milliseconds(10000),
+      std::bind(&OnSessionResponse, &sent, _1, _2));
+  EXPECT_FALSE(failed.called);
+
+  // The request that wasn't sent doesn't get the response.
+  axefx::GenericNoDataMessage name_response(axefx::PRESET_NAME);
+  ReportMessage(midi_in.get(), &name_response, sizeof(name_response));
+  EXPECT_TRUE(sent.called);
+  EXPECT_EQ(DeviceSession::OK, sent.status);
+  EXPECT_FALSE(failed.called);
+
+  EXPECT_TRUE(session.Run());
+  EXPECT_TRUE(failed.called);
+  EXPECT_EQ(DeviceSession::SEND_FAILED, failed.status);
+  EXPECT_EQ(0u, failed.messages);
+}
+
+TEST(DeviceSession, Disconnect) {
+  SharedThreadLoop loop(new ThreadLoop());
+  shared_ptr<MockMidiIn> midi_in(new MockMidiIn());
+  MockMidiOut midi_out;
+  DeviceSession session(midi_in, &midi_out, loop);
+
+  // Neither request should have to wait for its timeout.
+  SessionResult pending, later;
+  session.RequestPresetName(std::chrono::milliseconds(100000),
+      std::bind(&OnSessionResponse, &pending, _1, _2));
+  midi_in->ReportClosed();
+  EXPECT_TRUE(pending.called);
+  EXPECT_EQ(DeviceSession::DISCONNECTED, pending.status);
+
+  session.RequestPresetName(std::chrono::milliseconds(100000),
+      std::bind(&OnSessionResponse, &later, _1, _2));
+  EXPECT_EQ(1u, midi_out.sent_.size());
+  EXPECT_TRUE(session.Run());
+  EXPECT_TRUE(later.called);
+  EXPECT_EQ(DeviceSession::DISCONNECTED, later.status);
+}
+
+#if defined(OS_LINUX)
+namespace {
+void CountAndQuit(Message* msg, const shared_ptr<ThreadLoop>& loop,
+                  int* count) {
+  VerifyIsSysEx(msg);
+  ++(*count);
+  loop->Quit();
+}
+
+// Creates a listening Unix domain socket at |path| and points
+// AFX2LG_MIDI_PORTS to it.  Returns -1 on failure.
+int ListenForTestPort(const std::string& path) {
+  unlink(path.c_str());
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener == -1)
+    return -1;
+  sockaddr_un addr = {0};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 4) != 0) {
+    close(listener);
+    return -1;
+  }
+  setenv("AFX2LG_MIDI_PORTS", ("AXE-FX Test=" + path).c_str(), 1);
+  return listener;
+}
+}  // namespace
+
+// Talks to a fake device over a Unix domain socket, the same way the tools
+// would talk to a bridge process.
+TEST(MidiLinux, SocketTransport) {
+  std::string path("/tmp/afx2lg_midi_test_" + std::to_string(getpid()));
+  int listener = ListenForTestPort(path);
+  ASSERT_NE(-1, listener);
+
+  SharedThreadLoop loop(new ThreadLoop());
+  loop->set_timeout(std::chrono::milliseconds(5000));
+  shared_ptr<MidiIn> midi_in(MidiIn::OpenAxeFx(loop));
+  ASSERT_TRUE(midi_in.get() != NULL);
+  unique_ptr<MidiOut> midi_out(MidiOut::OpenAxeFx());
+  ASSERT_TRUE(midi_out.get() != NULL);
+  EXPECT_EQ("AXE-FX Test", midi_out->device()->name());
+
+  // MidiIn connects first.
+  int device_out = accept(listener, NULL, NULL);
+  int device_in = accept(listener, NULL, NULL);
+  ASSERT_NE(-1, device_out);
+  ASSERT_NE(-1, device_in);
+
+  // Host -> device.
+  axefx::PresetDumpRequest request;
+  EXPECT_TRUE(midi_out->Send(
+      unique_ptr<Message>(new Message(&request, sizeof(request))),
+      std::bind(&ThreadLoop::Quit, loop)));
+  EXPECT_TRUE(loop->Run());
+  uint8_t received[sizeof(request)] = {0};
+  EXPECT_EQ(static_cast<ssize_t>(sizeof(request)),
+            recv(device_in, &received[0], sizeof(received), MSG_WAITALL));
+  EXPECT_EQ(0, memcmp(&received[0], &request, sizeof(request)));
+
+  // Device -> host.  Send a whole bank and make sure it's framed correctly.
+  std::unique_ptr<uint8_t[]> buffer;
+  int file_size;
+  ASSERT_TRUE(ReadTestFileIntoBuffer("axefx2/V7_Bank_A.syx", &buffer,
+                                     &file_size));
+  int expected_count = 0;
+  for (int i = 0; i < file_size; ++i) {
+    if (buffer[i] == axefx::kSysExEnd)
+      ++expected_count;
+  }
+
+  int count = 0;
+  SysExDataBuffer sysex_buffer(std::bind(&CountAndQuit, _1, loop, &count));
+  ScopedBufferAttach attach(midi_in, &sysex_buffer);
+  std::thread writer([&]() {
+    send(device_out, buffer.get(), file_size, 0);
+  });
+  while (count < expected_count && loop->Run()) {}
+  writer.join();
+  EXPECT_EQ(expected_count, count);
+
+  // The device hanging up is reported on the worker.
+  bool closed = false;
+  midi_in->set_onclosed([&]() {
+    closed = true;
+    loop->Quit();
+  });
+  close(device_out);
+  while (!closed && loop->Run()) {}
+  EXPECT_TRUE(closed);
+
+  close(device_in);
+  close(listener);
+  unlink(path.c_str());
+  unsetenv("AFX2LG_MIDI_PORTS");
+}
+
+// Completion callbacks run on the I/O thread.  They must be free to wait for
+// another thread that opens a port, which needs the I/O thread's lock.
+TEST(MidiLinux, CallbackCanWaitForOpen) {
+  std::string path("/tmp/afx2lg_midi_test_" + std::to_string(getpid()));
+  int listener = ListenForTestPort(path);
+  ASSERT_NE(-1, listener);
+
+  SharedThreadLoop loop(new ThreadLoop());
+  loop->set_timeout(std::chrono::milliseconds(5000));
+  unique_ptr<MidiOut> midi_out(MidiOut::OpenAxeFx());
+  ASSERT_TRUE(midi_out.get() != NULL);
+  int device = accept(listener, NULL, NULL);
+  ASSERT_NE(-1, device);
+
+  shared_ptr<MidiIn> midi_in;
+  auto on_complete = [&]() {
+    std::thread opener([&]() { midi_in = MidiIn::OpenAxeFx(loop); });
+    opener.join();
+    loop->QueueTask(std::bind(&ThreadLoop::Quit, loop));
+  };
+  axefx::PresetDumpRequest request;
+  EXPECT_TRUE(midi_out->Send(
+      unique_ptr<Message>(new Message(&request, sizeof(request))),
+      on_complete));
+  EXPECT_TRUE(loop->Run());
+  EXPECT_TRUE(midi_in.get() != NULL);
+
+  midi_in.reset();
+  midi_out.reset();
+  close(device);
+  close(listener);
+  unlink(path.c_str());
+  unsetenv("AFX2LG_MIDI_PORTS");
+}
+#endif  // OS_LINUX
+
 }  // namespace midi
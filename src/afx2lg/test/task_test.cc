@@ -0,0 +1,120 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "common/ring_queue.h"
+#include "common/task.h"
+
+#include <functional>
+#include <string>
+
+namespace base {
+namespace {
+void Add(int* sum, int value) { *sum += value; }
+
+void AddOwned(int* sum, const unique_ptr<int>& value) { *sum += *value; }
+
+// Too big to be stored inline.
+struct AddArray {
+  AddArray(int* sum, int value) : sum_(sum) {
+    for (size_t i = 0; i < arraysize(values_); ++i)
+      values_[i] = value;
+  }
+  void operator()() const {
+    for (size_t i = 0; i < arraysize(values_); ++i)
+      *sum_ += values_[i];
+  }
+  int* sum_;
+  int values_[Task::kInlineSize / sizeof(int)];
+};
+
+// Counts how many copies of it are alive.
+struct Tracked {
+  explicit Tracked(int* alive) : alive_(alive) { ++(*alive_); }
+  Tracked(const Tracked& other) : alive_(other.alive_) { ++(*alive_); }
+  ~Tracked() { --(*alive_); }
+  void operator()() const {}
+  int* alive_;
+};
+}  // namespace
+
+TEST(Task, InlineAndHeapStorage) {
+  int sum = 0;
+  Task small(std::bind(&Add, &sum, 1));
+  EXPECT_TRUE(small.is_inline());
+  small();
+  EXPECT_EQ(1, sum);
+
+  const int kArraySize = Task::kInlineSize / sizeof(int);
+  Task big((AddArray(&sum, 1)));
+  EXPECT_FALSE(big.is_inline());
+  big();
+  EXPECT_EQ(1 + kArraySize, sum);
+
+  // Both kinds survive being moved around.
+  Task moved(std::move(small));
+  EXPECT_TRUE(small.is_null());
+  moved();
+  moved = std::move(big);
+  EXPECT_TRUE(big.is_null());
+  moved();
+  EXPECT_EQ(2 + 2 * kArraySize, sum);
+}
+
+TEST(Task, MoveOnlyCapture) {
+  int sum = 0;
+  unique_ptr<int> value(new int(5));
+  Task task(std::bind(&AddOwned, &sum, std::move(value)));
+  Task other;
+  other = std::move(task);
+  other();
+  EXPECT_EQ(5, sum);
+}
+
+TEST(Task, DestroysCallable) {
+  int alive = 0;
+  {
+    Task task((Tracked(&alive)));
+    EXPECT_EQ(1, alive);
+    Task moved(std::move(task));
+    EXPECT_EQ(1, alive);
+    moved = nullptr;
+    EXPECT_EQ(0, alive);
+    moved = Task(Tracked(&alive));
+    EXPECT_EQ(1, alive);
+  }
+  EXPECT_EQ(0, alive);
+}
+
+TEST(RingQueue, WrapAndGrow) {
+  RingQueue<std::string> queue(4);
+  EXPECT_TRUE(queue.empty());
+
+  // Go around the buffer a few times without growing it.
+  int next_in = 0, next_out = 0;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 3; ++i)
+      queue.push(std::to_string(next_in++));
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(std::to_string(next_out++), queue.front());
+      queue.pop();
+    }
+  }
+  EXPECT_EQ(4u, queue.capacity());
+
+  // Growing while wrapped keeps the order.
+  for (int i = 0; i < 11; ++i)
+    queue.push(std::to_string(next_in++));
+  EXPECT_EQ(11u, queue.size());
+  EXPECT_EQ(16u, queue.capacity());
+  for (size_t i = 0; i < queue.size(); ++i)
+    EXPECT_EQ(std::to_string(next_out + static_cast<int>(i)), queue[i]);
+  while (!queue.empty()) {
+    EXPECT_EQ(std::to_string(next_out++), queue.front());
+    queue.pop();
+  }
+  EXPECT_EQ(next_in, next_out);
+}
+
+}  // namespace base
@@ -17,6 +17,8 @@
       ],
       'dependencies': [
         '../axefx/axefx.gyp:axefx',
+        '../bench/bench.gyp:allocation_hook',
+        '../bench/bench.gyp:corpus_generator',
         '../common/base.gyp:base',
         '../jsoncpp/jsoncpp.gyp:*',
         '../gtest/gtest.gyp:gtest',
@@ -24,13 +26,20 @@
         '../midi/midi.gyp:midi',
       ],
       'sources': [
+        'allocation_test.cc',
         'axefx_test.cc',
+        'bounded_queue_test.cc',
+        'corpus_generator_test.cc',
         'lg_test.cc',
         'main.cc',
+        'metrics_test.cc',
         'midi_test.cc',
+        'task_test.cc',
         'test_utils.cc',
         'test_utils.h',
         'thread_loop_test.cc',
+        'thread_pool_test.cc',
+        'trace_test.cc',
       ],
     },
   ],
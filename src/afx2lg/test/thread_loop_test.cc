@@ -5,6 +5,8 @@
 
 #include "common/thread_loop.h"
 
+#include <vector>
+
 namespace base {
 namespace {
 template<typename T>
@@ -45,4 +47,115 @@ TEST(ThreadLoop, QueueTaskFromTask) {
   EXPECT_TRUE(loop.Run());
 }
 
+TEST(ThreadLoop, QueueMoveOnlyTask) {
+  struct Consume {
+    static void Run(ThreadLoop* loop, int* result, const unique_ptr<int>& i) {
+      *result = *i;
+      loop->Quit();
+    }
+  };
+  int result = 0;
+  ThreadLoop loop;
+  unique_ptr<int> value(new int(42));
+  loop.QueueTask(std::bind(&Consume::Run, &loop, &result, std::move(value)));
+  EXPECT_TRUE(loop.Run());
+  EXPECT_EQ(42, result);
+}
+
+namespace {
+void Append(std::vector<int>* v, int i) { v->push_back(i); }
+
+void CountAndQuitAfter(ThreadLoop* loop, int* count, int quit_after) {
+  if (++(*count) == quit_after)
+    loop->Quit();
+}
+
+// Keeps the loop busy until |*done| is set.
+void Spin(ThreadLoop* loop, const bool* done, int* count) {
+  ++(*count);
+  if (!*done)
+    loop->QueueTask(std::bind(&Spin, loop, done, count));
+}
+}  // namespace
+
+TEST(ThreadLoop, DelayedTasksRunInOrder) {
+  std::vector<int> order;
+  ThreadLoop loop;
+  loop.PostDelayedTask(std::bind(&ThreadLoop::Quit, &loop),
+                       std::chrono::milliseconds(30));
+  loop.PostDelayedTask(std::bind(&Append, &order, 2),
+                       std::chrono::milliseconds(20));
+  loop.PostDelayedTask(std::bind(&Append, &order, 1),
+                       std::chrono::milliseconds(10));
+  loop.QueueTask(std::bind(&Append, &order, 0));
+
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(loop.Run());
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(30));
+  ASSERT_EQ(3u, order.size());
+  EXPECT_EQ(0, order[0]);
+  EXPECT_EQ(1, order[1]);
+  EXPECT_EQ(2, order[2]);
+}
+
+TEST(ThreadLoop, CancelTimer) {
+  std::vector<int> order;
+  ThreadLoop loop;
+  ThreadLoop::TimerId id = loop.PostDelayedTask(std::bind(&Append, &order, 1),
+                                                std::chrono::milliseconds(1));
+  loop.PostDelayedTask(std::bind(&ThreadLoop::Quit, &loop),
+                       std::chrono::milliseconds(10));
+  EXPECT_TRUE(loop.CancelTimer(id));
+  EXPECT_FALSE(loop.CancelTimer(id));
+  EXPECT_TRUE(loop.Run());
+  EXPECT_TRUE(order.empty());
+}
+
+TEST(ThreadLoop, RepeatingTask) {
+  int count = 0;
+  ThreadLoop loop;
+  ThreadLoop::TimerId id = loop.PostRepeatingTask(
+      std::bind(&CountAndQuitAfter, &loop, &count, 3),
+      std::chrono::milliseconds(1));
+  EXPECT_TRUE(loop.Run());
+  EXPECT_EQ(3, count);
+  EXPECT_TRUE(loop.CancelTimer(id));
+
+  // Nothing should run after the timer has been cancelled.
+  loop.set_timeout(std::chrono::milliseconds(10));
+  EXPECT_FALSE(loop.Run());
+  EXPECT_EQ(3, count);
+}
+
+TEST(ThreadLoop, TimersRunWhileBusy) {
+  // The clock is only read between batches of tasks, but a loop that always
+  // has a task queued still gets to its timers.
+  bool done = false;
+  int spins = 0;
+  ThreadLoop loop;
+  ThreadLoop::TimerId cancelled = loop.PostDelayedTask(
+      std::bind(&Assign<int>, &spins, -1000000), std::chrono::milliseconds(1));
+  loop.PostDelayedTask(std::bind(&Assign<bool>, &done, true),
+                       std::chrono::milliseconds(5));
+  loop.PostDelayedTask(std::bind(&ThreadLoop::Quit, &loop),
+                       std::chrono::milliseconds(5));
+  EXPECT_TRUE(loop.CancelTimer(cancelled));
+  loop.QueueTask(std::bind(&Spin, &loop, &done, &spins));
+  EXPECT_TRUE(loop.Run());
+  EXPECT_TRUE(done);
+  EXPECT_LT(0, spins);
+}
+
+TEST(ThreadLoop, TimersKeepLoopAlive) {
+  // Delayed tasks count as activity, so the loop shouldn't time out while
+  // they keep coming.
+  int count = 0;
+  ThreadLoop loop;
+  loop.set_timeout(std::chrono::milliseconds(20));
+  loop.PostRepeatingTask(std::bind(&CountAndQuitAfter, &loop, &count, 10),
+                         std::chrono::milliseconds(5));
+  EXPECT_TRUE(loop.Run());
+}
+
 }  // namespace base
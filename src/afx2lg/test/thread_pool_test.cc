@@ -0,0 +1,112 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "common/thread_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <set>
+#include <thread>
+#include <vector>
+
+using std::placeholders::_1;
+
+namespace base {
+namespace {
+void Increment(std::vector<int>* counts, size_t index) {
+  ++(*counts)[index];
+}
+
+void Count(std::atomic<int>* count) {
+  ++(*count);
+}
+
+void SumRow(ThreadPool* pool, std::vector<std::atomic<int> >* sums,
+            size_t row) {
+  struct Cell {
+    static void Add(std::atomic<int>* sum, size_t column) {
+      *sum += static_cast<int>(column);
+    }
+  };
+  pool->ParallelFor(0, 100, std::bind(&Cell::Add, &(*sums)[row], _1));
+}
+
+void RecordThread(std::mutex* lock, std::set<std::thread::id>* ids) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  std::lock_guard<std::mutex> guard(*lock);
+  ids->insert(std::this_thread::get_id());
+}
+
+// Posts all the tasks from a single worker so that they start out in that
+// worker's queue.  The other workers have to steal to get any of them.
+void PostFromWorker(TaskGroup* group, std::mutex* lock,
+                    std::set<std::thread::id>* ids, int count) {
+  for (int i = 0; i < count; ++i)
+    group->PostTask(std::bind(&RecordThread, lock, ids));
+}
+}  // namespace
+
+TEST(ThreadPool, ParallelForVisitsEachIndexOnce) {
+  ThreadPool pool(4);
+  EXPECT_EQ(4u, pool.num_workers());
+
+  const size_t kSizes[] = { 0, 1, 3, 16, 17, 1000 };
+  for (size_t i = 0; i < arraysize(kSizes); ++i) {
+    std::vector<int> counts(kSizes[i] + 10, 0);
+    pool.ParallelFor(10, 10 + kSizes[i], std::bind(&Increment, &counts, _1));
+    for (size_t j = 0; j < counts.size(); ++j)
+      EXPECT_EQ(j < 10 ? 0 : 1, counts[j]) << "size=" << kSizes[i];
+  }
+}
+
+TEST(ThreadPool, NestedParallelFor) {
+  // With a single worker, the nested loops only complete if waiting threads
+  // help out with the queued work.
+  const size_t kWorkers[] = { 1, 3 };
+  for (size_t w = 0; w < arraysize(kWorkers); ++w) {
+    ThreadPool pool(kWorkers[w]);
+    std::vector<std::atomic<int> > sums(20);
+    for (size_t i = 0; i < sums.size(); ++i)
+      sums[i] = 0;
+    pool.ParallelFor(0, sums.size(), std::bind(&SumRow, &pool, &sums, _1));
+    for (size_t i = 0; i < sums.size(); ++i)
+      EXPECT_EQ(4950, sums[i]);
+  }
+}
+
+TEST(ThreadPool, TaskGroupWaitAndCancel) {
+  ThreadPool pool(2);
+  std::atomic<int> count(0);
+  {
+    TaskGroup group(&pool);
+    for (int i = 0; i < 50; ++i)
+      group.PostTask(std::bind(&Count, &count));
+    group.Wait();
+    EXPECT_EQ(50, count);
+  }
+
+  // Tasks posted after Cancel() never run, but Wait() still returns.
+  TaskGroup group(&pool);
+  group.Cancel();
+  EXPECT_TRUE(group.cancelled());
+  for (int i = 0; i < 50; ++i)
+    group.PostTask(std::bind(&Count, &count));
+  group.Wait();
+  EXPECT_EQ(50, count);
+}
+
+TEST(ThreadPool, WorkersStealTasks) {
+  ThreadPool pool(4);
+  std::mutex lock;
+  std::set<std::thread::id> ids;
+  TaskGroup group(&pool);
+  group.PostTask(std::bind(&PostFromWorker, &group, &lock, &ids, 40));
+  group.Wait();
+  // The sleep in each task gives the idle workers plenty of time to steal.
+  EXPECT_GT(ids.size(), 1u);
+}
+
+}  // namespace base
@@ -0,0 +1,72 @@
+// Copyright (c) 2013, Tomas Gunnarsson
+// All rights reserved.
+
+#include "gtest/gtest.h"
+
+#include "common/file_utils.h"
+#include "common/trace.h"
+
+#include <stdio.h>
+
+#include <thread>
+
+namespace base {
+namespace {
+
+const char kTraceFile[] = "afx2lg_trace_test.json";
+
+void TraceOnWorker() {
+  SetTraceThreadName("worker");
+  TRACE_EVENT1("test", "WorkerEvent", "value", 42);
+}
+
+}  // namespace
+
+// Tracing can only be started once per process, so everything is checked
+// from a single test.
+TEST(Trace, WritesEventsForEachThread) {
+  EXPECT_FALSE(TracingEnabled());
+  TRACE_EVENT0("test", "NotRecorded");
+
+  ASSERT_TRUE(StartTracing(kTraceFile));
+  EXPECT_TRUE(TracingEnabled());
+  EXPECT_FALSE(StartTracing(kTraceFile));
+  SetTraceThreadName("main");
+  {
+    TRACE_EVENT0("test", "MainEvent");
+    std::thread worker(&TraceOnWorker);
+    worker.join();
+  }
+  ASSERT_TRUE(StopTracing());
+  EXPECT_FALSE(TracingEnabled());
+  EXPECT_FALSE(StopTracing());
+
+  std::unique_ptr<uint8_t[]> buffer;
+  size_t size = 0;
+  ASSERT_TRUE(ReadFileIntoBuffer(kTraceFile, &buffer, &size));
+  remove(kTraceFile);
+  std::string trace(reinterpret_cast<char*>(buffer.get()), size);
+
+  EXPECT_EQ(0u, trace.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, trace.find("\"name\":\"MainEvent\""));
+  EXPECT_NE(std::string::npos, trace.find("\"name\":\"WorkerEvent\""));
+  EXPECT_NE(std::string::npos, trace.find("\"args\":{\"value\":42}"));
+  EXPECT_NE(std::string::npos, trace.find("\"args\":{\"name\":\"worker\"}"));
+  EXPECT_EQ(std::string::npos, trace.find("NotRecorded"));
+}
+
+TEST(Trace, TakeTraceArgument) {
+  char arg0[] = "tool";
+  char arg1[] = "-i=file.syx";
+  char arg2[] = "--trace=out.json";
+  char arg3[] = "-v";
+  char* argv[] = { arg0, arg1, arg2, arg3, NULL };
+  int argc = 4;
+  EXPECT_EQ("out.json", TakeTraceArgument(&argc, argv));
+  ASSERT_EQ(3, argc);
+  EXPECT_EQ(arg1, argv[1]);
+  EXPECT_EQ(arg3, argv[2]);
+  EXPECT_EQ(NULL, argv[3]);
+}
+
+}  // namespace base